@@ -184,6 +184,112 @@ static fsal_status_t fsal_readdir(struct fsal_obj_handle *dir_pub,
 	return fsal_status;
 }
 
+/**
+ * @brief Read a directory with the handles of its entries
+ *
+ * This function reads the contents of a directory as fsal_readdir
+ * does and passes each entry's handle to the supplied callback.
+ * ceph_readdirplus_r leaves the inodes of the entries in the client
+ * cache, so each handle is made from the inode found there by the
+ * number in the returned stat, with that stat as its attributes.
+ * Only an entry whose inode is already gone is looked up.
+ *
+ * @param[in]  dir_pub     The directory to read
+ * @param[in]  whence      The cookie indicating resumption, NULL to start
+ * @param[in]  dir_state   Opaque, passed to cb
+ * @param[in]  cb          Callback that receives directory entries
+ * @param[out] eof         True if there are no more entries
+ *
+ * @return FSAL status.
+ */
+
+static fsal_status_t fsal_readdir_plus(struct fsal_obj_handle *dir_pub,
+				       fsal_cookie_t *whence, void *dir_state,
+				       fsal_readdir_plus_cb cb, bool *eof)
+{
+	/* Generic status return */
+	int rc = 0;
+	/* The private 'full' export */
+	struct export *export =
+	    container_of(op_ctx->fsal_export, struct export, export);
+	/* The private 'full' directory handle */
+	struct handle *dir = container_of(dir_pub, struct handle, handle);
+	/* The director descriptor */
+	struct ceph_dir_result *dir_desc = NULL;
+	/* Cookie marking the start of the readdir */
+	uint64_t start = 0;
+	/* Return status */
+	fsal_status_t fsal_status = { ERR_FSAL_NO_ERROR, 0 };
+
+	rc = ceph_ll_opendir(export->cmount, dir->i, &dir_desc, 0, 0);
+	if (rc < 0)
+		return ceph2fsal_error(rc);
+
+	if (whence != NULL)
+		start = *whence;
+
+	ceph_seekdir(export->cmount, dir_desc, start);
+
+	while (!(*eof)) {
+		struct stat st;
+		struct dirent de;
+		int stmask = 0;
+		/* The entry's handle and the status of its lookup */
+		struct fsal_obj_handle *obj = NULL;
+		fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+		/* The entry's inode, found from its stat */
+		struct Inode *i;
+		struct handle *entry;
+		vinodeno_t vi;
+
+		rc = ceph_readdirplus_r(export->cmount, dir_desc, &de, &st,
+					&stmask);
+		if (rc < 0) {
+			fsal_status = ceph2fsal_error(rc);
+			goto closedir;
+		} else if (rc == 1) {
+			/* skip . and .. */
+			if ((strcmp(de.d_name, ".") == 0)
+			    || (strcmp(de.d_name, "..") == 0)) {
+				continue;
+			}
+
+			vi.ino.val = st.st_ino;
+			vi.snapid.val = st.st_dev;
+			i = ceph_ll_get_inode(export->cmount, vi);
+			if (i == NULL) {
+				status = lookup(dir_pub, de.d_name, &obj);
+			} else {
+				rc = construct_handle(&st, i, export, &entry);
+				if (rc < 0) {
+					ceph_ll_put(export->cmount, i);
+					status = ceph2fsal_error(rc);
+				} else {
+					obj = &entry->handle;
+				}
+			}
+
+			if (!cb(de.d_name, obj, status, dir_state, de.d_off))
+				goto closedir;
+
+		} else if (rc == 0) {
+			*eof = true;
+		} else {
+			/* Can't happen */
+			abort();
+		}
+	}
+
+ closedir:
+
+	rc = ceph_ll_releasedir(export->cmount, dir_desc);
+
+	if (rc < 0)
+		fsal_status = ceph2fsal_error(rc);
+
+	return fsal_status;
+}
+
 /**
  * @brief Create a regular file
  *
@@ -927,6 +1033,7 @@ void handle_ops_init(struct fsal_obj_ops *ops)
 	ops->create = fsal_create;
 	ops->mkdir = fsal_mkdir;
 	ops->readdir = fsal_readdir;
+	ops->readdir_plus = fsal_readdir_plus;
 	ops->symlink = fsal_symlink;
 	ops->readlink = fsal_readlink;
 	ops->getattrs = getattrs;
@@ -206,6 +206,127 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 	return status;
 }
 
+/**
+ * @brief Make the handle of an entry read by readdir_plus
+ *
+ * The stat from glfs_readdirplus_r carries no gfid, so the object is
+ * still got with glfs_h_lookupat, from the inode the readdirplus
+ * linked, but its attributes are the ones read with the entry.
+ */
+
+static fsal_status_t readdir_plus_entry(struct glusterfs_export *glfs_export,
+					struct glusterfs_handle *parenthandle,
+					const char *name, const struct stat *sb,
+					const char *vol_uuid,
+					struct fsal_obj_handle **handle)
+{
+	int rc = 0;
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+	struct glfs_object *glhandle = NULL;
+	unsigned char globjhdl[GFAPI_HANDLE_LENGTH] = {'\0'};
+	struct glusterfs_handle *objhandle = NULL;
+
+	glhandle =
+	    glfs_h_lookupat(glfs_export->gl_fs, parenthandle->glhandle, name,
+			    NULL);
+	if (glhandle == NULL) {
+		status = gluster2fsal_error(errno);
+		goto out;
+	}
+
+	rc = glfs_h_extract_handle(glhandle, globjhdl, GFAPI_HANDLE_LENGTH);
+	if (rc < 0) {
+		status = gluster2fsal_error(errno);
+		goto out;
+	}
+
+	rc = construct_handle(glfs_export, sb, glhandle, globjhdl,
+			      GLAPI_HANDLE_LENGTH, &objhandle, vol_uuid);
+	if (rc != 0) {
+		status = gluster2fsal_error(rc);
+		goto out;
+	}
+
+	*handle = &objhandle->handle;
+
+ out:
+	if (status.major != ERR_FSAL_NO_ERROR)
+		gluster_cleanup_vars(glhandle);
+
+	return status;
+}
+
+/**
+ * @brief Implements GLUSTER FSAL objectoperation readdir_plus
+ *
+ * Names are read with glfs_readdirplus_r, which links the inodes of
+ * the entries in gfapi, and each handle is made with the attributes
+ * read along with its name.
+ */
+
+static fsal_status_t readdir_plus(struct fsal_obj_handle *dir_hdl,
+				  fsal_cookie_t *whence, void *dir_state,
+				  fsal_readdir_plus_cb cb, bool *eof)
+{
+	int rc = 0;
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+	fsal_status_t entry_status;
+	struct glfs_fd *glfd = NULL;
+	long offset = 0;
+	struct dirent *pde = NULL;
+	struct fsal_obj_handle *obj;
+	char vol_uuid[GLAPI_UUID_LENGTH] = {'\0'};
+	struct glusterfs_export *glfs_export =
+	    container_of(op_ctx->fsal_export, struct glusterfs_export, export);
+	struct glusterfs_handle *objhandle =
+	    container_of(dir_hdl, struct glusterfs_handle, handle);
+
+	rc = glfs_get_volumeid(glfs_export->gl_fs, vol_uuid, GLAPI_UUID_LENGTH);
+	if (rc < 0)
+		return gluster2fsal_error(rc);
+
+	glfd = glfs_h_opendir(glfs_export->gl_fs, objhandle->glhandle);
+	if (glfd == NULL)
+		return gluster2fsal_error(errno);
+
+	if (whence != NULL)
+		offset = *whence;
+
+	glfs_seekdir(glfd, offset);
+
+	while (!(*eof)) {
+		struct dirent de;
+		struct stat sb;
+
+		rc = glfs_readdirplus_r(glfd, &sb, &de, &pde);
+		if (rc == 0 && pde != NULL) {
+			/* skip . and .. */
+			if ((strcmp(de.d_name, ".") == 0)
+			    || (strcmp(de.d_name, "..") == 0)) {
+				continue;
+			}
+			obj = NULL;
+			entry_status = readdir_plus_entry(glfs_export,
+							  objhandle, de.d_name,
+							  &sb, vol_uuid, &obj);
+			if (!cb(de.d_name, obj, entry_status, dir_state,
+				glfs_telldir(glfd)))
+				goto out;
+		} else if (rc == 0 && pde == NULL) {
+			*eof = true;
+		} else {
+			status = gluster2fsal_error(errno);
+			goto out;
+		}
+	}
+
+ out:
+	rc = glfs_closedir(glfd);
+	if (rc < 0)
+		status = gluster2fsal_error(errno);
+	return status;
+}
+
 /**
  * @brief Implements GLUSTER FSAL objectoperation create
  */
@@ -1159,6 +1280,158 @@ static fsal_status_t commit(struct fsal_obj_handle *obj_hdl,	/* sync */
 	return status;
 }
 
+/**
+ * @brief Context of an asynchronous gfapi call
+ */
+
+struct glusterfs_async_io {
+	struct fsal_obj_handle *obj_hdl;
+	struct fsal_io_arg *io;	/*< NULL for commit */
+	bool write;
+	fsal_async_cb done_cb;
+	void *caller_arg;
+};
+
+/**
+ * @brief Completion of glfs_pread_async/glfs_pwrite_async/glfs_fsync_async
+ *
+ * Called on a gfapi event thread.
+ */
+
+static void glusterfs_async_io_done(glfs_fd_t *glfd, ssize_t ret, void *data)
+{
+	struct glusterfs_async_io *aio = data;
+	struct glusterfs_handle *objhandle =
+	    container_of(aio->obj_hdl, struct glusterfs_handle, handle);
+	fsal_status_t status = { ERR_FSAL_NO_ERROR, 0 };
+
+	if (ret < 0) {
+		status = gluster2fsal_error(errno);
+	} else if (aio->io != NULL) {
+		aio->io->io_amount = ret;
+		if (!aio->write && ret < aio->io->io_size)
+			aio->io->end_of_file = true;
+		if (aio->write && (objhandle->openflags & FSAL_O_SYNC))
+			aio->io->fsal_stable = true;
+	}
+
+	aio->done_cb(aio->obj_hdl, status, aio->caller_arg);
+	gsh_free(aio);
+}
+
+static struct glusterfs_async_io *
+glusterfs_async_io_new(struct fsal_obj_handle *obj_hdl,
+		       struct fsal_io_arg *io, bool write,
+		       fsal_async_cb done_cb, void *caller_arg)
+{
+	struct glusterfs_async_io *aio = gsh_malloc(sizeof(*aio));
+
+	if (aio == NULL)
+		return NULL;
+
+	aio->obj_hdl = obj_hdl;
+	aio->io = io;
+	aio->write = write;
+	aio->done_cb = done_cb;
+	aio->caller_arg = caller_arg;
+	return aio;
+}
+
+/**
+ * @brief Implements GLUSTER FSAL objectoperation read_async
+ *
+ * READ_PLUS is left to the synchronous path.
+ */
+
+static fsal_status_t file_read_async(struct fsal_obj_handle *obj_hdl,
+				     struct fsal_io_arg *io,
+				     fsal_async_cb done_cb, void *caller_arg)
+{
+	struct glusterfs_handle *objhandle =
+	    container_of(obj_hdl, struct glusterfs_handle, handle);
+	struct glusterfs_async_io *aio;
+
+	if (io->info != NULL)
+		return fsalstat(ERR_FSAL_NOTSUPP, 0);
+
+	aio = glusterfs_async_io_new(obj_hdl, io, false, done_cb, caller_arg);
+	if (aio == NULL)
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+
+	io->io_amount = 0;
+	io->end_of_file = false;
+
+	if (glfs_pread_async(objhandle->glfd, io->buffer, io->io_size,
+			     io->offset, 0, glusterfs_async_io_done,
+			     aio) < 0) {
+		gsh_free(aio);
+		return gluster2fsal_error(errno);
+	}
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Implements GLUSTER FSAL objectoperation write_async
+ *
+ * WRITE_PLUS is left to the synchronous path.
+ */
+
+static fsal_status_t file_write_async(struct fsal_obj_handle *obj_hdl,
+				      struct fsal_io_arg *io,
+				      fsal_async_cb done_cb, void *caller_arg)
+{
+	struct glusterfs_handle *objhandle =
+	    container_of(obj_hdl, struct glusterfs_handle, handle);
+	struct glusterfs_async_io *aio;
+
+	if (io->info != NULL)
+		return fsalstat(ERR_FSAL_NOTSUPP, 0);
+
+	aio = glusterfs_async_io_new(obj_hdl, io, true, done_cb, caller_arg);
+	if (aio == NULL)
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+
+	io->io_amount = 0;
+
+	if (glfs_pwrite_async(objhandle->glfd, io->buffer, io->io_size,
+			      io->offset, io->fsal_stable ? O_SYNC : 0,
+			      glusterfs_async_io_done, aio) < 0) {
+		gsh_free(aio);
+		return gluster2fsal_error(errno);
+	}
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/**
+ * @brief Implements GLUSTER FSAL objectoperation commit_async
+ *
+ * Like commit, this syncs the entire file.
+ */
+
+static fsal_status_t commit_async(struct fsal_obj_handle *obj_hdl,
+				  off_t offset, size_t len,
+				  fsal_async_cb done_cb, void *caller_arg)
+{
+	struct glusterfs_handle *objhandle =
+	    container_of(obj_hdl, struct glusterfs_handle, handle);
+	struct glusterfs_async_io *aio;
+
+	aio = glusterfs_async_io_new(obj_hdl, NULL, false, done_cb,
+				     caller_arg);
+	if (aio == NULL)
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+
+	if (glfs_fsync_async(objhandle->glfd, glusterfs_async_io_done,
+			     aio) < 0) {
+		gsh_free(aio);
+		return gluster2fsal_error(errno);
+	}
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
 /**
  * @brief Implements GLUSTER FSAL objectoperation lock_op
  *
@@ -1556,6 +1829,10 @@ void handle_ops_init(struct fsal_obj_ops *ops)
 	ops->read = file_read;
 	ops->write = file_write;
 	ops->commit = commit;
+	ops->read_async = file_read_async;
+	ops->write_async = file_write_async;
+	ops->commit_async = commit_async;
+	ops->readdir_plus = readdir_plus;
 	ops->lock_op = lock_op;
 	ops->close = file_close;
 	ops->lru_cleanup = lru_cleanup;
@@ -833,21 +833,70 @@ static fsal_status_t linkfile(struct fsal_obj_handle *obj_hdl,
 	return fsalstat(fsal_error, retval);
 }
 
+/* lookup_at
+ * look up a name in a directory already open on dirfd, sparing the
+ * open of the directory by handle that lookup does
+ */
+
+static fsal_status_t lookup_at(struct vfs_fsal_obj_handle *parent_hdl,
+			       int dirfd, const char *name,
+			       struct fsal_obj_handle **handle)
+{
+	struct vfs_fsal_obj_handle *hdl;
+	struct fsal_filesystem *fs = parent_hdl->obj_handle.fs;
+	int retval;
+	struct stat stat;
+	vfs_file_handle_t *fh = NULL;
+	vfs_alloc_handle(fh);
+	fsal_dev_t dev;
+
+	*handle = NULL;		/* poison it first */
+
+	retval = fstatat(dirfd, name, &stat, AT_SYMLINK_NOFOLLOW);
+	if (retval < 0) {
+		retval = errno;
+		return fsalstat(posix2fsal_error(retval), retval);
+	}
+
+	dev = posix2fsal_devt(stat.st_dev);
+
+	if ((dev.minor != parent_hdl->dev.minor) ||
+	    (dev.major != parent_hdl->dev.major)) {
+		/* XDEV, lookup knows how to cross */
+		return lookup(&parent_hdl->obj_handle, name, handle);
+	}
+
+	if (vfs_name_to_handle(dirfd, fs, name, fh) < 0) {
+		retval = errno;
+		return fsalstat(posix2fsal_error(retval), retval);
+	}
+
+	hdl = alloc_handle(dirfd, fh, fs, &stat, parent_hdl->handle, name,
+			   op_ctx->fsal_export);
+	if (hdl == NULL)
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+
+	*handle = &hdl->obj_handle;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
 #define BUF_SIZE 1024
 /**
- * read_dirents
+ * read_entries
  * read the directory and call through the callback function for
- * each entry.
+ * each entry, with its handle if plus_cb is given.
  * @param dir_hdl [IN] the directory to read
  * @param whence [IN] where to start (next)
  * @param dir_state [IN] pass thru of state to callback
- * @param cb [IN] callback function
+ * @param cb [IN] callback function for names, or NULL
+ * @param plus_cb [IN] callback function for handles, or NULL
  * @param eof [OUT] eof marker true == end of dir
  */
 
-static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
+static fsal_status_t read_entries(struct fsal_obj_handle *dir_hdl,
 				  fsal_cookie_t *whence, void *dir_state,
-				  fsal_readdir_cb cb, bool *eof)
+				  fsal_readdir_cb cb,
+				  fsal_readdir_plus_cb plus_cb, bool *eof)
 {
 	struct vfs_fsal_obj_handle *myself;
 	int dirfd;
@@ -859,6 +908,8 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 	int nread;
 	struct vfs_dirent dentry, *dentryp = &dentry;
 	char buf[BUF_SIZE];
+	struct fsal_obj_handle *obj;
+	fsal_status_t status;
 
 	if (whence != NULL)
 		seekloc = (off_t) *whence;
@@ -903,8 +954,15 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 				goto skip;	/* must skip '.' and '..' */
 
 			/* callback to cache inode */
-			if (!cb(dentryp->vd_name, dir_state,
-				(fsal_cookie_t) dentryp->vd_offset)) {
+			if (plus_cb != NULL) {
+				status = lookup_at(myself, dirfd,
+						   dentryp->vd_name, &obj);
+				if (!plus_cb(dentryp->vd_name, obj, status,
+					     dir_state,
+					     (fsal_cookie_t) dentryp->vd_offset))
+					goto done;
+			} else if (!cb(dentryp->vd_name, dir_state,
+				       (fsal_cookie_t) dentryp->vd_offset)) {
 				goto done;
 			}
  skip:
@@ -920,6 +978,43 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 	return fsalstat(fsal_error, retval);
 }
 
+/**
+ * read_dirents
+ * read the directory and call through the callback function for
+ * each entry.
+ * @param dir_hdl [IN] the directory to read
+ * @param whence [IN] where to start (next)
+ * @param dir_state [IN] pass thru of state to callback
+ * @param cb [IN] callback function
+ * @param eof [OUT] eof marker true == end of dir
+ */
+
+static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
+				  fsal_cookie_t *whence, void *dir_state,
+				  fsal_readdir_cb cb, bool *eof)
+{
+	return read_entries(dir_hdl, whence, dir_state, cb, NULL, eof);
+}
+
+/**
+ * readdir_plus
+ * read the directory and call through the callback function for
+ * each entry with its handle.  The handles are got from the
+ * directory fd being read rather than by a lookup of each name.
+ * @param dir_hdl [IN] the directory to read
+ * @param whence [IN] where to start (next)
+ * @param dir_state [IN] pass thru of state to callback
+ * @param cb [IN] callback function
+ * @param eof [OUT] eof marker true == end of dir
+ */
+
+static fsal_status_t readdir_plus(struct fsal_obj_handle *dir_hdl,
+				  fsal_cookie_t *whence, void *dir_state,
+				  fsal_readdir_plus_cb cb, bool *eof)
+{
+	return read_entries(dir_hdl, whence, dir_state, NULL, cb, eof);
+}
+
 static fsal_status_t renamefile(struct fsal_obj_handle *olddir_hdl,
 				const char *old_name,
 				struct fsal_obj_handle *newdir_hdl,
@@ -1507,6 +1602,7 @@ void vfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->release = release;
 	ops->lookup = lookup;
 	ops->readdir = read_dirents;
+	ops->readdir_plus = readdir_plus;
 	ops->create = create;
 	ops->mkdir = makedir;
 	ops->mknode = makenode;
@@ -1523,6 +1619,9 @@ void vfs_handle_ops_init(struct fsal_obj_ops *ops)
 	ops->read = vfs_read;
 	ops->write = vfs_write;
 	ops->commit = vfs_commit;
+	ops->read_async = vfs_read_async;
+	ops->write_async = vfs_write_async;
+	ops->commit_async = vfs_commit_async;
 	ops->lock_op = vfs_lock_op;
 	ops->close = vfs_close;
 	ops->lru_cleanup = vfs_lru_cleanup;
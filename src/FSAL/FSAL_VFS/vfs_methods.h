@@ -216,6 +216,41 @@ fsal_status_t vfs_close(struct fsal_obj_handle *obj_hdl);
 fsal_status_t vfs_lru_cleanup(struct fsal_obj_handle *obj_hdl,
 			      lru_actions_t requests);
 
+/* asynchronous I/O, see vfs_uring.c */
+fsal_status_t vfs_read_async(struct fsal_obj_handle *obj_hdl,
+			     struct fsal_io_arg *io,
+			     fsal_async_cb done_cb, void *caller_arg);
+fsal_status_t vfs_write_async(struct fsal_obj_handle *obj_hdl,
+			      struct fsal_io_arg *io,
+			      fsal_async_cb done_cb, void *caller_arg);
+fsal_status_t vfs_commit_async(struct fsal_obj_handle *obj_hdl,
+			       off_t offset, size_t len,
+			       fsal_async_cb done_cb, void *caller_arg);
+
+/*
+ * I/O engine, the IO_Engine sub-block of the VFS/XFS config block
+ */
+
+enum vfs_io_engine_type {
+	VFS_IO_ENGINE_PREAD,	/*< blocking pread/pwrite/fsync */
+	VFS_IO_ENGINE_IO_URING	/*< io_uring, completions on a reaper */
+};
+
+struct vfs_io_engine_params {
+	uint32_t engine;		/*< enum vfs_io_engine_type */
+	uint32_t rings;			/*< shared rings, 0 for one per thread */
+	uint32_t ring_depth;		/*< entries per ring */
+	uint32_t fixed_buffers;		/*< registered buffers per ring */
+	uint32_t fixed_buffer_size;	/*< size of each registered buffer */
+};
+
+extern struct config_item vfs_io_engine_params[];
+
+int vfs_io_engine_commit(void *node, void *link_mem, void *self_struct,
+			 struct config_error_type *err_type);
+void vfs_io_engine_init(const struct vfs_io_engine_params *params);
+void vfs_io_engine_shutdown(void);
+
 /* extended attributes management */
 fsal_status_t vfs_list_ext_attrs(struct fsal_obj_handle *obj_hdl,
 				 unsigned int cookie,
@@ -0,0 +1,991 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file FSAL/FSAL_VFS/vfs_uring.c
+ * @brief Asynchronous I/O for the VFS module
+ *
+ * The io_uring engine queues reads, writes and fsyncs on a ring and
+ * returns to the worker at once.  Completions are reaped by a single
+ * thread that waits on the eventfd of every ring.
+ *
+ * Rings are either shared (Rings > 0, picked round robin) or one per
+ * thread (Rings = 0), created on first use.  On a shared ring,
+ * submissions are combined: whoever finds the ring being flushed
+ * leaves its entry for the flusher, so concurrent requests turn into
+ * few io_uring_enter calls.  Small I/Os may go through registered
+ * (fixed) buffers, trading a copy for the page pinning of each
+ * request.
+ *
+ * With the pread engine, when the kernel or the build lacks io_uring,
+ * or when a ring is full, I/O is done synchronously and the callback
+ * called before returning, as the default methods do.  The reaper
+ * itself never blocks: a commit started from a completion goes on the
+ * ring that completed, and waits there for room if it is full.
+ *
+ * Entries a failed io_uring_submit left queued are already in the
+ * kernel's submission ring and cannot be taken back, so the reaper is
+ * woken and retries the ring every VFS_URING_RETRY_MS until they are
+ * submitted.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "abstract_atomic.h"
+#include "FSAL/fsal_commonlib.h"
+#include "vfs_methods.h"
+
+#ifdef USE_IO_URING
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <liburing.h>
+#endif
+
+/**
+ * @brief Milliseconds between the reaper's retries of a failed submit
+ */
+
+#define VFS_URING_RETRY_MS 1
+
+/**
+ * @brief Asynchronous operations
+ */
+
+enum vfs_async_op {
+	VFS_ASYNC_READ,
+	VFS_ASYNC_WRITE,
+	VFS_ASYNC_FSYNC
+};
+
+static struct config_item_list io_engines[] = {
+	CONFIG_LIST_TOK("pread", VFS_IO_ENGINE_PREAD),
+	CONFIG_LIST_TOK("io_uring", VFS_IO_ENGINE_IO_URING),
+	CONFIG_LIST_EOL
+};
+
+struct config_item vfs_io_engine_params[] = {
+	CONF_ITEM_ENUM("Engine", VFS_IO_ENGINE_PREAD, io_engines,
+		       vfs_io_engine_params, engine),
+	CONF_ITEM_UI32("Rings", 0, 64, 4,
+		       vfs_io_engine_params, rings),
+	CONF_ITEM_UI32("Ring_Depth", 8, 4096, 256,
+		       vfs_io_engine_params, ring_depth),
+	CONF_ITEM_UI32("Fixed_Buffers", 0, 1024, 0,
+		       vfs_io_engine_params, fixed_buffers),
+	CONF_ITEM_UI32("Fixed_Buffer_Size", 4096, 1024 * 1024, 64 * 1024,
+		       vfs_io_engine_params, fixed_buffer_size),
+	CONFIG_EOL
+};
+
+int vfs_io_engine_commit(void *node, void *link_mem, void *self_struct,
+			 struct config_error_type *err_type)
+{
+	struct vfs_io_engine_params *params = self_struct;
+
+	if (params->fixed_buffers > params->ring_depth) {
+		LogWarn(COMPONENT_CONFIG,
+			"Fixed_Buffers (%u) larger than Ring_Depth (%u), trimmed",
+			params->fixed_buffers, params->ring_depth);
+		params->fixed_buffers = params->ring_depth;
+	}
+	return 0;
+}
+
+/**
+ * @brief Do an I/O synchronously and complete it
+ */
+
+static fsal_status_t vfs_rdwr_sync(struct fsal_obj_handle *obj_hdl,
+				   struct fsal_io_arg *io, bool write,
+				   fsal_async_cb done_cb, void *caller_arg)
+{
+	fsal_status_t status;
+
+	if (write && io->info != NULL)
+		status = obj_hdl->ops->write_plus(obj_hdl, io->offset,
+						  io->io_size, io->buffer,
+						  &io->io_amount,
+						  &io->fsal_stable, io->info);
+	else if (write)
+		status = vfs_write(obj_hdl, io->offset, io->io_size,
+				   io->buffer, &io->io_amount,
+				   &io->fsal_stable);
+	else if (io->info != NULL)
+		status = obj_hdl->ops->read_plus(obj_hdl, io->offset,
+						 io->io_size, io->buffer,
+						 &io->io_amount,
+						 &io->end_of_file, io->info);
+	else
+		status = vfs_read(obj_hdl, io->offset, io->io_size,
+				  io->buffer, &io->io_amount,
+				  &io->end_of_file);
+
+	done_cb(obj_hdl, status, caller_arg);
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+#ifdef USE_IO_URING
+
+/**
+ * @brief A ring
+ */
+
+struct vfs_uring {
+	struct io_uring ring;
+	pthread_mutex_t sq_mtx;		/*< Guards the submission queue */
+	pthread_mutex_t flush_mtx;	/*< Held by the thread flushing */
+	uint32_t unsubmitted;		/*< SQEs not yet submitted */
+	uint32_t inflight;		/*< Submitted or queued requests */
+	uint32_t depth;
+	int efd;			/*< Signalled on completions */
+	bool per_thread;
+	uint32_t closing;		/*< Owning thread is gone */
+	struct iovec *fixed;		/*< Registered buffers */
+	uint32_t nfixed;
+	uint32_t *fixed_free;		/*< Free registered buffers */
+	uint32_t nfixed_free;
+	struct vfs_uring_req *deferred;	/*< Waiting for room, reaper only */
+	bool retrying;			/*< On the retry list, reaper only */
+	struct vfs_uring *retry_next;	/*< On the retry list */
+};
+
+/**
+ * @brief A request on a ring
+ */
+
+struct vfs_uring_req {
+	struct vfs_uring *ring;
+	struct fsal_obj_handle *obj_hdl;
+	struct fsal_io_arg *io;		/*< NULL for fsync */
+	enum vfs_async_op op;
+	int fixed;			/*< Registered buffer, or -1 */
+	int fd;
+	fsal_async_cb done_cb;
+	void *caller_arg;
+	struct vfs_uring_req *next;	/*< On the deferred list */
+};
+
+static struct vfs_io_engine {
+	struct vfs_io_engine_params params;
+	bool active;
+	struct vfs_uring **rings;	/*< Shared rings */
+	uint32_t next_ring;
+	pthread_key_t ring_key;		/*< Per thread rings */
+	int epfd;
+	int ctl_efd;			/*< Wakes the reaper for shutdown */
+	pthread_t reaper;
+	struct vfs_uring *retry;	/*< Failed submits, reaper only */
+	uint32_t shutdown;
+} vfs_engine = {
+	.epfd = -1,
+	.ctl_efd = -1,
+};
+
+static __thread struct vfs_uring *vfs_uring_mine;
+
+/* the ring whose completions the reaper is running */
+static __thread struct vfs_uring *vfs_uring_reaping;
+
+/* set on the reaper thread */
+static __thread bool vfs_uring_on_reaper;
+
+static void vfs_uring_free(struct vfs_uring *ring)
+{
+	uint32_t i;
+
+	if (ring->fixed != NULL) {
+		for (i = 0; i < ring->nfixed; i++)
+			gsh_free(ring->fixed[i].iov_base);
+		gsh_free(ring->fixed);
+		gsh_free(ring->fixed_free);
+	}
+	io_uring_queue_exit(&ring->ring);
+	close(ring->efd);
+	pthread_mutex_destroy(&ring->sq_mtx);
+	pthread_mutex_destroy(&ring->flush_mtx);
+	gsh_free(ring);
+}
+
+/**
+ * @brief Register the fixed buffers of a ring
+ *
+ * Failing that (typically RLIMIT_MEMLOCK), the ring goes on without.
+ */
+
+static void vfs_uring_register_buffers(struct vfs_uring *ring)
+{
+	uint32_t n = vfs_engine.params.fixed_buffers;
+	size_t size = vfs_engine.params.fixed_buffer_size;
+	uint32_t i;
+	int rc;
+
+	ring->fixed = gsh_calloc(n, sizeof(struct iovec));
+	ring->fixed_free = gsh_calloc(n, sizeof(uint32_t));
+	if (ring->fixed == NULL || ring->fixed_free == NULL)
+		goto fail;
+
+	for (i = 0; i < n; i++) {
+		ring->fixed[i].iov_base = gsh_malloc_aligned(4096, size);
+		if (ring->fixed[i].iov_base == NULL)
+			goto fail;
+		ring->fixed[i].iov_len = size;
+		ring->fixed_free[i] = i;
+		ring->nfixed_free = i + 1;
+	}
+
+	rc = io_uring_register_buffers(&ring->ring, ring->fixed, n);
+	if (rc == 0) {
+		ring->nfixed = n;
+		return;
+	}
+
+	LogWarn(COMPONENT_FSAL,
+		"Could not register %u I/O buffers: %s", n, strerror(-rc));
+ fail:
+	if (ring->fixed != NULL) {
+		for (i = 0; i < ring->nfixed_free; i++)
+			gsh_free(ring->fixed[i].iov_base);
+	}
+	gsh_free(ring->fixed);
+	gsh_free(ring->fixed_free);
+	ring->fixed = NULL;
+	ring->fixed_free = NULL;
+	ring->nfixed_free = 0;
+}
+
+static struct vfs_uring *vfs_uring_new(bool per_thread)
+{
+	struct vfs_uring *ring = gsh_calloc(1, sizeof(struct vfs_uring));
+	struct epoll_event ev;
+	int rc;
+
+	if (ring == NULL)
+		return NULL;
+
+	ring->depth = vfs_engine.params.ring_depth;
+	ring->per_thread = per_thread;
+	rc = io_uring_queue_init(ring->depth, &ring->ring, 0);
+	if (rc < 0) {
+		LogMajor(COMPONENT_FSAL, "io_uring_queue_init failed: %s",
+			 strerror(-rc));
+		gsh_free(ring);
+		return NULL;
+	}
+
+	ring->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (ring->efd < 0 ||
+	    io_uring_register_eventfd(&ring->ring, ring->efd) < 0) {
+		LogMajor(COMPONENT_FSAL, "Could not set up io_uring eventfd");
+		if (ring->efd >= 0)
+			close(ring->efd);
+		io_uring_queue_exit(&ring->ring);
+		gsh_free(ring);
+		return NULL;
+	}
+
+	pthread_mutex_init(&ring->sq_mtx, NULL);
+	pthread_mutex_init(&ring->flush_mtx, NULL);
+
+	if (vfs_engine.params.fixed_buffers != 0)
+		vfs_uring_register_buffers(ring);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = ring;
+	if (epoll_ctl(vfs_engine.epfd, EPOLL_CTL_ADD, ring->efd, &ev) < 0) {
+		LogMajor(COMPONENT_FSAL, "Could not watch io_uring eventfd");
+		vfs_uring_free(ring);
+		return NULL;
+	}
+
+	return ring;
+}
+
+/**
+ * @brief The thread owning a per thread ring exits
+ *
+ * The reaper frees the ring once its last request completed.
+ */
+
+static void vfs_uring_release(void *arg)
+{
+	struct vfs_uring *ring = arg;
+
+	atomic_store_uint32_t(&ring->closing, 1);
+	if (eventfd_write(ring->efd, 1) < 0)
+		LogCrit(COMPONENT_FSAL, "Could not wake io_uring reaper");
+}
+
+static struct vfs_uring *vfs_uring_get(void)
+{
+	/* I/O started by a completion stays on its ring, so the reaper
+	 * never creates one */
+	if (vfs_uring_reaping != NULL)
+		return vfs_uring_reaping;
+
+	if (vfs_engine.params.rings != 0)
+		return vfs_engine.rings[
+			atomic_inc_uint32_t(&vfs_engine.next_ring) %
+			vfs_engine.params.rings];
+
+	if (vfs_uring_mine == NULL) {
+		vfs_uring_mine = vfs_uring_new(true);
+		if (vfs_uring_mine != NULL)
+			(void) pthread_setspecific(vfs_engine.ring_key,
+						   vfs_uring_mine);
+	}
+	return vfs_uring_mine;
+}
+
+/**
+ * @brief Get the entries a failed submit left queued pushed
+ *
+ * They may be all there is on the ring, with no completion to come
+ * and wake the reaper, so it is woken here.  The reaper itself puts
+ * the ring on its retry list instead.
+ */
+
+static void vfs_uring_submit_failed(struct vfs_uring *ring, int rc)
+{
+	LogFullDebug(COMPONENT_FSAL, "io_uring_submit failed: %s",
+		     strerror(-rc));
+
+	if (!vfs_uring_on_reaper && eventfd_write(ring->efd, 1) < 0)
+		LogCrit(COMPONENT_FSAL, "Could not wake io_uring reaper");
+}
+
+/**
+ * @brief Submit what is queued on a ring
+ *
+ * If another thread is flushing, our entries are left to it: it
+ * rechecks after dropping flush_mtx.
+ */
+
+static void vfs_uring_flush(struct vfs_uring *ring)
+{
+	int rc;
+
+	while (atomic_fetch_uint32_t(&ring->unsubmitted) != 0) {
+		if (pthread_mutex_trylock(&ring->flush_mtx) != 0)
+			return;
+
+		pthread_mutex_lock(&ring->sq_mtx);
+		rc = io_uring_submit(&ring->ring);
+		if (rc >= 0)
+			atomic_store_uint32_t(&ring->unsubmitted, 0);
+		pthread_mutex_unlock(&ring->sq_mtx);
+		pthread_mutex_unlock(&ring->flush_mtx);
+
+		if (rc < 0) {
+			vfs_uring_submit_failed(ring, rc);
+			return;
+		}
+	}
+}
+
+static void vfs_uring_prep(struct io_uring_sqe *sqe,
+			   struct vfs_uring_req *req, int fd)
+{
+	struct fsal_io_arg *io = req->io;
+	struct vfs_uring *ring = req->ring;
+
+	switch (req->op) {
+	case VFS_ASYNC_READ:
+		if (req->fixed >= 0)
+			io_uring_prep_read_fixed(sqe, fd,
+						 ring->fixed[req->fixed].iov_base,
+						 io->io_size, io->offset,
+						 req->fixed);
+		else
+			io_uring_prep_read(sqe, fd, io->buffer, io->io_size,
+					   io->offset);
+		break;
+	case VFS_ASYNC_WRITE:
+		if (req->fixed >= 0) {
+			memcpy(ring->fixed[req->fixed].iov_base, io->buffer,
+			       io->io_size);
+			io_uring_prep_write_fixed(sqe, fd,
+						  ring->fixed[req->fixed].
+						  iov_base,
+						  io->io_size, io->offset,
+						  req->fixed);
+		} else {
+			io_uring_prep_write(sqe, fd, io->buffer, io->io_size,
+					    io->offset);
+		}
+		if (io->fsal_stable)
+			sqe->rw_flags = RWF_SYNC;
+		break;
+	case VFS_ASYNC_FSYNC:
+		io_uring_prep_fsync(sqe, fd, 0);
+		break;
+	}
+	io_uring_sqe_set_data(sqe, req);
+}
+
+/**
+ * @brief Queue a request on a ring
+ *
+ * @param[in] req        The request
+ * @param[in] fd         File to do it on
+ * @param[in] submit_now Submit before returning, on this thread
+ *
+ * @return false if the ring is full.
+ */
+
+static bool vfs_uring_queue(struct vfs_uring_req *req, int fd,
+			    bool submit_now)
+{
+	struct vfs_uring *ring = req->ring;
+	struct io_uring_sqe *sqe;
+	int rc = 0;
+
+	/* the completion queue is twice the ring, this keeps it from
+	 * overflowing */
+	if (atomic_inc_uint32_t(&ring->inflight) > ring->depth) {
+		atomic_dec_uint32_t(&ring->inflight);
+		return false;
+	}
+
+	pthread_mutex_lock(&ring->sq_mtx);
+
+	sqe = io_uring_get_sqe(&ring->ring);
+	if (sqe == NULL) {
+		/* full of entries nobody submitted yet */
+		rc = io_uring_submit(&ring->ring);
+		if (rc >= 0)
+			atomic_store_uint32_t(&ring->unsubmitted, 0);
+		sqe = io_uring_get_sqe(&ring->ring);
+	}
+	if (sqe == NULL) {
+		pthread_mutex_unlock(&ring->sq_mtx);
+		atomic_dec_uint32_t(&ring->inflight);
+		if (rc < 0)
+			vfs_uring_submit_failed(ring, rc);
+		return false;
+	}
+
+	req->fixed = -1;
+	if (req->io != NULL && ring->nfixed_free != 0 &&
+	    req->io->io_size <= vfs_engine.params.fixed_buffer_size)
+		req->fixed = ring->fixed_free[--ring->nfixed_free];
+
+	vfs_uring_prep(sqe, req, fd);
+	atomic_inc_uint32_t(&ring->unsubmitted);
+
+	if (submit_now || ring->per_thread) {
+		rc = io_uring_submit(&ring->ring);
+		if (rc >= 0)
+			atomic_store_uint32_t(&ring->unsubmitted, 0);
+		pthread_mutex_unlock(&ring->sq_mtx);
+		if (rc < 0)
+			vfs_uring_submit_failed(ring, rc);
+		return true;
+	}
+
+	pthread_mutex_unlock(&ring->sq_mtx);
+	vfs_uring_flush(ring);
+	return true;
+}
+
+static void vfs_uring_complete(struct vfs_uring_req *req, int res)
+{
+	struct vfs_uring *ring = req->ring;
+	struct fsal_io_arg *io = req->io;
+	fsal_status_t status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	if (res < 0) {
+		status = fsalstat(posix2fsal_error(-res), -res);
+	} else if (req->op == VFS_ASYNC_READ) {
+		if (req->fixed >= 0)
+			memcpy(io->buffer, ring->fixed[req->fixed].iov_base,
+			       res);
+		io->io_amount = res;
+		/* dual eof condition, as vfs_read */
+		io->end_of_file = res == 0 ||
+		    io->offset + res >= req->obj_hdl->attributes.filesize;
+	} else if (req->op == VFS_ASYNC_WRITE) {
+		io->io_amount = res;
+	}
+
+	if (req->fixed >= 0) {
+		pthread_mutex_lock(&ring->sq_mtx);
+		ring->fixed_free[ring->nfixed_free++] = req->fixed;
+		pthread_mutex_unlock(&ring->sq_mtx);
+	}
+
+	/* leave room for a commit the callback starts */
+	atomic_dec_uint32_t(&ring->inflight);
+	req->done_cb(req->obj_hdl, status, req->caller_arg);
+	gsh_free(req);
+}
+
+/**
+ * @brief Queue the requests that found their ring full
+ *
+ * Only requests started by completions are deferred, and only the
+ * reaper queues them, as completions make room.
+ */
+
+static void vfs_uring_requeue(struct vfs_uring *ring)
+{
+	struct vfs_uring_req *req;
+
+	while (ring->deferred != NULL) {
+		req = ring->deferred;
+		ring->deferred = req->next;
+		if (!vfs_uring_queue(req, req->fd, false)) {
+			req->next = ring->deferred;
+			ring->deferred = req;
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Free a ring whose thread is gone, once it is idle
+ */
+
+static void vfs_uring_reap_closed(struct vfs_uring *ring)
+{
+	if (atomic_fetch_uint32_t(&ring->closing) &&
+	    atomic_fetch_uint32_t(&ring->inflight) == 0 &&
+	    ring->deferred == NULL && !ring->retrying) {
+		(void) epoll_ctl(vfs_engine.epfd, EPOLL_CTL_DEL, ring->efd,
+				 NULL);
+		vfs_uring_free(ring);
+	}
+}
+
+static void vfs_uring_reap(struct vfs_uring *ring)
+{
+	struct io_uring_cqe *cqe;
+	eventfd_t cnt;
+
+	(void) eventfd_read(ring->efd, &cnt);
+
+	vfs_uring_reaping = ring;
+	while (io_uring_peek_cqe(&ring->ring, &cqe) == 0) {
+		struct vfs_uring_req *req = io_uring_cqe_get_data(cqe);
+		int res = cqe->res;
+
+		io_uring_cqe_seen(&ring->ring, cqe);
+		vfs_uring_complete(req, res);
+	}
+	vfs_uring_reaping = NULL;
+
+	vfs_uring_requeue(ring);
+
+	/* a submission may have failed for want of room */
+	vfs_uring_flush(ring);
+
+	/* still failing, or another thread is at it; either way, look
+	 * again shortly rather than wait for a completion that may not
+	 * come */
+	if (atomic_fetch_uint32_t(&ring->unsubmitted) != 0 &&
+	    !ring->retrying) {
+		ring->retrying = true;
+		ring->retry_next = vfs_engine.retry;
+		vfs_engine.retry = ring;
+	}
+
+	vfs_uring_reap_closed(ring);
+}
+
+/**
+ * @brief Retry the rings a submit failed on
+ */
+
+static void vfs_uring_retry(void)
+{
+	struct vfs_uring **prev = &vfs_engine.retry;
+	struct vfs_uring *ring;
+
+	while (*prev != NULL) {
+		ring = *prev;
+		vfs_uring_flush(ring);
+		if (atomic_fetch_uint32_t(&ring->unsubmitted) != 0) {
+			prev = &ring->retry_next;
+			continue;
+		}
+		*prev = ring->retry_next;
+		ring->retrying = false;
+		vfs_uring_reap_closed(ring);
+	}
+}
+
+static void *vfs_uring_reaper(void *arg)
+{
+	struct epoll_event ev[16];
+	int n, i;
+
+	SetNameFunction("vfs_uring");
+	vfs_uring_on_reaper = true;
+
+	while (!atomic_fetch_uint32_t(&vfs_engine.shutdown)) {
+		n = epoll_wait(vfs_engine.epfd, ev, 16,
+			       vfs_engine.retry != NULL ?
+			       VFS_URING_RETRY_MS : -1);
+		for (i = 0; i < n; i++) {
+			if (ev[i].data.ptr != NULL)
+				vfs_uring_reap(ev[i].data.ptr);
+		}
+		vfs_uring_retry();
+	}
+	return NULL;
+}
+
+/**
+ * @brief Check the kernel has what we need
+ */
+
+static bool vfs_uring_probe(void)
+{
+	struct io_uring ring;
+	struct io_uring_probe *probe;
+	bool ok;
+	int rc;
+
+	rc = io_uring_queue_init(8, &ring, 0);
+	if (rc < 0) {
+		LogWarn(COMPONENT_FSAL, "io_uring not available: %s",
+			strerror(-rc));
+		return false;
+	}
+
+	probe = io_uring_get_probe_ring(&ring);
+	ok = probe != NULL &&
+	    io_uring_opcode_supported(probe, IORING_OP_READ) &&
+	    io_uring_opcode_supported(probe, IORING_OP_WRITE) &&
+	    io_uring_opcode_supported(probe, IORING_OP_FSYNC) &&
+	    io_uring_opcode_supported(probe, IORING_OP_READ_FIXED) &&
+	    io_uring_opcode_supported(probe, IORING_OP_WRITE_FIXED);
+	if (probe != NULL)
+		io_uring_free_probe(probe);
+	io_uring_queue_exit(&ring);
+
+	if (!ok)
+		LogWarn(COMPONENT_FSAL,
+			"io_uring lacks read/write/fsync operations");
+	return ok;
+}
+
+static void vfs_uring_teardown(void)
+{
+	uint32_t i;
+
+	if (vfs_engine.reaper != 0) {
+		atomic_store_uint32_t(&vfs_engine.shutdown, 1);
+		(void) eventfd_write(vfs_engine.ctl_efd, 1);
+		pthread_join(vfs_engine.reaper, NULL);
+		vfs_engine.reaper = 0;
+	}
+
+	if (vfs_engine.rings != NULL) {
+		for (i = 0; i < vfs_engine.params.rings; i++)
+			if (vfs_engine.rings[i] != NULL)
+				vfs_uring_free(vfs_engine.rings[i]);
+		gsh_free(vfs_engine.rings);
+		vfs_engine.rings = NULL;
+	}
+
+	if (vfs_engine.ctl_efd >= 0)
+		close(vfs_engine.ctl_efd);
+	if (vfs_engine.epfd >= 0)
+		close(vfs_engine.epfd);
+	vfs_engine.ctl_efd = -1;
+	vfs_engine.epfd = -1;
+}
+
+static bool vfs_uring_setup(void)
+{
+	struct epoll_event ev;
+	uint32_t i;
+
+	if (!vfs_uring_probe())
+		return false;
+
+	vfs_engine.epfd = epoll_create1(EPOLL_CLOEXEC);
+	vfs_engine.ctl_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (vfs_engine.epfd < 0 || vfs_engine.ctl_efd < 0)
+		goto fail;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(vfs_engine.epfd, EPOLL_CTL_ADD, vfs_engine.ctl_efd,
+		      &ev) < 0)
+		goto fail;
+
+	if (vfs_engine.params.rings != 0) {
+		vfs_engine.rings = gsh_calloc(vfs_engine.params.rings,
+					      sizeof(struct vfs_uring *));
+		if (vfs_engine.rings == NULL)
+			goto fail;
+		for (i = 0; i < vfs_engine.params.rings; i++) {
+			vfs_engine.rings[i] = vfs_uring_new(false);
+			if (vfs_engine.rings[i] == NULL)
+				goto fail;
+		}
+	} else if (pthread_key_create(&vfs_engine.ring_key,
+				      vfs_uring_release) != 0) {
+		goto fail;
+	}
+
+	if (pthread_create(&vfs_engine.reaper, NULL, vfs_uring_reaper,
+			   NULL) != 0) {
+		vfs_engine.reaper = 0;
+		goto fail;
+	}
+
+	return true;
+
+ fail:
+	LogMajor(COMPONENT_FSAL, "Could not set up the io_uring engine");
+	vfs_uring_teardown();
+	return false;
+}
+
+/**
+ * @brief Start an I/O on an io_uring
+ *
+ * On the reaper, an I/O that finds the ring full is deferred rather
+ * than done synchronously.
+ *
+ * @return false if it must be done synchronously.
+ */
+
+static bool vfs_uring_start(struct fsal_obj_handle *obj_hdl,
+			    struct fsal_io_arg *io, enum vfs_async_op op,
+			    fsal_async_cb done_cb, void *caller_arg)
+{
+	struct vfs_fsal_obj_handle *myself =
+	    container_of(obj_hdl, struct vfs_fsal_obj_handle, obj_handle);
+	struct vfs_uring_req *req;
+	struct vfs_uring *ring;
+	bool queued;
+
+	if (!vfs_engine.active)
+		return false;
+
+	ring = vfs_uring_get();
+	if (ring == NULL)
+		return false;
+
+	req = gsh_malloc(sizeof(struct vfs_uring_req));
+	if (req == NULL)
+		return false;
+
+	req->ring = ring;
+	req->obj_hdl = obj_hdl;
+	req->io = io;
+	req->op = op;
+	req->fd = myself->u.file.fd;
+	req->done_cb = done_cb;
+	req->caller_arg = caller_arg;
+
+	assert(myself->u.file.fd >= 0
+	       && myself->u.file.openflags != FSAL_O_CLOSED);
+
+	if (op == VFS_ASYNC_WRITE) {
+		/* the kernel charges the write to the submitter, so
+		 * submit it under the caller's credentials */
+		fsal_set_credentials(op_ctx->creds);
+		queued = vfs_uring_queue(req, myself->u.file.fd, true);
+		fsal_restore_ganesha_credentials();
+	} else {
+		queued = vfs_uring_queue(req, myself->u.file.fd, false);
+	}
+
+	if (!queued && ring == vfs_uring_reaping) {
+		req->next = ring->deferred;
+		ring->deferred = req;
+		return true;
+	}
+
+	if (!queued)
+		gsh_free(req);
+	return queued;
+}
+
+/**
+ * @brief Whether this is the reaper, which must not block
+ */
+
+static bool vfs_uring_reaper_thread(void)
+{
+	return vfs_uring_reaping != NULL;
+}
+
+void vfs_io_engine_init(const struct vfs_io_engine_params *params)
+{
+	if (vfs_engine.active)
+		return;
+
+	vfs_engine.params = *params;
+	if (params->engine != VFS_IO_ENGINE_IO_URING)
+		return;
+
+	vfs_engine.active = vfs_uring_setup();
+	if (vfs_engine.active)
+		LogInfo(COMPONENT_FSAL,
+			"io_uring I/O engine, %u %s rings of %u entries, %u fixed buffers",
+			params->rings ? params->rings : 1,
+			params->rings ? "shared" : "per thread",
+			params->ring_depth, params->fixed_buffers);
+	else
+		LogWarn(COMPONENT_FSAL, "Falling back to pread/pwrite");
+}
+
+void vfs_io_engine_shutdown(void)
+{
+	if (!vfs_engine.active)
+		return;
+
+	vfs_engine.active = false;
+	vfs_uring_teardown();
+	if (vfs_engine.params.rings == 0)
+		(void) pthread_key_delete(vfs_engine.ring_key);
+}
+
+#else				/* USE_IO_URING */
+
+static bool vfs_uring_start(struct fsal_obj_handle *obj_hdl,
+			    struct fsal_io_arg *io, enum vfs_async_op op,
+			    fsal_async_cb done_cb, void *caller_arg)
+{
+	return false;
+}
+
+static bool vfs_uring_reaper_thread(void)
+{
+	return false;
+}
+
+void vfs_io_engine_init(const struct vfs_io_engine_params *params)
+{
+	if (params->engine == VFS_IO_ENGINE_IO_URING)
+		LogWarn(COMPONENT_FSAL,
+			"Built without io_uring, falling back to pread/pwrite");
+}
+
+void vfs_io_engine_shutdown(void)
+{
+}
+
+#endif				/* USE_IO_URING */
+
+/**
+ * @brief Check the handle belongs to this FSAL, as the sync methods do
+ */
+
+static bool vfs_async_xdev(struct fsal_obj_handle *obj_hdl,
+			   fsal_status_t *status)
+{
+	if (obj_hdl->fsal == obj_hdl->fs->fsal)
+		return false;
+
+	LogDebug(COMPONENT_FSAL,
+		 "FSAL %s operation for handle belonging to FSAL %s, return EXDEV",
+		 obj_hdl->fsal->name, obj_hdl->fs->fsal->name);
+	*status = fsalstat(posix2fsal_error(EXDEV), EXDEV);
+	return true;
+}
+
+/* vfs_read_async
+ * concurrency (locks) is managed in cache_inode_*
+ */
+
+fsal_status_t vfs_read_async(struct fsal_obj_handle *obj_hdl,
+			     struct fsal_io_arg *io,
+			     fsal_async_cb done_cb, void *caller_arg)
+{
+	fsal_status_t status;
+
+	if (vfs_async_xdev(obj_hdl, &status))
+		return status;
+
+	io->io_amount = 0;
+	io->end_of_file = false;
+
+	if (io->info == NULL &&
+	    vfs_uring_start(obj_hdl, io, VFS_ASYNC_READ, done_cb, caller_arg))
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	return vfs_rdwr_sync(obj_hdl, io, false, done_cb, caller_arg);
+}
+
+/* vfs_write_async
+ * concurrency (locks) is managed in cache_inode_*
+ */
+
+fsal_status_t vfs_write_async(struct fsal_obj_handle *obj_hdl,
+			      struct fsal_io_arg *io,
+			      fsal_async_cb done_cb, void *caller_arg)
+{
+	fsal_status_t status;
+
+	if (vfs_async_xdev(obj_hdl, &status))
+		return status;
+
+	io->io_amount = 0;
+
+	if (io->info == NULL &&
+	    vfs_uring_start(obj_hdl, io, VFS_ASYNC_WRITE, done_cb,
+			    caller_arg))
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	return vfs_rdwr_sync(obj_hdl, io, true, done_cb, caller_arg);
+}
+
+/* vfs_commit_async
+ * Like vfs_commit, syncs the whole file.  Started from the completion
+ * of a write, it is always an IORING_OP_FSYNC on the same ring.
+ */
+
+fsal_status_t vfs_commit_async(struct fsal_obj_handle *obj_hdl,
+			       off_t offset, size_t len,
+			       fsal_async_cb done_cb, void *caller_arg)
+{
+	fsal_status_t status;
+
+	if (vfs_async_xdev(obj_hdl, &status))
+		return status;
+
+	if (vfs_uring_start(obj_hdl, NULL, VFS_ASYNC_FSYNC, done_cb,
+			    caller_arg))
+		return fsalstat(ERR_FSAL_NO_ERROR, 0);
+
+	/* out of memory; no fsync on the reaper */
+	if (vfs_uring_reaper_thread())
+		return fsalstat(ERR_FSAL_NOMEM, ENOMEM);
+
+	done_cb(obj_hdl, vfs_commit(obj_hdl, offset, len), caller_arg);
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
@@ -38,6 +38,7 @@
 #include <limits.h>
 #include <sys/types.h>
 #include "FSAL/fsal_init.h"
+#include "../vfs_methods.h"
 
 /* VFS FSAL module private storage
  */
@@ -54,6 +55,7 @@
 struct xfs_fsal_module {
 	struct fsal_module fsal;
 	struct fsal_staticfsinfo_t fs_info;
+	struct vfs_io_engine_params io_engine;
 	/* xfsfs_specific_initinfo_t specific_info;  placeholder */
 };
 
@@ -84,21 +86,24 @@ static struct fsal_staticfsinfo_t default_posix_info = {
 
 static struct config_item xfs_params[] = {
 	CONF_ITEM_BOOL("link_support", true,
-		       fsal_staticfsinfo_t, link_support),
+		       xfs_fsal_module, fs_info.link_support),
 	CONF_ITEM_BOOL("symlink_support", true,
-		       fsal_staticfsinfo_t, symlink_support),
+		       xfs_fsal_module, fs_info.symlink_support),
 	CONF_ITEM_BOOL("cansettime", true,
-		       fsal_staticfsinfo_t, cansettime),
+		       xfs_fsal_module, fs_info.cansettime),
 	CONF_ITEM_UI64("maxread", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       fsal_staticfsinfo_t, maxread),
+		       xfs_fsal_module, fs_info.maxread),
 	CONF_ITEM_UI64("maxwrite", 512, FSAL_MAXIOSIZE, FSAL_MAXIOSIZE,
-		       fsal_staticfsinfo_t, maxwrite),
+		       xfs_fsal_module, fs_info.maxwrite),
 	CONF_ITEM_MODE("umask", 0, 0777, 0,
-		       fsal_staticfsinfo_t, umask),
+		       xfs_fsal_module, fs_info.umask),
 	CONF_ITEM_BOOL("auth_xdev_export", false,
-		       fsal_staticfsinfo_t, auth_exportpath_xdev),
+		       xfs_fsal_module, fs_info.auth_exportpath_xdev),
 	CONF_ITEM_MODE("xattr_access_rights", 0, 0777, 0400,
-		       fsal_staticfsinfo_t, xattr_access_rights),
+		       xfs_fsal_module, fs_info.xattr_access_rights),
+	CONF_ITEM_BLOCK("IO_Engine", vfs_io_engine_params,
+			noop_conf_init, vfs_io_engine_commit,
+			xfs_fsal_module, io_engine),
 	CONFIG_EOL
 };
 
@@ -139,12 +144,13 @@ static fsal_status_t init_config(struct fsal_module *fsal_hdl,
 	xfs_me->fs_info = default_posix_info;	/* copy the consts */
 	(void) load_config_from_parse(config_struct,
 				      &xfs_param,
-				      &xfs_me->fs_info,
+				      xfs_me,
 				      true,
 				      &err_type);
 	if (!config_error_is_harmless(&err_type))
 		return fsalstat(ERR_FSAL_INVAL, 0);
 	display_fsinfo(&xfs_me->fs_info);
+	vfs_io_engine_init(&xfs_me->io_engine);
 	LogFullDebug(COMPONENT_FSAL,
 		     "Supported attributes constant = 0x%" PRIx64,
 		     (uint64_t) XFS_SUPPORTED_ATTRIBUTES);
@@ -196,6 +202,8 @@ MODULE_FINI void xfs_unload(void)
 {
 	int retval;
 
+	vfs_io_engine_shutdown();
+
 	retval = unregister_fsal(&XFS.fsal);
 	if (retval != 0) {
 		fprintf(stderr, "XFS module failed to unregister");
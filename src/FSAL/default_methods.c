@@ -552,6 +552,44 @@ static fsal_status_t read_dirents(struct fsal_obj_handle *dir_hdl,
 	return fsalstat(ERR_FSAL_NOTSUPP, 0);
 }
 
+struct readdir_plus_state {
+	struct fsal_obj_handle *dir_hdl;
+	fsal_readdir_plus_cb cb;
+	void *dir_state;
+};
+
+static bool readdir_plus_lookup(const char *name, void *dir_state,
+				fsal_cookie_t cookie)
+{
+	struct readdir_plus_state *state = dir_state;
+	struct fsal_obj_handle *obj = NULL;
+	fsal_status_t status;
+
+	status = state->dir_hdl->ops->lookup(state->dir_hdl, name, &obj);
+	if (FSAL_IS_ERROR(status))
+		obj = NULL;
+
+	return state->cb(name, obj, status, state->dir_state, cookie);
+}
+
+/* readdir_plus
+ * default case looks up each name read
+ */
+
+static fsal_status_t readdir_plus(struct fsal_obj_handle *dir_hdl,
+				  fsal_cookie_t *whence, void *dir_state,
+				  fsal_readdir_plus_cb cb, bool *eof)
+{
+	struct readdir_plus_state state = {
+		.dir_hdl = dir_hdl,
+		.cb = cb,
+		.dir_state = dir_state
+	};
+
+	return dir_hdl->ops->readdir(dir_hdl, whence, &state,
+				     readdir_plus_lookup, eof);
+}
+
 /* create
  * default case not supported
  */
@@ -770,6 +808,73 @@ static fsal_status_t commit(struct fsal_obj_handle *obj_hdl,	/* sync */
 	return fsalstat(ERR_FSAL_NOTSUPP, 0);
 }
 
+/* file_read_async
+ * default case reads synchronously
+ */
+
+static fsal_status_t file_read_async(struct fsal_obj_handle *obj_hdl,
+				     struct fsal_io_arg *io,
+				     fsal_async_cb done_cb,
+				     void *caller_arg)
+{
+	fsal_status_t status;
+
+	if (io->info != NULL)
+		status = obj_hdl->ops->read_plus(obj_hdl, io->offset,
+						 io->io_size, io->buffer,
+						 &io->io_amount,
+						 &io->end_of_file, io->info);
+	else
+		status = obj_hdl->ops->read(obj_hdl, io->offset,
+					    io->io_size, io->buffer,
+					    &io->io_amount,
+					    &io->end_of_file);
+
+	done_cb(obj_hdl, status, caller_arg);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* file_write_async
+ * default case writes synchronously
+ */
+
+static fsal_status_t file_write_async(struct fsal_obj_handle *obj_hdl,
+				      struct fsal_io_arg *io,
+				      fsal_async_cb done_cb,
+				      void *caller_arg)
+{
+	fsal_status_t status;
+
+	if (io->info != NULL)
+		status = obj_hdl->ops->write_plus(obj_hdl, io->offset,
+						  io->io_size, io->buffer,
+						  &io->io_amount,
+						  &io->fsal_stable, io->info);
+	else
+		status = obj_hdl->ops->write(obj_hdl, io->offset,
+					     io->io_size, io->buffer,
+					     &io->io_amount,
+					     &io->fsal_stable);
+
+	done_cb(obj_hdl, status, caller_arg);
+
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* commit_async
+ * default case not supported, the caller commits synchronously
+ * (not from the completion thread of a write_async)
+ */
+
+static fsal_status_t commit_async(struct fsal_obj_handle *obj_hdl,
+				  off_t offset, size_t len,
+				  fsal_async_cb done_cb,
+				  void *caller_arg)
+{
+	return fsalstat(ERR_FSAL_NOTSUPP, 0);
+}
+
 /* lock_op
  * default case not supported
  */
@@ -1053,7 +1158,11 @@ struct fsal_obj_ops def_handle_ops = {
 	.handle_to_key = handle_to_key,
 	.layoutget = layoutget,
 	.layoutreturn = layoutreturn,
-	.layoutcommit = layoutcommit
+	.layoutcommit = layoutcommit,
+	.read_async = file_read_async,
+	.write_async = file_write_async,
+	.commit_async = commit_async,
+	.readdir_plus = readdir_plus
 };
 
 /* fsal_ds_handle common methods */
@@ -416,7 +416,7 @@ static state_status_t create_file_recall(cache_entry_t *entry,
 		goto out;
 	}
 
-	glist_for_each(state_iter, &entry->state_list) {
+	glist_for_each(state_iter, &entry->state_data->state_list) {
 		/* Entry in the state list */
 		struct recall_state_list *list_entry = NULL;
 		/* Iterator over segments on this state */
@@ -508,7 +508,8 @@ static state_status_t create_file_recall(cache_entry_t *entry,
 		}
 		gsh_free(recall);
 	} else {
-		glist_add_tail(&entry->layoutrecall_list, &recall->entry_link);
+		glist_add_tail(&entry->state_data->layoutrecall_list,
+			       &recall->entry_link);
 		*recout = recall;
 	}
 
@@ -1194,7 +1195,7 @@ static int32_t delegrecall_completion_func(rpc_call_t *call,
 	assert(entry != NULL);
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 	deleg_entry = NULL;
-	glist_for_each_safe(glist, glist_n, &entry->object.file.deleg_list) {
+	glist_for_each_safe(glist, glist_n, &entry->state_data->deleg_list) {
 		tdentry = glist_entry(glist, struct deleg_data, dd_list);
 		if (deleg_ctx->drc_deleg_entry == tdentry &&
 		    SAME_STATEID(&deleg_ctx->drc_stateid, tdentry->dd_state)) {
@@ -1473,7 +1474,7 @@ static void delegrevoke_check(void *ctx)
 	nfs_client_id_t *clid = deleg_ctx->drc_clid;
 
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
-	glist_for_each_safe(glist, glist_n, &entry->object.file.deleg_list) {
+	glist_for_each_safe(glist, glist_n, &entry->state_data->deleg_list) {
 		deleg_entry = glist_entry(glist, struct deleg_data, dd_list);
 		if (deleg_ctx->drc_deleg_entry == deleg_entry &&
 			SAME_STATEID(&deleg_ctx->drc_stateid,
@@ -1533,7 +1534,7 @@ static void delegrecall_task(void *ctx)
 	struct deleg_data *deleg_entry = NULL;
 
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
-	glist_for_each_safe(glist, glist_n, &entry->object.file.deleg_list) {
+	glist_for_each_safe(glist, glist_n, &entry->state_data->deleg_list) {
 		deleg_entry = glist_entry(glist, struct deleg_data, dd_list);
 		if (deleg_ctx->drc_deleg_entry == deleg_entry &&
 			SAME_STATEID(&deleg_ctx->drc_stateid,
@@ -1603,7 +1604,7 @@ state_status_t delegrecall_impl(cache_entry_t *entry)
 
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 
-	glist_for_each_safe(glist, glist_n, &entry->object.file.deleg_list) {
+	glist_for_each_safe(glist, glist_n, &entry->state_data->deleg_list) {
 		deleg_entry = glist_entry(glist, struct deleg_data, dd_list);
 
 		LogDebug(COMPONENT_NFS_CB, "deleg_entry %p", deleg_entry);
@@ -41,6 +41,7 @@
 #include "idmapper.h"
 #include "delayed_exec.h"
 #include "export_mgr.h"
+#include "nfs_dupreq.h"
 #ifdef USE_DBUS
 #include "ganesha_dbus.h"
 #endif
@@ -363,6 +364,9 @@ static void do_shutdown(void)
 			 "Worker threads successfully shut down.");
 	}
 
+	LogEvent(COMPONENT_MAIN, "Stopping DRC evictor thread.");
+	dupreq2_pkgshutdown();
+
 	/* finalize RPC package */
 	Clean_RPC(); /* we MUST do this first */
 	(void)svc_shutdown(SVC_SHUTDOWN_FLAG_NONE);
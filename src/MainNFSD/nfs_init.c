@@ -68,6 +68,8 @@
 #include "delayed_exec.h"
 #include "client_mgr.h"
 #include "export_mgr.h"
+#include "pool_slab.h"
+#include "gsh_affinity.h"
 #ifdef USE_CAPS
 #include <sys/capability.h>	/* For capget/capset */
 #endif
@@ -175,6 +177,13 @@ void nfs_print_param_config()
 	printf("\tNFS_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
 	printf("\tMNT_Program = %u ;\n", nfs_param.core_param.program[P_NFS]);
 	printf("\tNb_Worker = %u ;\n", nfs_param.core_param.nb_worker);
+	printf("\tNb_Worker_Min = %u ;\n", nfs_param.core_param.nb_worker_min);
+	printf("\tWorker_Grow_Wait = %u ;\n",
+	       nfs_param.core_param.worker_grow_wait);
+	printf("\tDispatch_Queue_Shards = %u ;\n",
+	       nfs_param.core_param.dispatch_queue_shards);
+	printf("\tDispatch_Max_Reqs_Client = %u ;\n",
+	       nfs_param.core_param.dispatch_max_reqs_client);
 	printf("\tDRC_TCP_Npart = %u ;\n", nfs_param.core_param.drc.tcp.npart);
 	printf("\tDRC_TCP_Size = %u ;\n", nfs_param.core_param.drc.tcp.size);
 	printf("\tDRC_TCP_Cachesz = %u ;\n",
@@ -483,6 +492,9 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 	char GssError[MAXNAMLEN + 1];
 #endif
 
+	/* before any thread that may be placed is started */
+	gsh_affinity_init();
+
 #ifdef USE_DBUS
 	/* DBUS init */
 	gsh_dbus_pkginit();
@@ -510,14 +522,14 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 
 	nfs41_session_pool =
 	    pool_init("NFSv4.1 session pool", sizeof(nfs41_session_t),
-		      pool_basic_substrate, NULL, NULL, NULL);
+		      pool_slab_substrate, NULL, NULL, NULL);
 	if (!nfs41_session_pool)
 		LogFatal(COMPONENT_INIT,
 			 "Error while allocating NFSv4.1 session pool");
 
 	request_pool =
 	    pool_init("Request pool", sizeof(request_data_t),
-		      pool_basic_substrate, NULL,
+		      pool_slab_substrate, NULL,
 		      NULL /* FASTER constructor_request_data_t */ ,
 		      NULL);
 	if (!request_pool)
@@ -526,20 +538,13 @@ static void nfs_Init(const nfs_start_info_t *p_start_info)
 
 	request_data_pool =
 	    pool_init("Request Data Pool", sizeof(nfs_request_data_t),
-		      pool_basic_substrate, NULL,
+		      pool_slab_substrate, NULL,
 		      NULL /* FASTER constructor_nfs_request_data_t */ ,
 		      NULL);
 	if (!request_data_pool)
 		LogFatal(COMPONENT_INIT,
 			"Error while allocating request data pool");
 
-	dupreq_pool =
-	    pool_init("Duplicate Request Pool", sizeof(dupreq_entry_t),
-		      pool_basic_substrate, NULL, NULL, NULL);
-	if (!(dupreq_pool))
-		LogFatal(COMPONENT_INIT,
-			"Error while allocating duplicate request pool");
-
 	/* If rpcsec_gss is used, set the path to the keytab */
 #ifdef _HAVE_GSSAPI
 #ifdef HAVE_KRB5
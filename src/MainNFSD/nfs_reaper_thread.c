@@ -41,75 +41,69 @@ unsigned int reaper_delay = REAPER_DELAY;
 
 static struct fridgethr *reaper_fridge;
 
-static int reap_hash_table(hash_table_t *ht_reap)
+/**
+ * @brief Expire the clients whose lease came due
+ *
+ * The lease wheel hands over only the clients whose lease may have
+ * run out since the last pass, so no clientid hash table is walked or
+ * locked here.  Clients renewed in the meantime go back on the wheel.
+ *
+ * @return Number of clients looked at.
+ */
+static int reap_expired_clients(void)
 {
-	struct rbt_head *head_rbt;
-	struct hash_data *addr = NULL;
-	uint32_t i;
-	int rc;
-	struct rbt_node *pn;
+	struct glist_head due;
+	struct glist_head *glist, *glistn;
 	nfs_client_id_t *pclientid;
 	nfs_client_record_t *precord;
-	int count = 0;
-
-	/* For each bucket of the requested hashtable */
-	for (i = 0; i < ht_reap->parameter.index_size; i++) {
-		head_rbt = &ht_reap->partitions[i].rbt;
-
- restart:
-		/* acquire mutex */
-		PTHREAD_RWLOCK_wrlock(&ht_reap->partitions[i].lock);
+	int count;
 
-		/* go through all entries in the red-black-tree */
-		RBT_LOOP(head_rbt, pn) {
-			addr = RBT_OPAQ(pn);
+	glist_init(&due);
+	count = lease_wheel_due(&due);
 
-			pclientid = addr->val.addr;
-			count++;
+	glist_for_each_safe(glist, glistn, &due) {
+		pclientid = glist_entry(glist, nfs_client_id_t, cid_lease_link);
+		glist_del(glist);
 
-			pthread_mutex_lock(&pclientid->cid_mutex);
+		pthread_mutex_lock(&pclientid->cid_mutex);
 
-			if (!valid_lease(pclientid)) {
-				inc_client_id_ref(pclientid);
-
-				/* Take a reference to the client record */
-				precord = pclientid->cid_client_record;
-				inc_client_record_ref(precord);
-
-				pthread_mutex_unlock(&pclientid->cid_mutex);
+		if (pclientid->cid_confirmed == EXPIRED_CLIENT_ID) {
+			/* Already removed, drop the wheel's reference */
+			pthread_mutex_unlock(&pclientid->cid_mutex);
+			dec_client_id_ref(pclientid);
+			continue;
+		}
 
-				PTHREAD_RWLOCK_unlock(&ht_reap->partitions[i].
-						      lock);
+		if (valid_lease(pclientid)) {
+			lease_wheel_requeue(pclientid);
+			pthread_mutex_unlock(&pclientid->cid_mutex);
+			continue;
+		}
 
-				if (isDebug(COMPONENT_CLIENTID)) {
-					char str[HASHTABLE_DISPLAY_STRLEN];
+		/* Take a reference to the client record */
+		precord = pclientid->cid_client_record;
+		inc_client_record_ref(precord);
 
-					display_client_id_rec(pclientid, str);
+		pthread_mutex_unlock(&pclientid->cid_mutex);
 
-					LogFullDebug(COMPONENT_CLIENTID,
-						     "Expire index %d %s", i,
-						     str);
-				}
+		if (isDebug(COMPONENT_CLIENTID)) {
+			char str[HASHTABLE_DISPLAY_STRLEN];
 
-				/* Take cr_mutex and expire clientid */
-				pthread_mutex_lock(&precord->cr_mutex);
+			display_client_id_rec(pclientid, str);
 
-				rc = nfs_client_id_expire(pclientid);
+			LogFullDebug(COMPONENT_CLIENTID, "Expire %s", str);
+		}
 
-				pthread_mutex_unlock(&precord->cr_mutex);
+		/* Take cr_mutex and expire clientid */
+		pthread_mutex_lock(&precord->cr_mutex);
 
-				dec_client_id_ref(pclientid);
-				dec_client_record_ref(precord);
-				if (rc)
-					goto restart;
-			} else {
-				pthread_mutex_unlock(&pclientid->cid_mutex);
-			}
+		(void)nfs_client_id_expire(pclientid);
 
-			RBT_INCREMENT(pn);
-		}
+		pthread_mutex_unlock(&precord->cr_mutex);
 
-		PTHREAD_RWLOCK_unlock(&ht_reap->partitions[i].lock);
+		/* The wheel's reference */
+		dec_client_id_ref(pclientid);
+		dec_client_record_ref(precord);
 	}
 
 	return count;
@@ -158,9 +152,7 @@ static void reaper_run(struct fridgethr_context *ctx)
 #endif
 	}
 
-	rst->count =
-	    (reap_hash_table(ht_confirmed_client_id) +
-	     reap_hash_table(ht_unconfirmed_client_id));
+	rst->count = reap_expired_clients();
 }
 
 int reaper_init(void)
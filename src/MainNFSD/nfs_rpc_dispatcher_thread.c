@@ -36,6 +36,8 @@
 #include <sys/file.h>		/* for having FNDELAY */
 #include <sys/select.h>
 #include <poll.h>
+#include <sched.h>
+#include <unistd.h>
 #include <assert.h>
 #include "hashtable.h"
 #include "log.h"
@@ -56,6 +58,9 @@
 #include "nfs_dupreq.h"
 #include "nfs_file_handle.h"
 #include "fridgethr.h"
+#include "client_mgr.h"
+#include "export_mgr.h"
+#include "gsh_affinity.h"
 
 /**
  * TI-RPC event channels.  Each channel is a thread servicing an event
@@ -660,7 +665,7 @@ void nfs_rpc_dispatch_threads(pthread_attr_t *attr_thr)
 	for (ix = 0; ix < N_EVENT_CHAN; ++ix) {
 		code = pthread_create(&rpc_evchan[ix].thread_id, attr_thr,
 				      rpc_dispatcher_thread,
-				      (void *)&rpc_evchan[ix].chan_id);
+				      (void *)(uintptr_t) ix);
 		if (code != 0)
 			LogFatal(COMPONENT_THREAD,
 				 "Could not create rpc_dispatcher_thread #%u, error = %d (%s)",
@@ -757,26 +762,48 @@ uint32_t nfs_rpc_outstanding_reqs_est(void)
 	static uint32_t nreqs;
 	struct req_q_pair *qpair;
 	uint32_t treqs;
+	uint32_t sx;
 	int ix;
 
 	if ((atomic_inc_uint32_t(&ctr) % 10) != 0)
 		return atomic_fetch_uint32_t(&nreqs);
 
 	treqs = 0;
-	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
-		qpair = &(nfs_req_st.reqs.nfs_request_q.qset[ix]);
-		treqs += atomic_fetch_uint32_t(&qpair->producer.size);
-		treqs += atomic_fetch_uint32_t(&qpair->consumer.size);
+	for (sx = 0; sx < nfs_req_st.reqs.nshards; ++sx) {
+		struct req_q_set *nfs_request_q =
+			&nfs_req_st.reqs.shards[sx].nfs_request_q;
+
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+			qpair = &(nfs_request_q->qset[ix]);
+			treqs += atomic_fetch_uint32_t(&qpair->producer.size);
+			treqs += atomic_fetch_uint32_t(&qpair->consumer.size);
+		}
 	}
 
 	atomic_store_uint32_t(&nreqs, treqs);
 	return treqs;
 }
 
-static inline bool stallq_should_unstall(gsh_xprt_private_t *xu)
+/**
+ * @brief Whether a transport's sender is over a rate limit
+ *
+ * @param[in] xu  The transport's private data
+ * @param[in] now The time, from tb_now
+ */
+static inline bool nfs_rpc_xprt_throttled(gsh_xprt_private_t *xu,
+					  nsecs_elapsed_t now)
+{
+	return atomic_fetch_uint64_t(&xu->throttle_until) > now;
+}
+
+static inline bool stallq_should_unstall(gsh_xprt_private_t *xu,
+					 nsecs_elapsed_t now)
 {
-	return ((xu->req_cnt < nfs_param.core_param.dispatch_max_reqs_xprt / 2)
-		|| (xu->xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED));
+	if (xu->xprt->xp_flags & SVC_XPRT_FLAG_DESTROYED)
+		return true;
+
+	return (xu->req_cnt < nfs_param.core_param.dispatch_max_reqs_xprt / 2)
+		&& !nfs_rpc_xprt_throttled(xu, now);
 }
 
 void thr_stallq(struct fridgethr_context *thr_ctx)
@@ -784,11 +811,15 @@ void thr_stallq(struct fridgethr_context *thr_ctx)
 	gsh_xprt_private_t *xu;
 	struct glist_head *l;
 	SVCXPRT *xprt;
+	nsecs_elapsed_t now, until;
+	unsigned long delay_ms = 1000;
 
 	while (1) {
-		thread_delay_ms(1000);
+		thread_delay_ms(delay_ms);
+		delay_ms = 1000;
 		pthread_mutex_lock(&nfs_req_st.stallq.mtx);
  restart:
+		now = tb_now();
 		if (nfs_req_st.stallq.stalled == 0) {
 			nfs_req_st.stallq.active = FALSE;
 			pthread_mutex_unlock(&nfs_req_st.stallq.mtx);
@@ -797,8 +828,12 @@ void thr_stallq(struct fridgethr_context *thr_ctx)
 
 		glist_for_each(l, &nfs_req_st.stallq.q) {
 			xu = glist_entry(l, gsh_xprt_private_t, stallq);
+			/* come back when the earliest throttle ends */
+			until = atomic_fetch_uint64_t(&xu->throttle_until);
+			if (until > now && (until - now) / 1000000 < delay_ms)
+				delay_ms = (until - now) / 1000000 + 1;
 			/* handle stalled xprts that idle out */
-			if (stallq_should_unstall(xu)) {
+			if (stallq_should_unstall(xu, now)) {
 				xprt = xu->xprt;
 				/* lock ordering
 				 * (cf. nfs_rpc_cond_stall_xprt) */
@@ -846,8 +881,9 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 		 xprt->xp_refcnt, nreqs, xu->req_cnt,
 		 nfs_param.core_param.dispatch_max_reqs_xprt);
 
-	/* check per-xprt quota */
-	if (likely(nreqs < nfs_param.core_param.dispatch_max_reqs_xprt)) {
+	/* check per-xprt quota and the sender's rate limits */
+	if (likely(nreqs < nfs_param.core_param.dispatch_max_reqs_xprt)
+	    && !nfs_rpc_xprt_throttled(xu, tb_now())) {
 		pthread_mutex_unlock(&xprt->xp_lock);
 		return FALSE;
 	}
@@ -860,7 +896,8 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 		return TRUE;
 	}
 
-	LogDebug(COMPONENT_DISPATCH, "xprt %p has %u reqs, marking stalled",
+	LogDebug(COMPONENT_DISPATCH,
+		 "xprt %p has %u reqs or is over a rate limit, marking stalled",
 		 xprt, nreqs);
 
 	/* ok, need to stall */
@@ -892,10 +929,87 @@ static bool nfs_rpc_cond_stall_xprt(SVCXPRT *xprt)
 	return TRUE;
 }
 
+/**
+ * @brief Work out which shards CPUs enqueue on and workers visit
+ *
+ * CPUs are dealt round robin over the shards of their own NUMA node
+ * (over all shards without NUMA_Affinity), and each shard gets the
+ * order in which its workers look for requests: itself, the rest of
+ * its node, then everything else.
+ */
+static void nfs_rpc_q_map_shards(void)
+{
+	uint32_t nshards = nfs_req_st.reqs.nshards;
+	uint32_t ncpus = gsh_ncpus();
+	uint32_t nnodes = gsh_numa_nodes();
+	uint32_t *first, *count, *next;
+	struct req_q_shard *shard;
+	uint32_t cpu, node, sx, ix, n;
+
+	first = gsh_calloc(nnodes, sizeof(uint32_t));
+	count = gsh_calloc(nnodes, sizeof(uint32_t));
+	next = gsh_calloc(nnodes, sizeof(uint32_t));
+	nfs_req_st.reqs.cpu_shard = gsh_calloc(ncpus, sizeof(uint32_t));
+	if (first == NULL || count == NULL || next == NULL
+	    || nfs_req_st.reqs.cpu_shard == NULL)
+		LogFatal(COMPONENT_DISPATCH,
+			 "Unable to allocate the request queue shard map");
+	nfs_req_st.reqs.ncpus = ncpus;
+
+	/* each node's shards are contiguous */
+	for (sx = nshards; sx-- > 0;) {
+		node = nfs_req_st.reqs.shards[sx].node;
+		first[node] = sx;
+		count[node]++;
+	}
+
+	for (cpu = 0; cpu < ncpus; ++cpu) {
+		node = gsh_cpu_node(cpu);
+		if (node >= nnodes || count[node] == 0) {
+			nfs_req_st.reqs.cpu_shard[cpu] = cpu % nshards;
+			continue;
+		}
+		nfs_req_st.reqs.cpu_shard[cpu] =
+		    first[node] + next[node]++ % count[node];
+	}
+
+	for (sx = 0; sx < nshards; ++sx) {
+		shard = &nfs_req_st.reqs.shards[sx];
+		shard->visit = gsh_calloc(nshards, sizeof(uint32_t));
+		if (shard->visit == NULL)
+			LogFatal(COMPONENT_DISPATCH,
+				 "Unable to allocate the request queue shard map");
+		n = 0;
+		for (ix = 0; ix < nshards; ++ix)
+			if (nfs_req_st.reqs.shards[(sx + ix) % nshards].node ==
+			    shard->node)
+				shard->visit[n++] = (sx + ix) % nshards;
+		for (ix = 0; ix < nshards; ++ix)
+			if (nfs_req_st.reqs.shards[(sx + ix) % nshards].node !=
+			    shard->node)
+				shard->visit[n++] = (sx + ix) % nshards;
+	}
+
+	gsh_free(first);
+	gsh_free(count);
+	gsh_free(next);
+}
+
+/**
+ * @brief Place a decoder thread
+ *
+ * @param[in] ctx Thread fridge context
+ */
+static void decoder_thread_initializer(struct fridgethr_context *ctx)
+{
+	gsh_bind_thread(GSH_AFFINITY_DECODER, -1);
+}
+
 void nfs_rpc_queue_init(void)
 {
 	struct fridgethr_params reqparams;
 	struct req_q_pair *qpair;
+	uint32_t nshards, sx;
 	int rc = 0;
 	int ix;
 
@@ -910,6 +1024,7 @@ void nfs_rpc_queue_init(void)
 	reqparams.deferment = fridgethr_defer_block;
 	reqparams.block_delay =
 		nfs_param.core_param.decoder_fridge_block_timeout;
+	reqparams.thread_initialize = decoder_thread_initializer;
 
 	/* decoder thread pool */
 	rc = fridgethr_init(&req_fridge, "decoder", &reqparams);
@@ -917,19 +1032,60 @@ void nfs_rpc_queue_init(void)
 		LogFatal(COMPONENT_DISPATCH,
 			 "Unable to initialize decoder thread pool: %d", rc);
 
-	/* queues */
-	pthread_spin_init(&nfs_req_st.reqs.sp, PTHREAD_PROCESS_PRIVATE);
+	/* queue shards, by default one per online CPU, but never more
+	 * than there are workers to drain them */
+	nshards = nfs_param.core_param.dispatch_queue_shards;
+	if (nshards == 0) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+		nshards = (ncpu > 0) ? ncpu : 1;
+	}
+	/* at least one per node, so every node has local workers */
+	if (nshards < gsh_numa_nodes())
+		nshards = gsh_numa_nodes();
+	if (nshards > nfs_param.core_param.nb_worker)
+		nshards = nfs_param.core_param.nb_worker;
+
+	/* page aligned, so each shard can live on its node */
+	nfs_req_st.reqs.shards =
+		gsh_malloc_aligned(sysconf(_SC_PAGESIZE),
+				   nshards * sizeof(struct req_q_shard));
+	if (nfs_req_st.reqs.shards == NULL)
+		LogFatal(COMPONENT_DISPATCH,
+			 "Unable to allocate %u request queue shards",
+			 nshards);
+	for (sx = 0; sx < nshards; ++sx) {
+		struct req_q_shard *shard = &nfs_req_st.reqs.shards[sx];
+		uint32_t node = (uint64_t) sx * gsh_numa_nodes() / nshards;
+
+		gsh_numa_place(shard, sizeof(struct req_q_shard), node);
+		memset(shard, 0, sizeof(struct req_q_shard));
+		shard->node = node;
+	}
+	nfs_req_st.reqs.nshards = nshards;
 	nfs_req_st.reqs.size = 0;
-	for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
-		qpair = &(nfs_req_st.reqs.nfs_request_q.qset[ix]);
-		qpair->s = req_q_s[ix];
-		nfs_rpc_q_init(&qpair->producer);
-		nfs_rpc_q_init(&qpair->consumer);
+
+	nfs_rpc_q_map_shards();
+
+	for (sx = 0; sx < nshards; ++sx) {
+		struct req_q_shard *shard = &nfs_req_st.reqs.shards[sx];
+
+		for (ix = 0; ix < N_REQ_QUEUES; ++ix) {
+			qpair = &(shard->nfs_request_q.qset[ix]);
+			qpair->s = req_q_s[ix];
+			nfs_rpc_q_init(&qpair->producer);
+			nfs_rpc_q_init(&qpair->consumer);
+			nfs_rpc_q_init_flows(qpair);
+		}
+
+		/* idle workers */
+		init_event_count(&shard->ec);
+		shard->spinners = 0;
 	}
 
-	/* waitq */
-	glist_init(&nfs_req_st.reqs.wait_list);
-	nfs_req_st.reqs.waiters = 0;
+	LogInfo(COMPONENT_DISPATCH,
+		"%u request queue shards on %u NUMA nodes for %u workers",
+		nshards, gsh_numa_nodes(), nfs_param.core_param.nb_worker);
 
 	/* stallq */
 	gsh_mutex_init(&nfs_req_st.stallq.mtx, NULL);
@@ -938,26 +1094,100 @@ void nfs_rpc_queue_init(void)
 	nfs_req_st.stallq.stalled = 0;
 }
 
-static uint32_t enqueued_reqs;
-static uint32_t dequeued_reqs;
-
 uint32_t get_enqueue_count()
 {
-	return enqueued_reqs;
+	uint32_t enqueued = 0;
+	uint32_t sx;
+
+	for (sx = 0; sx < nfs_req_st.reqs.nshards; ++sx)
+		enqueued += atomic_fetch_uint32_t(
+				&nfs_req_st.reqs.shards[sx].enqueued);
+	return enqueued;
 }
 
 uint32_t get_dequeue_count()
 {
-	return dequeued_reqs;
+	uint32_t dequeued = 0;
+	uint32_t sx;
+
+	for (sx = 0; sx < nfs_req_st.reqs.nshards; ++sx)
+		dequeued += atomic_fetch_uint32_t(
+				&nfs_req_st.reqs.shards[sx].dequeued);
+	return dequeued;
+}
+
+/**
+ * @brief Choose the shard on which to enqueue a request
+ *
+ * Requests are queued on the shard of the CPU doing the enqueue, so
+ * that concurrent decoders on different cores do not share queue
+ * locks, and with NUMA_Affinity are handed to workers of the same
+ * node.
+ *
+ * @return The shard index.
+ */
+static inline uint32_t nfs_rpc_q_enqueue_shard(void)
+{
+	static uint32_t rr;
+	int cpu = -1;
+
+#ifdef LINUX
+	cpu = sched_getcpu();
+#endif
+	if (likely(cpu >= 0 && (uint32_t) cpu < nfs_req_st.reqs.ncpus))
+		return nfs_req_st.reqs.cpu_shard[cpu];
+
+	return atomic_inc_uint32_t(&rr) % nfs_req_st.reqs.nshards;
+}
+
+/**
+ * @brief Make sure up to @c n workers will look at the queues
+ *
+ * Shards are tried in @c sx's visiting order.  A shard with a spinning
+ * worker needs no wakeup, since the spinner rechecks every shard
+ * before it parks.  Otherwise parked workers are woken, until @c n
+ * have been accounted for.
+ *
+ * @param[in] sx Shard to prefer
+ * @param[in] n  Number of workers wanted
+ */
+static void nfs_rpc_q_wake(uint32_t sx, uint32_t n)
+{
+	struct req_q_shard *shard;
+	uint32_t nshards = nfs_req_st.reqs.nshards;
+	uint32_t *visit = nfs_req_st.reqs.shards[sx].visit;
+	uint32_t woken;
+	uint32_t ix;
+
+	/* order the caller's enqueue before the loads of spinners,
+	 * pairing with the recheck a spinner makes when it stops */
+	__sync_synchronize();
+
+	for (ix = 0; ix < nshards && n > 0; ++ix) {
+		shard = &nfs_req_st.reqs.shards[visit[ix]];
+
+		if (atomic_fetch_uint32_t(&shard->spinners) != 0)
+			return;
+
+		woken = ec_notify(&shard->ec, n);
+		if (woken) {
+			atomic_add_uint64_t(&shard->wakeups, woken);
+			n -= woken;
+		}
+	}
 }
 
 void nfs_rpc_enqueue_req(request_data_t *req)
 {
+	struct req_q_shard *shard;
 	struct req_q_set *nfs_request_q;
 	struct req_q_pair *qpair;
 	struct req_q *q;
+	uint32_t sx;
 
-	nfs_request_q = &nfs_req_st.reqs.nfs_request_q;
+	sx = nfs_rpc_q_enqueue_shard();
+	shard = &nfs_req_st.reqs.shards[sx];
+	nfs_request_q = &shard->nfs_request_q;
 
 	switch (req->rtype) {
 	case NFS_REQUEST:
@@ -999,123 +1229,203 @@ void nfs_rpc_enqueue_req(request_data_t *req)
 	++(q->size);
 	pthread_spin_unlock(&q->sp);
 
-	atomic_inc_uint32_t(&enqueued_reqs);
+	atomic_inc_uint32_t(&shard->enqueued);
 
 	LogDebug(COMPONENT_DISPATCH,
-		 "enqueued req, q %p (%s %p:%p) " "size is %d (enq %u deq %u)",
-		 q, qpair->s, &qpair->producer, &qpair->consumer, q->size,
-		 enqueued_reqs, dequeued_reqs);
+		 "enqueued req, shard %u q %p (%s %p:%p) size is %d",
+		 sx, q, qpair->s, &qpair->producer, &qpair->consumer,
+		 q->size);
+
+	/* potentially wakeup some thread, preferring a worker of this
+	 * shard, else any idle sibling (which will steal the request) */
+	nfs_rpc_q_wake(sx, 1);
 
-	/* potentially wakeup some thread */
+ out:
+	return;
+}
 
-	/* global waitq */
-	{
-		wait_q_entry_t *wqe;
+/**
+ * @brief Find the fair queueing flow of a request
+ *
+ * @param[in] qpair The queue pair
+ * @param[in] req   The request
+ *
+ * @return The flow.
+ */
+static inline struct req_q_flow *nfs_rpc_q_flow(struct req_q_pair *qpair,
+						request_data_t *req)
+{
+	uint64_t h = ((uintptr_t) req->tenant.client) >> 6;
 
-		/* SPIN LOCKED */
-		pthread_spin_lock(&nfs_req_st.reqs.sp);
-		if (nfs_req_st.reqs.waiters) {
-			wqe = glist_first_entry(&nfs_req_st.reqs.wait_list,
-						wait_q_entry_t, waitq);
+	h ^= ((uint64_t) (req->tenant.export_id + 1)) * 2654435761ULL;
+	return &qpair->flows[h % N_REQ_FLOWS];
+}
 
-			LogFullDebug(COMPONENT_DISPATCH,
-				     "nfs_req_st.reqs.waiters %u signal wqe %p (for q %p)",
-				     nfs_req_st.reqs.waiters, wqe, q);
-
-			/* release 1 waiter */
-			glist_del(&wqe->waitq);
-			--(nfs_req_st.reqs.waiters);
-			--(wqe->waiters);
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
-			pthread_mutex_lock(&wqe->lwe.mtx);
-			/* XXX reliable handoff */
-			wqe->flags |= Wqe_LFlag_SyncDone;
-			if (wqe->flags & Wqe_LFlag_WaitSync)
-				pthread_cond_signal(&wqe->lwe.cv);
-			pthread_mutex_unlock(&wqe->lwe.mtx);
-		} else
-			/* ! SPIN LOCKED */
-			pthread_spin_unlock(&nfs_req_st.reqs.sp);
+/**
+ * @brief Check whether a request's client is at its in-service cap
+ *
+ * The check and the later increment are not atomic, so a client can
+ * briefly overshoot Dispatch_Max_Reqs_Client by the number of
+ * workers racing on it.
+ *
+ * Requests resuming from asynchronous I/O gave up their slot when
+ * they were suspended (nfs_rpc_tenant_suspend) and take one again
+ * like any other request.
+ *
+ * @param[in] req The request
+ *
+ * @return true if the request must stay queued.
+ */
+static inline bool nfs_rpc_q_capped(request_data_t *req)
+{
+	uint32_t cap =
+	    atomic_fetch_uint32_t(&nfs_param.core_param.
+				  dispatch_max_reqs_client);
+
+	return cap != 0 && req->tenant.client != NULL
+	    && !req->tenant.in_service
+	    && atomic_fetch_uint32_t(&req->tenant.client->in_service) >= cap;
+}
+
+/**
+ * @brief Move requests from the producer side into their flows
+ *
+ * Called with the consumer side locked.
+ *
+ * @param[in] qpair The queue pair
+ * @param[in] reqs  Requests taken from the producer side
+ */
+static inline void nfs_rpc_q_distribute(struct req_q_pair *qpair,
+					struct glist_head *reqs)
+{
+	struct glist_head *g = NULL;
+	struct glist_head *n = NULL;
+	struct req_q_flow *flow;
+	request_data_t *req;
+
+	glist_for_each_safe(g, n, reqs) {
+		req = glist_entry(g, request_data_t, req_q);
+		flow = nfs_rpc_q_flow(qpair, req);
+		glist_del(&req->req_q);
+		glist_add_tail(&flow->q, &req->req_q);
+		if (flow->size++ == 0) {
+			/* newly active flows join at the end of the round */
+			flow->deficit = 0;
+			glist_add_tail(&qpair->active, &flow->active);
+		}
 	}
+}
 
- out:
-	return;
+/**
+ * @brief Pick the next request by deficit round robin
+ *
+ * The flow at the head of the active list is served while it has
+ * deficit left; otherwise it is granted its quantum (the weight of
+ * the export of its head request) and moves to the tail.  Flows
+ * whose head request belongs to a client at its cap are passed over.
+ *
+ * Called with the consumer side locked.
+ *
+ * @param[in] qpair The queue pair
+ *
+ * @return A request, or NULL if every queued request is held back.
+ */
+static request_data_t *nfs_rpc_q_drr(struct req_q_pair *qpair)
+{
+	struct req_q_flow *flow;
+	request_data_t *req;
+	uint32_t skipped = 0;
+
+	while (!glist_empty(&qpair->active)) {
+		flow = glist_first_entry(&qpair->active, struct req_q_flow,
+					 active);
+		req = glist_first_entry(&flow->q, request_data_t, req_q);
+
+		if (flow->deficit <= 0 || nfs_rpc_q_capped(req)) {
+			if (flow->deficit <= 0)
+				flow->deficit += req->tenant.weight
+				    ? req->tenant.weight : 1;
+			else if (++skipped >= N_REQ_FLOWS)
+				break;
+			glist_del(&flow->active);
+			glist_add_tail(&qpair->active, &flow->active);
+			continue;
+		}
+
+		glist_del(&req->req_q);
+		--(flow->deficit);
+		if (--(flow->size) == 0) {
+			glist_del(&flow->active);
+			flow->deficit = 0;
+		}
+
+		if (req->tenant.client != NULL && !req->tenant.in_service) {
+			atomic_inc_uint32_t(&req->tenant.client->in_service);
+			req->tenant.in_service = true;
+		}
+		return req;
+	}
+
+	return NULL;
 }
 
 /* static inline */
 request_data_t *nfs_rpc_consume_req(struct req_q_pair *qpair)
 {
 	request_data_t *nfsreq = NULL;
+	struct glist_head reqs;
+	uint32_t psize;
 
 	pthread_spin_lock(&qpair->consumer.sp);
-	if (qpair->consumer.size > 0) {
-		nfsreq =
-		    glist_first_entry(&qpair->consumer.q, request_data_t,
-				      req_q);
-		glist_del(&nfsreq->req_q);
-		--(qpair->consumer.size);
-		pthread_spin_unlock(&qpair->consumer.sp);
-		goto out;
-	} else {
-		char *s = NULL;
-		uint32_t csize = ~0U;
-		uint32_t psize = ~0U;
 
+	/* take whatever the decoders have queued, so that newly active
+	 * tenants compete in the current round */
+	if (atomic_fetch_uint32_t(&qpair->producer.size) > 0) {
+		glist_init(&reqs);
 		pthread_spin_lock(&qpair->producer.sp);
-		if (isFullDebug(COMPONENT_DISPATCH)) {
-			s = (char *)qpair->s;
-			csize = qpair->consumer.size;
-			psize = qpair->producer.size;
-		}
-		if (qpair->producer.size > 0) {
-			/* splice */
-			glist_splice_tail(&qpair->consumer.q,
-					  &qpair->producer.q);
-			qpair->consumer.size = qpair->producer.size;
-			qpair->producer.size = 0;
-			/* consumer.size > 0 */
-			pthread_spin_unlock(&qpair->producer.sp);
-			nfsreq =
-			    glist_first_entry(&qpair->consumer.q,
-					      request_data_t, req_q);
-			glist_del(&nfsreq->req_q);
-			--(qpair->consumer.size);
-			pthread_spin_unlock(&qpair->consumer.sp);
-			if (s)
-				LogFullDebug(COMPONENT_DISPATCH,
-					     "try splice, qpair %s consumer qsize=%u "
-					     "producer qsize=%u", s, csize,
-					     psize);
-			goto out;
-		}
-
+		psize = qpair->producer.size;
+		glist_splice_tail(&reqs, &qpair->producer.q);
+		qpair->consumer.size += psize;
+		qpair->producer.size = 0;
 		pthread_spin_unlock(&qpair->producer.sp);
-		pthread_spin_unlock(&qpair->consumer.sp);
+		nfs_rpc_q_distribute(qpair, &reqs);
+		LogFullDebug(COMPONENT_DISPATCH,
+			     "splice, qpair %s consumer qsize=%u "
+			     "producer qsize=%u", qpair->s,
+			     qpair->consumer.size, psize);
+	}
 
-		if (s)
-			LogFullDebug(COMPONENT_DISPATCH,
-				     "try splice, qpair %s consumer qsize=%u "
-				     "producer qsize=%u", s, csize, psize);
+	if (qpair->consumer.size > 0) {
+		nfsreq = nfs_rpc_q_drr(qpair);
+		if (nfsreq)
+			--(qpair->consumer.size);
 	}
- out:
+
+	pthread_spin_unlock(&qpair->consumer.sp);
+
 	return nfsreq;
 }
 
-request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
+/**
+ * @brief Try to take a request from any class queue of a shard
+ *
+ * @param[in] shard The shard to look at
+ *
+ * @return A request, or NULL if every queue of the shard is empty.
+ */
+static request_data_t *nfs_rpc_consume_shard(struct req_q_shard *shard)
 {
 	request_data_t *nfsreq = NULL;
-	struct req_q_set *nfs_request_q = &nfs_req_st.reqs.nfs_request_q;
+	struct req_q_set *nfs_request_q = &shard->nfs_request_q;
 	struct req_q_pair *qpair;
 	uint32_t ix, slot;
-	struct timespec timeout;
 
-	/* XXX: the following stands in for a more robust/flexible
-	 * weighting function */
+	/* rotate the class queue we start with, so that no class can
+	 * starve the others; fairness between tenants is handled within
+	 * each class queue (nfs_rpc_q_drr) */
 
 	/* slot in 1..4 */
- retry_deq:
-	slot = (nfs_rpc_q_next_slot() % 4);
+	slot = (nfs_rpc_q_next_slot(shard) % 4);
 	for (ix = 0; ix < 4; ++ix) {
 		switch (slot) {
 		case 0:
@@ -1147,7 +1457,7 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 		/* anything? */
 		nfsreq = nfs_rpc_consume_req(qpair);
 		if (nfsreq) {
-			atomic_inc_uint32_t(&dequeued_reqs);
+			atomic_inc_uint32_t(&shard->dequeued);
 			break;
 		}
 
@@ -1156,55 +1466,158 @@ request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
 
 	}			/* for */
 
-	/* wait */
-	if (!nfsreq) {
-		wait_q_entry_t *wqe = &worker->wqe;
-		assert(wqe->waiters == 0); /* wqe is not on any wait queue */
-		pthread_mutex_lock(&wqe->lwe.mtx);
-		wqe->flags = Wqe_LFlag_WaitSync;
-		wqe->waiters = 1;
-		/* XXX functionalize */
-		pthread_spin_lock(&nfs_req_st.reqs.sp);
-		glist_add_tail(&nfs_req_st.reqs.wait_list, &wqe->waitq);
-		++(nfs_req_st.reqs.waiters);
-		pthread_spin_unlock(&nfs_req_st.reqs.sp);
-		while (!(wqe->flags & Wqe_LFlag_SyncDone)) {
-			timeout.tv_sec = time(NULL) + 5;
-			timeout.tv_nsec = 0;
-			pthread_cond_timedwait(&wqe->lwe.cv, &wqe->lwe.mtx,
-					       &timeout);
-			if (fridgethr_you_should_break(worker->ctx)) {
-				/* We are returning;
-				 * so take us out of the waitq */
-				pthread_spin_lock(&nfs_req_st.reqs.sp);
-				if (wqe->waitq.next != NULL
-				    || wqe->waitq.prev != NULL) {
-					/* Element is still in wqitq,
-					 * remove it */
-					glist_del(&wqe->waitq);
-					--(nfs_req_st.reqs.waiters);
-					--(wqe->waiters);
-					wqe->flags &=
-					    ~(Wqe_LFlag_WaitSync |
-					      Wqe_LFlag_SyncDone);
-				}
-				pthread_spin_unlock(&nfs_req_st.reqs.sp);
-				pthread_mutex_unlock(&wqe->lwe.mtx);
-				return NULL;
-			}
-		}
+	return nfsreq;
+}
+
+/**
+ * @brief Seconds a worker of a shrinkable pool waits before it
+ *        counts as idle
+ */
+#define NFS_RPC_WORKER_IDLE 5
+
+/**
+ * @brief Take a request from the worker's shard, else from a sibling
+ *
+ * @param[in] worker The worker
+ *
+ * @return A request, or NULL if every shard is empty.
+ */
+static request_data_t *nfs_rpc_try_dequeue(nfs_worker_data_t *worker)
+{
+	struct req_q_shard *shard = &nfs_req_st.reqs.shards[worker->q_shard];
+	struct req_q_shard *sibling;
+	uint32_t nshards = nfs_req_st.reqs.nshards;
+	request_data_t *nfsreq;
+	uint32_t ix;
+
+	/* own shard first */
+	nfsreq = nfs_rpc_consume_shard(shard);
+	if (nfsreq) {
+		atomic_inc_uint64_t(&shard->local);
+		sibling = shard;
+		goto out;
+	}
 
-		/* XXX wqe was removed from nfs_req_st.waitq
-		 * (by signalling thread) */
-		wqe->flags &= ~(Wqe_LFlag_WaitSync | Wqe_LFlag_SyncDone);
-		pthread_mutex_unlock(&wqe->lwe.mtx);
-		LogFullDebug(COMPONENT_DISPATCH, "wqe wakeup %p", wqe);
-		goto retry_deq;
+	/* own shard is empty, steal from siblings, nearest first */
+	for (ix = 1; ix < nshards; ++ix) {
+		sibling = &nfs_req_st.reqs.shards[shard->visit[ix]];
+		nfsreq = nfs_rpc_consume_shard(sibling);
+		if (nfsreq) {
+			atomic_inc_uint64_t(&sibling->stolen);
+			goto out;
+		}
 	}
 
+	return NULL;
+
+ out:
+	/* an enqueue finding a spinner does not wake anyone, so pass
+	 * the wakeup on if more work is waiting */
+	if (nfs_rpc_q_backlog(sibling) != 0)
+		nfs_rpc_q_wake(worker->q_shard, 1);
+
 	return nfsreq;
 }
 
+/**
+ * @brief Spin briefly, watching for queued requests
+ *
+ * @param[in] shard The worker's shard
+ *
+ * @retval true if a request showed up.
+ * @retval false if none did within Worker_Spin microseconds.
+ */
+static bool nfs_rpc_spin(struct req_q_shard *shard)
+{
+	uint32_t nshards = nfs_req_st.reqs.nshards;
+	uint64_t spin = (uint64_t) nfs_param.core_param.worker_spin * 1000;
+	struct timespec start, cur;
+	uint32_t ix, loops;
+	bool found = false;
+
+	if (spin == 0)
+		return false;
+
+	atomic_inc_uint32_t(&shard->spinners);
+	now(&start);
+	for (loops = 1; !found; ++loops) {
+		for (ix = 0; ix < nshards && !found; ++ix)
+			found = nfs_rpc_q_backlog(
+					&nfs_req_st.reqs.shards[ix]) != 0;
+		if (found)
+			break;
+		cpu_relax();
+		/* look at the clock only now and then */
+		if ((loops % 64) == 0) {
+			now(&cur);
+			if (timespec_diff(&start, &cur) > spin)
+				break;
+		}
+	}
+	atomic_dec_uint32_t(&shard->spinners);
+
+	return found;
+}
+
+request_data_t *nfs_rpc_dequeue_req(nfs_worker_data_t *worker)
+{
+	request_data_t *nfsreq = NULL;
+	struct req_q_shard *shard = &nfs_req_st.reqs.shards[worker->q_shard];
+	struct timespec idle = {NFS_RPC_WORKER_IDLE, 0};
+	bool can_retire = nfs_param.core_param.nb_worker_min != 0
+	    && nfs_param.core_param.nb_worker_min <
+	    nfs_param.core_param.nb_worker;
+	uint32_t key;
+	int rc;
+
+	worker->idled = false;
+
+	while (true) {
+		nfsreq = nfs_rpc_try_dequeue(worker);
+		if (nfsreq)
+			return nfsreq;
+
+		if (nfs_rpc_spin(shard)) {
+			nfsreq = nfs_rpc_try_dequeue(worker);
+			if (nfsreq) {
+				atomic_inc_uint64_t(&shard->spin_hits);
+				return nfsreq;
+			}
+		}
+
+		/* park; anything enqueued after the key is taken bumps
+		 * the sequence and makes ec_wait return */
+		key = ec_prepare_wait(&shard->ec);
+
+		nfsreq = nfs_rpc_try_dequeue(worker);
+		if (nfsreq) {
+			ec_cancel_wait(&shard->ec);
+			return nfsreq;
+		}
+
+		if (fridgethr_you_should_break(worker->ctx)) {
+			ec_cancel_wait(&shard->ec);
+			return NULL;
+		}
+
+		/* only a pool that can shrink needs to notice idleness,
+		 * otherwise sleep until there is work */
+		atomic_inc_uint64_t(&shard->parks);
+		rc = ec_wait(&shard->ec, key, can_retire ? &idle : NULL);
+		LogFullDebug(COMPONENT_DISPATCH, "worker %u wakeup rc %d",
+			     worker->worker_index, rc);
+
+		if (rc == ETIMEDOUT) {
+			/* idle, and possibly retiring */
+			worker->idled = true;
+			return NULL;
+		}
+
+		if (fridgethr_you_should_break(worker->ctx))
+			return NULL;
+	}
+}
+
 /**
  * @brief Allocate a new request
  *
@@ -1237,6 +1650,9 @@ static inline request_data_t *alloc_nfs_request(SVCXPRT *xprt)
 	/* set up req */
 	req = &(nfsreq->r_u.nfs->req);
 
+	/* to requeue the request when its asynchronous I/O completes */
+	nfsreq->r_u.nfs->async.req = nfsreq;
+
 	/* set up xprt */
 	nfsreq->r_u.nfs->xprt = xprt;
 	req->rq_xprt = xprt;
@@ -1245,6 +1661,388 @@ static inline request_data_t *alloc_nfs_request(SVCXPRT *xprt)
 	return nfsreq;
 }
 
+/**
+ * @brief READ and WRITE bytes a decoded NFS request will move
+ *
+ * @param[in] reqnfs The decoded request
+ *
+ * @return The bytes requested or sent, summed over a compound.
+ */
+static uint64_t nfs_rpc_req_bytes(nfs_request_data_t *reqnfs)
+{
+	struct svc_req *req = &reqnfs->req;
+	uint64_t bytes = 0;
+
+	if (req->rq_vers == NFS_V3) {
+		if (req->rq_proc == NFSPROC3_READ)
+			bytes = reqnfs->arg_nfs.arg_read3.count;
+		else if (req->rq_proc == NFSPROC3_WRITE)
+			bytes = reqnfs->arg_nfs.arg_write3.data.data_len;
+	} else if (req->rq_vers == NFS_V4) {
+		COMPOUND4args *args = &reqnfs->arg_nfs.arg_compound4;
+		nfs_argop4 *argop;
+		uint32_t ix;
+
+		for (ix = 0; ix < args->argarray.argarray_len; ++ix) {
+			argop = &args->argarray.argarray_val[ix];
+			if (argop->argop == NFS4_OP_READ)
+				bytes += argop->nfs_argop4_u.opread.count;
+			else if (argop->argop == NFS4_OP_WRITE)
+				bytes += argop->nfs_argop4_u.opwrite.data.
+				    data_len;
+		}
+	}
+
+	return bytes;
+}
+
+/**
+ * @brief Export a decoded NFS request is for
+ *
+ * Runs in the decoder, so the handle is only looked at quietly: a
+ * bad one is reported when the request is executed.
+ *
+ * @param[in] reqnfs The decoded request
+ *
+ * @return The export id from the handle of an NFSv3 procedure, or
+ *         the first PUTFH of an NFSv4 compound, -1 if there is none.
+ */
+static int32_t nfs_rpc_req_export_id(nfs_request_data_t *reqnfs)
+{
+	struct svc_req *req = &reqnfs->req;
+	nfs_arg_t *arg = &reqnfs->arg_nfs;
+	nfs_fh3 *fh3;
+
+	if (req->rq_vers == NFS_V3) {
+		switch (req->rq_proc) {
+		case NFSPROC3_GETATTR:
+			fh3 = &arg->arg_getattr3.object;
+			break;
+		case NFSPROC3_SETATTR:
+			fh3 = &arg->arg_setattr3.object;
+			break;
+		case NFSPROC3_LOOKUP:
+			fh3 = &arg->arg_lookup3.what.dir;
+			break;
+		case NFSPROC3_ACCESS:
+			fh3 = &arg->arg_access3.object;
+			break;
+		case NFSPROC3_READLINK:
+			fh3 = &arg->arg_readlink3.symlink;
+			break;
+		case NFSPROC3_READ:
+			fh3 = &arg->arg_read3.file;
+			break;
+		case NFSPROC3_WRITE:
+			fh3 = &arg->arg_write3.file;
+			break;
+		case NFSPROC3_CREATE:
+			fh3 = &arg->arg_create3.where.dir;
+			break;
+		case NFSPROC3_MKDIR:
+			fh3 = &arg->arg_mkdir3.where.dir;
+			break;
+		case NFSPROC3_SYMLINK:
+			fh3 = &arg->arg_symlink3.where.dir;
+			break;
+		case NFSPROC3_MKNOD:
+			fh3 = &arg->arg_mknod3.where.dir;
+			break;
+		case NFSPROC3_REMOVE:
+			fh3 = &arg->arg_remove3.object.dir;
+			break;
+		case NFSPROC3_RMDIR:
+			fh3 = &arg->arg_rmdir3.object.dir;
+			break;
+		case NFSPROC3_RENAME:
+			fh3 = &arg->arg_rename3.from.dir;
+			break;
+		case NFSPROC3_LINK:
+			fh3 = &arg->arg_link3.file;
+			break;
+		case NFSPROC3_READDIR:
+			fh3 = &arg->arg_readdir3.dir;
+			break;
+		case NFSPROC3_READDIRPLUS:
+			fh3 = &arg->arg_readdirplus3.dir;
+			break;
+		case NFSPROC3_FSSTAT:
+			fh3 = &arg->arg_fsstat3.fsroot;
+			break;
+		case NFSPROC3_FSINFO:
+			fh3 = &arg->arg_fsinfo3.fsroot;
+			break;
+		case NFSPROC3_PATHCONF:
+			fh3 = &arg->arg_pathconf3.object;
+			break;
+		case NFSPROC3_COMMIT:
+			fh3 = &arg->arg_commit3.file;
+			break;
+		default:
+			return -1;
+		}
+		return nfs3_FhandleToExportIdQuiet(fh3);
+	} else if (req->rq_vers == NFS_V4) {
+		COMPOUND4args *args = &arg->arg_compound4;
+		nfs_argop4 *argop;
+		uint32_t ix;
+
+		for (ix = 0; ix < args->argarray.argarray_len; ++ix) {
+			argop = &args->argarray.argarray_val[ix];
+			if (argop->argop == NFS4_OP_SEQUENCE)
+				continue;
+			if (argop->argop == NFS4_OP_PUTFH)
+				return nfs4_FhandleToExportIdQuiet(
+					&argop->nfs_argop4_u.opputfh.object);
+			break;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Client of a decoded request
+ *
+ * A connection only ever has the one client, so it is looked up on
+ * the connection's first request and kept, with a reference, until
+ * the connection goes.  A UDP transport is shared by every client
+ * using it, and is looked up each time.
+ *
+ * @param[in] xprt The request's transport
+ *
+ * @return The client, referenced, or NULL.
+ */
+static struct gsh_client *nfs_rpc_xprt_client(SVCXPRT *xprt)
+{
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
+	struct gsh_client *client;
+	sockaddr_t addr;
+
+	if (xprt->xp_type != XPRT_UDP && xu->client != NULL) {
+		get_gsh_client_ref(xu->client);
+		return xu->client;
+	}
+
+	if (copy_xprt_addr(&addr, xprt) != 1)
+		return NULL;
+	client = get_gsh_client(&addr, false);
+
+	if (client != NULL && xprt->xp_type != XPRT_UDP) {
+		/* the connection's own reference */
+		get_gsh_client_ref(client);
+		xu->client = client;
+	}
+
+	return client;
+}
+
+/**
+ * @brief Export of a connection's request
+ *
+ * The export of a connection's last request is kept, with a
+ * reference, and used again while the requests are for the same
+ * export and gsh_export_gen says none has gone since.  Only the
+ * connection's decoder calls this, so no lock is needed.
+ *
+ * @param[in] xu        The connection
+ * @param[in] export_id The request's export
+ *
+ * @return The export, referenced by the connection, or NULL.
+ */
+static struct gsh_export *nfs_rpc_xprt_export(gsh_xprt_private_t *xu,
+					      uint16_t export_id)
+{
+	uint32_t gen = gsh_export_gen();
+
+	if (xu->export != NULL
+	    && (xu->export->export_id != export_id || xu->export_gen != gen)) {
+		put_gsh_export(xu->export);
+		xu->export = NULL;
+	}
+
+	if (xu->export == NULL) {
+		xu->export = get_gsh_export(export_id);
+		xu->export_gen = gen;
+	}
+
+	return xu->export;
+}
+
+/**
+ * @brief Classify the fair queueing tenant of a decoded request
+ *
+ * Takes a reference on the calling client, released by
+ * nfs_rpc_tenant_release, and finds the export the request is for
+ * (from the NFSv3 handle, or the first PUTFH of an NFSv4 compound)
+ * and its scheduling weight.  The request is charged to the rate
+ * limits of both.  On a connection, both are remembered from one
+ * request to the next.
+ *
+ * A UDP transport is shared by every client using it, so holding it
+ * off would punish all of them for one.  Its requests are policed
+ * instead: one arriving while its sender or export is already over
+ * the burst is not charged to either, and the caller drops it for
+ * the client to retransmit.
+ *
+ * @param[in,out] nfsreq The decoded request
+ * @param[in]     police Refuse requests over a limit, rather than
+ *                       charging them
+ *
+ * @return Nanoseconds the transport should not be read for, because
+ *         the client or export is over a rate limit, else 0.  When
+ *         policing, non-zero means the request must be dropped.
+ */
+static nsecs_elapsed_t nfs_rpc_classify_tenant(request_data_t *nfsreq,
+					       bool police)
+{
+	nfs_request_data_t *reqnfs = nfsreq->r_u.nfs;
+	struct svc_req *req = &reqnfs->req;
+	struct req_tenant *tenant = &nfsreq->tenant;
+	SVCXPRT *xprt = reqnfs->xprt;
+	struct gsh_export *export = NULL;
+	nsecs_elapsed_t now, burst, delay = 0, xdelay;
+	uint64_t bytes = 0;
+
+	tenant->client = nfs_rpc_xprt_client(xprt);
+	tenant->export_id = -1;
+	tenant->weight = 1;
+	tenant->in_service = false;
+
+	if (req->rq_prog == nfs_param.core_param.program[P_NFS]
+	    && req->rq_proc != NFSPROC_NULL)
+		bytes = nfs_rpc_req_bytes(reqnfs);
+
+	now = tb_now();
+	burst = (nsecs_elapsed_t) nfs_param.core_param.rate_limit_burst *
+	    1000000;
+
+	if (tenant->client != NULL && police) {
+		delay = tb_debt(&tenant->client->ops_tb,
+				nfs_param.core_param.client_ops_rate,
+				now, burst);
+		if (delay == 0)
+			delay = tb_debt(&tenant->client->bytes_tb,
+					nfs_param.core_param.client_bytes_rate,
+					now, burst);
+		if (delay != 0)
+			return delay;
+	}
+
+	if (req->rq_prog == nfs_param.core_param.program[P_NFS]
+	    && req->rq_proc != NFSPROC_NULL)
+		tenant->export_id = nfs_rpc_req_export_id(reqnfs);
+
+	if (tenant->export_id >= 0) {
+		if (xprt->xp_type == XPRT_UDP)
+			export = get_gsh_export(tenant->export_id);
+		else
+			export = nfs_rpc_xprt_export(
+				(gsh_xprt_private_t *) xprt->xp_u1,
+				tenant->export_id);
+	}
+
+	/* the export first, so that a request it refuses is not
+	 * charged to the client */
+	if (export != NULL) {
+		delay = gsh_export_admit(export, bytes, now, burst, police,
+					 &tenant->weight);
+		if (xprt->xp_type == XPRT_UDP)
+			put_gsh_export(export);
+		if (police && delay != 0)
+			return delay;
+	}
+
+	if (tenant->client != NULL) {
+		xdelay = tb_charge(&tenant->client->ops_tb,
+				   nfs_param.core_param.client_ops_rate,
+				   1, now, burst);
+		if (xdelay > delay)
+			delay = xdelay;
+		xdelay = tb_charge(&tenant->client->bytes_tb,
+				   nfs_param.core_param.client_bytes_rate,
+				   bytes, now, burst);
+		if (xdelay > delay)
+			delay = xdelay;
+	}
+
+	/* admitted; the debt it ran up refuses the next ones */
+	if (police)
+		delay = 0;
+
+	return delay;
+}
+
+/**
+ * @brief Hold off reading a transport whose sender is over a limit
+ *
+ * Only the transport's decoder calls this, so a plain store is
+ * enough to extend the deadline.
+ *
+ * @param[in] xprt  The transport
+ * @param[in] delay Nanoseconds to hold it off for
+ */
+static void nfs_rpc_throttle_xprt(SVCXPRT *xprt, nsecs_elapsed_t delay)
+{
+	gsh_xprt_private_t *xu = (gsh_xprt_private_t *) xprt->xp_u1;
+	nsecs_elapsed_t until = tb_now() + delay;
+
+	LogDebug(COMPONENT_DISPATCH, "xprt %p over rate limit for %" PRIu64
+		 " ns", xprt, delay);
+
+	if (until > atomic_fetch_uint64_t(&xu->throttle_until))
+		atomic_store_uint64_t(&xu->throttle_until, until);
+}
+
+/**
+ * @brief Give up the in-service slot of a suspended request
+ *
+ * A request waiting on asynchronous I/O holds no worker, so it must
+ * not count against Dispatch_Max_Reqs_Client; it takes a slot again
+ * when it is dequeued to resume.  As in nfs_rpc_tenant_release, the
+ * worker suspending it goes back to the queues and picks up whatever
+ * the cap was holding back.
+ *
+ * Must be called before the request can be requeued.
+ *
+ * @param[in,out] req The request
+ */
+void nfs_rpc_tenant_suspend(request_data_t *req)
+{
+	struct req_tenant *tenant = &req->tenant;
+
+	if (tenant->client == NULL || !tenant->in_service)
+		return;
+
+	atomic_dec_uint32_t(&tenant->client->in_service);
+	tenant->in_service = false;
+}
+
+/**
+ * @brief Release the fair queueing tenant of a request
+ *
+ * Drops the client's in-service count, if the request was dequeued,
+ * and the client reference taken by nfs_rpc_classify_tenant.
+ *
+ * @param[in,out] req The request
+ */
+void nfs_rpc_tenant_release(request_data_t *req)
+{
+	struct req_tenant *tenant = &req->tenant;
+
+	if (tenant->client == NULL)
+		return;
+
+	/* a worker is already on its way back to the queues (the one
+	 * that executed this request), so requests held back by the
+	 * client cap need no explicit wakeup */
+	if (tenant->in_service)
+		atomic_dec_uint32_t(&tenant->client->in_service);
+	put_gsh_client(tenant->client);
+	tenant->client = NULL;
+	tenant->in_service = false;
+}
+
 static inline void free_nfs_request(request_data_t *nfsreq)
 {
 	switch (nfsreq->rtype) {
@@ -1263,6 +2061,7 @@ static inline void free_nfs_request(request_data_t *nfsreq)
 	default:
 		break;
 	}
+	nfs_rpc_tenant_release(nfsreq);
 	pool_free(request_pool, nfsreq);
 }
 
@@ -1510,6 +2309,7 @@ static inline enum xprt_stat thr_decode_rpc_request(struct fridgethr_context
 	bool rlocked = FALSE;
 	bool enqueued = FALSE;
 	bool recv_status;
+	nsecs_elapsed_t delay;
 
 	LogDebug(COMPONENT_DISPATCH, "enter");
 
@@ -1586,6 +2386,24 @@ static inline enum xprt_stat thr_decode_rpc_request(struct fridgethr_context
 		if (!nfs_rpc_get_args(thr_ctx, nfsreq->r_u.nfs))
 			goto finish;
 
+		delay = nfs_rpc_classify_tenant(nfsreq,
+						xprt->xp_type == XPRT_UDP);
+		if (delay != 0 && xprt->xp_type == XPRT_UDP) {
+			LogDebug(COMPONENT_DISPATCH,
+				 "Dropping request xid=%u over rate limit on UDP xprt %p",
+				 nfsreq->r_u.nfs->req.rq_xid, xprt);
+			if (!SVC_FREEARGS(xprt,
+					  nfsreq->r_u.nfs->funcdesc->
+					  xdr_decode_func,
+					  (caddr_t) &nfsreq->r_u.nfs->arg_nfs))
+				LogCrit(COMPONENT_DISPATCH,
+					"Bad SVC_FREEARGS for %s",
+					nfsreq->r_u.nfs->funcdesc->funcname);
+			goto finish;
+		}
+		if (delay != 0)
+			nfs_rpc_throttle_xprt(xprt, delay);
+
 		/* update accounting */
 		if (!gsh_xprt_ref
 		    (xprt, XPRT_PRIVATE_FLAG_INCREQ, __func__, __LINE__)) {
@@ -1632,6 +2450,10 @@ static inline bool thr_continue_decoding(SVCXPRT *xprt, enum xprt_stat stat)
 	if (unlikely(nreqs > nfs_param.core_param.dispatch_max_reqs_xprt))
 		return FALSE;
 
+	/* over a rate limit, let nfs_rpc_cond_stall_xprt park it */
+	if (nfs_rpc_xprt_throttled(xu, tb_now()))
+		return FALSE;
+
 	return (stat == XPRT_MOREREQS);
 }
 
@@ -1812,17 +2634,21 @@ static bool nfs_rpc_getreq_ng(SVCXPRT *xprt /*, int chan_id */)
 /**
  * @brief Thread used to service an (epoll, etc) event channel.
  *
- * @param[in] arg Poitner to ID of the associated event channel
+ * @param[in] arg Index of the event channel in rpc_evchan[]
  *
  * @return Pointer to the result (but this function will mostly loop forever).
  *
  */
 void *rpc_dispatcher_thread(void *arg)
 {
-	int32_t chan_id = *((int32_t *) arg);
+	uint32_t ix = (uintptr_t) arg;
+	int32_t chan_id = rpc_evchan[ix].chan_id;
 
 	SetNameFunction("disp");
 
+	/* spread the channels over the nodes */
+	gsh_bind_thread(GSH_AFFINITY_EVCHAN, ix % gsh_numa_nodes());
+
 	/* Calling dispatcher main loop */
 	LogInfo(COMPONENT_DISPATCH, "Entering nfs/rpc dispatcher");
 
@@ -62,8 +62,10 @@
 #include "fridgethr.h"
 #include "client_mgr.h"
 #include "export_mgr.h"
+#include "sal_functions.h"
 #include "server_stats.h"
 #include "uid2grp.h"
+#include "gsh_affinity.h"
 
 #ifdef USE_LTTNG
 #include "ganesha_lttng/nfs_rpc.h"
@@ -75,6 +77,15 @@ pool_t *dupreq_pool;
 
 static struct fridgethr *worker_fridge;
 
+struct nfs_worker_pool nfs_worker_pool;
+
+/* Serializes pool growth decisions; contenders skip rather than wait */
+static pthread_mutex_t worker_pool_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* Least time between adding two workers, so that a new worker gets a
+ * chance to bring the queue wait down (nsecs) */
+#define WORKER_GROW_HOLDOFF (10 * NS_PER_MSEC)
+
 const nfs_function_desc_t invalid_funcdesc = {
 	.service_function = nfs_null,
 	.free_function = nfs_null_free,
@@ -698,15 +709,125 @@ const nfs_function_desc_t *nfs_rpc_get_funcdesc(nfs_request_data_t *reqnfs)
 	return funcdesc;
 }
 
+/**
+ * @brief Requeue a request suspended on asynchronous I/O
+ *
+ * @param[in] reqnfs The request
+ */
+static void nfs_rpc_resume_req(nfs_request_data_t *reqnfs)
+{
+	LogFullDebug(COMPONENT_DISPATCH, "Resuming request %p xid=%u",
+		     reqnfs, reqnfs->req.rq_xid);
+	reqnfs->async.resume = true;
+	nfs_rpc_enqueue_req(reqnfs->async.req);
+}
+
+/**
+ * @brief Completion of the asynchronous I/O of a request
+ *
+ * @param[in] io         The I/O
+ * @param[in] caller_arg The request
+ */
+static void nfs_rpc_rdwr_done(struct cache_inode_io *io, void *caller_arg)
+{
+	nfs_request_data_t *reqnfs = caller_arg;
+
+	/* unless the worker is done suspending the request, it will
+	 * requeue it itself */
+	if (atomic_dec_uint32_t(&reqnfs->async.pending) == 0)
+		nfs_rpc_resume_req(reqnfs);
+}
+
+/**
+ * @brief Drop the client record held across a request's suspension
+ *
+ * @param[in,out] reqnfs The request
+ */
+static void nfs_rpc_async_put_clientid(nfs_request_data_t *reqnfs)
+{
+	if (reqnfs->async.clientid == NULL)
+		return;
+
+	dec_client_id_ref(reqnfs->async.clientid);
+	reqnfs->async.clientid = NULL;
+}
+
+/**
+ * @brief Read or write on behalf of a request, asynchronously
+ *
+ * Starts the I/O described by reqnfs->async.io.  If it completes at
+ * once (always the case for FSALs without asynchronous I/O), it is
+ * finished here.  Otherwise the service function must return
+ * NFS_REQ_ASYNC_WAIT (a NFSv4 operation just returns, nfs4_Compound
+ * notices) with everything it needs to go on saved in the request.
+ * Once the I/O completes, the service function is called again with
+ * reqnfs->async.resume set, and calls cache_inode_rdwr_finish.
+ *
+ * op_ctx->clientid, if set, may point into state that goes away while
+ * the request is suspended.  A suspended request instead points it
+ * at @a clientid, referenced until the service function has returned
+ * for good.
+ *
+ * @param[in,out] reqnfs    The request
+ * @param[in]     clientid  Client record op_ctx->clientid is for, or
+ *                          NULL
+ * @param[out]    suspended Whether the request must be suspended
+ *
+ * @return The status of the I/O, if not suspended.
+ */
+cache_inode_status_t nfs_rpc_rdwr_async(nfs_request_data_t *reqnfs,
+				       nfs_client_id_t *clientid,
+				       bool *suspended)
+{
+	cache_inode_status_t status;
+
+	*suspended = false;
+
+	/* one count for us, one for the completion */
+	atomic_store_uint32_t(&reqnfs->async.pending, 2);
+
+	status = cache_inode_rdwr_async(&reqnfs->async.io, nfs_rpc_rdwr_done,
+					reqnfs);
+	if (status != CACHE_INODE_SUCCESS) {
+		atomic_store_uint32_t(&reqnfs->async.pending, 0);
+		return status;
+	}
+
+	if (atomic_fetch_uint32_t(&reqnfs->async.pending) == 1) {
+		/* already complete */
+		atomic_store_uint32_t(&reqnfs->async.pending, 0);
+		return cache_inode_rdwr_finish(&reqnfs->async.io);
+	}
+
+	if (clientid != NULL) {
+		/* a compound suspended before holds one already */
+		nfs_rpc_async_put_clientid(reqnfs);
+		inc_client_id_ref(clientid);
+		reqnfs->async.clientid = clientid;
+		op_ctx->clientid = &clientid->cid_clientid;
+	}
+
+	/* our count is dropped by nfs_rpc_execute, once the request's
+	 * context is saved */
+	reqnfs->async.suspended = true;
+	*suspended = true;
+
+	return CACHE_INODE_SUCCESS;
+}
+
 /**
  * @brief Main RPC dispatcher routine
  *
  * @param[in,out] req         NFS request
  * @param[in,out] worker_data Worker thread context
  *
+ * @retval NFS_REQ_ASYNC_WAIT if the request is suspended on
+ *         asynchronous I/O; it must not be released, its completion
+ *         requeues it.
+ * @retval NFS_REQ_OK otherwise.
  */
-static void nfs_rpc_execute(request_data_t *req,
-			    nfs_worker_data_t *worker_data)
+static int nfs_rpc_execute(request_data_t *req,
+			   nfs_worker_data_t *worker_data)
 {
 	nfs_request_data_t *reqnfs = req->r_u.nfs;
 	nfs_arg_t *arg_nfs = &reqnfs->arg_nfs;
@@ -730,6 +851,25 @@ static void nfs_rpc_execute(request_data_t *req,
 	tracepoint(nfs_rpc, start, req);
 #endif
 
+	if (reqnfs->async.resume) {
+		/* restore the context the request was suspended with */
+		req_ctx = reqnfs->async.req_ctx;
+		user_credentials = reqnfs->async.creds;
+		export_perms = reqnfs->async.export_perms;
+		worker_data->hostaddr = reqnfs->async.hostaddr;
+		op_ctx = &req_ctx;
+		op_ctx->creds = &user_credentials;
+		op_ctx->caller_addr = &worker_data->hostaddr;
+		op_ctx->export_perms = &export_perms;
+		res_nfs = reqnfs->res_nfs;
+		dpq_status = DUPREQ_SUCCESS;
+		if (op_ctx->client != NULL) {
+			SetClientIP(op_ctx->client->hostaddr_str);
+			client_ip = op_ctx->client->hostaddr_str;
+		}
+		goto resume;
+	}
+
 	/* Initialize permissions to allow nothing */
 	export_perms.options = 0;
 	export_perms.anonymous_uid = (uid_t) ANON_UID;
@@ -773,7 +913,13 @@ static void nfs_rpc_execute(request_data_t *req,
 	}
 
 	port = get_port(op_ctx->caller_addr);
-	op_ctx->client = get_gsh_client(op_ctx->caller_addr, false);
+	/* the decoder already found the client to queue the request */
+	if (req->tenant.client != NULL) {
+		op_ctx->client = req->tenant.client;
+		get_gsh_client_ref(op_ctx->client);
+	} else {
+		op_ctx->client = get_gsh_client(op_ctx->caller_addr, false);
+	}
 	if (op_ctx->client == NULL) {
 		LogDebug(COMPONENT_DISPATCH,
 			 "Cannot get client block for Program %d, Version %d, "
@@ -1269,14 +1415,41 @@ static void nfs_rpc_execute(request_data_t *req,
 			   (op_ctx->export != NULL
 			    ? op_ctx->export->export_id : -1));
 #endif
+ resume:
 		rc = reqnfs->funcdesc->service_function(arg_nfs,
 							worker_data, svcreq,
 							res_nfs);
+		reqnfs->async.resume = false;
+		if (rc != NFS_REQ_ASYNC_WAIT
+		    && reqnfs->async.clientid != NULL) {
+			/* whatever the resumed operation left there */
+			op_ctx->clientid = NULL;
+			nfs_rpc_async_put_clientid(reqnfs);
+		}
 
 #ifdef USE_LTTNG
 		tracepoint(nfs_rpc, op_end, req);
 #endif
 
+		if (rc == NFS_REQ_ASYNC_WAIT) {
+			/* save the context for the worker that resumes
+			 * the request, then let the completion requeue it
+			 * (or requeue it ourselves if it came first) */
+			reqnfs->async.req_ctx = req_ctx;
+			reqnfs->async.creds = user_credentials;
+			reqnfs->async.export_perms = export_perms;
+			reqnfs->async.hostaddr = worker_data->hostaddr;
+			reqnfs->async.suspended = false;
+			nfs_rpc_tenant_suspend(reqnfs->async.req);
+			LogFullDebug(COMPONENT_DISPATCH,
+				     "Suspending request %p xid=%u",
+				     reqnfs, svcreq->rq_xid);
+			if (atomic_dec_uint32_t(&reqnfs->async.pending) == 0)
+				nfs_rpc_resume_req(reqnfs);
+			SetClientIP(NULL);
+			op_ctx = NULL;
+			return NFS_REQ_ASYNC_WAIT;
+		}
 	}
 
  req_error:
@@ -1397,7 +1570,7 @@ out:
 	tracepoint(nfs_rpc, end, req);
 #endif
 
-	return;
+	return NFS_REQ_OK;
 }
 
 #ifdef _USE_9P
@@ -1459,10 +1632,13 @@ static void worker_thread_initializer(struct fridgethr_context *ctx)
 	snprintf(thr_name, sizeof(thr_name), "work-%u", wd->worker_index);
 	SetNameFunction(thr_name);
 
-	/* Initalize thr waitq */
-	init_wait_q_entry(&wd->wqe);
+	wd->q_shard = nfs_rpc_q_worker_shard(wd->worker_index);
+	/* keep the worker on its shard's node */
+	gsh_bind_thread(GSH_AFFINITY_WORKER,
+			nfs_req_st.reqs.shards[wd->q_shard].node);
 	wd->ctx = ctx;
 	ctx->thread_info = wd;
+	atomic_inc_uint32_t(&nfs_worker_pool.threads);
 }
 
 /**
@@ -1473,10 +1649,93 @@ static void worker_thread_initializer(struct fridgethr_context *ctx)
 
 static void worker_thread_finalizer(struct fridgethr_context *ctx)
 {
+	atomic_dec_uint32_t(&nfs_worker_pool.threads);
 	gsh_free(ctx->thread_info);
 	ctx->thread_info = NULL;
 }
 
+static void worker_run(struct fridgethr_context *ctx);
+
+/**
+ * @brief Account a request's queue wait and grow the pool if needed
+ *
+ * Called by a worker that just dequeued a request.  The average
+ * is an exponentially weighted one (1/8 of each sample), updated
+ * without a lock as an occasional lost sample does not matter.
+ *
+ * @param[in] nfsreq The request just dequeued
+ */
+
+static void worker_pool_adapt(request_data_t *nfsreq)
+{
+	struct nfs_worker_pool *wp = &nfs_worker_pool;
+	struct timespec ts;
+	nsecs_elapsed_t now_ns, wait, avg;
+	int rc;
+
+	now(&ts);
+	now_ns = timespec_diff(&ServerBootTime, &ts);
+	wait = now_ns - timespec_diff(&ServerBootTime, &nfsreq->time_queued);
+	avg = atomic_fetch_uint64_t(&wp->qwait_avg);
+	avg = avg - (avg >> 3) + (wait >> 3);
+	atomic_store_uint64_t(&wp->qwait_avg, avg);
+
+	if (nfs_param.core_param.nb_worker_min == 0
+	    || avg < (nsecs_elapsed_t) nfs_param.core_param.worker_grow_wait
+	    * NS_PER_USEC)
+		return;
+
+	/* only grow when every other worker is busy, a wait caused by
+	 * a burst the idle workers have yet to drain is no reason */
+	if (atomic_fetch_uint32_t(&wp->busy) + 1 <
+	    atomic_fetch_uint32_t(&wp->threads))
+		return;
+
+	if (pthread_mutex_trylock(&worker_pool_mtx) != 0)
+		return;
+
+	if (now_ns - wp->last_grow >= WORKER_GROW_HOLDOFF
+	    && atomic_fetch_uint32_t(&wp->threads) <
+	    nfs_param.core_param.nb_worker) {
+		wp->last_grow = now_ns;
+		rc = fridgethr_submit(worker_fridge, worker_run, NULL);
+		if (rc == 0) {
+			atomic_inc_uint64_t(&wp->grown);
+			LogDebug(COMPONENT_DISPATCH,
+				 "Added a worker, %u running, queue wait %"
+				 PRIu64 " nsecs", atomic_fetch_uint32_t(
+					 &wp->threads), avg);
+		} else {
+			LogDebug(COMPONENT_DISPATCH,
+				 "Unable to add a worker: %d", rc);
+		}
+	}
+
+	pthread_mutex_unlock(&worker_pool_mtx);
+}
+
+/**
+ * @brief Tell whether the worker pool is saturated
+ *
+ * The pool is saturated when requests wait longer than
+ * Worker_Grow_Wait in the queue, every worker is busy, and the pool
+ * may not grow any further.  NFSv4.1 sessions use this to ask
+ * clients for fewer slots.
+ *
+ * @return true if more requests in flight would only queue.
+ */
+
+bool nfs_worker_pool_saturated(void)
+{
+	struct nfs_worker_pool *wp = &nfs_worker_pool;
+	uint32_t threads = atomic_fetch_uint32_t(&wp->threads);
+
+	return atomic_fetch_uint64_t(&wp->qwait_avg) >=
+		(uint64_t) nfs_param.core_param.worker_grow_wait * NS_PER_USEC
+	    && atomic_fetch_uint32_t(&wp->busy) + 1 >= threads
+	    && threads >= nfs_param.core_param.nb_worker;
+}
+
 /**
  * @brief The main function for a worker thread
  *
@@ -1494,13 +1753,28 @@ static void worker_run(struct fridgethr_context *ctx)
 	request_data_t *nfsreq;
 	gsh_xprt_private_t *xu = NULL;
 	uint32_t reqcnt;
+	bool suspended;
 
 	/* Worker's loop */
 	while (!fridgethr_you_should_break(ctx)) {
 		nfsreq = nfs_rpc_dequeue_req(worker_data);
 
-		if (!nfsreq)
+		if (!nfsreq) {
+			/* idle for a while, leave if the pool is above
+			 * its minimum */
+			if (worker_data->idled && fridgethr_retire(ctx)) {
+				atomic_inc_uint64_t(&nfs_worker_pool.retired);
+				LogDebug(COMPONENT_DISPATCH,
+					 "Retiring idle worker %u",
+					 worker_data->worker_index);
+				return;
+			}
 			continue;
+		}
+
+		worker_pool_adapt(nfsreq);
+		atomic_inc_uint32_t(&nfs_worker_pool.busy);
+		suspended = false;
 
 /* need to do a getpeername(2) on the socket fd before we dive into the
  * rpc_execute.  9p is messy but we do have the fd....
@@ -1512,6 +1786,16 @@ static void worker_run(struct fridgethr_context *ctx)
 				"Unexpected unknown request");
 			break;
 		case NFS_REQUEST:
+			if (nfsreq->r_u.nfs->async.resume) {
+				/* finish it even if the xprt was destroyed
+				 * meanwhile, to release what it holds */
+				LogDebug(COMPONENT_DISPATCH,
+					 "NFS protocol request resumed, nfsreq=%p xprt=%p",
+					 nfsreq, nfsreq->r_u.nfs->xprt);
+				suspended = nfs_rpc_execute(nfsreq, worker_data)
+				    == NFS_REQ_ASYNC_WAIT;
+				break;
+			}
 			/* check for destroyed xprts */
 			xu = (gsh_xprt_private_t *) nfsreq->r_u.nfs->xprt->
 			    xp_u1;
@@ -1528,7 +1812,8 @@ static void worker_run(struct fridgethr_context *ctx)
 			LogDebug(COMPONENT_DISPATCH,
 				 "NFS protocol request, nfsreq=%p xprt=%p req_cnt=%d",
 				 nfsreq, nfsreq->r_u.nfs->xprt, reqcnt);
-			nfs_rpc_execute(nfsreq, worker_data);
+			suspended = nfs_rpc_execute(nfsreq, worker_data)
+			    == NFS_REQ_ASYNC_WAIT;
 			break;
 
 		case NFS_CALL:
@@ -1544,6 +1829,12 @@ static void worker_run(struct fridgethr_context *ctx)
 		}
 
  finalize_req:
+		atomic_dec_uint32_t(&nfs_worker_pool.busy);
+
+		/* a suspended request is not ours anymore */
+		if (suspended)
+			continue;
+
 		/* XXX needed? */
 		LogFullDebug(COMPONENT_DISPATCH,
 			     "Signaling completion of request");
@@ -1571,6 +1862,7 @@ static void worker_run(struct fridgethr_context *ctx)
 		LogFullDebug(COMPONENT_DISPATCH,
 			     "Invalidating processed entry");
 
+		nfs_rpc_tenant_release(nfsreq);
 		pool_free(request_pool, nfsreq);
 	}
 }
@@ -1583,6 +1875,10 @@ int worker_init(void)
 	memset(&frp, 0, sizeof(struct fridgethr_params));
 	frp.thr_max = nfs_param.core_param.nb_worker;
 	frp.thr_min = nfs_param.core_param.nb_worker;
+	if (nfs_param.core_param.nb_worker_min != 0
+	    && nfs_param.core_param.nb_worker_min <
+	    nfs_param.core_param.nb_worker)
+		frp.thr_min = nfs_param.core_param.nb_worker_min;
 	frp.flavor = fridgethr_flavor_looper;
 	frp.thread_initialize = worker_thread_initializer;
 	frp.thread_finalize = worker_thread_finalizer;
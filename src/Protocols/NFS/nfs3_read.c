@@ -48,6 +48,7 @@
 #include "server_stats.h"
 #include "export_mgr.h"
 #include "sal_functions.h"
+#include "io_buf.h"
 
 static void nfs_read_ok(struct svc_req *req,
 			nfs_res_t *res,
@@ -55,7 +56,7 @@ static void nfs_read_ok(struct svc_req *req,
 			int eof)
 {
 	if ((read_size == 0) && (data != NULL)) {
-		gsh_free(data);
+		io_buf_put(data);
 		data = NULL;
 	}
 
@@ -86,6 +87,7 @@ static void nfs_read_ok(struct svc_req *req,
  * @retval NFS_REQ_OK if successful
  * @retval NFS_REQ_DROP if failed but retryable
  * @retval NFS_REQ_FAILED if failed and not retryable
+ * @retval NFS_REQ_ASYNC_WAIT if waiting for the read to complete
  *
  */
 
@@ -93,6 +95,8 @@ int nfs3_read(nfs_arg_t *arg,
 	      nfs_worker_data_t *worker,
 	      struct svc_req *req, nfs_res_t *res)
 {
+	nfs_request_data_t *reqnfs = nfs_rpc_reqnfs(req);
+	struct cache_inode_io *io = &reqnfs->async.io;
 	cache_entry_t *entry;
 	pre_op_attr pre_attr;
 	cache_inode_status_t cache_status = CACHE_INODE_SUCCESS;
@@ -102,7 +106,17 @@ int nfs3_read(nfs_arg_t *arg,
 	void *data = NULL;
 	bool eof_met = false;
 	int rc = NFS_REQ_OK;
-	bool sync = false;
+	bool suspended;
+
+	if (reqnfs->async.resume) {
+		/* the read completed */
+		entry = io->entry;
+		offset = io->fsal.offset;
+		size = io->fsal.io_size;
+		data = io->fsal.buffer;
+		cache_status = cache_inode_rdwr_finish(io);
+		goto read_done;
+	}
 
 	if (isDebug(COMPONENT_NFSPROTO)) {
 		char str[LEN_FH_STR];
@@ -211,43 +225,50 @@ int nfs3_read(nfs_arg_t *arg,
 		nfs_read_ok(req, res, NULL, 0, entry, 0);
 		rc = NFS_REQ_OK;
 		goto out;
-	} else {
-		data = gsh_malloc(size);
-		if (data == NULL) {
-			rc = NFS_REQ_DROP;
-			goto out;
-		}
+	}
 
-		res->res_read3.status = nfs3_Errno_state(
-				state_share_anonymous_io_start(
-					entry,
-					OPEN4_SHARE_ACCESS_READ,
-					SHARE_BYPASS_READ));
+	data = io_buf_get(size);
+	if (data == NULL) {
+		rc = NFS_REQ_DROP;
+		goto out;
+	}
 
-		if (res->res_read3.status != NFS3_OK) {
-			rc = NFS_REQ_OK;
-			goto out;
-		}
+	res->res_read3.status = nfs3_Errno_state(
+			state_share_anonymous_io_start(
+				entry,
+				OPEN4_SHARE_ACCESS_READ,
+				SHARE_BYPASS_READ));
 
-		cache_status = cache_inode_rdwr(entry,
-						CACHE_INODE_READ,
-						offset,
-						size,
-						&read_size,
-						data,
-						&eof_met,
-						&sync);
+	if (res->res_read3.status != NFS3_OK) {
+		io_buf_put(data);
+		rc = NFS_REQ_OK;
+		goto out;
+	}
 
-		state_share_anonymous_io_done(entry, OPEN4_SHARE_ACCESS_READ);
+	io->entry = entry;
+	io->io_direction = CACHE_INODE_READ;
+	io->sync = false;
+	io->fsal.offset = offset;
+	io->fsal.io_size = size;
+	io->fsal.buffer = data;
+	io->fsal.info = NULL;
 
-		if (cache_status == CACHE_INODE_SUCCESS) {
-			nfs_read_ok(req, res, data, read_size,
-				    entry, eof_met);
-			rc = NFS_REQ_OK;
-			goto out;
-		}
-		gsh_free(data);
+	cache_status = nfs_rpc_rdwr_async(reqnfs, NULL, &suspended);
+	if (suspended)
+		return NFS_REQ_ASYNC_WAIT;
+
+ read_done:
+	read_size = io->fsal.io_amount;
+	eof_met = io->fsal.end_of_file;
+
+	state_share_anonymous_io_done(entry, OPEN4_SHARE_ACCESS_READ);
+
+	if (cache_status == CACHE_INODE_SUCCESS) {
+		nfs_read_ok(req, res, data, read_size, entry, eof_met);
+		rc = NFS_REQ_OK;
+		goto out;
 	}
+	io_buf_put(data);
 
 	/* If we are here, there was an error */
 	if (nfs_RetryableError(cache_status)) {
@@ -284,6 +305,6 @@ void nfs3_read_free(nfs_res_t *res)
 {
 	if ((res->res_read3.status == NFS3_OK)
 	    && (res->res_read3.READ3res_u.resok.data.data_len != 0)) {
-		gsh_free(res->res_read3.READ3res_u.resok.data.data_val);
+		io_buf_put(res->res_read3.READ3res_u.resok.data.data_val);
 	}
 }
@@ -66,6 +66,7 @@
  * @retval NFS_REQ_OK if successful
  * @retval NFS_REQ_DROP if failed but retryable
  * @retval NFS_REQ_FAILED if failed and not retryable
+ * @retval NFS_REQ_ASYNC_WAIT if waiting for the write to complete
  *
  */
 
@@ -73,6 +74,8 @@ int nfs3_write(nfs_arg_t *arg,
 	       nfs_worker_data_t *worker,
 	       struct svc_req *req, nfs_res_t *res)
 {
+	nfs_request_data_t *reqnfs = nfs_rpc_reqnfs(req);
+	struct cache_inode_io *io = &reqnfs->async.io;
 	cache_entry_t *entry;
 	pre_op_attr pre_attr = {
 		.attributes_follow = false
@@ -82,11 +85,20 @@ int nfs3_write(nfs_arg_t *arg,
 	size_t written_size = 0;
 	uint64_t offset = 0;
 	void *data = NULL;
-	bool eof_met = false;
 	bool sync = false;
+	bool suspended;
 	int rc = NFS_REQ_OK;
 	fsal_status_t fsal_status;
 
+	if (reqnfs->async.resume) {
+		/* the write completed */
+		entry = io->entry;
+		offset = io->fsal.offset;
+		size = io->fsal.io_size;
+		cache_status = cache_inode_rdwr_finish(io);
+		goto write_done;
+	}
+
 	if (isDebug(COMPONENT_NFSPROTO)) {
 		char str[LEN_FH_STR], *stables = "";
 
@@ -235,9 +247,21 @@ int nfs3_write(nfs_arg_t *arg,
 			goto out;
 		}
 
-		cache_status =
-		    cache_inode_rdwr(entry, CACHE_INODE_WRITE, offset, size,
-				     &written_size, data, &eof_met, &sync);
+		io->entry = entry;
+		io->io_direction = CACHE_INODE_WRITE;
+		io->sync = sync;
+		io->fsal.offset = offset;
+		io->fsal.io_size = size;
+		io->fsal.buffer = data;
+		io->fsal.info = NULL;
+
+		cache_status = nfs_rpc_rdwr_async(reqnfs, NULL, &suspended);
+		if (suspended)
+			return NFS_REQ_ASYNC_WAIT;
+
+ write_done:
+		written_size = io->fsal.io_amount;
+		sync = io->sync;
 
 		state_share_anonymous_io_done(entry, OPEN4_SHARE_ACCESS_WRITE);
 
@@ -39,6 +39,14 @@
 #include "export_mgr.h"
 #include "nfs_creds.h"
 
+/**
+ * @brief READ payload above which a slot keeps the reply only if the
+ *        client asked for sa_cachethis
+ */
+#define NFS41_CACHE_LARGE_REPLY 4096
+
+static void nfs41_cache_reply(compound_data_t *data, nfs_res_t *res);
+
 struct nfs4_op_desc {
 	char *name;
 	int (*funct) (struct nfs_argop4 *, compound_data_t *,
@@ -433,6 +441,7 @@ static const struct nfs4_op_desc optabv4[] = {
  *
  * @retval NFS_REQ_OKAY if a result is sent.
  * @retval NFS_REQ_DROP if we pretend we never saw the request.
+ * @retval NFS_REQ_ASYNC_WAIT if an operation is waiting for its I/O.
  */
 
 int nfs4_Compound(nfs_arg_t *arg,
@@ -451,6 +460,18 @@ int nfs4_Compound(nfs_arg_t *arg,
 	struct timespec ts;
 	int perm_flags;
 	char *tagname = NULL;
+	nfs_request_data_t *reqnfs = nfs_rpc_reqnfs(req);
+
+	if (reqnfs->async.resume) {
+		/* go on with the operation that was waiting for its I/O */
+		data = reqnfs->async.compound;
+		data.worker = worker;
+		op_start_time = reqnfs->async.op_start_time;
+		i = data.oppos;
+		opcode = argarray[i].argop;
+		resarray = res->res_compound4.resarray.resarray_val;
+		goto resume;
+	}
 
 	if (compound4_minor > 2) {
 		LogCrit(COMPONENT_NFS_V4, "Bad Minor Version %d",
@@ -691,9 +712,22 @@ int nfs4_Compound(nfs_arg_t *arg,
 			}
 		}
 
+ resume:
 		status = (optabv4[opcode].funct) (&argarray[i],
 						  &data,
 						  &resarray[i]);
+		reqnfs->async.resume = false;
+
+		if (reqnfs->async.suspended) {
+			/* the operation is waiting for its I/O, keep the
+			 * compound for the worker that resumes it */
+			LogFullDebug(COMPONENT_NFS_V4,
+				     "Request %d: %s suspended", i,
+				     optabv4[opcode].name);
+			reqnfs->async.compound = data;
+			reqnfs->async.op_start_time = op_start_time;
+			return NFS_REQ_ASYNC_WAIT;
+		}
 
 		LogCompoundFH(&data);
 
@@ -729,15 +763,26 @@ int nfs4_Compound(nfs_arg_t *arg,
 			 * anything.
 			 */
 
-			/* Free the reply allocated above */
+			/* Free the reply allocated above, the tag goes with
+			 * it since the cached reply carries its own.
+			 */
 			gsh_free(res->res_compound4.resarray.resarray_val);
+			if (res->res_compound4.tag.utf8string_val)
+				gsh_free(res->res_compound4.tag.utf8string_val);
 
-			/* Copy the reply from the cache */
-			res->res_compound4_extended = *data.cached_res;
-			status = ((COMPOUND4res *) data.cached_res)->status;
+			/* Send the cached reply, the reference taken by
+			 * SEQUENCE or CREATE_SESSION now belongs to res and is
+			 * dropped by nfs4_Compound_Free.
+			 */
+			res->res_compound4 = data.cached_res->res;
+			res->res_compound4_extended.res_cached =
+			    data.cached_res;
+			data.cached_res = NULL;
+			status = res->res_compound4.status;
 			LogFullDebug(COMPONENT_SESSIONS,
 				     "Use session replay cache %p result %s",
-				     data.cached_res, nfsstat4_to_str(status));
+				     res->res_compound4_extended.res_cached,
+				     nfsstat4_to_str(status));
 			break;	/* Exit the for loop */
 		}
 	}			/* for */
@@ -752,26 +797,8 @@ int nfs4_Compound(nfs_arg_t *arg,
 	/* Manage session's DRC: keep NFS4.1 replay for later use, but don't
 	 * save a replayed result again.
 	 */
-	if (data.cached_res != NULL && !data.use_drc) {
-		/* Pointer has been set by nfs4_op_sequence and points to slot
-		 * to cache result in.
-		 */
-		LogFullDebug(COMPONENT_SESSIONS,
-			     "Save result in session replay cache %p sizeof nfs_res_t=%d",
-			     data.cached_res, (int)sizeof(nfs_res_t));
-
-		/* Indicate to nfs4_Compound_Free that this reply is cached. */
-		res->res_compound4_extended.res_cached = true;
-
-		/* If the cache is already in use, free it. */
-		if (data.cached_res->res_cached) {
-			data.cached_res->res_cached = false;
-			nfs4_Compound_Free((nfs_res_t *) data.cached_res);
-		}
-
-		/* Save the result in the cache. */
-		*data.cached_res = res->res_compound4_extended;
-	}
+	if (data.cached_slot != NULL && !data.use_drc)
+		nfs41_cache_reply(&data, res);
 
 	/* If we have reserved a lease, update it and release it */
 	if (data.preserved_clientid != NULL) {
@@ -811,6 +838,31 @@ void nfs4_Compound_FreeOne(nfs_resop4 *res)
 	optabv4[opcode].free_res(res);
 }
 
+/**
+ * @brief Free the operations and tag of a COMPOUND4 result
+ *
+ * @param[in] res The result
+ */
+static void nfs4_Compound_FreeRes(COMPOUND4res *res)
+{
+	unsigned int i = 0;
+
+	for (i = 0; i < res->resarray.resarray_len; i++) {
+		nfs_resop4 *val = &res->resarray.resarray_val[i];
+		if (val) {
+			/* !val is an error case, but it can occur, so avoid
+			 * indirect on NULL
+			 */
+			nfs4_Compound_FreeOne(val);
+		}
+	}
+
+	gsh_free(res->resarray.resarray_val);
+
+	if (res->tag.utf8string_val)
+		gsh_free(res->tag.utf8string_val);
+}
+
 /**
  *
  * @brief Free the result for NFS4PROC_COMPOUND
@@ -822,7 +874,6 @@ void nfs4_Compound_FreeOne(nfs_resop4 *res)
  */
 void nfs4_Compound_Free(nfs_res_t *res)
 {
-	unsigned int i = 0;
 	log_components_t component = COMPONENT_NFS_V4;
 
 	if (isFullDebug(COMPONENT_SESSIONS))
@@ -830,8 +881,10 @@ void nfs4_Compound_Free(nfs_res_t *res)
 
 	if (res->res_compound4_extended.res_cached) {
 		LogFullDebug(component,
-			     "Skipping free of NFS4 result %p",
-			     res);
+			     "Releasing cached NFS4 result %p for %p",
+			     res->res_compound4_extended.res_cached, res);
+		nfs41_cached_reply_unref(res->res_compound4_extended.res_cached);
+		res->res_compound4_extended.res_cached = NULL;
 		return;
 	}
 
@@ -840,22 +893,108 @@ void nfs4_Compound_Free(nfs_res_t *res)
 		     res,
 		     res->res_compound4.resarray.resarray_len);
 
-	for (i = 0; i < res->res_compound4.resarray.resarray_len; i++) {
-		nfs_resop4 *val = &res->res_compound4.resarray.resarray_val[i];
-		if (val) {
-			/* !val is an error case, but it can occur, so avoid
-			 * indirect on NULL
-			 */
-			nfs4_Compound_FreeOne(val);
+	nfs4_Compound_FreeRes(&res->res_compound4);
+
+	return;
+}
+
+/**
+ * @brief Take a reference on a cached session reply
+ *
+ * @param[in] reply The reply
+ */
+void nfs41_cached_reply_ref(nfs41_cached_reply_t *reply)
+{
+	atomic_inc_int32_t(&reply->refcnt);
+}
+
+/**
+ * @brief Release a reference on a cached session reply
+ *
+ * The reply is freed with the last reference, which may be held by
+ * the slot or by a request still sending it.
+ *
+ * @param[in] reply The reply
+ */
+void nfs41_cached_reply_unref(nfs41_cached_reply_t *reply)
+{
+	if (atomic_dec_int32_t(&reply->refcnt) != 0)
+		return;
+
+	LogFullDebug(COMPONENT_SESSIONS,
+		     "Freeing cached NFS4 result %p (resarraylen=%i)",
+		     reply, reply->res.resarray.resarray_len);
+
+	nfs4_Compound_FreeRes(&reply->res);
+	gsh_free(reply);
+}
+
+/**
+ * @brief Check whether a reply is large enough to cache only on demand
+ *
+ * @param[in] res The reply
+ *
+ * @return true if the reply carries bulk READ data.
+ */
+static bool nfs41_reply_is_large(COMPOUND4res *res)
+{
+	unsigned int i;
+
+	for (i = 0; i < res->resarray.resarray_len; i++) {
+		nfs_resop4 *op = &res->resarray.resarray_val[i];
+
+		if (op->resop == NFS4_OP_READ
+		    && op->nfs_resop4_u.opread.status == NFS4_OK
+		    && op->nfs_resop4_u.opread.READ4res_u.resok4.data.data_len
+		       > NFS41_CACHE_LARGE_REPLY)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Save the reply of a sequenced request in its slot
+ *
+ * The slot and the reply being sent share one copy of the result
+ * through a refcount.  A large READ reply is only kept when the
+ * client set sa_cachethis; a replay of it gets
+ * NFS4ERR_RETRY_UNCACHED_REP instead.
+ *
+ * @param[in]     data The compound data, with cached_slot set
+ * @param[in,out] res  The reply to be sent
+ */
+static void nfs41_cache_reply(compound_data_t *data, nfs_res_t *res)
+{
+	nfs41_session_slot_t *slot = data->cached_slot;
+	nfs41_cached_reply_t *reply = NULL;
+	nfs41_cached_reply_t *old;
+
+	if (data->cachethis || !nfs41_reply_is_large(&res->res_compound4)) {
+		reply = gsh_malloc(sizeof(*reply));
+		if (reply != NULL) {
+			/* One reference for the slot, one for res */
+			reply->refcnt = 2;
+			reply->res = res->res_compound4;
+			res->res_compound4_extended.res_cached = reply;
 		}
 	}
 
-	gsh_free(res->res_compound4.resarray.resarray_val);
+	LogFullDebug(COMPONENT_SESSIONS,
+		     "Save result in session replay cache %p reply %p",
+		     slot, reply);
 
-	if (res->res_compound4.tag.utf8string_val)
-		gsh_free(res->res_compound4.tag.utf8string_val);
+	pthread_mutex_lock(&slot->lock);
+	old = slot->cached_result;
+	slot->cached_result = reply;
+	slot->cache_used = reply != NULL;
+	slot->busy = false;
+	pthread_mutex_unlock(&slot->lock);
 
-	return;
+	data->cached_slot = NULL;
+
+	if (old != NULL)
+		nfs41_cached_reply_unref(old);
 }
 
 /**
@@ -868,6 +1007,11 @@ void nfs4_Compound_Free(nfs_res_t *res)
  */
 void compound_data_Free(compound_data_t *data)
 {
+	if (data->cached_res) {
+		nfs41_cached_reply_unref(data->cached_res);
+		data->cached_res = NULL;
+	}
+
 	/* Release refcounted cache entries */
 	if (data->current_entry)
 		cache_inode_put(data->current_entry);
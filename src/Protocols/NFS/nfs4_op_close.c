@@ -54,7 +54,7 @@ void cleanup_layouts(compound_data_t *data)
 	 * return_on_close.
 	 */
 
-	glist_for_each(glist, &data->current_entry->state_list) {
+	glist_for_each(glist, &data->current_entry->state_data->state_list) {
 		state_t *state = glist_entry(glist, state_t,
 					     state_list);
 
@@ -68,7 +68,7 @@ void cleanup_layouts(compound_data_t *data)
 
 	glist_for_each_safe(glist,
 			    glistn,
-			    &data->current_entry->state_list) {
+			    &data->current_entry->state_data->state_list) {
 		state_t *state = glist_entry(glist, state_t,
 					     state_list);
 		bool deleted = false;
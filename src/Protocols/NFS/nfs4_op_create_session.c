@@ -78,6 +78,8 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 	char str_client[NFS4_OPAQUE_LIMIT * 2 + 1];
 	/* Return code from clientid calls */
 	int rc = 0;
+	/* Forechannel slots granted to the session */
+	uint32_t nb_slots;
 	/* Component for logging */
 	log_components_t component = COMPONENT_CLIENTID;
 	/* Abbreviated alias for arguments */
@@ -180,12 +182,19 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 		/* Special case : the request is used without use of
 		 * OP_SEQUENCE
 		 */
-		if ((arg_CREATE_SESSION4->csa_sequence + 1 ==
-		     found->cid_create_session_sequence)
-		    && (found->cid_create_session_slot.cache_used)) {
+		nfs41_session_slot_t *slot = &found->cid_create_session_slot;
+
+		if (arg_CREATE_SESSION4->csa_sequence + 1 ==
+		    found->cid_create_session_sequence) {
+			pthread_mutex_lock(&slot->lock);
+			data->cached_res = slot->cached_result;
+			if (data->cached_res != NULL)
+				nfs41_cached_reply_ref(data->cached_res);
+			pthread_mutex_unlock(&slot->lock);
+		}
+
+		if (data->cached_res != NULL) {
 			data->use_drc = true;
-			data->cached_res =
-			    &found->cid_create_session_slot.cached_result;
 
 			res_CREATE_SESSION4->csr_status = NFS4_OK;
 
@@ -300,6 +309,23 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 		goto out;
 	}
 
+	/* Grant the slots the client asked for, within our limit */
+	nb_slots = arg_CREATE_SESSION4->csa_fore_chan_attrs.ca_maxrequests;
+	if (nb_slots == 0)
+		nb_slots = 1;
+	if (nb_slots > nfs_param.nfsv4_param.max_session_slots)
+		nb_slots = nfs_param.nfsv4_param.max_session_slots;
+
+	if (!nfs41_Session_Alloc_Slots(nfs41_session, nb_slots)) {
+		LogCrit(component,
+			"Could not allocate %" PRIu32 " session slots",
+			nb_slots);
+		pool_free(nfs41_session_pool, nfs41_session);
+		dec_client_id_ref(found);
+		res_CREATE_SESSION4->csr_status = NFS4ERR_SERVERFAULT;
+		goto out;
+	}
+
 	nfs41_session->clientid = clientid;
 	nfs41_session->clientid_record = found;
 	nfs41_session->refcount = 2;	/* sentinel ref + call path ref */
@@ -323,7 +349,7 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 	pthread_mutex_unlock(&found->cid_mutex);
 
 	/* Set ca_maxrequests */
-	nfs41_session->fore_channel_attrs.ca_maxrequests = NFS41_NB_SLOTS;
+	nfs41_session->fore_channel_attrs.ca_maxrequests = nb_slots;
 	nfs41_Build_sessionid(&clientid, nfs41_session->session_id);
 
 	res_CREATE_SESSION4ok->csr_sequence = arg_CREATE_SESSION4->csa_sequence;
@@ -341,12 +367,6 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 	       nfs41_session->session_id,
 	       NFS4_SESSIONID_SIZE);
 
-	/* Create Session replay cache */
-	data->cached_res = &found->cid_create_session_slot.cached_result;
-	found->cid_create_session_slot.cache_used = true;
-
-	LogDebug(component, "CREATE_SESSION replay=%p", data->cached_res);
-
 	if (!nfs41_Session_Set(nfs41_session)) {
 		LogDebug(component, "Could not insert session into table");
 
@@ -360,6 +380,7 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 		dec_client_id_ref(found);
 
 		/* Free the memory for the session */
+		nfs41_Session_Free_Slots(nfs41_session);
 		pool_free(nfs41_session_pool, nfs41_session);
 
 		/* Maybe a more precise status would be better */
@@ -491,7 +512,16 @@ int nfs4_op_create_session(struct nfs_argop4 *op, compound_data_t *data,
 		}
 	}
 
-	LogDebug(component, "CREATE_SESSION success session=%p", nfs41_session);
+	/* Create Session replay cache, unless the request is sequenced
+	 * in which case its reply goes to the SEQUENCE slot.
+	 */
+	if (data->oppos == 0) {
+		data->cached_slot = &found->cid_create_session_slot;
+		data->cachethis = true;
+	}
+
+	LogDebug(component, "CREATE_SESSION success session=%p replay slot=%p",
+		 nfs41_session, data->cached_slot);
 
 	/* Successful exit */
 	res_CREATE_SESSION4->csr_status = NFS4_OK;
@@ -109,7 +109,7 @@ int nfs4_op_delegreturn(struct nfs_argop4 *op, compound_data_t *data,
 
 	found_deleg = NULL;
 	PTHREAD_RWLOCK_wrlock(&data->current_entry->state_lock);
-	glist_for_each(glist, &data->current_entry->object.file.deleg_list) {
+	glist_for_each(glist, &data->current_entry->state_data->deleg_list) {
 		iter_deleg = glist_entry(glist, struct deleg_data, dd_list);
 		LogDebug(COMPONENT_NFS_V4_LOCK, "iter deleg entry %p",
 			 iter_deleg);
@@ -296,7 +296,7 @@ void handle_recalls(struct fsal_layoutreturn_arg *arg, state_t *state,
 	struct glist_head *recall_next = NULL;
 
 	glist_for_each_safe(recall_iter, recall_next,
-			    &state->state_entry->layoutrecall_list) {
+			    &state->state_entry->state_data->layoutrecall_list) {
 		/* The current recall state */
 		struct state_layout_recall_file *r;
 		/* Iteration on states */
@@ -410,7 +410,7 @@ nfsstat4 nfs4_return_one_state(cache_entry_t *entry,
 	/* The current segment in iteration */
 	state_layout_segment_t *g = NULL;
 
-	recalls = glist_length(&entry->layoutrecall_list);
+	recalls = glist_length(&entry->state_data->layoutrecall_list);
 
 	if (body_val) {
 		xdrmem_create(&lrf_body,
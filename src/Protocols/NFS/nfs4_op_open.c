@@ -179,7 +179,7 @@ static nfsstat4 open4_do_open(struct nfs_argop4 *op, compound_data_t *data,
 	/* Try to find if the same open_owner already has acquired a
 	 * stateid for this file
 	 */
-	glist_for_each(glist, &data->current_entry->state_list) {
+	glist_for_each(glist, &data->current_entry->state_data->state_list) {
 		state_iterate = glist_entry(glist, state_t, state_list);
 
 		if (state_iterate->state_type != STATE_TYPE_SHARE)
@@ -934,7 +934,7 @@ static nfsstat4 open4_claim_deleg(OPEN4args *arg, compound_data_t *data,
 		state_t *found_state = NULL;
 
 		PTHREAD_RWLOCK_wrlock(&entry_lookup->state_lock);
-		glist_for_each(glist, &entry_lookup->object.file.deleg_list) {
+		glist_for_each(glist, &entry_lookup->state_data->deleg_list) {
 			iter_deleg = glist_entry(glist,
 						struct deleg_data,
 						dd_list);
@@ -48,6 +48,7 @@
 #include "fsal_pnfs.h"
 #include "server_stats.h"
 #include "export_mgr.h"
+#include "io_buf.h"
 
 /**
  * @brief Read on a pNFS pNFS data server
@@ -87,7 +88,7 @@ static int op_dsread(struct nfs_argop4 *op, compound_data_t *data,
 
 	/* Construct the FSAL file handle */
 
-	buffer = gsh_malloc_aligned(4096, arg_READ4->count);
+	buffer = io_buf_get(arg_READ4->count);
 	if (buffer == NULL) {
 		LogEvent(COMPONENT_NFS_V4, "FAILED to allocate read buffer");
 		res_READ4->status = NFS4ERR_SERVERFAULT;
@@ -107,7 +108,7 @@ static int op_dsread(struct nfs_argop4 *op, compound_data_t *data,
 				&eof);
 
 	if (nfs_status != NFS4_OK) {
-		gsh_free(buffer);
+		io_buf_put(buffer);
 		res_READ4->READ4res_u.resok4.data.data_val = NULL;
 	}
 
@@ -164,7 +165,7 @@ static int op_dsread_plus(struct nfs_argop4 *op, compound_data_t *data,
 
 	/* Construct the FSAL file handle */
 
-	buffer = gsh_malloc_aligned(4096, arg_READ4->count);
+	buffer = io_buf_get(arg_READ4->count);
 	if (buffer == NULL) {
 		LogEvent(COMPONENT_NFS_V4, "FAILED to allocate read buffer");
 		res_RPLUS->rpr_status = NFS4ERR_SERVERFAULT;
@@ -183,7 +184,7 @@ static int op_dsread_plus(struct nfs_argop4 *op, compound_data_t *data,
 
 	res_RPLUS->rpr_status = nfs_status;
 	if (nfs_status != NFS4_OK) {
-		gsh_free(buffer);
+		io_buf_put(buffer);
 		return res_RPLUS->rpr_status;
 	}
 
@@ -225,11 +226,27 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 	cache_entry_t *entry = NULL;
 	bool sync = false;
 	bool anonymous_started = false;
+	nfs_request_data_t *reqnfs = nfs_rpc_reqnfs(data->req);
+	struct cache_inode_io *async_io = &reqnfs->async.io;
+	bool suspended;
 
 	/* Say we are managing NFS4_OP_READ */
 	resp->resop = NFS4_OP_READ;
 	res_READ4->status = NFS4_OK;
 
+	if (reqnfs->async.resume) {
+		/* the read completed */
+		entry = async_io->entry;
+		offset = async_io->fsal.offset;
+		size = async_io->fsal.io_size;
+		bufferdata = async_io->fsal.buffer;
+		anonymous_started = reqnfs->async.anonymous_io;
+		cache_status = cache_inode_rdwr_finish(async_io);
+		read_size = async_io->fsal.io_amount;
+		eof_met = async_io->fsal.end_of_file;
+		goto read_done;
+	}
+
 	/* Do basic checks on a filehandle Only files can be read */
 
 	if ((data->minorversion > 0)
@@ -453,7 +470,7 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 	}
 
 	/* Some work is to be done */
-	bufferdata = gsh_malloc_aligned(4096, size);
+	bufferdata = io_buf_get(size);
 
 	if (bufferdata == NULL) {
 		LogEvent(COMPONENT_NFS_V4, "FAILED to allocate bufferdata");
@@ -467,12 +484,39 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 		    so_clientid;
 	}
 
-	cache_status =
-	    cache_inode_rdwr_plus(entry, io, offset, size, &read_size,
-				  bufferdata, &eof_met, &sync, info);
+	if (io == CACHE_INODE_READ) {
+		/* plain READs may be suspended while the FSAL works */
+		async_io->entry = entry;
+		async_io->io_direction = io;
+		async_io->sync = false;
+		async_io->fsal.offset = offset;
+		async_io->fsal.io_size = size;
+		async_io->fsal.buffer = bufferdata;
+		async_io->fsal.info = NULL;
+		reqnfs->async.anonymous_io = anonymous_started;
+
+		cache_status = nfs_rpc_rdwr_async(reqnfs,
+						  !anonymous_started
+						  && data->minorversion == 0
+						  ? state_found->state_owner->
+						  so_owner.so_nfs4_owner.
+						  so_clientrec : NULL,
+						  &suspended);
+		if (suspended)
+			return res_READ4->status;
+
+		read_size = async_io->fsal.io_amount;
+		eof_met = async_io->fsal.end_of_file;
+	} else {
+		cache_status =
+		    cache_inode_rdwr_plus(entry, io, offset, size, &read_size,
+					  bufferdata, &eof_met, &sync, info);
+	}
+
+ read_done:
 	if (cache_status != CACHE_INODE_SUCCESS) {
 		res_READ4->status = nfs4_Errno(cache_status);
-		gsh_free(bufferdata);
+		io_buf_put(bufferdata);
 		res_READ4->READ4res_u.resok4.data.data_val = NULL;
 		goto done;
 	}
@@ -480,7 +524,7 @@ static int nfs4_read(struct nfs_argop4 *op, compound_data_t *data,
 	if (cache_inode_size(entry, &file_size) !=
 	    CACHE_INODE_SUCCESS) {
 		res_READ4->status = nfs4_Errno(cache_status);
-		gsh_free(bufferdata);
+		io_buf_put(bufferdata);
 		res_READ4->READ4res_u.resok4.data.data_val = NULL;
 		goto done;
 	}
@@ -552,7 +596,7 @@ void nfs4_op_read_Free(nfs_resop4 *res)
 
 	if (resp->status == NFS4_OK)
 		if (resp->READ4res_u.resok4.data.data_val != NULL)
-			gsh_free(resp->READ4res_u.resok4.data.data_val);
+			io_buf_put(resp->READ4res_u.resok4.data.data_val);
 	return;
 }				/* nfs4_op_read_Free */
 
@@ -612,7 +656,7 @@ void nfs4_op_read_plus_Free(nfs_resop4 *res)
 
 	if (resp->rpr_status == NFS4_OK && conp->what == NFS4_CONTENT_DATA)
 		if (conp->data.d_data.data_val != NULL)
-			gsh_free(conp->data.d_data.data_val);
+			io_buf_put(conp->data.d_data.data_val);
 
 	return;
 }				/* nfs4_op_read_Free */
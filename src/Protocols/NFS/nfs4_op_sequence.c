@@ -33,6 +33,46 @@
 #include "sal_functions.h"
 #include "nfs_rpc_callback.h"
 #include "nfs_convert.h"
+#include "nfs_core.h"
+
+/**
+ * @brief Fewest slots we ask a client to keep using under load
+ */
+#define NFS41_TARGET_SLOTS_MIN 4
+
+/**
+ * @brief Compute the target_highest_slotid to return to a client
+ *
+ * While the worker pool is saturated every session is asked to give
+ * up an eighth of its slots per SEQUENCE, down to a floor; otherwise
+ * it gets one back per SEQUENCE up to its full table.  Updates may
+ * race, which only makes the adjustment a little slower.
+ *
+ * @param[in,out] session The session
+ *
+ * @return The target highest slot id.
+ */
+static slotid4 nfs41_session_target_slotid(nfs41_session_t *session)
+{
+	uint32_t target = atomic_fetch_uint32_t(&session->target_slots);
+	uint32_t floor = MIN(session->nb_slots, NFS41_TARGET_SLOTS_MIN);
+	uint32_t next = target;
+
+	if (nfs_worker_pool_saturated()) {
+		next = target - target / 8;
+		if (next == target)
+			next--;
+		if (next < floor)
+			next = floor;
+	} else if (target < session->nb_slots) {
+		next = target + 1;
+	}
+
+	if (next != target)
+		atomic_store_uint32_t(&session->target_slots, next);
+
+	return next - 1;
+}
 
 /**
  * @brief the NFS4_OP_SEQUENCE operation
@@ -78,7 +118,8 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 			res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_slotid =
 			    arg_SEQUENCE4->sa_slotid;
 			res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.
-			    sr_highest_slotid = NFS41_NB_SLOTS - 1;
+			    sr_highest_slotid =
+			    nfs_param.nfsv4_param.max_session_slots - 1;
 			res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.
 			    sr_target_highest_slotid = arg_SEQUENCE4->sa_slotid;
 			res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.
@@ -122,8 +163,7 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 	pthread_mutex_unlock(&session->clientid_record->cid_mutex);
 
 	/* Check is slot is compliant with ca_maxrequests */
-	if (arg_SEQUENCE4->sa_slotid >=
-	    session->fore_channel_attrs.ca_maxrequests) {
+	if (arg_SEQUENCE4->sa_slotid >= session->nb_slots) {
 		dec_session_ref(session);
 		res_SEQUENCE4->sr_status = NFS4ERR_BADSLOT;
 		LogDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
@@ -140,20 +180,17 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 	    arg_SEQUENCE4->sa_sequenceid) {
 		if (session->slots[arg_SEQUENCE4->sa_slotid].sequence ==
 		    arg_SEQUENCE4->sa_sequenceid) {
-#if IMPLEMENT_CACHETHIS
-			/** @todo
-			 *
-			 * Ganesha always caches result anyway so ignore
-			 * cachethis
-			 */
-			if (session->slots[arg_SEQUENCE4->sa_slotid]
-			    .cache_used) {
-#endif
+			nfs41_session_slot_t *slot =
+			    &session->slots[arg_SEQUENCE4->sa_slotid];
+
+			if (slot->busy) {
+				/* The original request is still running */
+				res_SEQUENCE4->sr_status = NFS4ERR_DELAY;
+			} else if (slot->cached_result != NULL) {
 				/* Replay operation through the DRC */
 				data->use_drc = true;
-				data->cached_res =
-				    &session->slots[arg_SEQUENCE4->sa_slotid].
-				    cached_result;
+				data->cached_res = slot->cached_result;
+				nfs41_cached_reply_ref(data->cached_res);
 
 				LogFullDebugAlt(COMPONENT_SESSIONS,
 						COMPONENT_CLIENTID,
@@ -162,27 +199,19 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 						arg_SEQUENCE4->sa_slotid,
 						data->cached_res);
 
-				pthread_mutex_unlock(&session->
-					slots[arg_SEQUENCE4->sa_slotid].lock);
-				dec_session_ref(session);
 				res_SEQUENCE4->sr_status = NFS4_OK;
-				return res_SEQUENCE4->sr_status;
-#if IMPLEMENT_CACHETHIS
 			} else {
 				/* Illegal replay */
-				pthread_mutex_unlock(&session->
-					slots[arg_SEQUENCE4->sa_slotid].lock);
-				dec_session_ref(session);
 				res_SEQUENCE4->sr_status =
 				    NFS4ERR_RETRY_UNCACHED_REP;
-				LogDebugAlt(COMPONENT_SESSIONS,
-					    COMPONENT_CLIENTID,
-					    "SEQUENCE returning status %s",
-					    nfsstat4_to_str(res_SEQUENCE4->
-							    sr_status));
-				return res_SEQUENCE4->sr_status;
 			}
-#endif
+
+			pthread_mutex_unlock(&slot->lock);
+			dec_session_ref(session);
+			LogDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
+				    "SEQUENCE replay returning status %s",
+				    nfsstat4_to_str(res_SEQUENCE4->sr_status));
+			return res_SEQUENCE4->sr_status;
 		}
 
 		pthread_mutex_unlock(&session->
@@ -212,9 +241,9 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_slotid =
 	    arg_SEQUENCE4->sa_slotid;
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_highest_slotid =
-	    NFS41_NB_SLOTS - 1;
+	    session->nb_slots - 1;
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_target_highest_slotid =
-	    arg_SEQUENCE4->sa_slotid;	/* Maybe not the best choice */
+	    nfs41_session_target_slotid(session);
 
 	res_SEQUENCE4->SEQUENCE4res_u.sr_resok4.sr_status_flags = 0;
 
@@ -223,27 +252,17 @@ int nfs4_op_sequence(struct nfs_argop4 *op, compound_data_t *data,
 		    SEQ4_STATUS_CB_PATH_DOWN;
 	}
 
-#if IMPLEMENT_CACHETHIS
-/* Ganesha always caches result anyway so ignore cachethis */
-	if (arg_SEQUENCE4->sa_cachethis) {
-#endif
-		data->cached_res =
-		    &session->slots[arg_SEQUENCE4->sa_slotid].cached_result;
-		session->slots[arg_SEQUENCE4->sa_slotid].cache_used = true;
-
-		LogFullDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
-				"Use sesson slot %" PRIu32 "=%p for DRC",
-				arg_SEQUENCE4->sa_slotid, data->cached_res);
-#if IMPLEMENT_CACHETHIS
-	} else {
-		data->cached_res = NULL;
-		session->slots[arg_SEQUENCE4->sa_slotid].cache_used = false;
-
-		LogFullDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
-				"Don't use sesson slot %" PRIu32
-				"=NULL for DRC", arg_SEQUENCE4->sa_slotid);
-	}
-#endif
+	/* The reply is saved in the slot by nfs4_Compound, large ones only
+	 * if the client asked for it.
+	 */
+	data->cached_slot = &session->slots[arg_SEQUENCE4->sa_slotid];
+	data->cachethis = arg_SEQUENCE4->sa_cachethis;
+	data->cached_slot->busy = true;
+
+	LogFullDebugAlt(COMPONENT_SESSIONS, COMPONENT_CLIENTID,
+			"Use sesson slot %" PRIu32 "=%p for DRC cachethis=%d",
+			arg_SEQUENCE4->sa_slotid, data->cached_slot,
+			arg_SEQUENCE4->sa_cachethis);
 
 	pthread_mutex_unlock(&session->slots[arg_SEQUENCE4->sa_slotid].lock);
 
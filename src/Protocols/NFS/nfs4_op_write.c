@@ -167,11 +167,25 @@ static int nfs4_write(struct nfs_argop4 *op, compound_data_t *data,
 	fsal_status_t fsal_status;
 	bool anonymous_started = false;
 	struct gsh_buffdesc verf_desc;
+	nfs_request_data_t *reqnfs = nfs_rpc_reqnfs(data->req);
+	struct cache_inode_io *async_io = &reqnfs->async.io;
+	bool suspended;
 
 	/* Lock are not supported */
 	resp->resop = NFS4_OP_WRITE;
 	res_WRITE4->status = NFS4_OK;
 
+	if (reqnfs->async.resume) {
+		/* the write completed */
+		entry = async_io->entry;
+		size = async_io->fsal.io_size;
+		anonymous_started = reqnfs->async.anonymous_io;
+		cache_status = cache_inode_rdwr_finish(async_io);
+		written_size = async_io->fsal.io_amount;
+		sync = async_io->sync;
+		goto write_done;
+	}
+
 	if ((data->minorversion > 0)
 	     && (nfs4_Is_Fh_DSHandle(&data->currentFH))) {
 		if (io == CACHE_INODE_WRITE)
@@ -392,16 +406,42 @@ static int nfs4_write(struct nfs_argop4 *op, compound_data_t *data,
 		    so_clientid;
 	}
 
-	cache_status = cache_inode_rdwr_plus(entry,
-					io,
-					offset,
-					size,
-					&written_size,
-					bufferdata,
-					&eof_met,
-					&sync,
-					info);
+	if (io == CACHE_INODE_WRITE) {
+		/* plain WRITEs may be suspended while the FSAL works */
+		async_io->entry = entry;
+		async_io->io_direction = io;
+		async_io->sync = sync;
+		async_io->fsal.offset = offset;
+		async_io->fsal.io_size = size;
+		async_io->fsal.buffer = bufferdata;
+		async_io->fsal.info = NULL;
+		reqnfs->async.anonymous_io = anonymous_started;
+
+		cache_status = nfs_rpc_rdwr_async(reqnfs,
+						  !anonymous_started
+						  && data->minorversion == 0
+						  ? state_found->state_owner->
+						  so_owner.so_nfs4_owner.
+						  so_clientrec : NULL,
+						  &suspended);
+		if (suspended)
+			return res_WRITE4->status;
+
+		written_size = async_io->fsal.io_amount;
+		sync = async_io->sync;
+	} else {
+		cache_status = cache_inode_rdwr_plus(entry,
+						io,
+						offset,
+						size,
+						&written_size,
+						bufferdata,
+						&eof_met,
+						&sync,
+						info);
+	}
 
+ write_done:
 	if (cache_status != CACHE_INODE_SUCCESS) {
 		LogDebug(COMPONENT_NFS_V4,
 			 "cache_inode_rdwr returned %s",
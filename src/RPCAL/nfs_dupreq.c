@@ -49,13 +49,35 @@
 
 #include "nfs_dupreq.h"
 #include "city.h"
+#include "gsh_cksum.h"
 #include "abstract_mem.h"
+#include "pool_slab.h"
 #include "gsh_intrinsic.h"
 #include "wait_queue.h"
+#include "abstract_atomic.h"
+#include "fridgethr.h"
 
 #define DUPREQ_BAD_ADDR1 0x01	/* safe for marked pointers, etc */
 #define DUPREQ_NOCACHE   0x02
 
+/* retired entries reclaimed at a time */
+#define DRC_RETIRE_BATCH 16
+
+/* bytes charged for an entry before its reply is known */
+#define DRC_ENTRY_BYTES (sizeof(dupreq_entry_t) + sizeof(nfs_res_t))
+
+/* longest retransmit window a client can earn, in seconds */
+#define DRC_RETAIN_MAX_S 600
+
+/* victims chosen by one pass of drc_evict */
+#define DRC_EVICT_ROUNDS 8
+
+/* seconds between budget checks when nobody wakes the evictor */
+#define DRC_EVICT_INTERVAL 10
+
+/* bytes of encoded arguments a request checksum covers */
+#define DRC_CKSUM_PREFIX 256
+
 pool_t *nfs_res_pool;
 pool_t *tcp_drc_pool;		/* pool of per-connection DRC objects */
 
@@ -81,10 +103,42 @@ struct drc_st {
 	int32_t tcp_drc_recycle_qlen;
 	time_t last_expire_check;
 	uint32_t expire_delta;
+	uint64_t bytes;		/* held by all DRCs, atomic */
+	uint32_t evict_wanted;	/* evictor woken and not yet run, atomic */
 };
 
 static struct drc_st *drc_st;
 
+/* the DRC budget evictor */
+static struct fridgethr *drc_fridge;
+
+/**
+ * @brief Charge bytes held by an entry to its DRC and the budget
+ *
+ * @param[in] drc    The DRC
+ * @param[in] bytes  Bytes to charge
+ */
+static inline void drc_charge(drc_t *drc, uint32_t bytes)
+{
+	(void)atomic_add_uint64_t(&drc->bytes, bytes);
+	(void)atomic_add_uint64_t(&drc_st->bytes, bytes);
+}
+
+/**
+ * @brief Return the bytes of an entry leaving its DRC
+ *
+ * @param[in] drc  The DRC
+ * @param[in] dv   The entry
+ */
+static inline void drc_uncharge(drc_t *drc, dupreq_entry_t *dv)
+{
+	(void)atomic_sub_uint64_t(&drc->bytes, dv->bytes);
+	(void)atomic_sub_uint64_t(&drc_st->bytes, dv->bytes);
+}
+
+static void drc_drain(drc_t *drc);
+static void drc_evict(struct fridgethr_context *ctx);
+
 /**
  * @brief Comparison function for duplicate request entries.
  *
@@ -106,23 +160,28 @@ static inline int uint32_cmpf(uint32_t lhs, uint32_t rhs)
 }
 
 /**
- * @brief Comparison function for duplicate request entries.
+ * @brief Compare the calls of two duplicate request entries
  *
- * @param[in] lhs An integer
- * @param[in] rhs Another integer
+ * @param[in] lk  Left-hand entry
+ * @param[in] rk  Right-hand entry
  *
- * @return -1 if the left-hand is smaller than the right, 0 if they
- * are equal, and 1 if the left-hand is larger.
+ * @return -1,0,1 by xid, then program, version and procedure.
  */
-static inline int uint64_cmpf(uint64_t lhs, uint64_t rhs)
+static inline int dupreq_call_cmpf(const dupreq_entry_t *lk,
+				   const dupreq_entry_t *rk)
 {
-	if (lhs < rhs)
-		return -1;
-
-	if (lhs == rhs)
-		return 0;
-
-	return 1;
+	int c;
+
+	c = uint32_cmpf(lk->hin.tcp.rq_xid, rk->hin.tcp.rq_xid);
+	if (c)
+		return c;
+	c = uint32_cmpf(lk->hin.rq_prog, rk->hin.rq_prog);
+	if (c)
+		return c;
+	c = uint32_cmpf(lk->hin.rq_vers, rk->hin.rq_vers);
+	if (c)
+		return c;
+	return uint32_cmpf(lk->hin.rq_proc, rk->hin.rq_proc);
 }
 
 /**
@@ -146,16 +205,7 @@ static inline int dupreq_shared_cmpf(const struct opr_rbtree_node *lhs,
 		return -1;
 		break;
 	case 0:
-		switch (uint32_cmpf(lk->hin.tcp.rq_xid, rk->hin.tcp.rq_xid)) {
-		case -1:
-			return -1;
-			break;
-		case 0:
-			return uint64_cmpf(lk->hk, rk->hk);
-			break;
-		default:
-			break;
-		}		/* xid */
+		return dupreq_call_cmpf(lk, rk);
 		break;
 	default:
 		break;
@@ -177,22 +227,10 @@ static inline int dupreq_tcp_cmpf(const struct opr_rbtree_node *lhs,
 {
 	dupreq_entry_t *lk, *rk;
 
-	LogDebug(COMPONENT_DUPREQ, "%s", __func__);
-
 	lk = opr_containerof(lhs, dupreq_entry_t, rbt_k);
 	rk = opr_containerof(rhs, dupreq_entry_t, rbt_k);
 
-	if (lk->hin.tcp.rq_xid < rk->hin.tcp.rq_xid)
-		return -1;
-
-	if (lk->hin.tcp.rq_xid == rk->hin.tcp.rq_xid) {
-		LogDebug(COMPONENT_DUPREQ,
-			 "xids eq (%u), ck1 %" PRIu64 " ck2 %" PRIu64,
-			 lk->hin.tcp.rq_xid, lk->hk, rk->hk);
-		return uint64_cmpf(lk->hk, rk->hk);
-	}
-
-	return 1;
+	return dupreq_call_cmpf(lk, rk);
 }
 
 /**
@@ -215,6 +253,63 @@ static inline int drc_recycle_cmpf(const struct opr_rbtree_node *lhs,
 		&lk->d_u.tcp.addr, &rk->d_u.tcp.addr, false);
 }
 
+/**
+ * @brief Allocate the per-partition queues and counters of a DRC
+ *
+ * @param[in] drc  The DRC, with npart set
+ *
+ * @return true if successful, else false.
+ */
+static bool drc_init_parts(drc_t *drc)
+{
+	int ix;
+
+	drc->part = gsh_calloc(drc->npart, sizeof(struct drc_part));
+	if (unlikely(!drc->part))
+		return false;
+
+	for (ix = 0; ix < drc->npart; ++ix)
+		TAILQ_INIT(&drc->part[ix].dupreq_q);
+
+	drc->retired = NULL;
+	drc->nretired = 0;
+
+	return true;
+}
+
+/**
+ * @brief Find the queue and counters of a DRC partition
+ *
+ * @param[in] drc  The DRC
+ * @param[in] t    One of its tree partitions
+ *
+ * @return the corresponding drc_part.
+ */
+static inline struct drc_part *drc_part_of(drc_t *drc,
+					   struct rbtree_x_part *t)
+{
+	return &drc->part[t - drc->xt.tree];
+}
+
+/**
+ * @brief Lock a DRC partition, counting contention
+ *
+ * A wait is counted before blocking, without the lock, so
+ * lock_waits is updated atomically.
+ *
+ * @param[in] t  The tree partition
+ * @param[in] p  Its drc_part
+ */
+static inline void drc_part_lock(struct rbtree_x_part *t,
+				 struct drc_part *p)
+{
+	if (likely(pthread_mutex_trylock(&t->mtx) == 0))
+		return;
+
+	(void) atomic_inc_uint64_t(&p->lock_waits);
+	pthread_mutex_lock(&t->mtx);
+}
+
 /**
  * @brief Initialize a shared duplicate request cache
  */
@@ -241,7 +336,9 @@ static inline void init_shared_drc()
 	assert(!code);
 
 	/* completed requests */
-	TAILQ_INIT(&drc->dupreq_q);
+	if (unlikely(!drc_init_parts(drc)))
+		LogFatal(COMPONENT_INIT,
+			 "UDP DRC partition allocation failed");
 
 	/* init closed-form "cache" partition */
 	for (ix = 0; ix < drc->npart; ++ix) {
@@ -266,24 +363,25 @@ static inline void init_shared_drc()
  */
 void dupreq2_pkginit(void)
 {
+	struct fridgethr_params frp;
 	int code __attribute__ ((unused)) = 0;
 
 	dupreq_pool = pool_init("Duplicate Request Pool",
 				sizeof(dupreq_entry_t),
-				pool_basic_substrate, NULL, NULL, NULL);
+				pool_slab_substrate, NULL, NULL, NULL);
 	if (unlikely(!(dupreq_pool)))
 		LogFatal(COMPONENT_INIT,
 			 "Error while allocating duplicate request pool");
 
 	nfs_res_pool = pool_init("nfs_res_t pool", sizeof(nfs_res_t),
-				 pool_basic_substrate,
+				 pool_slab_substrate,
 				 NULL, NULL, NULL);
 	if (unlikely(!(nfs_res_pool)))
 		LogFatal(COMPONENT_INIT,
 			 "Error while allocating nfs_res_t pool");
 
 	tcp_drc_pool = pool_init("TCP DRC Pool", sizeof(drc_t),
-				 pool_basic_substrate,
+				 pool_slab_substrate,
 				 NULL, NULL, NULL);
 	if (!(dupreq_pool))
 		LogFatal(COMPONENT_INIT,
@@ -309,6 +407,25 @@ void dupreq2_pkginit(void)
 
 	/* UDP DRC is global, shared */
 	init_shared_drc();
+
+	/* budget evictor, woken by nfs_dupreq_finish */
+	memset(&frp, 0, sizeof(struct fridgethr_params));
+	frp.thr_max = 1;
+	frp.thr_min = 1;
+	frp.thread_delay = DRC_EVICT_INTERVAL;
+	frp.flavor = fridgethr_flavor_looper;
+
+	code = fridgethr_init(&drc_fridge, "DRC_evict", &frp);
+	if (code != 0)
+		LogFatal(COMPONENT_INIT,
+			 "Unable to initialize DRC evictor fridge, error code %d.",
+			 code);
+
+	code = fridgethr_submit(drc_fridge, drc_evict, NULL);
+	if (code != 0)
+		LogFatal(COMPONENT_INIT,
+			 "Unable to start DRC evictor thread, error code %d.",
+			 code);
 }
 
 /**
@@ -384,7 +501,13 @@ static inline drc_t *alloc_tcp_drc(enum drc_type dtype)
 	assert(!code);
 
 	/* completed requests */
-	TAILQ_INIT(&drc->dupreq_q);
+	if (unlikely(!drc_init_parts(drc))) {
+		LogCrit(COMPONENT_DUPREQ, "alloc TCP DRC partitions failed");
+		pthread_mutex_destroy(&drc->mtx);
+		pool_free(tcp_drc_pool, drc);
+		drc = NULL;
+		goto out;
+	}
 
 	/* recycling DRC */
 	TAILQ_INIT_ENTRY(drc, d_u.tcp.recycle_q);
@@ -417,8 +540,13 @@ static inline drc_t *alloc_tcp_drc(enum drc_type dtype)
  */
 static inline void free_tcp_drc(drc_t *drc)
 {
-	if (drc->xt.tree[0].cache)
-		gsh_free(drc->xt.tree[0].cache);
+	int ix;
+
+	drc_drain(drc);
+	for (ix = 0; ix < drc->npart; ++ix)
+		if (drc->xt.tree[ix].cache)
+			gsh_free(drc->xt.tree[ix].cache);
+	gsh_free(drc->part);
 	pthread_mutex_destroy(&drc->mtx);
 	LogFullDebug(COMPONENT_DUPREQ, "free TCP drc %p", drc);
 	pool_free(tcp_drc_pool, drc);
@@ -433,7 +561,7 @@ static inline void free_tcp_drc(drc_t *drc)
  */
 static inline uint32_t nfs_dupreq_ref_drc(drc_t *drc)
 {
-	return ++(drc->refcnt); /* locked */
+	return atomic_inc_uint32_t(&drc->refcnt);
 }
 
 /**
@@ -445,7 +573,7 @@ static inline uint32_t nfs_dupreq_ref_drc(drc_t *drc)
  */
 static inline uint32_t nfs_dupreq_unref_drc(drc_t *drc)
 {
-	return --(drc->refcnt); /* locked */
+	return atomic_dec_uint32_t(&drc->refcnt);
 }
 
 #define DRC_ST_LOCK()				\
@@ -474,7 +602,8 @@ static inline void drc_free_expired(void)
 		drc = TAILQ_FIRST(&drc_st->tcp_drc_recycle_q);
 		if (drc && (drc->d_u.tcp.recycle_time > 0)
 		    && ((now - drc->d_u.tcp.recycle_time) >
-			drc_st->expire_delta) && (drc->refcnt == 0)) {
+			drc_st->expire_delta)
+		    && (atomic_fetch_uint32_t(&drc->refcnt) == 0)) {
 			LogFullDebug(COMPONENT_DUPREQ,
 				     "remove expired drc %p from "
 				     "recycle queue", drc);
@@ -499,7 +628,7 @@ static inline void drc_free_expired(void)
 			pthread_mutex_lock(&drc->mtx);
 			drc->flags &= ~DRC_FLAG_RECYCLE;
 			/* but if not, dispose it */
-			if (drc->refcnt == 0) {
+			if (atomic_fetch_uint32_t(&drc->refcnt) == 0) {
 				pthread_mutex_unlock(&drc->mtx);
 				free_tcp_drc(drc);
 				continue;
@@ -522,6 +651,12 @@ static inline void drc_free_expired(void)
 /**
  * @brief Find and reference a DRC to process the supplied svc_req.
  *
+ * Once a connection has its DRC, finding it again takes no lock: the
+ * xprt's own reference keeps the DRC alive, so the call path ref is a
+ * plain atomic increment.  Likewise for the shared UDP DRC, which is
+ * never freed.  Only the first request on a connection goes to the
+ * recycle tree, under drc_st->mtx.
+ *
  * @param[in] req  The svc_req being processed.
  *
  * @return The ref'd DRC if sucessfully located, else NULL.
@@ -538,19 +673,26 @@ nfs_dupreq_get_drc(struct svc_req *req)
 	case DRC_UDP_V234:
 		LogFullDebug(COMPONENT_DUPREQ, "ref shared UDP DRC");
 		drc = &(drc_st->udp_drc);
-		DRC_ST_LOCK();
 		(void)nfs_dupreq_ref_drc(drc);
-		DRC_ST_UNLOCK();
 		goto out;
 		break;
 	case DRC_TCP_V4:
 	case DRC_TCP_V3:
+		drc = atomic_fetch_voidptr((void **)&xu->drc);
+		if (likely(drc)) {
+			LogFullDebug(COMPONENT_DUPREQ, "ref DRC=%p for xprt=%p",
+				     drc, req->rq_xprt);
+			/* call path ref */
+			(void)nfs_dupreq_ref_drc(drc);
+			goto out;
+		}
 		pthread_mutex_lock(&req->rq_xprt->xp_lock);
 		if (xu->drc) {
+			/* raced with another first request */
 			drc = xu->drc;
 			LogFullDebug(COMPONENT_DUPREQ, "ref DRC=%p for xprt=%p",
 				     drc, req->rq_xprt);
-			pthread_mutex_lock(&drc->mtx);	/* LOCKED */
+			(void)nfs_dupreq_ref_drc(drc);
 		} else {
 			drc_t drc_k;
 			struct rbtree_x_part *t = NULL;
@@ -596,6 +738,12 @@ nfs_dupreq_get_drc(struct svc_req *req)
 			}
 			if (!drc) {
 				drc = alloc_tcp_drc(dtype);
+				if (unlikely(!drc)) {
+					DRC_ST_UNLOCK();
+					pthread_mutex_unlock(
+						&req->rq_xprt->xp_lock);
+					goto out;
+				}
 				LogFullDebug(COMPONENT_DUPREQ,
 					     "alloc new TCP DRC=%p for xprt=%p",
 					     drc, req->rq_xprt);
@@ -605,16 +753,17 @@ nfs_dupreq_get_drc(struct svc_req *req)
 				/* assign already-computed hash */
 				drc->d_u.tcp.hk = drc_k.d_u.tcp.hk;
 				pthread_mutex_lock(&drc->mtx);	/* LOCKED */
-				/* xprt ref */
-				drc->refcnt = 1;
 				/* insert dict */
 				opr_rbtree_insert(&t->t,
 						  &drc->d_u.tcp.recycle_k);
 			}
-			DRC_ST_UNLOCK();
 			drc->d_u.tcp.recycle_time = 0;
 			/* xprt drc */
 			(void)nfs_dupreq_ref_drc(drc);	/* xu ref */
+			/* call path ref */
+			(void)nfs_dupreq_ref_drc(drc);
+			pthread_mutex_unlock(&drc->mtx);
+			DRC_ST_UNLOCK();
 
 			/* try to expire unused DRCs somewhat in proportion to
 			 * new connection arrivals */
@@ -624,7 +773,7 @@ nfs_dupreq_get_drc(struct svc_req *req)
 				     "after ref drc %p refcnt==%u ", drc,
 				     drc->refcnt);
 
-			xu->drc = drc;
+			atomic_store_voidptr((void **)&xu->drc, drc);
 		}
 		pthread_mutex_unlock(&req->rq_xprt->xp_lock);
 		break;
@@ -633,10 +782,6 @@ nfs_dupreq_get_drc(struct svc_req *req)
 		break;
 	}
 
-	/* call path ref */
-	(void)nfs_dupreq_ref_drc(drc);
-	pthread_mutex_unlock(&drc->mtx);
-
 	if (drc_check_expired)
 		drc_free_expired();
 
@@ -656,19 +801,20 @@ out:
  */
 void nfs_dupreq_put_drc(SVCXPRT *xprt, drc_t *drc, uint32_t flags)
 {
-	if (!(flags & DRC_FLAG_LOCKED))
-		pthread_mutex_lock(&drc->mtx);
-	/* drc LOCKED */
+	uint32_t refcnt;
+
+	if (flags & DRC_FLAG_LOCKED)
+		pthread_mutex_unlock(&drc->mtx);
 
-	if (drc->refcnt == 0) {
+	if (unlikely(atomic_fetch_uint32_t(&drc->refcnt) == 0)) {
 		LogCrit(COMPONENT_DUPREQ,
 			"drc %p refcnt will underrun " "refcnt=%u", drc,
 			drc->refcnt);
 	}
 
-	nfs_dupreq_unref_drc(drc);
+	refcnt = nfs_dupreq_unref_drc(drc);
 
-	LogFullDebug(COMPONENT_DUPREQ, "drc %p refcnt==%u", drc, drc->refcnt);
+	LogFullDebug(COMPONENT_DUPREQ, "drc %p refcnt==%u", drc, refcnt);
 
 	switch (drc->type) {
 	case DRC_UDP_V234:
@@ -676,30 +822,27 @@ void nfs_dupreq_put_drc(SVCXPRT *xprt, drc_t *drc, uint32_t flags)
 		break;
 	case DRC_TCP_V4:
 	case DRC_TCP_V3:
-		if (drc->refcnt == 0) {
-			if (!(drc->flags & DRC_FLAG_RECYCLE)) {
-				/* note t's lock order wrt drc->mtx is
-				 * the opposite of drc->xt[*].lock */
+		if (refcnt == 0) {
+			/* same lock order as nfs_dupreq_get_drc, which may
+			 * have revived the DRC since we dropped our ref */
+			DRC_ST_LOCK();
+			pthread_mutex_lock(&drc->mtx);
+			if (atomic_fetch_uint32_t(&drc->refcnt) == 0
+			    && !(drc->flags & DRC_FLAG_RECYCLE)) {
 				drc->d_u.tcp.recycle_time = time(NULL);
 				drc->flags |= DRC_FLAG_RECYCLE;
-				pthread_mutex_unlock(&drc->mtx); /* !LOCKED */
-				DRC_ST_LOCK();
 				TAILQ_INSERT_TAIL(&drc_st->tcp_drc_recycle_q,
 						  drc, d_u.tcp.recycle_q);
 				++(drc_st->tcp_drc_recycle_qlen);
 				LogFullDebug(COMPONENT_DUPREQ,
 					     "enqueue drc %p for recycle", drc);
-				DRC_ST_UNLOCK();
-				goto out;
 			}
+			pthread_mutex_unlock(&drc->mtx);
+			DRC_ST_UNLOCK();
 		}
 	default:
 		break;
 	};
-
-	pthread_mutex_unlock(&drc->mtx); /* !LOCKED */
-out:
-	return;
 }
 
 /**
@@ -811,6 +954,89 @@ static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
 	pool_free(dupreq_pool, dv);
 }
 
+/**
+ * @brief Free the retired entries of a DRC
+ *
+ * Takes the whole retired list at once, so concurrent callers each
+ * free a disjoint set.  An entry is only retired at refcnt 0, but the
+ * nfs_dupreq_rele that dropped that ref may still be unlocking its
+ * mutex, so each entry's mutex is cycled before it is freed.
+ *
+ * @param[in] drc  The DRC
+ */
+static void drc_reclaim(drc_t *drc)
+{
+	dupreq_entry_t *dv, *next;
+	uint32_t n = 0;
+
+	do {
+		dv = atomic_fetch_voidptr((void **)&drc->retired);
+	} while (dv && !__sync_bool_compare_and_swap(&drc->retired, dv, NULL));
+
+	for (; dv; dv = next) {
+		next = dv->retire_next;
+		pthread_mutex_lock(&dv->mtx);
+		pthread_mutex_unlock(&dv->mtx);
+		nfs_dupreq_free_dupreq(dv);
+		++n;
+	}
+
+	if (n)
+		(void)atomic_sub_uint32_t(&drc->nretired, n);
+}
+
+/**
+ * @brief Retire an entry already unlinked from its DRC
+ *
+ * The entry is pushed on the DRC's retired list, and the list is
+ * reclaimed once DRC_RETIRE_BATCH entries are waiting, so the result
+ * teardown is paid in batches and never under a partition lock.
+ *
+ * @param[in] drc  The DRC
+ * @param[in] dv   The entry
+ */
+static inline void drc_retire(drc_t *drc, dupreq_entry_t *dv)
+{
+	dupreq_entry_t *head;
+
+	do {
+		head = atomic_fetch_voidptr((void **)&drc->retired);
+		dv->retire_next = head;
+	} while (!__sync_bool_compare_and_swap(&drc->retired, head, dv));
+
+	if (atomic_inc_uint32_t(&drc->nretired) >= DRC_RETIRE_BATCH)
+		drc_reclaim(drc);
+}
+
+/**
+ * @brief Free every entry of an unreferenced DRC
+ *
+ * @param[in] drc  The DRC, which no request may be using
+ */
+static void drc_drain(drc_t *drc)
+{
+	struct rbtree_x_part *t;
+	struct drc_part *p;
+	dupreq_entry_t *dv;
+	int ix;
+
+	for (ix = 0; ix < drc->npart; ++ix) {
+		t = &drc->xt.tree[ix];
+		p = &drc->part[ix];
+		pthread_mutex_lock(&t->mtx);
+		while ((dv = TAILQ_FIRST(&p->dupreq_q)) != NULL) {
+			TAILQ_REMOVE(&p->dupreq_q, dv, fifo_q);
+			rbtree_x_cached_remove(&drc->xt, t, &dv->rbt_k,
+					       dv->hk);
+			(void)atomic_dec_uint32_t(&drc->size);
+			drc_uncharge(drc, dv);
+			nfs_dupreq_free_dupreq(dv);
+		}
+		pthread_mutex_unlock(&t->mtx);
+	}
+	drc_reclaim(drc);
+}
+
 /**
  * @page DRC_RETIRE DRC request retire heuristic.
  *
@@ -820,6 +1046,16 @@ static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
  * some small constant, say, 16, otherwise, by 1.  And retwnd decreases by 1
  * when we successfully finish any request.  Likewise in finish, a cached
  * request may be retired iff we are above our water mark, and retwnd is 0.
+ *
+ * Independently, a DRC learns how long after a reply its client
+ * retransmits: on every hit, retain_s moves a quarter of the way to
+ * twice the delay observed.  The water mark does not retire an entry
+ * younger than that while the DRC is within its hard bound, so a
+ * client that retransmits late keeps its replies longer.
+ *
+ * Since requests on different partitions no longer share a lock,
+ * retwnd and size are updated atomically and the heuristic reads them
+ * without a lock; it tolerates being off by a few requests.
  */
 
 #define RETWND_START_BIAS 16
@@ -832,12 +1068,13 @@ static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
  *
  * @param[in] drc The duplicate request cache
  */
-#define drc_inc_retwnd(drc)					\
-	do {							\
-		if ((drc)->retwnd == 0)				\
-			(drc)->retwnd = RETWND_START_BIAS;	\
-		else						\
-			++((drc)->retwnd);			\
+#define drc_inc_retwnd(drc)						\
+	do {								\
+		if (atomic_fetch_uint32_t(&(drc)->retwnd) == 0)		\
+			atomic_store_uint32_t(&(drc)->retwnd,		\
+					      RETWND_START_BIAS);	\
+		else							\
+			(void)atomic_inc_uint32_t(&(drc)->retwnd);	\
 	} while (0)
 
 /**
@@ -847,10 +1084,14 @@ static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
  *
  * @param[in] drc The duplicate request cache
  */
-#define drc_dec_retwnd(drc)			\
-	do {					\
-		if ((drc)->retwnd > 0)		\
-			--((drc)->retwnd);	\
+#define drc_dec_retwnd(drc)						\
+	do {								\
+		uint32_t __w = atomic_fetch_uint32_t(&(drc)->retwnd);	\
+									\
+		while (__w > 0 &&					\
+		       !__sync_bool_compare_and_swap(&(drc)->retwnd,	\
+						     __w, __w - 1))	\
+			__w = atomic_fetch_uint32_t(&(drc)->retwnd);	\
 	} while (0)
 
 /**
@@ -865,21 +1106,257 @@ static inline void nfs_dupreq_free_dupreq(dupreq_entry_t *dv)
  */
 static inline bool drc_should_retire(drc_t *drc)
 {
+	uint32_t size = atomic_fetch_uint32_t(&drc->size);
+
 	/* do not exeed the hard bound on cache size */
-	if (unlikely(drc->size > drc->maxsize))
+	if (unlikely(size > drc->maxsize))
 		return true;
 
 	/* otherwise, are we permitted to retire requests */
-	if (unlikely(drc->retwnd > 0))
+	if (unlikely(atomic_fetch_uint32_t(&drc->retwnd) > 0))
 		return false;
 
 	/* finally, retire if drc->size is above intended high water mark */
-	if (unlikely(drc->size > drc->hiwat))
+	if (unlikely(size > drc->hiwat))
 		return true;
 
 	return false;
 }
 
+/**
+ * @brief Learn a client's retransmit window from a DRC hit
+ *
+ * @param[in] drc  The client's DRC
+ * @param[in] dv   The entry retransmitted
+ */
+static inline void drc_note_retransmit(drc_t *drc, dupreq_entry_t *dv)
+{
+	time_t delay = time(NULL) - dv->timestamp;
+	uint32_t retain = atomic_fetch_uint32_t(&drc->retain_s);
+	uint32_t want;
+
+	if (delay < 1)
+		delay = 1;
+	want = MIN(2 * delay, DRC_RETAIN_MAX_S);
+	atomic_store_uint32_t(&drc->retain_s, (3 * retain + want + 3) / 4);
+}
+
+/**
+ * @brief Find when the oldest entry of a DRC was completed
+ *
+ * @param[in] drc  The DRC
+ *
+ * @return its timestamp, or 0 if the DRC is empty.
+ */
+static time_t drc_oldest(drc_t *drc)
+{
+	dupreq_entry_t *dv;
+	time_t oldest = 0;
+	int ix;
+
+	for (ix = 0; ix < drc->npart; ++ix) {
+		pthread_mutex_lock(&drc->xt.tree[ix].mtx);
+		dv = TAILQ_FIRST(&drc->part[ix].dupreq_q);
+		if (dv && (!oldest || dv->timestamp < oldest))
+			oldest = dv->timestamp;
+		pthread_mutex_unlock(&drc->xt.tree[ix].mtx);
+	}
+
+	return oldest;
+}
+
+/**
+ * @brief Rank a DRC for eviction
+ *
+ * The more bytes a DRC holds, and the longer its oldest entry has
+ * outlived its client's retransmit window, the sooner it is evicted.
+ *
+ * @param[in] drc  The DRC
+ * @param[in] now  The current time
+ *
+ * @return the score, 0 if there is nothing to evict.
+ */
+static uint64_t drc_evict_score(drc_t *drc, time_t now)
+{
+	uint64_t bytes = atomic_fetch_uint64_t(&drc->bytes);
+	time_t oldest;
+
+	if (!bytes)
+		return 0;
+
+	oldest = drc_oldest(drc);
+	if (!oldest)
+		return 0;
+
+	return bytes * (now - oldest + 1) /
+	    (atomic_fetch_uint32_t(&drc->retain_s) + 1);
+}
+
+/**
+ * @brief Evict the oldest unreferenced entries of a DRC
+ *
+ * Partitions are taken in turn, so entries go roughly oldest first.
+ *
+ * @param[in] drc   The DRC
+ * @param[in] want  Bytes to free
+ *
+ * @return the bytes freed.
+ */
+static uint64_t drc_evict_drc(drc_t *drc, uint64_t want)
+{
+	struct rbtree_x_part *t;
+	struct drc_part *p;
+	dupreq_entry_t *dv;
+	uint64_t freed = 0;
+	bool progress = true;
+	int ix;
+
+	while (freed < want && progress) {
+		progress = false;
+		for (ix = 0; ix < drc->npart && freed < want; ++ix) {
+			t = &drc->xt.tree[ix];
+			p = &drc->part[ix];
+			pthread_mutex_lock(&t->mtx);
+			dv = TAILQ_FIRST(&p->dupreq_q);
+			if (dv && atomic_fetch_uint32_t(&dv->refcnt) == 0) {
+				TAILQ_REMOVE(&p->dupreq_q, dv, fifo_q);
+				(void)atomic_dec_uint32_t(&drc->size);
+				rbtree_x_cached_remove(&drc->xt, t, &dv->rbt_k,
+						       dv->hk);
+				drc_uncharge(drc, dv);
+				++(p->evicted);
+				freed += dv->bytes;
+				progress = true;
+			} else {
+				dv = NULL;
+			}
+			pthread_mutex_unlock(&t->mtx);
+			if (dv)
+				drc_retire(drc, dv);
+		}
+	}
+
+	return freed;
+}
+
+/**
+ * @brief Bring all DRCs back under the DRC budget
+ *
+ * The body of the DRC evictor thread, run every DRC_EVICT_INTERVAL
+ * seconds and whenever nfs_dupreq_finish finds the budget exceeded,
+ * so that no request pays for the scan.
+ *
+ * Evicts down to 7/8 of DRC_Budget, choosing the highest scoring DRC
+ * each round and taking at most half of it, so that one large
+ * client does not lose everything while others keep stale replies.
+ *
+ * The TCP DRCs are referenced and copied out under drc_st->mtx, and
+ * scanned without it, so that connections coming and going are not
+ * held up by the scan.
+ *
+ * @param[in] ctx  Thread context
+ */
+static void drc_evict(struct fridgethr_context *ctx)
+{
+	uint64_t budget = nfs_param.core_param.drc.budget;
+	uint64_t target = budget - budget / 8;
+	uint64_t bytes, score, best, want;
+	struct rbtree_x *xt = &drc_st->tcp_drc_recycle_t;
+	struct opr_rbtree_node *n;
+	drc_t **drcs, *victim;
+	time_t now = time(NULL);
+	uint32_t ndrc = 0, i;
+	int round, ix;
+
+	SetNameFunction("drc_evict");
+
+	/* wakes from here on ask for another pass */
+	atomic_store_uint32_t(&drc_st->evict_wanted, 0);
+
+	if (!budget || atomic_fetch_uint64_t(&drc_st->bytes) <= budget)
+		return;
+
+	DRC_ST_LOCK();
+	for (ix = 0; ix < xt->npart; ++ix)
+		for (n = opr_rbtree_first(&xt->tree[ix].t); n;
+		     n = opr_rbtree_next(n))
+			++ndrc;
+	drcs = gsh_malloc((ndrc + 1) * sizeof(drc_t *));
+	if (unlikely(!drcs)) {
+		DRC_ST_UNLOCK();
+		LogCrit(COMPONENT_DUPREQ, "No memory to evict from the DRCs");
+		return;
+	}
+	ndrc = 0;
+	for (ix = 0; ix < xt->npart; ++ix)
+		for (n = opr_rbtree_first(&xt->tree[ix].t); n;
+		     n = opr_rbtree_next(n)) {
+			drcs[ndrc] = opr_containerof(n, drc_t,
+						     d_u.tcp.recycle_k);
+			(void)nfs_dupreq_ref_drc(drcs[ndrc++]);
+		}
+	DRC_ST_UNLOCK();
+
+	for (round = 0; round < DRC_EVICT_ROUNDS; ++round) {
+		bytes = atomic_fetch_uint64_t(&drc_st->bytes);
+		if (bytes <= target)
+			break;
+
+		victim = &drc_st->udp_drc;
+		best = drc_evict_score(victim, now);
+		for (i = 0; i < ndrc; ++i) {
+			score = drc_evict_score(drcs[i], now);
+			if (score > best) {
+				best = score;
+				victim = drcs[i];
+			}
+		}
+		if (!best)
+			break;
+
+		want = MIN(bytes - target,
+			   atomic_fetch_uint64_t(&victim->bytes) / 2 + 1);
+		LogDebug(COMPONENT_DUPREQ,
+			 "DRC over budget (%" PRIu64 " bytes), evicting %"
+			 PRIu64 " from DRC=%p", bytes, want, victim);
+		/* everything of the best victim is in use: give up */
+		if (!drc_evict_drc(victim, want))
+			break;
+	}
+
+	/* a DRC no connection holds goes back on the recycle queue */
+	for (i = 0; i < ndrc; ++i)
+		nfs_dupreq_put_drc(NULL, drcs[i], DRC_FLAG_NONE);
+	gsh_free(drcs);
+}
+
+/**
+ * @brief Checksum the arguments of a request
+ *
+ * The decoded arguments are encoded again into a small buffer, which
+ * stops at the first item that does not fit, so the checksum covers
+ * at most DRC_CKSUM_PREFIX bytes (for a WRITE, everything but the
+ * data) whatever the size of the request.  It only has to tell a
+ * retransmission from a new call that reused the xid.
+ *
+ * @param[in] nfs_req  The request
+ *
+ * @return the checksum.
+ */
+static uint64_t nfs_dupreq_cksum(nfs_request_data_t *nfs_req)
+{
+	char buf[DRC_CKSUM_PREFIX];
+	XDR xdrs;
+	u_int len;
+
+	xdrmem_create(&xdrs, buf, sizeof(buf), XDR_ENCODE);
+	(void)nfs_req->funcdesc->xdr_decode_func(&xdrs, &nfs_req->arg_nfs);
+	len = xdr_getpos(&xdrs);
+	xdr_destroy(&xdrs);
+
+	return gsh_cksum64(buf, len, nfs_req->req.rq_proc);
+}
+
 static inline bool nfs_dupreq_v4_cacheable(nfs_request_data_t *nfs_req)
 {
 	COMPOUND4args *arg_c4 = (COMPOUND4args *)&nfs_req->arg_nfs;
@@ -990,8 +1467,21 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 		break;
 	}
 
-	/* TI-RPC computed checksum */
-	dk->hk = req->rq_cksum;
+	/* index by call; the checksum is only compared on a match */
+	{
+		uint32_t call[4] = { dk->hin.tcp.rq_xid, dk->hin.rq_prog,
+				     dk->hin.rq_vers, dk->hin.rq_proc };
+
+		dk->hk = CityHash64WithSeed((char *)call, sizeof(call), 911);
+		if (drc->type == DRC_UDP_V234)
+			dk->hk = CityHash64WithSeed((char *)&dk->hin.addr,
+						    sizeof(sockaddr_t),
+						    dk->hk);
+	}
+	if ((drc->type == DRC_UDP_V234) ?
+	    nfs_param.core_param.drc.udp.checksum :
+	    nfs_param.core_param.drc.tcp.checksum)
+		dk->hin.tcp.checksum = nfs_dupreq_cksum(nfs_req);
 
 	dk->state = DUPREQ_START;
 	dk->timestamp = time(NULL);
@@ -1000,27 +1490,60 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 		struct opr_rbtree_node *nv;
 		struct rbtree_x_part *t =
 		    rbtx_partition_of_scalar(&drc->xt, dk->hk);
-		pthread_mutex_lock(&t->mtx);	/* partition lock */
+		struct drc_part *p = drc_part_of(drc, t);
+
+		dupreq_entry_t *stale = NULL;
+
+		drc_part_lock(t, p);	/* partition lock */
 		nv = rbtree_x_cached_lookup(&drc->xt, t, &dk->rbt_k, dk->hk);
 		if (nv) {
-			/* cached request */
 			dv = opr_containerof(nv, dupreq_entry_t, rbt_k);
+			if (unlikely(dv->hin.tcp.checksum !=
+				     dk->hin.tcp.checksum)) {
+				/* xid reused for a new call */
+				pthread_mutex_lock(&dv->mtx);
+				if (dv->refcnt == 0 &&
+				    dv->state == DUPREQ_COMPLETE) {
+					stale = dv;
+					TAILQ_REMOVE(&p->dupreq_q, dv, fifo_q);
+					(void)atomic_dec_uint32_t(&drc->size);
+					rbtree_x_cached_remove(&drc->xt, t,
+							       &dv->rbt_k,
+							       dv->hk);
+					drc_uncharge(drc, dv);
+					nv = NULL;
+				}
+				pthread_mutex_unlock(&dv->mtx);
+				if (nv) {
+					/* still in use: run this one
+					 * uncached */
+					pthread_mutex_unlock(&t->mtx);
+					req->rq_u1 = (void *)DUPREQ_NOCACHE;
+					res = alloc_nfs_res();
+					goto release_dk;
+				}
+			}
+		}
+		if (nv) {
+			/* cached request */
 			pthread_mutex_lock(&dv->mtx);
 			if (unlikely(dv->state == DUPREQ_START)) {
+				++(p->busy);
 				status = DUPREQ_BEING_PROCESSED;
 			} else {
 				/* satisfy req from the DRC, incref,
 				   extend window */
+				++(p->hits);
 				res = dv->res;
-				pthread_mutex_lock(&drc->mtx);
 				drc_inc_retwnd(drc);
-				pthread_mutex_unlock(&drc->mtx);
+				drc_note_retransmit(drc, dv);
 				status = DUPREQ_EXISTS;
 				(dv->refcnt)++;
 			}
 			LogDebug(COMPONENT_DUPREQ,
 				 "dupreq hit dk=%p, dk xid=%u cksum %" PRIu64
-				 " state=%s", dk, dk->hin.tcp.rq_xid, dk->hk,
+				 " state=%s", dk, dk->hin.tcp.rq_xid,
+				 dk->hin.tcp.checksum,
 				 dupreq_state_table[dk->state]);
 			req->rq_u1 = dv;
 			pthread_mutex_unlock(&dv->mtx);
@@ -1031,15 +1554,23 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
 						     dk->hk);
 			(dk->refcnt)++;
 			/* add to q tail */
-			pthread_mutex_lock(&drc->mtx);
-			TAILQ_INSERT_TAIL(&drc->dupreq_q, dk, fifo_q);
-			++(drc->size);
-			pthread_mutex_unlock(&drc->mtx);
+			++(p->misses);
+			TAILQ_INSERT_TAIL(&p->dupreq_q, dk, fifo_q);
+			(void)atomic_inc_uint32_t(&drc->size);
+			dk->bytes = DRC_ENTRY_BYTES;
+			drc_charge(drc, dk->bytes);
 			req->rq_u1 = dk;
 			release_dk = false;
 			dv = dk;
 		}
 		pthread_mutex_unlock(&t->mtx);
+
+		if (stale) {
+			LogDebug(COMPONENT_DUPREQ,
+				 "replaced stale dv=%p xid=%u on DRC=%p", stale,
+				 stale->hin.tcp.rq_xid, drc);
+			drc_retire(drc, stale);
+		}
 	}
 
 	LogFullDebug(COMPONENT_DUPREQ,
@@ -1078,6 +1609,10 @@ dupreq_status_t nfs_dupreq_start(nfs_request_data_t *nfs_req,
  * immediately preceding requests.  A timeout may supplement the water mark,
  * in future.
  *
+ * The request retired is the oldest on the partition @c req hashed
+ * to, so only that partition is locked.  Its teardown is deferred to
+ * drc_reclaim.
+ *
  * req->rq_u1 has either a magic value, or points to a duplicate request
  * cache entry allocated in nfs_dupreq_start.
  *
@@ -1092,7 +1627,10 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 	dupreq_entry_t *ov = NULL, *dv = (dupreq_entry_t *)req->rq_u1;
 	dupreq_status_t status = DUPREQ_SUCCESS;
 	struct rbtree_x_part *t;
+	struct drc_part *p;
 	drc_t *drc = NULL;
+	const nfs_function_desc_t *func;
+	uint32_t res_bytes = 0;
 
 	/* do nothing if req is marked no-cache */
 	if (dv == (void *)DUPREQ_NOCACHE)
@@ -1102,15 +1640,19 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 	if (dv == (void *)DUPREQ_BAD_ADDR1)
 		goto out;
 
+	func = nfs_dupreq_func(dv);
+	if (func && func->xdr_encode_func)
+		res_bytes = xdr_sizeof(func->xdr_encode_func, res_nfs);
+
 	pthread_mutex_lock(&dv->mtx);
 	dv->res = res_nfs;
 	dv->timestamp = time(NULL);
 	dv->state = DUPREQ_COMPLETE;
+	dv->bytes += res_bytes;
 	drc = dv->hin.drc;
 	pthread_mutex_unlock(&dv->mtx);
 
-	/* cond. remove from q head */
-	pthread_mutex_lock(&drc->mtx);
+	drc_charge(drc, res_bytes);
 
 	LogFullDebug(COMPONENT_DUPREQ,
 		     "completing dv=%p xid=%u on DRC=%p state=%s, status=%s, "
@@ -1121,42 +1663,55 @@ dupreq_status_t nfs_dupreq_finish(struct svc_req *req, nfs_res_t *res_nfs)
 	/* ok, do the new retwnd calculation here.  then, put drc only if
 	 * we retire an entry */
 	if (drc_should_retire(drc)) {
-		/* again: */
-		ov = TAILQ_FIRST(&drc->dupreq_q);
+		t = rbtx_partition_of_scalar(&drc->xt, dv->hk);
+		p = drc_part_of(drc, t);
+
+		/* cond. remove from q head */
+		drc_part_lock(t, p);	/* partition lock */
+		ov = TAILQ_FIRST(&p->dupreq_q);
 		if (likely(ov)) {
 			/* finished request count against retwnd */
 			drc_dec_retwnd(drc);
-			/* check refcnt */
-			if (ov->refcnt > 0) {
+			/* check refcnt--it is only raised under the
+			 * partition lock, so 0 stays 0 */
+			if (atomic_fetch_uint32_t(&ov->refcnt) > 0) {
 				/* ov still in use, apparently */
-				goto unlock;
+				ov = NULL;
+			} else if (atomic_fetch_uint32_t(&drc->size) <=
+				   drc->maxsize &&
+				   time(NULL) - ov->timestamp <
+				   atomic_fetch_uint32_t(&drc->retain_s)) {
+				/* the client may still retransmit it */
+				ov = NULL;
+			} else {
+				/* remove q and dict entries */
+				TAILQ_REMOVE(&p->dupreq_q, ov, fifo_q);
+				(void)atomic_dec_uint32_t(&drc->size);
+				drc_uncharge(drc, ov);
+				rbtree_x_cached_remove(&drc->xt, t,
+						       &ov->rbt_k, ov->hk);
+				++(p->retired);
 			}
-			/* remove q entry */
-			TAILQ_REMOVE(&drc->dupreq_q, ov, fifo_q);
-			--(drc->size);
-
-			/* remove dict entry */
-			t = rbtx_partition_of_scalar(&drc->xt, ov->hk);
-			/* interlock */
-			pthread_mutex_unlock(&drc->mtx);
-			pthread_mutex_lock(&t->mtx);	/* partition lock */
-			rbtree_x_cached_remove(&drc->xt, t, &ov->rbt_k, ov->hk);
-			pthread_mutex_unlock(&t->mtx);
+		}
+		pthread_mutex_unlock(&t->mtx);
 
+		if (ov) {
 			LogDebug(COMPONENT_DUPREQ,
 				 "retiring ov=%p xid=%u on DRC=%p state=%s, "
 				 "status=%s, refcnt=%d", ov, ov->hin.tcp.rq_xid,
-				 ov->hin.drc, dupreq_state_table[dv->state],
+				 ov->hin.drc, dupreq_state_table[ov->state],
 				 dupreq_status_table[status], ov->refcnt);
 
-			/* deep free ov */
-			nfs_dupreq_free_dupreq(ov);
-			goto out;
+			drc_retire(drc, ov);
 		}
 	}
 
- unlock:
-	pthread_mutex_unlock(&drc->mtx);
+	/* over the budget, have the evictor run once */
+	if (nfs_param.core_param.drc.budget &&
+	    unlikely(atomic_fetch_uint64_t(&drc_st->bytes) >
+		     nfs_param.core_param.drc.budget) &&
+	    __sync_bool_compare_and_swap(&drc_st->evict_wanted, 0, 1))
+		fridgethr_wake(drc_fridge);
 
  out:
 	return status;
@@ -1183,6 +1738,7 @@ dupreq_status_t nfs_dupreq_delete(struct svc_req *req)
 	dupreq_entry_t *dv = (dupreq_entry_t *)req->rq_u1;
 	dupreq_status_t status = DUPREQ_SUCCESS;
 	struct rbtree_x_part *t;
+	struct drc_part *p;
 	drc_t *drc;
 
 	/* do nothing if req is marked no-cache */
@@ -1206,20 +1762,19 @@ dupreq_status_t nfs_dupreq_delete(struct svc_req *req)
 
 	/* XXX dv holds a ref on drc */
 	t = rbtx_partition_of_scalar(&drc->xt, dv->hk);
+	p = drc_part_of(drc, t);
 
-	pthread_mutex_lock(&t->mtx);
+	drc_part_lock(t, p);
 	rbtree_x_cached_remove(&drc->xt, t, &dv->rbt_k, dv->hk);
 
-	pthread_mutex_unlock(&t->mtx);
-	pthread_mutex_lock(&drc->mtx);
-
 	if (TAILQ_IS_ENQUEUED(dv, fifo_q))
-		TAILQ_REMOVE(&drc->dupreq_q, dv, fifo_q);
-	--(drc->size);
+		TAILQ_REMOVE(&p->dupreq_q, dv, fifo_q);
+	(void)atomic_dec_uint32_t(&drc->size);
+	drc_uncharge(drc, dv);
+	pthread_mutex_unlock(&t->mtx);
 
-	/* release dv's ref and unlock */
-	nfs_dupreq_put_drc(req->rq_xprt, drc, DRC_FLAG_LOCKED);
-	/* !LOCKED */
+	/* release dv's ref */
+	nfs_dupreq_put_drc(req->rq_xprt, drc, DRC_FLAG_NONE);
 
  out:
 	return status;
@@ -1283,10 +1838,84 @@ void nfs_dupreq_rele(struct svc_req *req, const nfs_function_desc_t *func)
 	return;
 }
 
+/**
+ * @brief Report a DRC to a drc_foreach callback
+ *
+ * @param[in] drc  The DRC
+ * @param[in] cb   The callback
+ * @param[in] arg  Its argument
+ */
+static void drc_report(drc_t *drc,
+		       void (*cb)(const struct drc_stats *, void *),
+		       void *arg)
+{
+	static const char *const type_s[] = {
+		[DRC_TCP_V4] = "TCP_V4",
+		[DRC_TCP_V3] = "TCP_V3",
+		[DRC_UDP_V234] = "UDP",
+	};
+	char addr[SOCK_NAME_MAX] = "";
+	struct drc_stats stats;
+
+	if (drc->type != DRC_UDP_V234)
+		sprint_sockaddr(&drc->d_u.tcp.addr, addr, sizeof(addr));
+
+	stats.type = type_s[drc->type];
+	stats.addr = addr;
+	stats.size = atomic_fetch_uint32_t(&drc->size);
+	stats.refcnt = atomic_fetch_uint32_t(&drc->refcnt);
+	stats.bytes = atomic_fetch_uint64_t(&drc->bytes);
+	stats.retain_s = atomic_fetch_uint32_t(&drc->retain_s);
+	stats.npart = drc->npart;
+	stats.part = drc->part;
+	cb(&stats, arg);
+}
+
+/**
+ * @brief Call a function for the shared DRC and every TCP DRC
+ *
+ * drc_st->mtx is held throughout, so no DRC is freed under the
+ * callback, but it must not block.
+ *
+ * @param[in] cb   The function
+ * @param[in] arg  Its argument
+ */
+void drc_foreach(void (*cb)(const struct drc_stats *, void *), void *arg)
+{
+	struct rbtree_x *xt;
+	struct opr_rbtree_node *n;
+	int ix;
+
+	if (!drc_st)
+		return;
+
+	DRC_ST_LOCK();
+	drc_report(&drc_st->udp_drc, cb, arg);
+	xt = &drc_st->tcp_drc_recycle_t;
+	for (ix = 0; ix < xt->npart; ++ix)
+		for (n = opr_rbtree_first(&xt->tree[ix].t); n;
+		     n = opr_rbtree_next(n))
+			drc_report(opr_containerof(n, drc_t,
+						   d_u.tcp.recycle_k),
+				   cb, arg);
+	DRC_ST_UNLOCK();
+}
+
 /**
  * @brief Shutdown the dupreq2 package.
  */
 void dupreq2_pkgshutdown(void)
 {
-	/* XXX do nothing */
+	int rc = fridgethr_sync_command(drc_fridge,
+					fridgethr_comm_stop,
+					120);
+
+	if (rc == ETIMEDOUT) {
+		LogMajor(COMPONENT_DUPREQ,
+			 "Shutdown timed out, cancelling threads.");
+		fridgethr_cancel(drc_fridge);
+	} else if (rc != 0) {
+		LogMajor(COMPONENT_DUPREQ,
+			 "Failed shutting down DRC evictor thread: %d", rc);
+	}
 }
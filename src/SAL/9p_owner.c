@@ -246,6 +246,7 @@ static hash_parameter_t _9p_owner_hash_param = {
 	.compare_key = compare_9p_owner_key,
 	.key_to_str = display_9p_owner_key,
 	.val_to_str = display_9p_owner_val,
+	.ht_name = "9P Owner",
 	.flags = HT_FLAG_NONE,
 };
 
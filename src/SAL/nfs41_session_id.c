@@ -175,7 +175,8 @@ static hash_parameter_t session_id_param = {
 	.compare_key = compare_session_id,
 	.key_to_str = display_session_id_key,
 	.val_to_str = display_session_id_val,
-	.flags = HT_FLAG_CACHE,
+	.ht_name = "Session ID",
+	.flags = HT_FLAG_RESIZE,
 };
 
 /**
@@ -223,6 +224,61 @@ int32_t inc_session_ref(nfs41_session_t *session)
 	return refcnt;
 }
 
+/**
+ * @brief Drop the reply cached in a session slot
+ *
+ * @param[in] slot The slot, no longer reachable by requests
+ */
+void nfs41_Slot_Release_Reply(nfs41_session_slot_t *slot)
+{
+	if (slot->cached_result != NULL) {
+		nfs41_cached_reply_unref(slot->cached_result);
+		slot->cached_result = NULL;
+		slot->cache_used = false;
+	}
+}
+
+/**
+ * @brief Allocate a session's forechannel slot table
+ *
+ * Slots hold no reply until their first request completes.
+ *
+ * @param[in,out] session  The session being created
+ * @param[in]     nb_slots Slots to allocate, ca_maxrequests
+ *
+ * @return true on success.
+ */
+bool nfs41_Session_Alloc_Slots(nfs41_session_t *session, uint32_t nb_slots)
+{
+	session->slots = gsh_calloc(nb_slots, sizeof(nfs41_session_slot_t));
+	if (session->slots == NULL)
+		return false;
+
+	session->nb_slots = nb_slots;
+	session->target_slots = nb_slots;
+	return true;
+}
+
+/**
+ * @brief Drop the replies cached in a session's slots and the table
+ *
+ * @param[in] session The session being freed
+ */
+void nfs41_Session_Free_Slots(nfs41_session_t *session)
+{
+	uint32_t i;
+
+	if (session->slots == NULL)
+		return;
+
+	for (i = 0; i < session->nb_slots; i++)
+		nfs41_Slot_Release_Reply(&session->slots[i]);
+
+	gsh_free(session->slots);
+	session->slots = NULL;
+	session->nb_slots = 0;
+}
+
 int32_t dec_session_ref(nfs41_session_t *session)
 {
 	int32_t refcnt = atomic_dec_int32_t(&session->refcount);
@@ -242,6 +298,7 @@ int32_t dec_session_ref(nfs41_session_t *session)
 			nfs_rpc_destroy_chan(&session->cb_chan);
 
 		/* Free the memory for the session */
+		nfs41_Session_Free_Slots(session);
 		pool_free(nfs41_session_pool, session);
 	}
 
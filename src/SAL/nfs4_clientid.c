@@ -49,6 +49,7 @@
 #include "cache_inode_lru.h"
 #include "abstract_atomic.h"
 #include "city.h"
+#include "pool_slab.h"
 
 /**
  * @brief Hashtable used to cache NFSv4 clientids
@@ -322,7 +323,16 @@ void free_client_id(nfs_client_id_t *clientid)
 							       session_link);
 			nfs41_Session_Del(session->session_id);
 		}
+
+		nfs41_Slot_Release_Reply(&clientid->cid_create_session_slot);
 	}
+
+	if (pthread_mutex_destroy(&clientid->cid_create_session_slot.lock)
+	    != 0)
+		LogDebug(COMPONENT_CLIENTID,
+			 "pthread_mutex_destroy returned errno %d (%s)", errno,
+			 strerror(errno));
+
 	pool_free(client_id_pool, clientid);
 }
 
@@ -518,6 +528,17 @@ nfs_client_id_t *create_client_id(clientid4 clientid,
 		return NULL;
 	}
 
+	if (pthread_mutex_init(&client_rec->cid_create_session_slot.lock,
+			       NULL) == -1) {
+		LogCrit(COMPONENT_CLIENTID,
+			"Could not init create session slot mutex for clientid %"
+			PRIx64, clientid);
+		pthread_mutex_destroy(&client_rec->cid_mutex);
+		pool_free(client_id_pool, client_rec);
+
+		return NULL;
+	}
+
 	owner = &client_rec->cid_owner;
 
 	if (pthread_mutex_init(&owner->so_mutex, NULL) == -1) {
@@ -623,6 +644,9 @@ clientid_status_t nfs_client_id_insert(nfs_client_id_t *clientid)
 	/* Take a reference to the unconfirmed clientid for the hash table. */
 	(void)inc_client_id_ref(clientid);
 
+	/* And let the reaper find it when its lease is due */
+	lease_wheel_add(clientid);
+
 	if (isFullDebug(COMPONENT_CLIENTID) &&
 	    isFullDebug(COMPONENT_HASHTABLE)) {
 		LogFullDebug(COMPONENT_CLIENTID,
@@ -1006,6 +1030,7 @@ bool nfs_client_id_expire(nfs_client_id_t *clientid)
 					}
 
 					/* Free the memory for the session */
+					nfs41_Session_Free_Slots(session);
 					pool_free(nfs41_session_pool, session);
 				}
 
@@ -1141,7 +1166,7 @@ static hash_parameter_t cid_confirmed_hash_param = {
 	.key_to_str = display_client_id_key,
 	.val_to_str = display_client_id_val,
 	.ht_name = "Confirmed Client ID",
-	.flags = HT_FLAG_CACHE,
+	.flags = HT_FLAG_RESIZE,
 	.ht_log_component = COMPONENT_CLIENTID,
 };
 
@@ -1208,7 +1233,7 @@ int nfs_Init_client_id(void)
 
 	client_id_pool =
 	    pool_init("NFS4 Client ID Pool", sizeof(nfs_client_id_t),
-		      pool_basic_substrate, NULL, NULL, NULL);
+		      pool_slab_substrate, NULL, NULL, NULL);
 
 	if (client_id_pool == NULL) {
 		LogCrit(COMPONENT_INIT,
@@ -1216,6 +1241,8 @@ int nfs_Init_client_id(void)
 		return -1;
 	}
 
+	lease_wheel_init();
+
 	return CLIENT_ID_SUCCESS;
 }
 
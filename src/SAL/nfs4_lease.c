@@ -39,6 +39,56 @@
 #include "nfs_core.h"
 #include "nfs4.h"
 #include "sal_functions.h"
+#include "abstract_atomic.h"
+
+/**
+ * @brief Seconds covered by the lease wheel
+ *
+ * A power of two larger than the longest lease plus a reaper
+ * interval, so that every client on the wheel is due within one
+ * turn and a single level of one second slots suffices.
+ */
+#define LEASE_WHEEL_SIZE 256
+#define LEASE_WHEEL_MASK (LEASE_WHEEL_SIZE - 1)
+
+/**
+ * @brief Client records by the second their lease should be checked
+ *
+ * Each client in a clientid hash table sits in the slot of the second
+ * its lease runs out, and the wheel holds a reference to it.  The
+ * reaper only visits the slots that came due since its last run.
+ * A lease renewed by update_lease moves to its new slot; one renewed
+ * any other way is found valid when its old slot comes due and is
+ * requeued then.
+ *
+ * The wheel turns by the monotonic clock, so a step of the wall
+ * clock that cid_last_renew is kept in does not stop slots coming
+ * due.
+ *
+ * Lock order is cid_mutex, then the wheel's mutex.
+ */
+static struct lease_wheel {
+	pthread_mutex_t mtx;
+	time_t now;		/*< Last second handed to the reaper */
+	struct glist_head slot[LEASE_WHEEL_SIZE];
+} lease_wheel = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER
+};
+
+static void lease_wheel_move(nfs_client_id_t *clientid);
+
+/**
+ * @brief The second the lease wheel is at
+ *
+ * @return Seconds on the monotonic clock.
+ */
+static inline time_t lease_wheel_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
 
 /**
  * @brief Return the lifetime of a valid lease
@@ -143,8 +193,10 @@ void update_lease(nfs_client_id_t *clientid)
 	clientid->cid_lease_reservations--;
 
 	/* Renew lease when last reservation is released */
-	if (clientid->cid_lease_reservations == 0)
+	if (clientid->cid_lease_reservations == 0) {
 		clientid->cid_last_renew = time(NULL);
+		lease_wheel_move(clientid);
+	}
 
 	if (isFullDebug(COMPONENT_CLIENTID)) {
 		char str[HASHTABLE_DISPLAY_STRLEN];
@@ -154,4 +206,179 @@ void update_lease(nfs_client_id_t *clientid)
 	}
 }
 
+/**
+ * @brief Initialize the lease wheel
+ */
+void lease_wheel_init(void)
+{
+	int i;
+
+	for (i = 0; i < LEASE_WHEEL_SIZE; i++)
+		glist_init(&lease_wheel.slot[i]);
+
+	lease_wheel.now = lease_wheel_clock();
+}
+
+/**
+ * @brief Put a client in the slot for the given second
+ *
+ * The caller must hold the wheel's mutex.  A second the reaper has
+ * already been handed goes to the next one.
+ *
+ * @param[in] clientid Client record
+ * @param[in] expire   Second the lease should be checked
+ */
+static void lease_wheel_queue(nfs_client_id_t *clientid, time_t expire)
+{
+	if (expire <= lease_wheel.now)
+		expire = lease_wheel.now + 1;
+
+	clientid->cid_lease_expire = expire;
+	clientid->cid_lease_queued = true;
+	glist_add_tail(&lease_wheel.slot[expire & LEASE_WHEEL_MASK],
+		       &clientid->cid_lease_link);
+}
+
+/**
+ * @brief Second at which a client's lease runs out
+ *
+ * What is left of the lease by the wall clock is counted from now on
+ * the wheel's clock, and is never more than a whole lease, so that a
+ * wall clock stepped back only brings the check forward.
+ *
+ * @param[in] clientid Client record
+ *
+ * @return The second, on the wheel's clock, the reaper should look at
+ *         the client.
+ */
+static inline time_t lease_expiry(nfs_client_id_t *clientid)
+{
+	time_t left = clientid->cid_last_renew +
+	    nfs_param.nfsv4_param.lease_lifetime - time(NULL);
+
+	if (left < 0)
+		left = 0;
+	else if (left > nfs_param.nfsv4_param.lease_lifetime)
+		left = nfs_param.nfsv4_param.lease_lifetime;
+
+	return lease_wheel_clock() + left;
+}
+
+/**
+ * @brief Start tracking the lease of a new client record
+ *
+ * Called when the record is hashed; the wheel takes a reference that
+ * the reaper drops once it finds the record expired.
+ *
+ * @param[in] clientid Client record
+ */
+void lease_wheel_add(nfs_client_id_t *clientid)
+{
+	(void)inc_client_id_ref(clientid);
+
+	pthread_mutex_lock(&lease_wheel.mtx);
+	lease_wheel_queue(clientid, lease_expiry(clientid));
+	pthread_mutex_unlock(&lease_wheel.mtx);
+}
+
+/**
+ * @brief Put back a client the reaper found with a valid lease
+ *
+ * The caller must hold cid_mutex; the wheel's reference is kept.
+ *
+ * @param[in] clientid Client record
+ */
+void lease_wheel_requeue(nfs_client_id_t *clientid)
+{
+	time_t expire = lease_expiry(clientid);
+
+	/* A reserved lease cannot expire, look again a lease later */
+	if (clientid->cid_lease_reservations != 0)
+		expire = lease_wheel_clock() +
+		    nfs_param.nfsv4_param.lease_lifetime;
+
+	pthread_mutex_lock(&lease_wheel.mtx);
+	lease_wheel_queue(clientid, expire);
+	pthread_mutex_unlock(&lease_wheel.mtx);
+}
+
+/**
+ * @brief Move a renewed lease to its new slot
+ *
+ * The caller must hold cid_mutex.  A client the reaper is looking at
+ * is off the wheel and is left for it to requeue.
+ *
+ * cid_lease_expire is only set under cid_mutex once the record is
+ * hashed, so a lease renewed again within the same second is seen
+ * without taking the wheel's mutex.
+ *
+ * @param[in] clientid Client record
+ */
+static void lease_wheel_move(nfs_client_id_t *clientid)
+{
+	time_t expire = lease_expiry(clientid);
+
+	if (clientid->cid_lease_expire == expire)
+		return;
+
+	pthread_mutex_lock(&lease_wheel.mtx);
+	if (clientid->cid_lease_queued
+	    && clientid->cid_lease_expire != expire) {
+		glist_del(&clientid->cid_lease_link);
+		lease_wheel_queue(clientid, expire);
+	}
+	pthread_mutex_unlock(&lease_wheel.mtx);
+}
+
+/**
+ * @brief Take the clients whose lease check came due off the wheel
+ *
+ * Only the slots for the seconds since the last call are visited, so
+ * the cost is that of the clients due rather than of all clients.
+ * The wheel's reference to each client passes to the caller, which
+ * either requeues it or drops the reference.
+ *
+ * @param[out] due List to which the clients are moved, linked through
+ *                 cid_lease_link
+ *
+ * @return Number of clients moved.
+ */
+int lease_wheel_due(struct glist_head *due)
+{
+	struct glist_head *glist, *glistn;
+	time_t now = lease_wheel_clock();
+	time_t t;
+	int count = 0;
+
+	pthread_mutex_lock(&lease_wheel.mtx);
+
+	t = lease_wheel.now + 1;
+	if (now - lease_wheel.now > LEASE_WHEEL_SIZE)
+		t = now - LEASE_WHEEL_MASK;
+
+	for (; t <= now; t++) {
+		glist_for_each_safe(glist, glistn,
+				    &lease_wheel.slot[t & LEASE_WHEEL_MASK]) {
+			nfs_client_id_t *clientid =
+			    glist_entry(glist, nfs_client_id_t,
+					cid_lease_link);
+
+			if (clientid->cid_lease_expire > now)
+				continue;
+
+			glist_del(glist);
+			clientid->cid_lease_queued = false;
+			glist_add_tail(due, glist);
+			count++;
+		}
+	}
+
+	if (now > lease_wheel.now)
+		lease_wheel.now = now;
+
+	pthread_mutex_unlock(&lease_wheel.mtx);
+
+	return count;
+}
+
 /** @} */
@@ -145,7 +145,7 @@ state_status_t state_add_impl(cache_entry_t *entry, state_type_t state_type,
 	bool got_pinned = false;
 	state_status_t status = 0;
 
-	if (glist_empty(&entry->state_list)) {
+	if (glist_empty(&entry->state_data->state_list)) {
 		cache_status = cache_inode_inc_pin_ref(entry);
 
 		if (cache_status != CACHE_INODE_SUCCESS) {
@@ -160,7 +160,7 @@ state_status_t state_add_impl(cache_entry_t *entry, state_type_t state_type,
 
 	/* Check conflicting delegations and recall if necessary */
 	if (entry->type == REGULAR_FILE) {
-		glist_for_each(glist, &entry->object.file.deleg_list) {
+		glist_for_each(glist, &entry->state_data->deleg_list) {
 			iter_deleg = glist_entry(glist, struct deleg_data,
 						 dd_list);
 			piter_state = iter_deleg->dd_state;
@@ -195,7 +195,7 @@ state_status_t state_add_impl(cache_entry_t *entry, state_type_t state_type,
 	}
 
 
-	/* Add the stateid.other, this will increment cid_stateid_counter */
+	/* Start the stateid.other, nfs4_State_Set completes it */
 	nfs4_BuildStateId_Other(owner_input->so_owner.so_nfs4_owner.
 				so_clientrec, pnew_state->stateid_other);
 
@@ -209,14 +209,10 @@ state_status_t state_add_impl(cache_entry_t *entry, state_type_t state_type,
 	if (refer)
 		pnew_state->state_refer = *refer;
 
-	if (isDebug(COMPONENT_STATE))
-		sprint_mem(debug_str, (char *)pnew_state->stateid_other,
-			   OTHERSIZE);
-
 	glist_init(&pnew_state->state_list);
 	glist_init(&pnew_state->state_owner_list);
 
-	/* Add the state to the related hashtable */
+	/* Add the state to the stateid table */
 	if (!nfs4_State_Set(pnew_state->stateid_other, pnew_state)) {
 		sprint_mem(debug_str, (char *)pnew_state->stateid_other,
 			   OTHERSIZE);
@@ -238,8 +234,12 @@ state_status_t state_add_impl(cache_entry_t *entry, state_type_t state_type,
 		return status;
 	}
 
+	if (isDebug(COMPONENT_STATE))
+		sprint_mem(debug_str, (char *)pnew_state->stateid_other,
+			   OTHERSIZE);
+
 	/* Add state to list for cache entry */
-	glist_add_tail(&entry->state_list, &pnew_state->state_list);
+	glist_add_tail(&entry->state_data->state_list, &pnew_state->state_list);
 
 	inc_state_owner_ref(owner_input);
 
@@ -260,7 +260,7 @@ state_status_t state_add_impl(cache_entry_t *entry, state_type_t state_type,
 
 	if (pnew_state->state_type == STATE_TYPE_DELEG &&
 	    pnew_state->state_data.deleg.sd_type == OPEN_DELEGATE_WRITE)
-		entry->object.file.write_delegated = true;
+		entry->state_data->write_delegated = true;
 
 	/* Copy the result */
 	*state = pnew_state;
@@ -355,7 +355,7 @@ void state_del_locked(state_t *state, cache_entry_t *entry)
 	/* Reset write delegated if this is a write delegation */
 	if (state->state_type == STATE_TYPE_DELEG &&
 	    state->state_data.deleg.sd_type == OPEN_DELEGATE_WRITE)
-		entry->object.file.write_delegated = false;
+		entry->state_data->write_delegated = false;
 
 	/* Remove from list of states for a particular export */
 	PTHREAD_RWLOCK_wrlock(&state->state_export->lock);
@@ -374,7 +374,7 @@ void state_del_locked(state_t *state, cache_entry_t *entry)
 
 	LogFullDebug(COMPONENT_STATE, "Deleted state %s", debug_str);
 
-	if (glist_empty(&entry->state_list))
+	if (glist_empty(&entry->state_data->state_list))
 		cache_inode_dec_pin_ref(entry, false);
 }
 
@@ -411,10 +411,10 @@ void state_nfs4_state_wipe(cache_entry_t *entry)
 	struct glist_head *glist, *glistn;
 	state_t *state = NULL;
 
-	if (glist_empty(&entry->state_list))
+	if (glist_empty(&entry->state_data->state_list))
 		return;
 
-	glist_for_each_safe(glist, glistn, &entry->state_list) {
+	glist_for_each_safe(glist, glistn, &entry->state_data->state_list) {
 		state = glist_entry(glist, state_t, state_list);
 		state_del_locked(state, entry);
 	}
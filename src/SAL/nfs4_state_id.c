@@ -45,6 +45,7 @@
 #include <arpa/inet.h>
 #include <string.h>
 #include <pthread.h>
+#include <assert.h>
 #include <fcntl.h>
 #include <sys/file.h>		/* for having FNDELAY */
 #include <pwd.h>
@@ -60,11 +61,83 @@
 #include "nfs_file_handle.h"
 #include "sal_functions.h"
 #include "nfs_proto_tools.h"
+#include "pool_slab.h"
 
 /**
- * @brief Hash table for stateids.
+ * @brief Bits of the stateid's last word that index the state table
+ *
+ * The "other" part of a stateid is the 64 bit clientid followed by a
+ * word holding the index of the state's slot in the state table and,
+ * in the remaining high order bits, the slot's generation.
+ */
+#define STATEID_INDEX_BITS 22
+#define STATEID_INDEX_MASK ((1U << STATEID_INDEX_BITS) - 1)
+#define STATEID_GEN_MASK ((1U << (32 - STATEID_INDEX_BITS)) - 1)
+
+/**
+ * @brief The state table is allocated in chunks of this many slots
+ */
+#define STATEID_CHUNK_BITS 12
+#define STATEID_CHUNK_SIZE (1U << STATEID_CHUNK_BITS)
+#define STATEID_NCHUNKS (1U << (STATEID_INDEX_BITS - STATEID_CHUNK_BITS))
+
+/**
+ * @brief Free slots kept back from reuse while the table can grow
+ *
+ * A freed slot is only handed out again after at least this many
+ * other slots, so that its generation takes that many times 1024
+ * states to wrap.
  */
-hash_table_t *ht_state_id;
+#define STATEID_FREE_RESERVE STATEID_CHUNK_SIZE
+
+/**
+ * @brief A slot in the state table
+ */
+struct stateid_slot {
+	state_t *state;		/*< The state, NULL if free */
+	uint32_t gen;		/*< Bumped each time the slot is reused */
+	uint32_t next_free;	/*< Next free slot + 1, 0 ends the list */
+};
+
+/**
+ * @brief A FIFO list of slots, threaded through next_free
+ */
+struct stateid_slot_list {
+	uint32_t head;		/*< First slot + 1, 0 if empty */
+	uint32_t tail;		/*< Last slot + 1, 0 if empty */
+	uint32_t count;		/*< Slots in the list */
+};
+
+/**
+ * @brief Table of all NFSv4 states, addressed by stateid
+ *
+ * Lookups take no lock: chunks are never freed once published, and
+ * a slot whose generation or state does not match the stateid is
+ * a miss.  Adding and removing states serialize on the mutex.
+ *
+ * A lookup may read a state that is being freed, before it finds the
+ * generation changed.  That is only safe because state_v4_pool is a
+ * slab pool, whose memory stays a state_t until the pool is
+ * destroyed; nfs4_State_Set checks it is.
+ *
+ * Freed slots go to the tail of the free list and are taken from
+ * its head.  A slot whose generation wraps would give its old
+ * stateids back to a new state of the same client, so it sits out
+ * at least two lease periods, first on the retiring list and then
+ * on the cooling list, before it is free again.
+ */
+static struct stateid_table {
+	pthread_mutex_t mtx;
+	struct stateid_slot *chunk[STATEID_NCHUNKS];
+	uint32_t nchunks;	/*< Chunks allocated */
+	uint32_t in_use;	/*< States in the table */
+	struct stateid_slot_list free;	/*< Free slots, oldest first */
+	struct stateid_slot_list retiring; /*< Wrapped this period */
+	struct stateid_slot_list cooling; /*< Wrapped last period */
+	time_t period_start;	/*< When retiring was started */
+} stateid_table = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER
+};
 
 /**
  * @brief All-zeroes stateid4.other
@@ -78,224 +151,272 @@ char all_ones[OTHERSIZE];
 #define seqid_all_one 0xFFFFFFFF
 
 /**
- * @brief Display a stateid other
+ * @brief Get the table word of a stateid other
  *
- * @param[in]  other The other
- * @param[out] str   Output buffer
+ * @param[in] other The other
  *
- * @return Length of output string.
+ * @return The slot index and generation.
  */
-int display_stateid_other(char *other, char *str)
+static inline uint32_t stateid_other_word(const char *other)
 {
-	uint32_t epoch = *((uint32_t *) other);
-	uint64_t count = *((uint64_t *) (other + sizeof(uint32_t)));
-	return sprintf(str, "epoch=0x%08x counter=0x%016llx",
-		       (unsigned int)epoch, (unsigned long long)count);
+	uint32_t word;
+
+	memcpy(&word, other + sizeof(clientid4), sizeof(word));
+	return word;
 }
 
 /**
- * @brief Display a stateid other in the hash table
+ * @brief Display a stateid other
  *
- * @param[in]  buff The key
- * @param[out] str  Output buffer
+ * @param[in]  other The other
+ * @param[out] str   Output buffer
  *
  * @return Length of output string.
  */
-int display_state_id_key(struct gsh_buffdesc *buff, char *str)
+int display_stateid_other(char *other, char *str)
 {
-	return display_stateid_other(buff->addr, str);
+	clientid4 clientid;
+	uint32_t word = stateid_other_word(other);
+
+	memcpy(&clientid, other, sizeof(clientid));
+	return sprintf(str, "clientid=0x%016llx index=%u gen=%u",
+		       (unsigned long long)clientid,
+		       word & STATEID_INDEX_MASK,
+		       word >> STATEID_INDEX_BITS);
 }
 
 /**
- * @brief Display a state in the hash table
- *
- * @param[in]  buff The value
- * @param[out] str  Output buffer
+ * @brief Init the stateid table
  *
- * @return Length of output string.
+ * @retval 0 if successful.
+ * @retval -1 on failure.
  */
-int display_state_id_val(struct gsh_buffdesc *buff, char *str)
+int nfs4_Init_state_id(void)
 {
-	state_t *state = buff->addr;
+	/* Init  all_one */
+	memset(all_zero, 0, OTHERSIZE);
+	memset(all_ones, 0xFF, OTHERSIZE);
 
-	return sprintf(str,
-		       "state %p is associated with entry=%p type=%u seqid=%u",
-		       state, state->state_entry, state->state_type,
-		       state->state_seqid);
+	return 0;
 }
 
 /**
- * @brief Compare to stateids
+ * @brief Build the 12 byte "other" portion of a stateid
  *
- * @param[in] buff1 One key
- * @param[in] buff2 Another key
+ * Only the clientid is filled in here, the slot index and generation
+ * are added by nfs4_State_Set.  The clientid lets a stateid whose
+ * state is gone be traced to its client and server epoch.
  *
- * @retval 0 if equal.
- * @retval 1 if not equal.
+ * @param[in]  clientid The client owning the state
+ * @param[out] other    stateid.other object (a char[OTHERSIZE] string)
  */
-int compare_state_id(struct gsh_buffdesc *buff1, struct gsh_buffdesc *buff2)
+void nfs4_BuildStateId_Other(nfs_client_id_t *clientid, char *other)
 {
-	if (isFullDebug(COMPONENT_STATE)) {
-		char str1[OTHERSIZE * 2 + 32], str2[OTHERSIZE * 2 + 32];
-
-		display_stateid_other(buff1->addr, str1);
-		display_stateid_other(buff2->addr, str2);
-
-		if (isDebug(COMPONENT_HASHTABLE))
-			LogFullDebug(COMPONENT_STATE, "{%s} vs {%s}", str1,
-				     str2);
-	}
-
-	return memcmp(buff1->addr, buff2->addr, OTHERSIZE);
-}				/* compare_state_id */
+	/* The first part of the other is the 64 bit clientid, which
+	 * consists of the epoch in the high order 32 bits followed by
+	 * the clientid counter in the low order 32 bits.
+	 */
+	memcpy(other, &clientid->cid_clientid, sizeof(clientid->cid_clientid));
+	memset(other + sizeof(clientid->cid_clientid), 0,
+	       OTHERSIZE - sizeof(clientid->cid_clientid));
+}
 
 /**
- * @brief Hash a stateid
+ * @brief Find the slot a stateid other points to
  *
- * @param[in] stateid Array aliased to stateid
+ * @param[in] word The table word of the other
+ *
+ * @return The slot, or NULL if the index is out of the table.
  */
-inline uint32_t compute_stateid_hash_value(uint32_t *stateid)
+static inline struct stateid_slot *stateid_slot_of(uint32_t word)
 {
-	return stateid[1] ^ stateid[2];
+	uint32_t index = word & STATEID_INDEX_MASK;
+	struct stateid_slot *chunk =
+	    atomic_fetch_voidptr((void **)
+				 &stateid_table.chunk[index >>
+						      STATEID_CHUNK_BITS]);
+
+	if (chunk == NULL)
+		return NULL;
+
+	return &chunk[index & (STATEID_CHUNK_SIZE - 1)];
 }
 
 /**
- * @brief Hash index for a stateid
+ * @brief Append a slot to a slot list
  *
- * @param[in] hparam Hash parameter
- * @param[in] key    Key to hash
+ * The caller must hold the table's mutex.
  *
- * @return The hash index.
+ * @param[in,out] list  The list
+ * @param[in]     index Index of the slot
  */
-uint32_t state_id_value_hash_func(hash_parameter_t *hparam,
-				  struct gsh_buffdesc *key)
+static void stateid_list_append(struct stateid_slot_list *list,
+				uint32_t index)
 {
-	uint32_t val =
-	    compute_stateid_hash_value(key->addr) % hparam->index_size;
+	stateid_slot_of(index)->next_free = 0;
 
-	if (isDebug(COMPONENT_HASHTABLE))
-		LogFullDebug(COMPONENT_STATE, "val = %" PRIu32, val);
+	if (list->tail != 0)
+		stateid_slot_of(list->tail - 1)->next_free = index + 1;
+	else
+		list->head = index + 1;
 
-	return val;
+	list->tail = index + 1;
+	list->count++;
 }
 
 /**
- * @brief RBT hash for a stateid
+ * @brief Move all slots of a list to the tail of another
  *
- * @param[in] hparam Hash parameter
- * @param[in] key    Key to hash
+ * The caller must hold the table's mutex.
  *
- * @return The RBT hash.
+ * @param[in,out] dst The list to add to
+ * @param[in,out] src The list to empty
  */
-uint64_t state_id_rbt_hash_func(hash_parameter_t *hparam,
-				struct gsh_buffdesc *key)
+static void stateid_list_splice(struct stateid_slot_list *dst,
+				struct stateid_slot_list *src)
 {
-	uint64_t val = compute_stateid_hash_value(key->addr);
+	if (src->head == 0)
+		return;
 
-	if (isDebug(COMPONENT_HASHTABLE))
-		LogFullDebug(COMPONENT_STATE, "rbt = %" PRIu64, val);
+	if (dst->tail != 0)
+		stateid_slot_of(dst->tail - 1)->next_free = src->head;
+	else
+		dst->head = src->head;
 
-	return val;
+	dst->tail = src->tail;
+	dst->count += src->count;
+	memset(src, 0, sizeof(*src));
 }
 
-static hash_parameter_t state_id_param = {
-	.index_size = PRIME_STATE,
-	.hash_func_key = state_id_value_hash_func,
-	.hash_func_rbt = state_id_rbt_hash_func,
-	.compare_key = compare_state_id,
-	.key_to_str = display_state_id_key,
-	.val_to_str = display_state_id_val,
-	.flags = HT_FLAG_CACHE,
-};
-
 /**
- * @brief Init the hashtable for stateids
+ * @brief Free the slots whose generation wrapped long enough ago
  *
- * @retval 0 if successful.
- * @retval -1 on failure.
+ * The caller must hold the table's mutex.
  */
-int nfs4_Init_state_id(void)
+static void stateid_table_rotate(void)
 {
-	/* Init  all_one */
-	memset(all_zero, 0, OTHERSIZE);
-	memset(all_ones, 0xFF, OTHERSIZE);
-
-	ht_state_id = hashtable_init(&state_id_param);
+	time_t now = time(NULL);
 
-	if (ht_state_id == NULL) {
-		LogCrit(COMPONENT_STATE, "Cannot init State Id cache");
-		return -1;
-	}
+	if (now - stateid_table.period_start <
+	    nfs_param.nfsv4_param.lease_lifetime)
+		return;
 
-	return 0;
+	stateid_list_splice(&stateid_table.free, &stateid_table.cooling);
+	stateid_table.cooling = stateid_table.retiring;
+	memset(&stateid_table.retiring, 0, sizeof(stateid_table.retiring));
+	stateid_table.period_start = now;
 }
 
 /**
- * @brief Build the 12 byte "other" portion of a stateid
+ * @brief Add a chunk of free slots to the state table
  *
- * It is built from the ServerEpoch and a 64 bit global counter.
+ * The new slots go to the head of the free list, ahead of the slots
+ * freed recently.  The caller must hold the table's mutex.
  *
- * @param[in] other stateid.other object (a char[OTHERSIZE] string)
+ * @retval true if a chunk was added.
+ * @retval false if the table is full or out of memory.
  */
-void nfs4_BuildStateId_Other(nfs_client_id_t *clientid, char *other)
+static bool stateid_table_grow(void)
 {
-	uint32_t my_stateid =
-	    atomic_inc_uint32_t(&clientid->cid_stateid_counter);
+	struct stateid_slot *chunk;
+	uint32_t base, i;
 
-	/* The first part of the other is the 64 bit clientid, which
-	 * consists of the epoch in the high order 32 bits followed by
-	 * the clientid counter in the low order 32 bits.
-	 */
-	memcpy(other, &clientid->cid_clientid, sizeof(clientid->cid_clientid));
+	if (stateid_table.nchunks == STATEID_NCHUNKS)
+		return false;
+
+	chunk = gsh_calloc(STATEID_CHUNK_SIZE, sizeof(struct stateid_slot));
+	if (chunk == NULL)
+		return false;
+
+	base = stateid_table.nchunks << STATEID_CHUNK_BITS;
+
+	/* Thread the slots so that the lowest is handed out first */
+	for (i = STATEID_CHUNK_SIZE; i-- > 0;) {
+		chunk[i].next_free = stateid_table.free.head;
+		stateid_table.free.head = base + i + 1;
+	}
+
+	if (stateid_table.free.tail == 0)
+		stateid_table.free.tail = base + STATEID_CHUNK_SIZE;
+	stateid_table.free.count += STATEID_CHUNK_SIZE;
 
-	memcpy(other + sizeof(clientid->cid_clientid), &my_stateid,
-	       sizeof(my_stateid));
+	atomic_store_voidptr((void **)
+			     &stateid_table.chunk[stateid_table.nchunks],
+			     chunk);
+	stateid_table.nchunks++;
+
+	return true;
 }
 
 /**
- * @brief Set a state into the stateid hashtable.
+ * @brief Set a state into the stateid table.
  *
- * @param[in] other stateid4.other
- * @param[in] state The state to add
+ * A free slot is taken for the state, and its index and generation
+ * complete the other built by nfs4_BuildStateId_Other.
+ *
+ * @param[in,out] other stateid4.other
+ * @param[in]     state The state to add
  *
  * @retval 1 if ok.
  * @retval 0 if not ok.
  */
 int nfs4_State_Set(char other[OTHERSIZE], state_t *state)
 {
-	struct gsh_buffdesc buffkey;
-	struct gsh_buffdesc buffval;
-
-	buffkey.addr = gsh_malloc(OTHERSIZE);
+	struct stateid_slot *slot;
+	uint32_t index, word;
 
-	if (buffkey.addr == NULL)
-		return 0;
+	/* nfs4_State_Get_Pointer needs type stable states */
+	assert(state_v4_pool->substrate_vector == pool_slab_substrate);
 
-	LogFullDebug(COMPONENT_STATE, "Allocating stateid key %p",
-		     buffkey.addr);
+	pthread_mutex_lock(&stateid_table.mtx);
 
-	memcpy(buffkey.addr, other, OTHERSIZE);
-	buffkey.len = OTHERSIZE;
+	stateid_table_rotate();
 
-	buffval.addr = state;
-	buffval.len = sizeof(state_t);
+	/* Grow rather than reuse a slot freed too recently */
+	if (stateid_table.free.count <= STATEID_FREE_RESERVE)
+		(void) stateid_table_grow();
 
-	if (hashtable_test_and_set
-	    (ht_state_id, &buffkey, &buffval,
-	     HASHTABLE_SET_HOW_SET_NO_OVERWRITE) != HASHTABLE_SUCCESS) {
+	if (stateid_table.free.count == 0) {
+		pthread_mutex_unlock(&stateid_table.mtx);
 		LogCrit(COMPONENT_STATE,
-			"hashtable_test_and_set failed for key %p",
-			buffkey.addr);
-		gsh_free(buffkey.addr);
+			"State table full with %" PRIu32 " states and %"
+			PRIu32 " slots waiting out a generation wrap",
+			stateid_table.in_use,
+			stateid_table.retiring.count +
+			stateid_table.cooling.count);
 		return 0;
 	}
 
+	index = stateid_table.free.head - 1;
+	slot = stateid_slot_of(index);
+	stateid_table.free.head = slot->next_free;
+	if (stateid_table.free.head == 0)
+		stateid_table.free.tail = 0;
+	stateid_table.free.count--;
+	slot->next_free = 0;
+	stateid_table.in_use++;
+
+	word = (slot->gen << STATEID_INDEX_BITS) | index;
+	memcpy(other + sizeof(clientid4), &word, sizeof(word));
+
+	atomic_store_voidptr((void **)&slot->state, state);
+
+	pthread_mutex_unlock(&stateid_table.mtx);
+
 	return 1;
 }
 
 /**
  * @brief Get the state from the stateid
  *
+ * The slot is found from the index in the stateid, and the state is
+ * only returned if the slot's generation and the state's own other
+ * match the stateid.
+ *
+ * No lock is taken, so the state read may already be freed; its
+ * memory is still a state_t only because state_v4_pool is a slab
+ * pool.  Do not change that pool's substrate without locking here.
+ *
  * @param[in]  other      stateid4.other
  * @param[out] state_data State found
  *
@@ -304,55 +425,68 @@ int nfs4_State_Set(char other[OTHERSIZE], state_t *state)
  */
 int nfs4_State_Get_Pointer(char other[OTHERSIZE], state_t **state_data)
 {
-	struct gsh_buffdesc buffkey;
-	struct gsh_buffdesc buffval;
-	int rc;
+	uint32_t word = stateid_other_word(other);
+	struct stateid_slot *slot = stateid_slot_of(word);
+	state_t *state;
 
-	buffkey.addr = (caddr_t) other;
-	buffkey.len = OTHERSIZE;
+	if (slot == NULL)
+		goto notfound;
 
-	rc = HashTable_Get(ht_state_id, &buffkey, &buffval);
-	if (rc != HASHTABLE_SUCCESS) {
-		LogDebug(COMPONENT_STATE, "HashTable_Get returned %d", rc);
-		return 0;
-	}
+	state = atomic_fetch_voidptr((void **)&slot->state);
 
-	*state_data = buffval.addr;
+	if (state == NULL
+	    || atomic_fetch_uint32_t(&slot->gen) !=
+	       word >> STATEID_INDEX_BITS
+	    || memcmp(state->stateid_other, other, OTHERSIZE) != 0)
+		goto notfound;
+
+	*state_data = state;
 
 	return 1;
+
+ notfound:
+	LogDebug(COMPONENT_STATE, "No state for index %" PRIu32 " gen %" PRIu32,
+		 word & STATEID_INDEX_MASK, word >> STATEID_INDEX_BITS);
+	return 0;
 }
 
 /**
  * @brief Remove a state from the stateid table
  *
+ * The slot's generation is bumped, so that the stateid no longer
+ * matches once the slot is reused.  A slot whose generation wraps is
+ * held back, see stateid_table.
+ *
  * @param[in] other stateid4.other
  *
  * This really can't fail.
  */
 void nfs4_State_Del(char other[OTHERSIZE])
 {
-	struct gsh_buffdesc buffkey, old_key, old_value;
-	hash_error_t err;
-
-	buffkey.addr = other;
-	buffkey.len = OTHERSIZE;
+	uint32_t word = stateid_other_word(other);
+	struct stateid_slot *slot = stateid_slot_of(word);
 
-	err = HashTable_Del(ht_state_id, &buffkey, &old_key, &old_value);
+	pthread_mutex_lock(&stateid_table.mtx);
 
-	if (err == HASHTABLE_SUCCESS) {
-		/* free the key that was stored in hash table */
-		LogFullDebug(COMPONENT_STATE, "Freeing stateid key %p",
-			     old_key.addr);
-		gsh_free(old_key.addr);
-
-		/* State is managed in stuff alloc, no free is needed for
-		 * old_value.addr
-		 */
-	} else {
+	if (slot == NULL || slot->state == NULL
+	    || slot->gen != word >> STATEID_INDEX_BITS) {
+		pthread_mutex_unlock(&stateid_table.mtx);
 		LogCrit(COMPONENT_STATE,
-			"Failure to delete state %s",
-			hash_table_err_to_str(err));
+			"Failure to delete state index %" PRIu32
+			" gen %" PRIu32, word & STATEID_INDEX_MASK,
+			word >> STATEID_INDEX_BITS);
+		return;
 	}
+
+	atomic_store_voidptr((void **)&slot->state, NULL);
+	atomic_store_uint32_t(&slot->gen, (slot->gen + 1) & STATEID_GEN_MASK);
+
+	stateid_list_append(slot->gen != 0 ? &stateid_table.free
+					   : &stateid_table.retiring,
+			    word & STATEID_INDEX_MASK);
+	stateid_table.in_use--;
+
+	pthread_mutex_unlock(&stateid_table.mtx);
 }
 
 /**
@@ -736,8 +870,33 @@ nfsstat4 nfs4_Check_Stateid(stateid4 *stateid, cache_entry_t *entry,
 
 void nfs_State_PrintAll(void)
 {
-	if (isFullDebug(COMPONENT_STATE))
-		hashtable_log(COMPONENT_STATE, ht_state_id);
+	char str[OTHERSIZE * 2 + 64];
+	uint32_t c, i;
+
+	if (!isFullDebug(COMPONENT_STATE))
+		return;
+
+	pthread_mutex_lock(&stateid_table.mtx);
+
+	LogFullDebug(COMPONENT_STATE, "State table: %" PRIu32 " states",
+		     stateid_table.in_use);
+
+	for (c = 0; c < stateid_table.nchunks; c++) {
+		for (i = 0; i < STATEID_CHUNK_SIZE; i++) {
+			state_t *state = stateid_table.chunk[c][i].state;
+
+			if (state == NULL)
+				continue;
+
+			display_stateid_other(state->stateid_other, str);
+			LogFullDebug(COMPONENT_STATE,
+				     "{%s} state %p entry=%p type=%u seqid=%u",
+				     str, state, state->state_entry,
+				     state->state_type, state->state_seqid);
+		}
+	}
+
+	pthread_mutex_unlock(&stateid_table.mtx);
 }
 
 /**
@@ -641,6 +641,7 @@ static hash_parameter_t nsm_client_hash_param = {
 	.compare_key = compare_nsm_client_key,
 	.key_to_str = display_nsm_client_key,
 	.val_to_str = display_nsm_client_val,
+	.ht_name = "NSM Client",
 	.flags = HT_FLAG_NONE,
 };
 
@@ -651,6 +652,7 @@ static hash_parameter_t nlm_client_hash_param = {
 	.compare_key = compare_nlm_client_key,
 	.key_to_str = display_nlm_client_key,
 	.val_to_str = display_nlm_client_val,
+	.ht_name = "NLM Client",
 	.flags = HT_FLAG_NONE,
 };
 
@@ -661,7 +663,8 @@ static hash_parameter_t nlm_owner_hash_param = {
 	.compare_key = compare_nlm_owner_key,
 	.key_to_str = display_nlm_owner_key,
 	.val_to_str = display_nlm_owner_val,
-	.flags = HT_FLAG_NONE,
+	.ht_name = "NLM Owner",
+	.flags = HT_FLAG_RESIZE,
 };
 
 /**
@@ -118,7 +118,7 @@ static bool remove_deleg_data(cache_entry_t *entry,
 	struct deleg_data *deleg_data;
 	struct glist_head *glist;
 
-	glist_for_each(glist, &entry->object.file.deleg_list) {
+	glist_for_each(glist, &entry->state_data->deleg_list) {
 		deleg_data = glist_entry(glist, struct deleg_data, dd_list);
 		if (deleg_data->dd_state == state) {
 			assert(deleg_data->dd_owner == owner);
@@ -159,7 +159,7 @@ state_status_t acquire_lease_lock(cache_entry_t *entry, state_owner_t *owner,
 	if (status == STATE_SUCCESS) {
 		/* Insert deleg data into delegation list */
 		update_delegation_stats(deleg_data);
-		glist_add_tail(&entry->object.file.deleg_list,
+		glist_add_tail(&entry->state_data->deleg_list,
 			       &deleg_data->dd_list);
 	} else {
 		LogDebug(COMPONENT_STATE, "Could not set lease, error=%s",
@@ -514,7 +514,7 @@ void state_deleg_revoke(state_t *state, cache_entry_t *entry)
 	state->state_data.deleg.sd_state = DELEG_RECALL_WIP;
 
 	/* Find the delegation lock and revoke it */
-	glist_for_each(glist, &entry->object.file.deleg_list) {
+	glist_for_each(glist, &entry->state_data->deleg_list) {
 		deleg_data = glist_entry(glist, struct deleg_data, dd_list);
 		if (deleg_data->dd_state == state) {
 			(void)deleg_revoke(deleg_data);
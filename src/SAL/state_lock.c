@@ -51,6 +51,7 @@
 #include "nlm_util.h"
 #include "cache_inode_lru.h"
 #include "export_mgr.h"
+#include "pool_slab.h"
 
 /**
  * @page state_lock_entry_locking state_lock_entry_t locking rule
@@ -99,6 +100,11 @@ pthread_mutex_t blocked_locks_mutex = PTHREAD_MUTEX_INITIALIZER;
  */
 state_owner_t unknown_owner;
 
+/**
+ * @brief Pool for lock entries
+ */
+static pool_t *state_lock_entry_pool;
+
 /**
  * @brief Blocking lock cookies
  */
@@ -117,6 +123,7 @@ static hash_parameter_t cookie_param = {
 	.compare_key = compare_lock_cookie_key,
 	.key_to_str = display_lock_cookie_key,
 	.val_to_str = display_lock_cookie_val,
+	.ht_name = "Lock Cookie",
 	.flags = HT_FLAG_NONE,
 };
 
@@ -162,11 +169,18 @@ state_status_t state_lock_init(void)
 
 	state_owner_pool =
 	    pool_init("NFSv4 state owners", sizeof(state_owner_t),
-		      pool_basic_substrate, NULL, NULL, NULL);
+		      pool_slab_substrate, NULL, NULL, NULL);
 
+	/* Must stay a slab pool: nfs4_State_Get_Pointer reads states
+	 * without a lock and relies on freed ones keeping their memory
+	 * (checked in nfs4_State_Set) */
 	state_v4_pool =
 	    pool_init("NFSv4 files states", sizeof(state_t),
-		      pool_basic_substrate, NULL, NULL, NULL);
+		      pool_slab_substrate, NULL, NULL, NULL);
+
+	state_lock_entry_pool =
+	    pool_init("Lock entries", sizeof(state_lock_entry_t),
+		      pool_slab_substrate, NULL, NULL, NULL);
 	return status;
 }
 
@@ -523,17 +537,15 @@ static state_lock_entry_t *create_state_lock_entry(cache_entry_t *entry,
 {
 	state_lock_entry_t *new_entry;
 
-	new_entry = gsh_malloc(sizeof(*new_entry));
+	new_entry = pool_alloc(state_lock_entry_pool, NULL);
 	if (!new_entry)
 		return NULL;
 
 	LogFullDebug(COMPONENT_STATE, "new_entry = %p owner %p", new_entry,
 		     owner);
 
-	memset(new_entry, 0, sizeof(*new_entry));
-
 	if (pthread_mutex_init(&new_entry->sle_mutex, NULL) == -1) {
-		gsh_free(new_entry);
+		pool_free(state_lock_entry_pool, new_entry);
 		return NULL;
 	}
 
@@ -666,7 +678,7 @@ void lock_entry_dec_ref(state_lock_entry_t *lock_entry)
 		pthread_mutex_unlock(&all_locks_mutex);
 #endif
 
-		gsh_free(lock_entry);
+		pool_free(state_lock_entry_pool, lock_entry);
 	}
 }
 
@@ -744,7 +756,7 @@ static state_lock_entry_t *get_overlapping_entry(cache_entry_t *entry,
 	state_lock_entry_t *found_entry = NULL;
 	uint64_t found_entry_end, range_end = lock_end(lock);
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
+	glist_for_each(glist, &entry->state_data->lock_list) {
 		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 
 		LogEntry("Checking", found_entry);
@@ -798,7 +810,7 @@ static void merge_lock_entry(cache_entry_t *entry,
 
 	/* lock_entry might be STATE_NON_BLOCKING or STATE_GRANTING */
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
+	glist_for_each_safe(glist, glistn, &entry->state_data->lock_list) {
 		check_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 
 		/* Skip entry being merged - it could be in the list */
@@ -850,7 +862,7 @@ static void merge_lock_entry(cache_entry_t *entry,
 						 "Memory allocation failure during lock upgrade/downgrade");
 					continue;
 				}
-				glist_add_tail(&entry->object.file.lock_list,
+				glist_add_tail(&entry->state_data->lock_list,
 					       &(check_entry_right->sle_list));
 			} else {
 				/* No split, just shrink, make the logic below
@@ -1672,7 +1684,7 @@ void state_complete_grant(state_cookie_entry_t *cookie_entry)
 	/* In case all locks have wound up free,
 	 * we must release the pin reference.
 	 */
-	if (glist_empty(&entry->object.file.lock_list))
+	if (glist_empty(&entry->state_data->lock_list))
 		cache_inode_dec_pin_ref(entry, false);
 
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
@@ -1764,7 +1776,7 @@ void process_blocked_lock_upcall(state_block_data_t *block_data)
 	/* In case all locks have wound up free,
 	 * we must release the pin reference.
 	 */
-	if (glist_empty(&entry->object.file.lock_list))
+	if (glist_empty(&entry->state_data->lock_list))
 		cache_inode_dec_pin_ref(entry, false);
 
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
@@ -1788,7 +1800,7 @@ static void grant_blocked_locks(cache_entry_t *entry)
 	if (export->ops->fs_supports(export, fso_lock_support_async_block))
 		return;
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
+	glist_for_each_safe(glist, glistn, &entry->state_data->lock_list) {
 		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 
 		if (found_entry->sle_blocked != STATE_NLM_BLOCKING
@@ -1919,7 +1931,7 @@ void cancel_blocked_locks_range(cache_entry_t *entry,
 	state_lock_entry_t *found_entry = NULL;
 	uint64_t found_entry_end, range_end = lock_end(lock);
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.lock_list) {
+	glist_for_each_safe(glist, glistn, &entry->state_data->lock_list) {
 		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 
 		/* Skip locks not owned by owner */
@@ -2019,7 +2031,7 @@ state_status_t state_release_grant(state_cookie_entry_t *cookie_entry)
 	/* In case all locks have wound up free,
 	 * we must release the pin reference.
 	 */
-	if (glist_empty(&entry->object.file.lock_list))
+	if (glist_empty(&entry->state_data->lock_list))
 		cache_inode_dec_pin_ref(entry, false);
 
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
@@ -2112,7 +2124,7 @@ state_status_t do_unlock_no_owner(cache_entry_t *entry,
 
 	status =
 	    subtract_list_from_list(entry, &fsal_unlock_list,
-				    &entry->object.file.lock_list);
+				    &entry->state_data->lock_list);
 	if (status != STATE_SUCCESS) {
 		/* We ran out of memory while trying to build the unlock list.
 		 * We have already released the locks from cache inode lock
@@ -2365,7 +2377,7 @@ state_status_t state_test(cache_entry_t *entry,
 	}
 
 	if (isFullDebug(COMPONENT_STATE) && isFullDebug(COMPONENT_MEMLEAKS))
-		LogList("Lock List", entry, &entry->object.file.lock_list);
+		LogList("Lock List", entry, &entry->state_data->lock_list);
 
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
 
@@ -2458,7 +2470,7 @@ state_status_t state_lock(cache_entry_t *entry,
 		 * and again. So if we have a mapping blocked request return
 		 * that
 		 */
-		glist_for_each(glist, &entry->object.file.lock_list) {
+		glist_for_each(glist, &entry->state_data->lock_list) {
 			found_entry =
 			    glist_entry(glist, state_lock_entry_t, sle_list);
 
@@ -2505,7 +2517,7 @@ state_status_t state_lock(cache_entry_t *entry,
 		}
 	}
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
+	glist_for_each(glist, &entry->state_data->lock_list) {
 		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 		/* Need to reject lock request if this lock owner already has
 		 * a lock on this file via a different export.
@@ -2547,7 +2559,7 @@ state_status_t state_lock(cache_entry_t *entry,
 				 */
 				LogEntry("Conflicts with", found_entry);
 				LogList("Locks", entry,
-					&entry->object.file.lock_list);
+					&entry->state_data->lock_list);
 				copy_conflict(found_entry, holder, conflict);
 				allow = false;
 				overlap = true;
@@ -2720,10 +2732,10 @@ state_status_t state_lock(cache_entry_t *entry,
 		/* if the list is empty to start with; increment the pin ref
 		 * count before adding it to the list
 		 */
-		if (glist_empty(&entry->object.file.lock_list))
+		if (glist_empty(&entry->state_data->lock_list))
 			cache_inode_inc_pin_ref(entry);
 
-		glist_add_tail(&entry->object.file.lock_list,
+		glist_add_tail(&entry->state_data->lock_list,
 			       &found_entry->sle_list);
 
 		/* A lock downgrade could unblock blocked locks */
@@ -2746,10 +2758,10 @@ state_status_t state_lock(cache_entry_t *entry,
 		/* if the list is empty to start with; increment the pin ref
 		 * count before adding it to the list
 		 */
-		if (glist_empty(&entry->object.file.lock_list))
+		if (glist_empty(&entry->state_data->lock_list))
 			cache_inode_inc_pin_ref(entry);
 
-		glist_add_tail(&entry->object.file.lock_list,
+		glist_add_tail(&entry->state_data->lock_list,
 			       &found_entry->sle_list);
 
 		PTHREAD_RWLOCK_unlock(&entry->state_lock);
@@ -2817,7 +2829,7 @@ state_status_t state_unlock(cache_entry_t *entry,
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 
 	/* If lock list is empty, there really isn't any work for us to do. */
-	if (glist_empty(&entry->object.file.lock_list)) {
+	if (glist_empty(&entry->state_data->lock_list)) {
 		PTHREAD_RWLOCK_unlock(&entry->state_lock);
 		cache_inode_dec_pin_ref(entry, false);
 		LogDebug(COMPONENT_STATE,
@@ -2842,13 +2854,13 @@ state_status_t state_unlock(cache_entry_t *entry,
 	/* Release the lock from cache inode lock list for entry */
 	status =
 	    subtract_lock_from_list(entry, owner, state, lock, &removed,
-				    &entry->object.file.lock_list);
+				    &entry->state_data->lock_list);
 
 	/* If the lock list has become zero; decrement the pin ref count pt
 	 * placed. Do this here just in case subtract_lock_from_list has made
 	 * list empty even if it failed.
 	 */
-	if (glist_empty(&entry->object.file.lock_list))
+	if (glist_empty(&entry->state_data->lock_list))
 		cache_inode_dec_pin_ref(entry, false);
 
 	if (status != STATE_SUCCESS) {
@@ -2892,7 +2904,7 @@ state_status_t state_unlock(cache_entry_t *entry,
 	if (isFullDebug(COMPONENT_STATE) && isFullDebug(COMPONENT_MEMLEAKS)
 	    && lock->lock_start == 0 && lock->lock_length == 0)
 		empty =
-		    LogList("Lock List", entry, &entry->object.file.lock_list);
+		    LogList("Lock List", entry, &entry->state_data->lock_list);
 
 	grant_blocked_locks(entry);
 
@@ -2940,7 +2952,7 @@ state_status_t state_cancel(cache_entry_t *entry,
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 
 	/* If lock list is empty, there really isn't any work for us to do. */
-	if (glist_empty(&entry->object.file.lock_list)) {
+	if (glist_empty(&entry->state_data->lock_list)) {
 		PTHREAD_RWLOCK_unlock(&entry->state_lock);
 
 		cache_inode_dec_pin_ref(entry, false);
@@ -2950,7 +2962,7 @@ state_status_t state_cancel(cache_entry_t *entry,
 		return STATE_SUCCESS;
 	}
 
-	glist_for_each(glist, &entry->object.file.lock_list) {
+	glist_for_each(glist, &entry->state_data->lock_list) {
 		found_entry = glist_entry(glist, state_lock_entry_t, sle_list);
 
 		if (different_owners(found_entry->sle_owner, owner))
@@ -2975,7 +2987,7 @@ state_status_t state_cancel(cache_entry_t *entry,
 	/* If the lock list has become zero; decrement
 	 * the pin ref count pt placed
 	 */
-	if (glist_empty(&entry->object.file.lock_list))
+	if (glist_empty(&entry->state_data->lock_list))
 		cache_inode_dec_pin_ref(entry, false);
 
 	PTHREAD_RWLOCK_unlock(&entry->state_lock);
@@ -3433,7 +3445,7 @@ void find_blocked_lock_upcall(cache_entry_t *entry, void *owner,
 	if (isFullDebug(COMPONENT_STATE) && isFullDebug(COMPONENT_MEMLEAKS)) {
 		PTHREAD_RWLOCK_rdlock(&entry->state_lock);
 
-		LogList("File Lock List", entry, &entry->object.file.lock_list);
+		LogList("File Lock List", entry, &entry->state_data->lock_list);
 
 		PTHREAD_RWLOCK_unlock(&entry->state_lock);
 	}
@@ -3484,10 +3496,10 @@ void available_blocked_lock_upcall(cache_entry_t *entry, void *owner,
  */
 void state_lock_wipe(cache_entry_t *entry)
 {
-	if (glist_empty(&entry->object.file.lock_list))
+	if (glist_empty(&entry->state_data->lock_list))
 		return;
 
-	free_list(&entry->object.file.lock_list);
+	free_list(&entry->state_data->lock_list);
 
 	cache_inode_dec_pin_ref(entry, false);
 }
@@ -1155,7 +1155,7 @@ state_owner_t *get_state_owner(care_t care, state_owner_t *key,
 		DisplayOwner(key, str);
 		LogCrit(COMPONENT_STATE, "Could not init mutex for {%s}", str);
 
-		gsh_free(owner);
+		pool_free(state_owner_pool, owner);
 		return NULL;
 	}
 #ifdef DEBUG_SAL
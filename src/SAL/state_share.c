@@ -799,10 +799,10 @@ state_status_t state_nlm_share(cache_entry_t *entry,
 	/* Add share to list for file, if list was empty take a pin ref to
 	 * keep this file pinned in the inode cache.
 	 */
-	if (glist_empty(&entry->object.file.nlm_share_list))
+	if (glist_empty(&entry->state_data->nlm_share_list))
 		cache_inode_inc_pin_ref(entry);
 
-	glist_add_tail(&entry->object.file.nlm_share_list,
+	glist_add_tail(&entry->state_data->nlm_share_list,
 		       &nlm_share->sns_share_per_file);
 
 	/* Add to share list for export */
@@ -853,7 +853,7 @@ state_status_t state_nlm_share(cache_entry_t *entry,
 			 */
 			glist_del(&nlm_share->sns_share_per_file);
 
-			if (glist_empty(&entry->object.file.nlm_share_list))
+			if (glist_empty(&entry->state_data->nlm_share_list))
 				cache_inode_dec_pin_ref(entry, true);
 
 			/* Remove the share from the NSM Client list */
@@ -939,7 +939,7 @@ state_status_t state_nlm_unshare(cache_entry_t *entry,
 
 	PTHREAD_RWLOCK_wrlock(&entry->state_lock);
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.nlm_share_list) {
+	glist_for_each_safe(glist, glistn, &entry->state_data->nlm_share_list) {
 		nlm_share =
 		    glist_entry(glist, state_nlm_share_t, sns_share_per_file);
 
@@ -1025,7 +1025,7 @@ state_status_t state_nlm_unshare(cache_entry_t *entry,
 		 */
 		glist_del(&nlm_share->sns_share_per_file);
 
-		if (glist_empty(&entry->object.file.nlm_share_list))
+		if (glist_empty(&entry->state_data->nlm_share_list))
 			cache_inode_dec_pin_ref(entry, true);
 
 		/* Remove the share from the NSM Client list */
@@ -1072,7 +1072,7 @@ void state_share_wipe(cache_entry_t *entry)
 	struct glist_head *glistn;
 	state_owner_t *owner;
 
-	glist_for_each_safe(glist, glistn, &entry->object.file.nlm_share_list) {
+	glist_for_each_safe(glist, glistn, &entry->state_data->nlm_share_list) {
 		nlm_share =
 		    glist_entry(glist, state_nlm_share_t, sns_share_per_file);
 
@@ -1088,7 +1088,7 @@ void state_share_wipe(cache_entry_t *entry)
 		 */
 		glist_del(&nlm_share->sns_share_per_file);
 
-		if (glist_empty(&entry->object.file.nlm_share_list))
+		if (glist_empty(&entry->state_data->nlm_share_list))
 			cache_inode_dec_pin_ref(entry, false);
 
 		/* Remove the share from the NSM Client list */
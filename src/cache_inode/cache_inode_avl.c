@@ -43,6 +43,7 @@
 #include "fsal.h"
 #include "cache_inode.h"
 #include "cache_inode_avl.h"
+#include "cache_inode_lru.h"
 #include "murmur3.h"
 #include "city.h"
 
@@ -100,8 +101,13 @@ avl_dirent_set_deleted(cache_entry_t *entry, cache_inode_dir_entry_t *v)
 #endif
 
 	v->flags |= DIR_ENTRY_FLAG_DELETED;
+	cache_inode_lru_charge(entry, -(int64_t) v->ckey.kv.len);
 	cache_inode_key_delete(&v->ckey);
 
+	/* a chunked dirent keeps its cookie in the chunk */
+	if (v->chunk)
+		return;
+
 	/* save cookie in deleted avl */
 	avltree_insert(&v->node_hk, &entry->object.dir.avl.c);
 }
@@ -114,9 +120,11 @@ avl_dirent_clear_deleted(cache_entry_t *entry,
 	struct avltree *c = &entry->object.dir.avl.c;
 	struct avltree_node *node;
 
-	node = avltree_inline_lookup(&v->node_hk, c);
-	assert(node);
-	avltree_remove(&v->node_hk, c);
+	if (!v->chunk) {
+		node = avltree_inline_lookup(&v->node_hk, c);
+		assert(node);
+		avltree_remove(&v->node_hk, c);
+	}
 	memset(&v->node_hk, 0, sizeof(struct avltree_node));
 
 	node = avltree_insert(&v->node_hk, t);
@@ -178,13 +186,13 @@ cache_inode_avl_insert_impl(cache_entry_t *entry,
 	case 0:
 		/* success, note iterations */
 		v->hk.p = j + j2;
-		if (entry->object.dir.avl.collisions < v->hk.p)
-			entry->object.dir.avl.collisions = v->hk.p;
+		if (entry->object.dir.collisions < v->hk.p)
+			entry->object.dir.collisions = v->hk.p;
 
 		LogDebug(COMPONENT_CACHE_INODE,
 			 "inserted new dirent on entry=%p cookie=%" PRIu64
 			 " collisions %d", entry, v->hk.k,
-			 entry->object.dir.avl.collisions);
+			 entry->object.dir.collisions);
 		break;
 	default:
 		/* already inserted, or, keep trying at current j, j2 */
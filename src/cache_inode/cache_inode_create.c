@@ -210,6 +210,8 @@ cache_inode_create(cache_entry_t *parent,
 	}
 
 	PTHREAD_RWLOCK_wrlock(&parent->content_lock);
+	/* Where the FSAL returns the new name is unknown */
+	cache_inode_dir_chunks_stale(parent);
 	/* Add this entry to the directory (also takes an internal ref) */
 	status = cache_inode_add_cached_dirent(parent, name, *entry, NULL);
 	PTHREAD_RWLOCK_unlock(&parent->content_lock);
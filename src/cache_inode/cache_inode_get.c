@@ -123,8 +123,10 @@ again:
 	PTHREAD_RWLOCK_wrlock(&export->lock);
 
 	/* If export_list is empty, store this export as first */
-	if (glist_empty(&entry->export_list))
+	if (glist_empty(&entry->export_list)) {
 		atomic_store_voidptr(&entry->first_export, export);
+		cache_inode_lru_charge_export(entry, export->export_id);
+	}
 
 	expmap->export = export;
 	expmap->entry = entry;
@@ -178,6 +180,8 @@ void clean_mapping(cache_entry_t *entry)
 		gsh_free(expmap);
 	}
 
+	cache_inode_lru_charge_export(entry, -1);
+
 	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
 }
 
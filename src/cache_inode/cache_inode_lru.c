@@ -54,6 +54,7 @@
 #include "cache_inode_hash.h"
 #include "gsh_intrinsic.h"
 #include "sal_functions.h"
+#include "gsh_affinity.h"
 
 /**
  *
@@ -67,10 +68,10 @@
  *
  * This module implements a constant-time cache management strategy
  * based on LRU.  Some ideas are taken from 2Q [Johnson and Shasha 1994]
- * and MQ [Zhou, Chen, Li 2004].  In this system, cache management does
+ * and ARC [Megiddo and Modha 2003].  In this system, cache management does
  * interact with cache entry lifecycle, but the lru queue is not a garbage
  * collector. Most imporantly, cache management operations execute in constant
- * time, as expected with LRU (and MQ).
+ * time, as expected with LRU.
  *
  * Cache entries in use by a currently-active protocol request (or other
  * operation) have a positive refcount, and threfore should not be present
@@ -115,6 +116,12 @@ struct lru_q_lane {
 		struct glist_head *glist;
 		struct glist_head *glistn;
 	} iter;
+	/* Where the next FD reaper run goes on, an entry of q or its
+	 * list head */
+	struct {
+		struct lru_q *q;
+		struct glist_head *pos;
+	} fd_scan;
 	struct {
 		char *func;
 		uint32_t line;
@@ -133,16 +140,61 @@ struct lru_q_lane {
 	pthread_mutex_unlock(&(qlane)->mtx)
 
 /**
- * A multi-level LRU algorithm inspired by MQ [Zhou].  Transition from
- * L1 to L2 implies various checks (open files, etc) have been
- * performed, so ensures they are performed only once.  A
- * correspondence to the "scan resistance" property of 2Q and MQ is
- * accomplished by recycling/clean loads onto the LRU of L1.  Async
- * processing onto L2 constrains oscillation in this algorithm.
+ * A two-level LRU algorithm after 2Q [Johnson] and ARC [Megiddo].
+ * New entries are loaded onto the MRU of L1, a probationary queue.
+ * An initial reference to an entry in L1 more than
+ * LRU_CORRELATED_PERIOD seconds after it was put there is a reuse,
+ * not part of the burst of references one client operation makes,
+ * and moves it to the MRU of the protected L2.  When an entry is
+ * reclaimed, the hash of its key is remembered as a ghost together
+ * with the queue it came from.  An entry created while its ghost is
+ * still remembered has proven itself reused at a distance and is
+ * admitted to L2 at once.  Reclaim takes from L1 while L1 is
+ * larger than lru_state.l1_target, so a scan (one backup, find or
+ * READDIR of a huge directory) only cycles through L1.  Ghost hits
+ * adapt the target: a hit on an L1 ghost means L1 was too small, a
+ * hit on an L2 ghost means L2 was.
  */
 
 static struct lru_q_lane LRU[LRU_N_Q_LANES];
 
+/**
+ * References to an L1 entry within this many seconds of its being
+ * put on L1 are taken to be correlated and do not promote it.
+ */
+
+#define LRU_CORRELATED_PERIOD 3
+
+/**
+ * The ghost set.  Each slot holds the key hash of a reclaimed entry
+ * with the low bits replaced by the queue it was reclaimed from.  The
+ * table is direct mapped on the key hash and lockless: a reclaim that
+ * collides simply forgets the older ghost, which bounds the set at
+ * about one ghost per cached entry, as in ARC.
+ */
+
+#define LRU_GHOST_L1 0x1
+#define LRU_GHOST_L2 0x2
+#define LRU_GHOST_ORIGIN (LRU_GHOST_L1 | LRU_GHOST_L2)
+
+static struct {
+	uint64_t *tags;
+	uint64_t mask;
+	int64_t l1;		/* ghosts from L1 */
+	int64_t l2;		/* ghosts from L2 */
+} lru_ghosts;
+
+/**
+ * Chunks of cached directory content, most recently read at the
+ * head.  The lock nests inside directory content locks; the LRU
+ * thread only tries content locks while holding it.
+ */
+
+static struct {
+	pthread_mutex_t mtx;
+	struct glist_head q;
+} lru_chunks;
+
 /**
  * This is a global counter of files opened by cache_inode.  This is
  * preliminary expected to go away.  Problems with this method are
@@ -188,21 +240,27 @@ enum lru_edge {
 
 static const uint32_t FD_FALLBACK_LIMIT = 0x400;
 
+/* Closed entries the FD reaper may step over per entry of work */
+static const uint32_t FD_SCAN_RATIO = 8;
+
 /* Some helper macros */
 #define LRU_NEXT(n) \
 	(atomic_inc_uint32_t(&(n)) % LRU_N_Q_LANES)
 
 /* Delete lru, use iif the current thread is not the LRU
- * thread.  The node being removed is lru, glist a pointer to L1's q,
- * qlane its lane. */
+ * thread.  The node being removed is lru, glist a pointer to L1's
+ * or L2's q, qlane its lane. */
 #define LRU_DQ_SAFE(lru, q) \
 	do { \
-		if ((lru)->qid == LRU_ENTRY_L1) { \
+		if ((lru)->qid == LRU_ENTRY_L1 || \
+		    (lru)->qid == LRU_ENTRY_L2) { \
 			struct lru_q_lane *qlane = &LRU[(lru)->lane]; \
 			if (unlikely((qlane->iter.active) && \
 				     ((&(lru)->q) == qlane->iter.glistn))) { \
 				qlane->iter.glistn = (lru)->q.next; \
 			} \
+			if (unlikely((&(lru)->q) == qlane->fd_scan.pos)) \
+				qlane->fd_scan.pos = (lru)->q.next; \
 		} \
 		glist_del(&(lru)->q); \
 		--((q)->size); \
@@ -247,12 +305,19 @@ lru_init_queues(void)
 		/* init iterator */
 		qlane->iter.active = false;
 
+		/* the FD reaper starts at the end of L2, so at L1 */
+		qlane->fd_scan.q = &qlane->L2;
+		qlane->fd_scan.pos = &qlane->L2.q;
+
 		/* init lane queues */
 		lru_init_queue(&LRU[ix].L1, LRU_ENTRY_L1);
 		lru_init_queue(&LRU[ix].L2, LRU_ENTRY_L2);
 		lru_init_queue(&LRU[ix].pinned, LRU_ENTRY_PINNED);
 		lru_init_queue(&LRU[ix].cleanup, LRU_ENTRY_CLEANUP);
 	}
+
+	pthread_mutex_init(&lru_chunks.mtx, NULL);
+	glist_init(&lru_chunks.q);
 }
 
 /**
@@ -405,8 +470,12 @@ cache_inode_lru_clean(cache_entry_t *entry)
 		}
 	}
 
-	if (entry->type == DIRECTORY)
+	if (entry->type == DIRECTORY) {
+		/* The LRU thread may be reclaiming a chunk */
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
 		cache_inode_release_dirents(entry, CACHE_INODE_AVL_BOTH);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+	}
 
 	/* Free FSAL resources */
 	if (entry->obj_handle) {
@@ -417,6 +486,16 @@ cache_inode_lru_clean(cache_entry_t *entry)
 	/* Clean out the export mapping before deconstruction */
 	clean_mapping(entry);
 
+	/* Credit whatever the entry still holds, dirents were credited
+	 * as they were released */
+	cache_inode_lru_charge(entry, -(int64_t) entry->lru.bytes);
+
+	/* Nothing can hold state on an entry being cleaned */
+	if (entry->state_data != &cache_inode_no_state) {
+		gsh_free(entry->state_data);
+		entry->state_data = &cache_inode_no_state;
+	}
+
 	/* Finalize last bits of the cache entry */
 	cache_inode_key_delete(&entry->fh_hk.key);
 	pthread_rwlock_destroy(&entry->content_lock);
@@ -424,6 +503,130 @@ cache_inode_lru_clean(cache_entry_t *entry)
 	pthread_rwlock_destroy(&entry->attr_lock);
 }
 
+/**
+ * @brief Account for a ghost entering or leaving the set
+ *
+ * @param[in] tag  The ghost tag, may be empty
+ * @param[in] inc  True if it entered the set
+ */
+static inline void
+lru_ghost_count(uint64_t tag, bool inc)
+{
+	int64_t *cnt;
+
+	if (tag & LRU_GHOST_L1)
+		cnt = &lru_ghosts.l1;
+	else if (tag & LRU_GHOST_L2)
+		cnt = &lru_ghosts.l2;
+	else
+		return;
+
+	if (inc)
+		atomic_inc_int64_t(cnt);
+	else
+		atomic_dec_int64_t(cnt);
+}
+
+/**
+ * @brief Remember a reclaimed entry
+ *
+ * @param[in] hk   Key hash of the reclaimed entry
+ * @param[in] qid  Queue it was reclaimed from
+ */
+static inline void
+lru_ghost_add(uint64_t hk, enum lru_q_id qid)
+{
+	uint64_t *slot = &lru_ghosts.tags[hk & lru_ghosts.mask];
+	uint64_t tag = (hk & ~(uint64_t) LRU_GHOST_ORIGIN) |
+	    ((qid == LRU_ENTRY_L1) ? LRU_GHOST_L1 : LRU_GHOST_L2);
+	uint64_t old;
+
+	do {
+		old = atomic_fetch_uint64_t(slot);
+	} while (!__sync_bool_compare_and_swap(slot, old, tag));
+
+	lru_ghost_count(old, false);
+	lru_ghost_count(tag, true);
+}
+
+/**
+ * @brief Look up and forget the ghost of a key
+ *
+ * @param[in] hk  Key hash of a newly created entry
+ *
+ * @return The queue the ghost was reclaimed from, LRU_ENTRY_NONE if
+ *         there is no ghost.
+ */
+static inline enum lru_q_id
+lru_ghost_take(uint64_t hk)
+{
+	uint64_t *slot = &lru_ghosts.tags[hk & lru_ghosts.mask];
+	uint64_t old = atomic_fetch_uint64_t(slot);
+
+	if (old == 0 ||
+	    (old & ~(uint64_t) LRU_GHOST_ORIGIN) !=
+	    (hk & ~(uint64_t) LRU_GHOST_ORIGIN))
+		return LRU_ENTRY_NONE;
+
+	if (!__sync_bool_compare_and_swap(slot, old, 0))
+		return LRU_ENTRY_NONE;
+
+	lru_ghost_count(old, false);
+
+	return (old & LRU_GHOST_L1) ? LRU_ENTRY_L1 : LRU_ENTRY_L2;
+}
+
+/**
+ * @brief Adapt the L1 target to a ghost hit
+ *
+ * As in ARC, the target moves towards the queue whose ghost was hit,
+ * by more when that queue's ghosts are the scarcer ones.
+ *
+ * @param[in] origin  Queue the ghost was reclaimed from
+ */
+static inline void
+lru_adapt(enum lru_q_id origin)
+{
+	/* the counts may briefly lag the set */
+	int64_t b1 = MAX(atomic_fetch_int64_t(&lru_ghosts.l1), 1);
+	int64_t b2 = MAX(atomic_fetch_int64_t(&lru_ghosts.l2), 1);
+	uint64_t old, new, delta;
+
+	do {
+		old = atomic_fetch_uint64_t(&lru_state.l1_target);
+		if (origin == LRU_ENTRY_L1) {
+			delta = MAX(b2 / b1, 1);
+			new = MIN(old + delta, lru_state.entries_hiwat);
+		} else {
+			delta = MAX(b1 / b2, 1);
+			new = (old > delta) ? old - delta : 0;
+		}
+	} while (!__sync_bool_compare_and_swap(&lru_state.l1_target,
+					       old, new));
+}
+
+/**
+ * @brief Total the entries queued on L1 or L2 of all lanes
+ *
+ * The lane sizes are read without their locks; the result is only a
+ * hint.
+ *
+ * @param[out] l1  Entries on L1
+ * @param[out] l2  Entries on L2
+ */
+void
+cache_inode_lru_sizes(uint64_t *l1, uint64_t *l2)
+{
+	int ix;
+
+	*l1 = 0;
+	*l2 = 0;
+	for (ix = 0; ix < LRU_N_Q_LANES; ++ix) {
+		*l1 += atomic_fetch_uint64_t(&LRU[ix].L1.size);
+		*l2 += atomic_fetch_uint64_t(&LRU[ix].L2.size);
+	}
+}
+
 /**
  * @brief Try to pull an entry off the queue
  *
@@ -489,6 +692,11 @@ lru_reap_impl(enum lru_q_id qid)
 				entry->lru.qid = LRU_ENTRY_NONE;
 				QUNLOCK(qlane);
 				cih_latch_rele(&latch);
+				lru_ghost_add(entry->fh_hk.key.hk, qid);
+				(void)atomic_inc_uint64_t(
+					(qid == LRU_ENTRY_L1)
+					? &cache_stp->inode_evict_l1
+					: &cache_stp->inode_evict_l2);
 				goto out;
 			}
 			cih_latch_rele(&latch);
@@ -513,13 +721,26 @@ static inline cache_inode_lru_t *
 lru_try_reap_entry(void)
 {
 	cache_inode_lru_t *lru;
+	uint64_t l1, l2;
+	enum lru_q_id first, second;
 
-	if (lru_state.entries_used < lru_state.entries_hiwat)
+	if (lru_state.entries_used < lru_state.entries_hiwat &&
+	    !cache_inode_lru_over_bytes())
 		return NULL;
 
-	lru = lru_reap_impl(LRU_ENTRY_L2);
+	/* Keep L1 at its target, so scans don't push out L2 */
+	cache_inode_lru_sizes(&l1, &l2);
+	if (l1 > atomic_fetch_uint64_t(&lru_state.l1_target) || !l2) {
+		first = LRU_ENTRY_L1;
+		second = LRU_ENTRY_L2;
+	} else {
+		first = LRU_ENTRY_L2;
+		second = LRU_ENTRY_L1;
+	}
+
+	lru = lru_reap_impl(first);
 	if (!lru)
-		lru = lru_reap_impl(LRU_ENTRY_L1);
+		lru = lru_reap_impl(second);
 
 	return lru;
 }
@@ -553,6 +774,7 @@ cache_inode_lru_cleanup_push(cache_entry_t *entry)
 		q = &qlane->cleanup;
 		glist_add(&q->q, &lru->q);
 		++(q->size);
+		(void)atomic_inc_uint64_t(&cache_stp->inode_evict_killed);
 	}
 
 	QUNLOCK(qlane);
@@ -601,6 +823,8 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry)
 					   CIH_REMOVE_QLOCKED);
 			LRU_DQ_SAFE(lru, q);
 			entry->lru.qid = LRU_ENTRY_CLEANUP;
+			(void)atomic_inc_uint64_t(
+				&cache_stp->inode_evict_killed);
 		}
 
 		QUNLOCK(qlane);
@@ -619,6 +843,10 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry)
  * This function is responsible for deferred cleanup of cache entries
  * killed in request or upcall (or most other) contexts.
  *
+ * This function is responsible for holding the cache to its byte
+ * budget, see lru_reclaim_bytes, and directory chunks to
+ * Chunks_HWMark, see lru_reclaim_chunks.
+ *
  * This function is responsible for cleaning the FD cache.  It works
  * by the following rules:
  *
@@ -626,21 +854,21 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry)
  *    nothing.
  *
  *  - If the number of open FDs is between the low and high water
- *    mark, make one pass through the queues, and exit.  Each pass
- *    consists of taking an entry from L1, examining to see if it is a
- *    regular file not bearing state with an open FD, closing the open
- *    FD if it is, and then moving it to L2.  The advantage of the two
- *    level system is twofold: First, seldom used entries congregate
- *    in L2 and the promotion behaviour provides some scan
- *    resistance.  Second, once an entry is examined, it is moved to
- *    L2, so we won't examine the same cache entry repeatedly.
+ *    mark, examine up to per_lane_work entries of each lane, and
+ *    exit.  Each lane is walked from the LRU of L1 and then of L2,
+ *    examining each entry to see if it is a regular file not bearing
+ *    state with an open FD, and closing the open FD if it is.
+ *    Entries stay where they are: the queues order entries for
+ *    reclaim, and the FD reaper must not promote or demote them.
+ *    Entries without an open FD are stepped over under the lane
+ *    lock and count for little, so each run reaches further than
+ *    the entries it closed last time.
  *
  *  - If the number of open FDs is greater than the high water mark,
- *    we consider ourselves to be in extremis.  In this case we make a
- *    number of passes through the queue not to exceed the number of
- *    passes that would be required to process the number of entries
- *    equal to a biggest_window percent of the system specified
- *    maximum.
+ *    we consider ourselves to be in extremis.  In this case the walk
+ *    of each lane goes on until all lanes together have examined a
+ *    number of entries equal to a biggest_window percent of the
+ *    system specified maximum.
  *
  *  - If we are in extremis, and performing the maximum amount of work
  *    allowed has not moved the open FD count required_progress%
@@ -659,6 +887,97 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry)
  * @param[in] ctx Fridge context
  */
 
+/**
+ * @brief Reclaim entries down to the byte budget
+ *
+ * Entries are created on demand, so lru_try_reap_entry only keeps the
+ * cache from growing.  Dirents accumulate in existing entries, so
+ * when the cache holds more bytes than Entries_Bytes_HWMark, the LRU
+ * thread frees entries by the same policy until it is back under
+ * budget or has done a run's work.
+ */
+
+static void
+lru_reclaim_bytes(void)
+{
+	cache_inode_lru_t *lru;
+	cache_entry_t *entry;
+	uint32_t reclaimed = 0;
+
+	while (cache_inode_lru_over_bytes() &&
+	       reclaimed < cache_param.reaper_work) {
+		lru = lru_try_reap_entry();
+		if (!lru)
+			break;
+		/* we uniquely hold entry */
+		entry = container_of(lru, cache_entry_t, lru);
+		cache_inode_lru_clean(entry);
+		pool_free(cache_inode_entry_pool, entry);
+		atomic_dec_int64_t(&lru_state.entries_used);
+		++reclaimed;
+	}
+
+	LogDebug(COMPONENT_CACHE_INODE_LRU,
+		 "Reclaimed %" PRIu32 " entries for bytes, %" PRIu64
+		 " bytes of %" PRIu64 " in use", reclaimed,
+		 atomic_fetch_uint64_t(&lru_state.bytes_used),
+		 lru_state.bytes_hiwat);
+}
+
+/**
+ * @brief Reclaim directory chunks
+ *
+ * Frees the least recently read chunks while there are more than
+ * Chunks_HWMark of them or the cache is over its byte budget, up to a
+ * run's work.  Chunks are taken before entries, since a chunk can be
+ * read again at the cost of one FSAL readdir.  A chunk whose
+ * directory is busy is passed over; a later run will find it.
+ */
+
+static void
+lru_reclaim_chunks(void)
+{
+	struct cache_inode_dir_chunk *chunk;
+	struct glist_head *glist;
+	cache_entry_t *parent;
+	uint32_t examined = 0, reclaimed = 0;
+
+	pthread_mutex_lock(&lru_chunks.mtx);
+
+	glist = lru_chunks.q.prev;
+	while (glist != &lru_chunks.q &&
+	       examined < cache_param.reaper_work &&
+	       (lru_state.chunks_used > lru_state.chunks_hiwat ||
+		cache_inode_lru_over_bytes())) {
+		chunk = glist_entry(glist, struct cache_inode_dir_chunk, lru);
+		glist = glist->prev;
+		++examined;
+
+		parent = chunk->parent;
+		if (pthread_rwlock_trywrlock(&parent->content_lock) != 0)
+			continue;
+
+		glist_del(&chunk->lru);
+		--lru_state.chunks_used;
+		pthread_mutex_unlock(&lru_chunks.mtx);
+
+		cache_inode_release_dir_chunk(parent, chunk);
+		PTHREAD_RWLOCK_unlock(&parent->content_lock);
+		++reclaimed;
+
+		/* Our place may have gone with the lock */
+		pthread_mutex_lock(&lru_chunks.mtx);
+		glist = lru_chunks.q.prev;
+	}
+
+	pthread_mutex_unlock(&lru_chunks.mtx);
+
+	LogDebug(COMPONENT_CACHE_INODE_LRU,
+		 "Reclaimed %" PRIu32 " of %" PRIu32 " directory chunks "
+		 "examined, %" PRIu64 " in use", reclaimed, examined,
+		 lru_state.chunks_used);
+}
+
 #define CL_FLAGS \
 	(CACHE_INODE_FLAG_REALLYCLOSE| \
 	 CACHE_INODE_FLAG_NOT_PINNED| \
@@ -729,10 +1048,8 @@ lru_run(struct fridgethr_context *ctx)
 		/* The count of open file descriptors before this run
 		   of the reaper. */
 		size_t formeropen = atomic_fetch_size_t(&open_fd_count);
-		/* Work done in the most recent pass of all queues.  if
-		   value is less than the work to do in a single queue,
-		   don't spin through more passes. */
-		size_t workpass = 0;
+		/* Entries to examine in each lane */
+		size_t lane_work = lru_state.per_lane_work;
 
 		time_t curr_time = time(NULL);
 		fdratepersec =
@@ -750,132 +1067,136 @@ lru_run(struct fridgethr_context *ctx)
 			LogDebug(COMPONENT_CACHE_INODE_LRU,
 				 "Open FDs over high water mark, "
 				 "reapring aggressively.");
+			lane_work = MAX(lane_work,
+					lru_state.biggest_window /
+					LRU_N_Q_LANES);
 		}
 
 		/* Total fds closed between all lanes and all current runs. */
-		do {
-			workpass = 0;
-			for (lane = 0; lane < LRU_N_Q_LANES; ++lane) {
-				/* The amount of work done on this lane on
-				   this pass. */
-				size_t workdone = 0;
-				/* The entry being examined */
-				cache_inode_lru_t *lru = NULL;
-				/* Number of entries closed in this run. */
-				size_t closed = 0;
-				/* a cache_status */
-				cache_inode_status_t cache_status =
-				    CACHE_INODE_SUCCESS;
-				/* a cache entry */
-				cache_entry_t *entry;
-				/* Current queue lane */
-				struct lru_q_lane *qlane = &LRU[lane];
-				q = &qlane->L1;
-				/* entry refcnt */
-				uint32_t refcnt;
-
-				LogDebug(COMPONENT_CACHE_INODE_LRU,
-					 "Reaping up to %d entries from lane "
-					 "%zd",
-					 lru_state.per_lane_work, lane);
-
-				LogFullDebug(COMPONENT_CACHE_INODE_LRU,
-					     "formeropen=%zd totalwork=%zd "
-					     "workpass=%zd closed:%zd "
-					     "totalclosed:%" PRIu64, formeropen,
-					     totalwork, workpass, closed,
-					     totalclosed);
-
-				QLOCK(qlane);
-				qlane->iter.active = true;	/* ACTIVE */
-				/* While for_each_safe per se is NOT MT-safe,
-				 * the iteration can be made so by the
-				 * convention that any competing thread which
-				 * would invalidate the iteration also adjusts
-				 * glist and (in particular) glistn */
-				glist_for_each_safe(qlane->iter.glist,
-						    qlane->iter.glistn, &q->q) {
-					struct lru_q *q;
-
-					/* check per-lane work */
-					if (workdone >= lru_state.per_lane_work)
-						goto next_lane;
-
-					lru =
-					    glist_entry(qlane->iter.glist,
-							cache_inode_lru_t, q);
-					refcnt =
-					    atomic_inc_int32_t(&lru->refcnt);
-
-					/* get entry early */
-					entry =
-					    container_of(lru, cache_entry_t,
-							 lru);
-
-					/* check refcnt in range */
-					if (unlikely(refcnt > 2)) {
-						cache_inode_lru_unref(
-							entry,
-							LRU_UNREF_QLOCKED);
-						workdone++; /* but count it */
-						/* qlane LOCKED, lru refcnt is
-						 * restored */
-						continue;
-					}
+		for (lane = 0; lane < LRU_N_Q_LANES; ++lane) {
+			/* The amount of work done on this lane. */
+			size_t workdone = 0;
+			/* Entries stepped over without an open FD */
+			size_t skipped = 0;
+			/* Queue ends the walk has reached */
+			int ends;
+			/* The entry being examined */
+			cache_inode_lru_t *lru = NULL;
+			/* Number of entries closed in this run. */
+			size_t closed = 0;
+			/* a cache_status */
+			cache_inode_status_t cache_status =
+			    CACHE_INODE_SUCCESS;
+			/* a cache entry */
+			cache_entry_t *entry;
+			/* Current queue lane */
+			struct lru_q_lane *qlane = &LRU[lane];
+			/* entry refcnt */
+			uint32_t refcnt;
 
-					/* Move entry to MRU of L2 */
-					q = &qlane->L1;
-					LRU_DQ_SAFE(lru, q);
-					lru->qid = LRU_ENTRY_L2;
-					q = &qlane->L2;
-					glist_add(&q->q, &lru->q);
-					++(q->size);
-
-					/* Drop the lane lock while performing
-					 * (slow) operations on entry */
-					QUNLOCK(qlane);
-
-					/* Acquire the content lock first; we
-					 * may need to look at fds and close
-					 * it. */
-					PTHREAD_RWLOCK_wrlock(&entry->
-							      content_lock);
-					if (is_open(entry)) {
-						cache_status =
-						    cache_inode_close(
-							    entry, CL_FLAGS);
-						if (cache_status !=
-						    CACHE_INODE_SUCCESS) {
-							LogCrit(
-						      COMPONENT_CACHE_INODE_LRU,
-							"Error closing file in LRU thread.");
-						} else {
-							++totalclosed;
-							++closed;
-						}
-					}
-					PTHREAD_RWLOCK_unlock(&entry->
-							      content_lock);
+			LogDebug(COMPONENT_CACHE_INODE_LRU,
+				 "Reaping up to %zd entries from lane %zd",
+				 lane_work, lane);
 
-					QLOCK(qlane);	/* QLOCKED */
-					cache_inode_lru_unref(
-						entry,
-						LRU_UNREF_QLOCKED);
-					++workdone;
-				} /* for_each_safe lru */
+			LogFullDebug(COMPONENT_CACHE_INODE_LRU,
+				     "formeropen=%zd totalwork=%zd "
+				     "totalclosed:%" PRIu64, formeropen,
+				     totalwork, totalclosed);
 
- next_lane:
-				qlane->iter.active = false; /* !ACTIVE */
+			QLOCK(qlane);
+			qlane->iter.active = true;	/* ACTIVE */
+			/* Go on from where the last run stopped, through
+			 * the rest of its queue and then the other */
+			q = qlane->fd_scan.q;
+			qlane->iter.glist = qlane->fd_scan.pos;
+			ends = 0;
+			/* While the walk per se is NOT MT-safe, the
+			 * iteration can be made so by the convention that
+			 * any competing thread which would invalidate the
+			 * iteration also adjusts glist and (in particular)
+			 * glistn */
+			while (workdone < lane_work) {
+				if (qlane->iter.glist == &q->q) {
+					/* end of the queue */
+					if (++ends > 2)
+						break;
+					q = (q == &qlane->L1)
+						? &qlane->L2 : &qlane->L1;
+					qlane->iter.glist = q->q.next;
+					continue;
+				}
+				qlane->iter.glistn = qlane->iter.glist->next;
+
+				lru = glist_entry(qlane->iter.glist,
+						  cache_inode_lru_t, q);
+				refcnt = atomic_inc_int32_t(&lru->refcnt);
+
+				/* get entry early */
+				entry = container_of(lru, cache_entry_t, lru);
+
+				/* check refcnt in range */
+				if (unlikely(refcnt > 2)) {
+					cache_inode_lru_unref(
+						entry, LRU_UNREF_QLOCKED);
+					workdone++; /* but count it */
+					/* qlane LOCKED, lru refcnt is
+					 * restored */
+					qlane->iter.glist = qlane->iter.glistn;
+					continue;
+				}
+
+				/* Entries stay in place, so step over
+				 * closed ones cheaply */
+				if (!is_open(entry)) {
+					cache_inode_lru_unref(
+						entry, LRU_UNREF_QLOCKED);
+					qlane->iter.glist = qlane->iter.glistn;
+					if (++skipped >=
+					    lane_work * FD_SCAN_RATIO)
+						break;
+					continue;
+				}
+
+				/* Drop the lane lock while performing
+				 * (slow) operations on entry */
 				QUNLOCK(qlane);
-				LogDebug(COMPONENT_CACHE_INODE_LRU,
-					 "Actually processed %zd entries on "
-					 "lane %zd closing %zd descriptors",
-					 workdone, lane, closed);
-				workpass += workdone;
-			}	/* foreach lane */
-			totalwork += workpass;
-		} while (extremis && (workpass >= lru_state.per_lane_work)
-			 && (totalwork < lru_state.biggest_window));
+
+				/* Acquire the content lock first; we may
+				 * need to look at fds and close it. */
+				PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+				if (is_open(entry)) {
+					cache_status =
+					    cache_inode_close(entry,
+							      CL_FLAGS);
+					if (cache_status !=
+					    CACHE_INODE_SUCCESS) {
+						LogCrit(
+						    COMPONENT_CACHE_INODE_LRU,
+						    "Error closing file in LRU thread.");
+					} else {
+						++totalclosed;
+						++closed;
+					}
+				}
+				PTHREAD_RWLOCK_unlock(&entry->content_lock);
+
+				QLOCK(qlane);	/* QLOCKED */
+				cache_inode_lru_unref(entry,
+						      LRU_UNREF_QLOCKED);
+				++workdone;
+				qlane->iter.glist = qlane->iter.glistn;
+			} /* walk */
+
+			qlane->fd_scan.q = q;
+			qlane->fd_scan.pos = qlane->iter.glist;
+			qlane->iter.active = false; /* !ACTIVE */
+			QUNLOCK(qlane);
+			LogDebug(COMPONENT_CACHE_INODE_LRU,
+				 "Actually processed %zd entries on "
+				 "lane %zd closing %zd descriptors",
+				 workdone, lane, closed);
+			totalwork += workdone;
+		}	/* foreach lane */
 
 		currentopen = atomic_fetch_size_t(&open_fd_count);
 		if (extremis
@@ -896,6 +1217,13 @@ lru_run(struct fridgethr_context *ctx)
 		}
 	}
 
+	if (lru_state.chunks_used > lru_state.chunks_hiwat ||
+	    cache_inode_lru_over_bytes())
+		lru_reclaim_chunks();
+
+	if (cache_inode_lru_over_bytes())
+		lru_reclaim_bytes();
+
 	/* The following calculation will progressively garbage collect
 	 * more frequently as these two factors increase:
 	 * 1. current number of open file descriptors
@@ -938,6 +1266,16 @@ lru_run(struct fridgethr_context *ctx)
 		     lru_state.fds_lowat);
 }
 
+/**
+ * @brief Place the LRU thread
+ *
+ * @param[in] ctx Thread fridge context
+ */
+static void lru_thread_initializer(struct fridgethr_context *ctx)
+{
+	gsh_bind_thread(GSH_AFFINITY_LRU, -1);
+}
+
 /* Public functions */
 
 /**
@@ -960,6 +1298,7 @@ cache_inode_lru_pkginit(void)
 	frp.thr_min = 1;
 	frp.thread_delay = cache_param.lru_run_interval;
 	frp.flavor = fridgethr_flavor_looper;
+	frp.thread_initialize = lru_thread_initializer;
 
 	atomic_store_size_t(&open_fd_count, 0);
 
@@ -967,6 +1306,10 @@ cache_inode_lru_pkginit(void)
 	   bit fishy, so come back and revisit this. */
 	lru_state.entries_hiwat = cache_param.entries_hwmark;
 	lru_state.entries_used = 0;
+	lru_state.bytes_hiwat = cache_param.entries_bytes_hwmark;
+	lru_state.bytes_used = 0;
+	lru_state.chunks_hiwat = cache_param.chunks_hwmark;
+	lru_state.chunks_used = 0;
 
 	/* Find out the system-imposed file descriptor limit */
 	if (getrlimit(RLIMIT_NOFILE, &rlim) != 0) {
@@ -1064,6 +1407,18 @@ err_open:
 	/* init queue complex */
 	lru_init_queues();
 
+	/* about one ghost per entry, see lru_ghosts */
+	lru_state.l1_target = 0;
+	lru_ghosts.mask = 0x3ff;
+	while (lru_ghosts.mask < lru_state.entries_hiwat)
+		lru_ghosts.mask = (lru_ghosts.mask << 1) | 1;
+	lru_ghosts.tags = gsh_calloc(lru_ghosts.mask + 1, sizeof(uint64_t));
+	if (lru_ghosts.tags == NULL) {
+		LogMajor(COMPONENT_CACHE_INODE_LRU,
+			 "Unable to allocate LRU ghost set.");
+		return ENOMEM;
+	}
+
 	/* spawn LRU background thread */
 	code = fridgethr_init(&lru_fridge, "LRU_fridge", &frp);
 	if (code != 0) {
@@ -1223,42 +1578,114 @@ cache_inode_lru_get(cache_entry_t **entry)
 	nentry->lru.refcnt = 2;
 	nentry->lru.pin_refcnt = 0;
 	nentry->lru.cf = 0;
+	nentry->lru.bytes = 0;
+	nentry->lru.export_id = -1;
+	nentry->lru.l1_since = time(NULL);
+	nentry->state_data = &cache_inode_no_state;
 
-	/* Enqueue. */
+	/* Enqueue on probation. */
 	lane = lru_lane_of_entry(nentry);
-	lru_insert_entry(nentry, &LRU[lane].L1, lane, LRU_HEAD);
+	lru_insert_entry(nentry, &LRU[lane].L1, lane, LRU_TAIL);
 
  out:
 	*entry = nentry;
 	return status;
 }
 
+/**
+ * @brief Admit a newly hashed entry
+ *
+ * This function checks whether the key of a new entry, just made
+ * reachable, belongs to an entry recently reclaimed.  If it does, the
+ * entry was reused at a distance larger than the cache: it is moved to
+ * the MRU of L2 and the L1 target adapts.  Otherwise it stays on L1,
+ * where cache_inode_lru_get put it.
+ *
+ * @param[in] entry  The new entry, with its key set
+ */
+void
+cache_inode_lru_admit(cache_entry_t *entry)
+{
+	cache_inode_lru_t *lru = &entry->lru;
+	struct lru_q_lane *qlane = &LRU[lru->lane];
+	enum lru_q_id origin;
+	struct lru_q *q;
+
+	origin = lru_ghost_take(entry->fh_hk.key.hk);
+	if (origin == LRU_ENTRY_NONE)
+		return;
+
+	(void)atomic_inc_uint64_t((origin == LRU_ENTRY_L1)
+				  ? &cache_stp->inode_ghost_l1
+				  : &cache_stp->inode_ghost_l2);
+	lru_adapt(origin);
+
+	QLOCK(qlane);
+	if (lru->qid == LRU_ENTRY_L1) {
+		q = &qlane->L1;
+		LRU_DQ_SAFE(lru, q);
+		lru->qid = LRU_ENTRY_L2;
+		q = &qlane->L2;
+		glist_add_tail(&q->q, &lru->q);
+		++(q->size);
+	}
+	QUNLOCK(qlane);
+}
+
 /**
  * @brief Function to let the state layer pin an entry
  *
  * This function moves the given entry to the pinned queue partition
  * for its lane.  If the entry is already pinned, it is a no-op.
  *
+ * The first pin also gives the entry its own state block, which it
+ * keeps until it is cleaned.
+ *
  * @param[in] entry  The entry to be moved
  *
  * @retval CACHE_INODE_SUCCESS if the entry was moved.
  * @retval CACHE_INODE_DEAD_ENTRY if the entry is in the process of
  *                                disposal
+ * @retval CACHE_INODE_MALLOC_ERROR if the state block could not be
+ *                                  allocated
  */
 cache_inode_status_t
 cache_inode_inc_pin_ref(cache_entry_t *entry)
 {
 	uint32_t lane = entry->lru.lane;
 	struct lru_q_lane *qlane = &LRU[lane];
+	struct cache_inode_state_data *sd = NULL;
+
+	if (entry->state_data == &cache_inode_no_state) {
+		sd = gsh_calloc(1, sizeof(*sd));
+		if (sd == NULL) {
+			LogCrit(COMPONENT_CACHE_INODE_LRU,
+				"can't allocate state for entry %p", entry);
+			return CACHE_INODE_MALLOC_ERROR;
+		}
+		glist_init(&sd->state_list);
+		glist_init(&sd->layoutrecall_list);
+		glist_init(&sd->lock_list);
+		glist_init(&sd->deleg_list);
+		glist_init(&sd->nlm_share_list);
+	}
 
 	/* Pin ref is infrequent, and never concurrent because SAL invariantly
 	 * holds the state lock exclusive whenever it is called. */
 	QLOCK(qlane);
 	if (entry->lru.qid == LRU_ENTRY_CLEANUP) {
 		QUNLOCK(qlane);
+		gsh_free(sd);
 		return CACHE_INODE_DEAD_ENTRY;
 	}
 
+	/* Not every caller holds the state lock, so only the first to
+	 * get here installs its block */
+	if (sd != NULL && entry->state_data == &cache_inode_no_state) {
+		entry->state_data = sd;
+		sd = NULL;
+	}
+
 	/* Pin if not pinned already */
 	cond_pin_entry(entry, LRU_FLAG_NONE /* future */);
 
@@ -1267,6 +1694,8 @@ cache_inode_inc_pin_ref(cache_entry_t *entry)
 
 	QUNLOCK(qlane);		/* !LOCKED (lane) */
 
+	gsh_free(sd);
+
 	return CACHE_INODE_SUCCESS;
 }
 
@@ -1303,6 +1732,7 @@ void cache_inode_dec_pin_ref(cache_entry_t *entry, bool closefile)
 			--(q->size);
 			/* add to MRU of L1 */
 			lru->qid = LRU_ENTRY_L1;
+			lru->l1_since = time(NULL);
 			q = &qlane->L1;
 			glist_add_tail(&q->q, &lru->q);
 			++(q->size);
@@ -1318,6 +1748,79 @@ void cache_inode_dec_pin_ref(cache_entry_t *entry, bool closefile)
 	QUNLOCK(qlane);
 }
 
+/**
+ * @brief Charge an entry to the export it is reached through
+ *
+ * For ShowCacheInodeBytes, each entry counts in the first export it
+ * is mapped to.  Its entry and bytes move from the export it was
+ * charged to, if any, to @a export_id.
+ *
+ * The caller holds attr_lock for write, as it does to change the
+ * entry's export mapping.  A charge racing with the move may land on
+ * the old export, so the per export figures are approximate.
+ *
+ * An export whose counters cannot be allocated is not charged.
+ *
+ * @param[in] entry     The entry
+ * @param[in] export_id The export, or -1 for none
+ */
+void
+cache_inode_lru_charge_export(cache_entry_t *entry, int32_t export_id)
+{
+	int32_t old = atomic_fetch_int32_t(&entry->lru.export_id);
+	struct lru_export_bytes *eb;
+	int64_t bytes;
+
+	if (old == export_id)
+		return;
+
+	if (export_id >= 0 && lru_export_bytes_alloc(export_id) == NULL)
+		export_id = -1;
+
+	atomic_store_int32_t(&entry->lru.export_id, export_id);
+	bytes = atomic_fetch_uint64_t(&entry->lru.bytes);
+	if (old >= 0) {
+		eb = lru_export_bytes(old);
+		atomic_dec_int64_t(&eb->entries);
+		atomic_sub_int64_t(&eb->bytes, bytes);
+	}
+	if (export_id >= 0) {
+		eb = lru_export_bytes(export_id);
+		atomic_inc_int64_t(&eb->entries);
+		atomic_add_int64_t(&eb->bytes, bytes);
+	}
+}
+
+/**
+ * @brief Find the counters of an export, allocating them if needed
+ *
+ * @param[in] export_id The export
+ *
+ * @return The counters, NULL if they could not be allocated.
+ */
+struct lru_export_bytes *lru_export_bytes_alloc(uint16_t export_id)
+{
+	void **slot = (void **)&lru_state.export_bytes[
+					export_id / LRU_EXPORT_BYTES_BLOCK];
+	struct lru_export_bytes *block;
+
+	if (atomic_fetch_voidptr(slot) == NULL) {
+		block = gsh_calloc(LRU_EXPORT_BYTES_BLOCK,
+				   sizeof(struct lru_export_bytes));
+		if (block == NULL) {
+			LogMajor(COMPONENT_CACHE_INODE_LRU,
+				 "Unable to allocate byte counters for export %"
+				 PRIu16, export_id);
+			return NULL;
+		}
+		/* another thread may have got there first */
+		if (!__sync_bool_compare_and_swap(slot, NULL, block))
+			gsh_free(block);
+	}
+
+	return lru_export_bytes(export_id);
+}
+
 /**
  * @brief Return true if a file is pinned.
  *
@@ -1354,10 +1857,12 @@ cache_inode_is_pinned(cache_entry_t *entry)
  * path, hence does not influence LRU, and is lockless.
  *
  * A flags value of LRU_REQ_INITIAL indicates an ordinary initial reference,
- * and strongly influences LRU.  LRU_REQ_SCAN indicates a scan reference
- * (currently, READDIR) and weakly influences LRU.  Ascan reference should not
- * be taken by call paths which may open a file descriptor.  In both cases, the
- * L1->L2 boundary is sticky (scan resistence).
+ * and advances the entry to the MRU of its queue, or from L1 to the MRU of
+ * L2 if the entry has been on L1 longer than LRU_CORRELATED_PERIOD.
+ * LRU_REQ_SCAN indicates a scan reference (currently, READDIR) and does not
+ * influence LRU.  A scan reference should not be taken by call paths which
+ * may open a file descriptor.  A scan therefore only promotes what it
+ * touches again later (scan resistence).
  *
  * @retval CACHE_INODE_SUCCESS if the reference was acquired
  */
@@ -1366,47 +1871,46 @@ cache_inode_lru_ref(cache_entry_t *entry, uint32_t flags)
 {
 	atomic_inc_int32_t(&entry->lru.refcnt);
 
-	/* adjust LRU on initial refs */
-	if (flags & (LRU_REQ_INITIAL | LRU_REQ_SCAN)) {
+	/* adjust LRU on initial refs; scans don't (scan resistence) */
+	if (flags & LRU_REQ_INITIAL) {
 
 		cache_inode_lru_t *lru = &entry->lru;
 		struct lru_q_lane *qlane = &LRU[lru->lane];
 		struct lru_q *q;
+		bool reuse;
+
+		/* A reuse of an L1 entry is never skipped, so that it is
+		 * promoted */
+		reuse = lru->qid == LRU_ENTRY_L1 &&
+			time(NULL) - atomic_fetch_uint32_t(&lru->l1_since) >
+			LRU_CORRELATED_PERIOD;
 
 		/* do it less */
-		if ((atomic_inc_int32_t(&entry->lru.cf) % 3) != 0)
+		if (!reuse && (atomic_inc_int32_t(&entry->lru.cf) % 3) != 0)
 			goto out;
 
 		QLOCK(qlane);
 
 		switch (lru->qid) {
 		case LRU_ENTRY_L1:
-			q = lru_queue_of(entry);
-			if (flags & LRU_REQ_INITIAL) {
-				/* advance entry to MRU (of L1) */
+			if (reuse) {
+				/* second, uncorrelated reference: promote
+				 * to MRU of L2 */
+				q = &qlane->L1;
 				LRU_DQ_SAFE(lru, q);
+				lru->qid = LRU_ENTRY_L2;
+				q = &qlane->L2;
 				glist_add_tail(&q->q, &lru->q);
-				--(q->size);
-			} else {
-				/* do not advance entry in L1 on LRU_REQ_SCAN
-				 * (scan resistence) */
+				++(q->size);
+				break;
 			}
-			break;
+			/* fall through */
 		case LRU_ENTRY_L2:
+			/* advance entry to MRU (of its queue) */
 			q = lru_queue_of(entry);
-			if (flags & LRU_REQ_INITIAL) {
-				/* move entry to LRU of L1 */
-				glist_del(&lru->q);	/* skip L1 fixups */
-				--(q->size);
-				lru->qid = LRU_ENTRY_L1;
-				q = &qlane->L1;
-				glist_add(&q->q, &lru->q);
-				++(q->size);
-			} else {
-				/* advance entry to MRU of L2 */
-				glist_del(&lru->q);	/* skip L1 fixups */
-				glist_add_tail(&q->q, &lru->q);
-			}
+			LRU_DQ_SAFE(lru, q);
+			glist_add_tail(&q->q, &lru->q);
+			++(q->size);
 			break;
 		default:
 			/* do nothing */
@@ -1544,4 +2048,66 @@ lru_wake_thread(void)
 	fridgethr_wake(lru_fridge);
 }
 
+/**
+ * @brief Put a newly read directory chunk on the chunk LRU
+ *
+ * Wakes the LRU thread when this takes the chunks over
+ * Chunks_HWMark.  The directory's content lock is held.
+ *
+ * @param[in] chunk The chunk
+ */
+
+void
+cache_inode_lru_chunk_insert(struct cache_inode_dir_chunk *chunk)
+{
+	bool wake;
+
+	pthread_mutex_lock(&lru_chunks.mtx);
+	glist_add(&lru_chunks.q, &chunk->lru);
+	wake = ++lru_state.chunks_used == lru_state.chunks_hiwat + 1;
+	pthread_mutex_unlock(&lru_chunks.mtx);
+
+	if (wake)
+		lru_wake_thread();
+}
+
+/**
+ * @brief Make a directory chunk the most recently read
+ *
+ * The directory's content lock is held.
+ *
+ * @param[in] chunk The chunk
+ */
+
+void
+cache_inode_lru_chunk_ref(struct cache_inode_dir_chunk *chunk)
+{
+	pthread_mutex_lock(&lru_chunks.mtx);
+	if (!glist_null(&chunk->lru)) {
+		glist_del(&chunk->lru);
+		glist_add(&lru_chunks.q, &chunk->lru);
+	}
+	pthread_mutex_unlock(&lru_chunks.mtx);
+}
+
+/**
+ * @brief Take a directory chunk off the chunk LRU
+ *
+ * Does nothing if the LRU thread already took it.  The directory's
+ * content lock is held for write.
+ *
+ * @param[in] chunk The chunk
+ */
+
+void
+cache_inode_lru_chunk_remove(struct cache_inode_dir_chunk *chunk)
+{
+	pthread_mutex_lock(&lru_chunks.mtx);
+	if (!glist_null(&chunk->lru)) {
+		glist_del(&chunk->lru);
+		--lru_state.chunks_used;
+	}
+	pthread_mutex_unlock(&lru_chunks.mtx);
+}
+
 /** @} */
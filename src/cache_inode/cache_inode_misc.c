@@ -55,6 +55,21 @@
 
 pool_t *cache_inode_entry_pool;
 
+/**
+ * @brief State block of entries that were never pinned
+ *
+ * Its lists stay empty, so it can be walked like any other.
+ */
+struct cache_inode_state_data cache_inode_no_state = {
+	.state_list = GLIST_HEAD_INIT(cache_inode_no_state.state_list),
+	.layoutrecall_list =
+		GLIST_HEAD_INIT(cache_inode_no_state.layoutrecall_list),
+	.lock_list = GLIST_HEAD_INIT(cache_inode_no_state.lock_list),
+	.deleg_list = GLIST_HEAD_INIT(cache_inode_no_state.deleg_list),
+	.nlm_share_list =
+		GLIST_HEAD_INIT(cache_inode_no_state.nlm_share_list),
+};
+
 const char *
 cache_inode_err_str(cache_inode_status_t err)
 {
@@ -290,9 +305,7 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 	/* Initialize common fields */
 	nentry->type = new_obj->type;
 	nentry->flags = 0;
-	glist_init(&nentry->state_list);
 	glist_init(&nentry->export_list);
-	glist_init(&nentry->layoutrecall_list);
 
 	/* See if someone raced us. */
 	oentry =
@@ -335,12 +348,8 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 			 "Adding a REGULAR_FILE, entry=%p", nentry);
 
 		/* No shares or locks, yet. */
-		glist_init(&nentry->object.file.deleg_list);
-		glist_init(&nentry->object.file.lock_list);
-		glist_init(&nentry->object.file.nlm_share_list);
 		memset(&nentry->object.file.share_state, 0,
 		       sizeof(cache_inode_share_t));
-		nentry->object.file.write_delegated = false;
 
 		/* Init statistics used for intelligently granting delegations*/
 		init_deleg_heuristics(nentry);
@@ -363,8 +372,9 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 						   CACHE_INODE_DIR_POPULATED);
 		}
 
-		nentry->object.dir.avl.collisions = 0;
+		nentry->object.dir.collisions = 0;
 		nentry->object.dir.nbactive = 0;
+		nentry->object.dir.chunks = NULL;
 		glist_init(&nentry->object.dir.export_roots);
 		/* init avl tree */
 		cache_inode_avl_init(nentry);
@@ -416,6 +426,15 @@ cache_inode_new_entry(struct fsal_obj_handle *new_obj,
 		goto out;
 	}
 
+	/* The FSAL's private handle is at least an obj_handle and its
+	 * wire handle */
+	cache_inode_lru_charge(nentry, sizeof(cache_entry_t) +
+			       nentry->fh_hk.key.kv.len +
+			       sizeof(struct fsal_obj_handle) + fh_desc.len);
+
+	/* Promote it if it was reclaimed recently */
+	cache_inode_lru_admit(nentry);
+
 	/* Map this new entry and the active export */
 	if (!check_mapping(nentry, op_ctx->export)) {
 		LogCrit(COMPONENT_CACHE_INODE,
@@ -575,6 +594,7 @@ void cache_inode_unexport(struct gsh_export *export)
 		if (expmap == NULL) {
 			/* Clear out first export pointer */
 			atomic_store_voidptr(&entry->first_export, NULL);
+			cache_inode_lru_charge_export(entry, -1);
 			/* We must not hold entry->attr_lock across
 			 * try_cleanup_push (LRU lane lock order) */
 			PTHREAD_RWLOCK_unlock(&export->lock);
@@ -588,6 +608,8 @@ void cache_inode_unexport(struct gsh_export *export)
 			/* Make sure first export pointer is still valid */
 			atomic_store_voidptr(&entry->first_export,
 					     expmap->export);
+			cache_inode_lru_charge_export(entry,
+						      expmap->export->export_id);
 
 			PTHREAD_RWLOCK_unlock(&export->lock);
 			PTHREAD_RWLOCK_unlock(&entry->attr_lock);
@@ -813,6 +835,8 @@ cache_inode_release_dirents(cache_entry_t *entry,
 
 	switch (which) {
 	case CACHE_INODE_AVL_NAMES:
+		/* chunked dirents are released with their chunks */
+		cache_inode_release_dir_chunks(entry);
 		tree = &entry->object.dir.avl.t;
 		break;
 
@@ -841,6 +865,9 @@ cache_inode_release_dirents(cache_entry_t *entry,
 						 cache_inode_dir_entry_t,
 						 node_hk);
 			avltree_remove(dirent_node, tree);
+			cache_inode_lru_charge(
+				entry,
+				-(int64_t) cache_inode_dirent_bytes(dirent));
 			if (dirent->ckey.kv.len)
 				cache_inode_key_delete(&dirent->ckey);
 			gsh_free(dirent);
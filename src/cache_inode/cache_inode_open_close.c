@@ -176,6 +176,7 @@ cache_inode_open(cache_entry_t *entry,
 		 * of closing and opening the file again. This avoids
 		 * losing any lock state due to closing the file!
 		 */
+		cache_inode_io_drain(entry);
 		fsal_export = op_ctx->fsal_export;
 		if (fsal_export->ops->fs_supports(fsal_export,
 						  fso_reopen_method)) {
@@ -301,6 +302,7 @@ cache_inode_close(cache_entry_t *entry, uint32_t flags)
 	    || (flags & CACHE_INODE_FLAG_REALLYCLOSE)
 	    || (entry->obj_handle->attributes.numlinks == 0)) {
 		LogFullDebug(COMPONENT_CACHE_INODE, "Closing entry %p", entry);
+		cache_inode_io_drain(entry);
 		fsal_status = entry->obj_handle->ops->close(entry->obj_handle);
 		if (FSAL_IS_ERROR(fsal_status)
 		    && (fsal_status.major != ERR_FSAL_NOT_OPENED)) {
@@ -365,7 +367,7 @@ void cache_inode_adjust_openflags(cache_entry_t *entry)
 	 * downgrade!
 	 */
 	if (entry->object.file.share_state.share_access_write > 0 ||
-	    entry->object.file.write_delegated ||
+	    entry->state_data->write_delegated ||
 	    !fsal_export->ops->fs_supports(fsal_export, fso_reopen_method))
 		return;
 
@@ -387,6 +389,7 @@ void cache_inode_adjust_openflags(cache_entry_t *entry)
 		goto unlock;
 
 	openflags &= ~FSAL_O_WRITE;
+	cache_inode_io_drain(entry);
 	fsal_status = obj_hdl->ops->reopen(obj_hdl, openflags);
 	if (FSAL_IS_ERROR(fsal_status)) {
 		LogWarn(COMPONENT_CACHE_INODE,
@@ -44,6 +44,7 @@
 #include "nfs_core.h"
 #include "nfs_exports.h"
 #include "export_mgr.h"
+#include "abstract_atomic.h"
 
 #include <unistd.h>
 #include <sys/types.h>
@@ -53,6 +54,254 @@
 #include <pthread.h>
 #include <assert.h>
 
+/**
+ * @brief Serializes waiting for asynchronous I/O to drain
+ *
+ * Waiters are rare (closing or reopening a file with I/O in flight),
+ * so all entries share one condition.
+ */
+static pthread_mutex_t io_drain_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t io_drain_cv = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Wait for the asynchronous I/O on a file to complete
+ *
+ * Called, with the content lock held for write, before the FSAL file
+ * is closed or reopened.  Holding the content lock keeps new I/O from
+ * starting.
+ *
+ * @param[in] entry The file
+ */
+
+void cache_inode_io_drain(cache_entry_t *entry)
+{
+	if (atomic_fetch_uint32_t(&entry->object.file.io_inflight) == 0)
+		return;
+
+	pthread_mutex_lock(&io_drain_mtx);
+	while (atomic_fetch_uint32_t(&entry->object.file.io_inflight) != 0)
+		pthread_cond_wait(&io_drain_cv, &io_drain_mtx);
+	pthread_mutex_unlock(&io_drain_mtx);
+}
+
+/**
+ * @brief Drop the in flight count of a completed asynchronous I/O
+ *
+ * @param[in] entry The file
+ */
+
+static void cache_inode_io_unpin(cache_entry_t *entry)
+{
+	if (atomic_dec_uint32_t(&entry->object.file.io_inflight) != 0)
+		return;
+
+	pthread_mutex_lock(&io_drain_mtx);
+	pthread_cond_broadcast(&io_drain_cv);
+	pthread_mutex_unlock(&io_drain_mtx);
+}
+
+/**
+ * @brief Compute the open mode needed for an I/O
+ *
+ * @param[in]     io_direction Whether this is a read or a write
+ * @param[in,out] sync         Whether a write must be stable, forced
+ *                             on for exports with the COMMIT option
+ *
+ * @return The open flags.
+ */
+
+static fsal_openflags_t
+cache_inode_rdwr_openflags(cache_inode_io_direction_t io_direction,
+			   bool *sync)
+{
+	fsal_openflags_t openflags;
+
+	if (io_direction == CACHE_INODE_READ ||
+	    io_direction == CACHE_INODE_READ_PLUS)
+		return FSAL_O_READ;
+
+	/* Pretent that the caller requested sync (stable write)
+	 * if the export has COMMIT option. Note that
+	 * FSAL_O_SYNC is not always honored, so just setting
+	 * FSAL_O_SYNC has no guaranty that this write will be
+	 * a stable write.
+	 */
+	if (op_ctx->export->export_perms.options & EXPORT_OPTION_COMMIT)
+		*sync = true;
+	openflags = FSAL_O_WRITE;
+	if (*sync)
+		openflags |= FSAL_O_SYNC;
+
+	return openflags;
+}
+
+/**
+ * @brief Make sure a file is open in a mode suitable for an I/O
+ *
+ * We need a write lock only if we need to open or close a file
+ * descriptor.
+ *
+ * @param[in]  entry     The file
+ * @param[in]  openflags Mode needed
+ * @param[out] opened    Whether we opened a previously closed file
+ *
+ * @return CACHE_INODE_SUCCESS, with the content lock held for read,
+ *         or errors, with the content lock released.
+ */
+
+static cache_inode_status_t
+cache_inode_rdwr_open(cache_entry_t *entry, fsal_openflags_t openflags,
+		      bool *opened)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	fsal_openflags_t loflags;
+	cache_inode_status_t status;
+
+	*opened = false;
+
+	PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+	loflags = obj_hdl->ops->status(obj_hdl);
+	while ((!is_open(entry))
+	       || (loflags && loflags != FSAL_O_RDWR && loflags != openflags)) {
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+		loflags = obj_hdl->ops->status(obj_hdl);
+		if ((!is_open(entry))
+		    || (loflags && loflags != FSAL_O_RDWR
+			&& loflags != openflags)) {
+			status =
+			    cache_inode_open(entry, openflags,
+					     (CACHE_INODE_FLAG_CONTENT_HAVE |
+					      CACHE_INODE_FLAG_CONTENT_HOLD));
+			if (status != CACHE_INODE_SUCCESS) {
+				PTHREAD_RWLOCK_unlock(&entry->content_lock);
+				return status;
+			}
+			*opened = true;
+		}
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+		loflags = obj_hdl->ops->status(obj_hdl);
+	}
+
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Handle an FSAL I/O error
+ *
+ * Kills the entry on ESTALE, and closes the file on other errors.
+ * Called with the content lock held, which is returned held (for
+ * read or write).
+ *
+ * @param[in] entry       The file
+ * @param[in] fsal_status The FSAL error
+ *
+ * @return The cache_inode error.
+ */
+
+static cache_inode_status_t
+cache_inode_rdwr_error(cache_entry_t *entry, fsal_status_t fsal_status)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	cache_inode_status_t status;
+	cache_inode_status_t cstatus;
+
+	if (fsal_status.major == ERR_FSAL_DELAY) {
+		LogEvent(COMPONENT_CACHE_INODE,
+			 "cache_inode_rdwr: FSAL_write "
+			 " returned EBUSY");
+	} else {
+		LogDebug(COMPONENT_CACHE_INODE,
+			 "cache_inode_rdwr: fsal_status.major = %d",
+			 fsal_status.major);
+	}
+
+	status = cache_inode_error_convert(fsal_status);
+
+	if (fsal_status.major == ERR_FSAL_STALE) {
+		cache_inode_kill_entry(entry);
+		return status;
+	}
+
+	if ((fsal_status.major != ERR_FSAL_NOT_OPENED)
+	    && (obj_hdl->ops->status(obj_hdl) != FSAL_O_CLOSED)) {
+		LogFullDebug(COMPONENT_CACHE_INODE,
+			     "cache_inode_rdwr: CLOSING entry %p",
+			     entry);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+
+		cstatus =
+		    cache_inode_close(entry,
+				      (CACHE_INODE_FLAG_REALLYCLOSE |
+				       CACHE_INODE_FLAG_CONTENT_HAVE |
+				       CACHE_INODE_FLAG_CONTENT_HOLD));
+
+		if (cstatus != CACHE_INODE_SUCCESS) {
+			LogCrit(COMPONENT_CACHE_INODE,
+				"Error closing file in cache_inode_rdwr: %d.",
+				cstatus);
+		}
+	}
+
+	return status;
+}
+
+/**
+ * @brief Finish a successful I/O
+ *
+ * Closes the file if the I/O opened it and updates the attributes.
+ * Called with the content lock held for read, which is released.
+ *
+ * @param[in] entry        The file
+ * @param[in] io_direction Whether this was a read or a write
+ * @param[in] opened       Whether the I/O opened the file
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+
+static cache_inode_status_t
+cache_inode_rdwr_done(cache_entry_t *entry,
+		      cache_inode_io_direction_t io_direction,
+		      bool opened)
+{
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	cache_inode_status_t status;
+
+	if (opened) {
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
+		status =
+		    cache_inode_close(entry,
+				      CACHE_INODE_FLAG_CONTENT_HAVE |
+				      CACHE_INODE_FLAG_CONTENT_HOLD);
+		if (status != CACHE_INODE_SUCCESS) {
+			LogEvent(COMPONENT_CACHE_INODE,
+				 "cache_inode_rdwr: cache_inode_close = %d",
+				 status);
+			PTHREAD_RWLOCK_unlock(&entry->content_lock);
+			return status;
+		}
+	}
+
+	PTHREAD_RWLOCK_unlock(&entry->content_lock);
+
+	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
+	if (io_direction == CACHE_INODE_WRITE ||
+	    io_direction == CACHE_INODE_WRITE_PLUS) {
+		status = cache_inode_refresh_attrs(entry);
+		if (status != CACHE_INODE_SUCCESS) {
+			PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+			return status;
+		}
+	} else
+		cache_inode_set_time_current(&obj_hdl->attributes.atime);
+	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
+
+	return CACHE_INODE_SUCCESS;
+}
+
 /**
  * @brief Reads/Writes through the cache layer
  *
@@ -86,73 +335,27 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
 	/* Required open mode to successfully read or write */
 	fsal_openflags_t openflags = FSAL_O_CLOSED;
-	fsal_openflags_t loflags;
-	/* True if we have taken the content lock on 'entry' */
-	bool content_locked = false;
-	/* True if we have taken the attribute lock on 'entry' */
-	bool attributes_locked = false;
 	/* TRUE if we opened a previously closed FD */
 	bool opened = false;
 
 	cache_inode_status_t status = CACHE_INODE_SUCCESS;
 
-	/* Set flags for a read or write, as appropriate */
-	if (io_direction == CACHE_INODE_READ ||
-	    io_direction == CACHE_INODE_READ_PLUS) {
-		openflags = FSAL_O_READ;
-	} else {
-		struct export_perms *perms;
-
-		/* Pretent that the caller requested sync (stable write)
-		 * if the export has COMMIT option. Note that
-		 * FSAL_O_SYNC is not always honored, so just setting
-		 * FSAL_O_SYNC has no guaranty that this write will be
-		 * a stable write.
-		 */
-		perms = &op_ctx->export->export_perms;
-		if (perms->options & EXPORT_OPTION_COMMIT)
-			*sync = true;
-		openflags = FSAL_O_WRITE;
-		if (*sync)
-			openflags |= FSAL_O_SYNC;
-	}
-
 	assert(obj_hdl != NULL);
 
 	/* IO is done only on REGULAR_FILEs */
 	if (entry->type != REGULAR_FILE) {
-		status =
-		    entry->type ==
+		return entry->type ==
 		    DIRECTORY ? CACHE_INODE_IS_A_DIRECTORY :
 		    CACHE_INODE_BAD_TYPE;
-		goto out;
 	}
 
-	/* Write through the FSAL.  We need a write lock only if we need
-	   to open or close a file descriptor. */
-	PTHREAD_RWLOCK_rdlock(&entry->content_lock);
-	content_locked = true;
-	loflags = obj_hdl->ops->status(obj_hdl);
-	while ((!is_open(entry))
-	       || (loflags && loflags != FSAL_O_RDWR && loflags != openflags)) {
-		PTHREAD_RWLOCK_unlock(&entry->content_lock);
-		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
-		loflags = obj_hdl->ops->status(obj_hdl);
-		if ((!is_open(entry))
-		    || (loflags && loflags != FSAL_O_RDWR
-			&& loflags != openflags)) {
-			status =
-			    cache_inode_open(entry, openflags,
-					     (CACHE_INODE_FLAG_CONTENT_HAVE |
-					      CACHE_INODE_FLAG_CONTENT_HOLD));
-			if (status != CACHE_INODE_SUCCESS)
-				goto out;
-			opened = true;
-		}
-		PTHREAD_RWLOCK_unlock(&entry->content_lock);
-		PTHREAD_RWLOCK_rdlock(&entry->content_lock);
-		loflags = obj_hdl->ops->status(obj_hdl);
-	}
+	/* Set flags for a read or write, as appropriate */
+	openflags = cache_inode_rdwr_openflags(io_direction, sync);
+
+	/* Write through the FSAL. */
+	status = cache_inode_rdwr_open(entry, openflags, &opened);
+	if (status != CACHE_INODE_SUCCESS)
+		return status;
 
 	/* Call FSAL_read or FSAL_write */
 	if (io_direction == CACHE_INODE_READ) {
@@ -195,48 +398,10 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 		     fsal_status.major, io_size, *bytes_moved);
 
 	if (FSAL_IS_ERROR(fsal_status)) {
-		if (fsal_status.major == ERR_FSAL_DELAY) {
-			LogEvent(COMPONENT_CACHE_INODE,
-				 "cache_inode_rdwr: FSAL_write "
-				 " returned EBUSY");
-		} else {
-			LogDebug(COMPONENT_CACHE_INODE,
-				 "cache_inode_rdwr: fsal_status.major = %d",
-				 fsal_status.major);
-		}
-
 		*bytes_moved = 0;
-		status = cache_inode_error_convert(fsal_status);
-
-		if (fsal_status.major == ERR_FSAL_STALE) {
-			cache_inode_kill_entry(entry);
-			goto out;
-		}
-
-		if ((fsal_status.major != ERR_FSAL_NOT_OPENED)
-		    && (obj_hdl->ops->status(obj_hdl) != FSAL_O_CLOSED)) {
-			cache_inode_status_t cstatus;
-
-			LogFullDebug(COMPONENT_CACHE_INODE,
-				     "cache_inode_rdwr: CLOSING entry %p",
-				     entry);
-			PTHREAD_RWLOCK_unlock(&entry->content_lock);
-			PTHREAD_RWLOCK_wrlock(&entry->content_lock);
-
-			cstatus =
-			    cache_inode_close(entry,
-					      (CACHE_INODE_FLAG_REALLYCLOSE |
-					       CACHE_INODE_FLAG_CONTENT_HAVE |
-					       CACHE_INODE_FLAG_CONTENT_HOLD));
-
-			if (cstatus != CACHE_INODE_SUCCESS) {
-				LogCrit(COMPONENT_CACHE_INODE,
-					"Error closing file in cache_inode_rdwr: %d.",
-					cstatus);
-			}
-		}
-
-		goto out;
+		status = cache_inode_rdwr_error(entry, fsal_status);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+		return status;
 	}
 
 	LogFullDebug(COMPONENT_CACHE_INODE,
@@ -244,53 +409,203 @@ cache_inode_rdwr_plus(cache_entry_t *entry,
 		     "bytes_moved=%zu, offset=%" PRIu64, io_size, *bytes_moved,
 		     offset);
 
-	if (opened) {
-		PTHREAD_RWLOCK_unlock(&entry->content_lock);
-		PTHREAD_RWLOCK_wrlock(&entry->content_lock);
-		status =
-		    cache_inode_close(entry,
-				      CACHE_INODE_FLAG_CONTENT_HAVE |
-				      CACHE_INODE_FLAG_CONTENT_HOLD);
-		if (status != CACHE_INODE_SUCCESS) {
-			LogEvent(COMPONENT_CACHE_INODE,
-				 "cache_inode_rdwr: cache_inode_close = %d",
-				 status);
-			goto out;
+	return cache_inode_rdwr_done(entry, io_direction, opened);
+}
+
+/**
+ * @brief Completion of the commit following an unstable write
+ *
+ * @param[in] obj_hdl    The file
+ * @param[in] ret        Result of the commit
+ * @param[in] caller_arg The I/O
+ */
+
+static void cache_inode_commit_done(struct fsal_obj_handle *obj_hdl,
+				    fsal_status_t ret, void *caller_arg)
+{
+	struct cache_inode_io *io = caller_arg;
+
+	io->fsal.fsal_stable = !FSAL_IS_ERROR(ret);
+	io->fsal_status = ret;
+	cache_inode_io_unpin(io->entry);
+	io->done_cb(io, io->caller_arg);
+}
+
+/**
+ * @brief Completion of an asynchronous FSAL read or write
+ *
+ * A write that had to be stable but was not is followed by a commit,
+ * which reports the completion instead.  If the FSAL cannot commit
+ * asynchronously, the commit is not done here, on what may be the
+ * FSAL's completion thread, but by cache_inode_rdwr_finish; the file
+ * stays pinned open until then.
+ *
+ * @param[in] obj_hdl    The file
+ * @param[in] ret        Result of the I/O
+ * @param[in] caller_arg The I/O
+ */
+
+static void cache_inode_io_done(struct fsal_obj_handle *obj_hdl,
+				fsal_status_t ret, void *caller_arg)
+{
+	struct cache_inode_io *io = caller_arg;
+
+	if (io->need_commit && !io->fsal.fsal_stable && !FSAL_IS_ERROR(ret)) {
+		ret = obj_hdl->ops->commit_async(obj_hdl, io->fsal.offset,
+						 io->fsal.io_size,
+						 cache_inode_commit_done, io);
+		if (!FSAL_IS_ERROR(ret))
+			return;
+		if (ret.major == ERR_FSAL_NOTSUPP) {
+			io->commit_deferred = true;
+			io->fsal_status = fsalstat(ERR_FSAL_NO_ERROR, 0);
+			io->done_cb(io, io->caller_arg);
+			return;
 		}
 	}
 
-	if (content_locked) {
-		PTHREAD_RWLOCK_unlock(&entry->content_lock);
-		content_locked = false;
+	io->fsal_status = ret;
+	cache_inode_io_unpin(io->entry);
+	io->done_cb(io, io->caller_arg);
+}
+
+/**
+ * @brief Start a read or write through the cache layer
+ *
+ * This is the asynchronous version of cache_inode_rdwr_plus.  The
+ * file is opened if needed, then the FSAL I/O is started and the
+ * content lock released; the file is kept from being closed until
+ * the I/O completes.  The caller MUST NOT hold either the content or
+ * attribute locks when calling this function.
+ *
+ * If this returns CACHE_INODE_SUCCESS, @a done_cb is called exactly
+ * once, either before this returns or from an FSAL thread, and the
+ * caller must then call cache_inode_rdwr_finish.  Otherwise @a done_cb
+ * is never called and the I/O is over.
+ *
+ * FSALs without asynchronous I/O do the I/O synchronously, and call
+ * @a done_cb, before this returns.
+ *
+ * @param[in,out] io         The I/O, see struct cache_inode_io
+ * @param[in]     done_cb    Completion callback
+ * @param[in]     caller_arg Argument of the completion callback
+ *
+ * @return CACHE_INODE_SUCCESS if the I/O was started, errors otherwise.
+ */
+
+cache_inode_status_t cache_inode_rdwr_async(struct cache_inode_io *io,
+					    cache_inode_io_cb done_cb,
+					    void *caller_arg)
+{
+	cache_entry_t *entry = io->entry;
+	struct fsal_obj_handle *obj_hdl = entry->obj_handle;
+	fsal_openflags_t openflags;
+	fsal_status_t fsal_status;
+	cache_inode_status_t status;
+	bool writing = io->io_direction == CACHE_INODE_WRITE
+		       || io->io_direction == CACHE_INODE_WRITE_PLUS;
+
+	assert(obj_hdl != NULL);
+
+	io->fsal.io_amount = 0;
+	io->fsal.end_of_file = false;
+
+	/* IO is done only on REGULAR_FILEs */
+	if (entry->type != REGULAR_FILE) {
+		return entry->type ==
+		    DIRECTORY ? CACHE_INODE_IS_A_DIRECTORY :
+		    CACHE_INODE_BAD_TYPE;
 	}
 
-	PTHREAD_RWLOCK_wrlock(&entry->attr_lock);
-	attributes_locked = true;
-	if (io_direction == CACHE_INODE_WRITE ||
-	    io_direction == CACHE_INODE_WRITE_PLUS) {
-		status = cache_inode_refresh_attrs(entry);
-		if (status != CACHE_INODE_SUCCESS)
-			goto out;
-	} else
-		cache_inode_set_time_current(&obj_hdl->attributes.atime);
-	PTHREAD_RWLOCK_unlock(&entry->attr_lock);
-	attributes_locked = false;
+	openflags = cache_inode_rdwr_openflags(io->io_direction, &io->sync);
+
+	status = cache_inode_rdwr_open(entry, openflags, &io->opened);
+	if (status != CACHE_INODE_SUCCESS)
+		return status;
+
+	io->done_cb = done_cb;
+	io->caller_arg = caller_arg;
+	io->commit_deferred = false;
+	io->fsal.fsal_stable = writing && io->sync;
+	io->need_commit = writing && io->sync
+	    && !(obj_hdl->ops->status(obj_hdl) & FSAL_O_SYNC);
+	if (io->io_direction == CACHE_INODE_READ
+	    || io->io_direction == CACHE_INODE_WRITE)
+		io->fsal.info = NULL;
+
+	/* keep the file open across the I/O without holding the
+	 * content lock */
+	atomic_inc_uint32_t(&entry->object.file.io_inflight);
+	PTHREAD_RWLOCK_unlock(&entry->content_lock);
+
+	if (writing)
+		fsal_status = obj_hdl->ops->write_async(obj_hdl, &io->fsal,
+							cache_inode_io_done,
+							io);
+	else
+		fsal_status = obj_hdl->ops->read_async(obj_hdl, &io->fsal,
+						       cache_inode_io_done,
+						       io);
 
-	status = CACHE_INODE_SUCCESS;
+	if (FSAL_IS_ERROR(fsal_status)) {
+		/* never started, the callback will not be called */
+		cache_inode_io_unpin(entry);
+		io->fsal_status = fsal_status;
+		return cache_inode_rdwr_finish(io);
+	}
 
- out:
+	return CACHE_INODE_SUCCESS;
+}
 
-	if (content_locked) {
-		PTHREAD_RWLOCK_unlock(&entry->content_lock);
-		content_locked = false;
+/**
+ * @brief Complete an asynchronous read or write
+ *
+ * Called, with op_ctx set, after the completion callback of
+ * cache_inode_rdwr_async.  The amount of data moved is in
+ * io->fsal.io_amount, end of file in io->fsal.end_of_file and whether
+ * a write is stable in io->sync.  A commit the FSAL could not start
+ * asynchronously is done here.
+ *
+ * @param[in,out] io The I/O
+ *
+ * @return CACHE_INODE_SUCCESS or various errors
+ */
+
+cache_inode_status_t cache_inode_rdwr_finish(struct cache_inode_io *io)
+{
+	cache_entry_t *entry = io->entry;
+	cache_inode_status_t status;
+
+	LogFullDebug(COMPONENT_FSAL,
+		     "cache_inode_rdwr: FSAL async IO operation returned "
+		     "%d, asked_size=%zu, effective_size=%zu",
+		     io->fsal_status.major, io->fsal.io_size,
+		     io->fsal.io_amount);
+
+	if (io->commit_deferred) {
+		/* still pinned, so without the content lock, which a
+		 * close waiting for the pin would be holding */
+		io->fsal_status = entry->obj_handle->ops->commit(
+			entry->obj_handle, io->fsal.offset, io->fsal.io_size);
+		io->fsal.fsal_stable = !FSAL_IS_ERROR(io->fsal_status);
+		io->commit_deferred = false;
+		cache_inode_io_unpin(entry);
 	}
 
-	if (attributes_locked) {
-		PTHREAD_RWLOCK_unlock(&entry->attr_lock);
-		attributes_locked = false;
+	PTHREAD_RWLOCK_rdlock(&entry->content_lock);
+
+	if (FSAL_IS_ERROR(io->fsal_status)) {
+		io->fsal.io_amount = 0;
+		status = cache_inode_rdwr_error(entry, io->fsal_status);
+		PTHREAD_RWLOCK_unlock(&entry->content_lock);
+		return status;
 	}
 
-	return status;
+	if (io->io_direction == CACHE_INODE_WRITE
+	    || io->io_direction == CACHE_INODE_WRITE_PLUS)
+		io->sync = io->fsal.fsal_stable;
+
+	return cache_inode_rdwr_done(entry, io->io_direction, io->opened);
 }
 
 cache_inode_status_t
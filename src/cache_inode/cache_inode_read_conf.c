@@ -61,6 +61,8 @@ static struct config_item cache_inode_params[] = {
 		       cache_inode_parameter, getattr_dir_invalidation),
 	CONF_ITEM_UI32("Entries_HWMark", 1, UINT32_MAX, 100000,
 		       cache_inode_parameter, entries_hwmark),
+	CONF_ITEM_UI64("Entries_Bytes_HWMark", 0, UINT64_MAX, 0,
+		       cache_inode_parameter, entries_bytes_hwmark),
 	CONF_ITEM_UI32("LRU_Run_Interval", 1, 24 * 3600, 90,
 		       cache_inode_parameter, lru_run_interval),
 	CONF_ITEM_BOOL("Cache_FDs", true,
@@ -81,6 +83,10 @@ static struct config_item cache_inode_params[] = {
 		       cache_inode_parameter, futility_count),
 	CONF_ITEM_BOOL("Retry_Readdir", false,
 		       cache_inode_parameter, retry_readdir),
+	CONF_ITEM_UI32("Dir_Chunk", 0, UINT32_MAX, 128,
+		       cache_inode_parameter, dir_chunk),
+	CONF_ITEM_UI32("Chunks_HWMark", 1, UINT32_MAX, 1000,
+		       cache_inode_parameter, chunks_hwmark),
 	CONFIG_EOL
 };
 
@@ -196,9 +196,7 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 				/* overwrite, replace entry and expire the
 				 * old */
 				cache_entry_t *oldentry;
-				avl_dirent_set_deleted(directory, dirent);
-				cache_inode_key_dup(&dirent2->ckey,
-						    &dirent->ckey);
+
 				oldentry =
 				    cache_inode_get_keyed(
 					    &dirent2->ckey,
@@ -214,6 +212,17 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 					cache_inode_lru_unref(oldentry,
 							      LRU_FLAG_NONE);
 				}
+				/* newname now names what name did */
+				cache_inode_lru_charge(
+					directory,
+					-(int64_t) dirent2->ckey.kv.len);
+				cache_inode_key_delete(&dirent2->ckey);
+				cache_inode_key_dup(&dirent2->ckey,
+						    &dirent->ckey);
+				cache_inode_lru_charge(directory,
+						       dirent2->ckey.kv.len);
+				avl_dirent_set_deleted(directory, dirent);
+				directory->object.dir.nbactive--;
 			} else
 				status = CACHE_INODE_ENTRY_EXISTS;
 		} else {
@@ -224,6 +233,7 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 					     + newnamesize);
 			memcpy(dirent3->name, newname, newnamesize);
 			dirent3->flags = DIR_ENTRY_FLAG_NONE;
+			dirent3->chunk = NULL;
 			cache_inode_key_dup(&dirent3->ckey, &dirent->ckey);
 			avl_dirent_set_deleted(directory, dirent);
 			code = cache_inode_avl_qp_insert(directory, dirent3);
@@ -234,6 +244,10 @@ cache_inode_operate_cached_dirent(cache_entry_t *directory,
 				avl_dirent_clear_deleted(directory, dirent);
 				/* dirent3 was never inserted */
 				gsh_free(dirent3);
+			} else {
+				cache_inode_lru_charge(
+					directory,
+					cache_inode_dirent_bytes(dirent3));
 			}
 		}		/* !found */
 		break;
@@ -290,6 +304,7 @@ cache_inode_add_cached_dirent(cache_entry_t *parent,
 	}
 
 	new_dir_entry->flags = DIR_ENTRY_FLAG_NONE;
+	new_dir_entry->chunk = NULL;
 
 	memcpy(&new_dir_entry->name, name, namesize);
 	cache_inode_key_dup(&new_dir_entry->ckey, &entry->fh_hk.key);
@@ -310,6 +325,7 @@ cache_inode_add_cached_dirent(cache_entry_t *parent,
 
 	/* we're going to succeed */
 	parent->object.dir.nbactive++;
+	cache_inode_lru_charge(parent, cache_inode_dirent_bytes(new_dir_entry));
 
 	return status;
 }
@@ -358,69 +374,118 @@ struct cache_inode_populate_cb_state {
 };
 
 /**
- * @brief Populate a single dir entry
+ * @brief Release a handle passed to a readdir_plus callback
  *
- * This callback serves to populate a single dir entry from the
- * readdir.
+ * @param[in] entry_hdl The handle, may be NULL
+ */
+
+static inline void
+readdir_release_hdl(struct fsal_obj_handle *entry_hdl)
+{
+	if (entry_hdl != NULL)
+		entry_hdl->ops->release(entry_hdl);
+}
+
+/**
+ * @brief Cache the entry for a name being read
  *
- * @param[in]     name      Name of the directory entry
- * @param[in,out] dir_state Callback state
- * @param[in]     cookie    Directory cookie
+ * @param[in]  directory   The directory being read
+ * @param[in]  name        Name of the directory entry
+ * @param[in]  entry_hdl   Handle readdir_plus found for the name,
+ *                         consumed
+ * @param[in]  fsal_status Why readdir_plus found no handle
+ * @param[out] entry       The entry with a reference, NULL if the name
+ *                         is to be skipped
+ * @param[out] status      Why the entry was not found
  *
  * @retval true if more entries are requested
- * @retval false if no more should be sent and the last was not processed
+ * @retval false if the read should stop
  */
 
 static bool
-populate_dirent(const char *name, void *dir_state,
-		fsal_cookie_t cookie)
+readdir_lookup_entry(cache_entry_t *directory, const char *name,
+		     struct fsal_obj_handle *entry_hdl,
+		     fsal_status_t fsal_status,
+		     cache_entry_t **entry, cache_inode_status_t *status)
 {
-	struct cache_inode_populate_cb_state *state =
-	    (struct cache_inode_populate_cb_state *)dir_state;
-	struct fsal_obj_handle *entry_hdl;
-	cache_inode_dir_entry_t *new_dir_entry = NULL;
-	cache_entry_t *cache_entry = NULL;
-	fsal_status_t fsal_status = { 0, 0 };
-	struct fsal_obj_handle *dir_hdl = state->directory->obj_handle;
+	struct fsal_obj_handle *dir_hdl = directory->obj_handle;
 
-	fsal_status = dir_hdl->ops->lookup(dir_hdl, name, &entry_hdl);
-	if (FSAL_IS_ERROR(fsal_status)) {
-		*state->status = cache_inode_error_convert(fsal_status);
-		if (*state->status == CACHE_INODE_FSAL_XDEV) {
+	*entry = NULL;
+
+	if (entry_hdl == NULL) {
+		if (!FSAL_IS_ERROR(fsal_status))
+			fsal_status = fsalstat(ERR_FSAL_SERVERFAULT, 0);
+		*status = cache_inode_error_convert(fsal_status);
+		if (*status == CACHE_INODE_FSAL_XDEV) {
 			LogInfo(COMPONENT_NFS_READDIR,
 				"Ignoring XDEV entry %s",
 				name);
-			*state->status = CACHE_INODE_SUCCESS;
+			*status = CACHE_INODE_SUCCESS;
 			return true;
 		}
 		LogInfo(COMPONENT_CACHE_INODE,
 			"Lookup failed on %s in dir %p with %s",
-			name, dir_hdl, cache_inode_err_str(*state->status));
+			name, dir_hdl, cache_inode_err_str(*status));
 		return !cache_param.retry_readdir;
 	}
 
 	LogFullDebug(COMPONENT_NFS_READDIR, "Creating entry for %s", name);
 
-	*state->status =
-	    cache_inode_new_entry(entry_hdl, CACHE_INODE_FLAG_NONE,
-				  &cache_entry);
+	*status = cache_inode_new_entry(entry_hdl, CACHE_INODE_FLAG_NONE,
+					entry);
 
-	if (cache_entry == NULL) {
-		*state->status = CACHE_INODE_NOT_FOUND;
+	if (*entry == NULL) {
+		*status = CACHE_INODE_NOT_FOUND;
 		/* we do not free entry_hdl because it is consumed by
 		   cache_inode_new_entry */
 		LogEvent(COMPONENT_NFS_READDIR,
 			 "cache_inode_new_entry failed with %s",
-			 cache_inode_err_str(*state->status));
+			 cache_inode_err_str(*status));
 		return false;
 	}
 
-	if (cache_entry->type == DIRECTORY) {
+	if ((*entry)->type == DIRECTORY) {
 		/* Insert Parent's key */
-		cache_inode_key_dup(&cache_entry->object.dir.parent,
-				    &state->directory->fh_hk.key);
+		cache_inode_key_dup(&(*entry)->object.dir.parent,
+				    &directory->fh_hk.key);
 	}
 
+	return true;
+}
+
+/**
+ * @brief Populate a single dir entry
+ *
+ * This callback serves to populate a single dir entry from the
+ * readdir.
+ *
+ * @param[in]     name      Name of the directory entry
+ * @param[in]     obj       Handle of the entry, consumed
+ * @param[in]     status    Why there is no handle
+ * @param[in,out] dir_state Callback state
+ * @param[in]     cookie    Directory cookie
+ *
+ * @retval true if more entries are requested
+ * @retval false if no more should be sent and the last was not processed
+ */
+
+static bool
+populate_dirent(const char *name, struct fsal_obj_handle *obj,
+		fsal_status_t status, void *dir_state,
+		fsal_cookie_t cookie)
+{
+	struct cache_inode_populate_cb_state *state =
+	    (struct cache_inode_populate_cb_state *)dir_state;
+	cache_inode_dir_entry_t *new_dir_entry = NULL;
+	cache_entry_t *cache_entry = NULL;
+
+	if (!readdir_lookup_entry(state->directory, name, obj, status,
+				  &cache_entry, state->status))
+		return false;
+
+	if (cache_entry == NULL)
+		return true;
+
 	*state->status =
 	    cache_inode_add_cached_dirent(state->directory, name, cache_entry,
 					  &new_dir_entry);
@@ -491,11 +556,11 @@ cache_inode_readdir_populate(cache_entry_t *directory)
 	state.offset_cookie = 0;
 
 	fsal_status =
-		directory->obj_handle->ops->readdir(directory->obj_handle,
-						    NULL,
-						    (void *)&state,
-						    populate_dirent,
-						    &eod);
+		directory->obj_handle->ops->readdir_plus(directory->obj_handle,
+							 NULL,
+							 (void *)&state,
+							 populate_dirent,
+							 &eod);
 	if (FSAL_IS_ERROR(fsal_status)) {
 		if (fsal_status.major == ERR_FSAL_STALE) {
 			LogEvent(COMPONENT_NFS_READDIR,
@@ -533,12 +598,703 @@ cache_inode_readdir_populate(cache_entry_t *directory)
 	return status;
 }				/* cache_inode_readdir_populate */
 
+/**
+ * @brief Return the next dirent of a chunk
+ *
+ * @param[in] chunk  The chunk
+ * @param[in] dirent A dirent of the chunk, NULL for the first
+ *
+ * @return The dirent after dirent, NULL at the end of the chunk.
+ */
+
+static inline cache_inode_dir_entry_t *
+dir_chunk_next_dirent(struct cache_inode_dir_chunk *chunk,
+		      cache_inode_dir_entry_t *dirent)
+{
+	struct glist_head *next = dirent != NULL
+	    ? dirent->chunk_list.next : chunk->dirents.next;
+
+	if (next == &chunk->dirents)
+		return NULL;
+
+	return glist_entry(next, cache_inode_dir_entry_t, chunk_list);
+}
+
+/**
+ * @brief Return the chunk a chain of chunks starts with
+ *
+ * @param[in] chunk A chunk of the chain
+ */
+
+static struct cache_inode_dir_chunk *
+dir_chunk_head(struct cache_inode_dir_chunk *chunk)
+{
+	while (chunk->prev != NULL)
+		chunk = chunk->prev;
+
+	return chunk;
+}
+
+/**
+ * @brief Release a chunk of a directory's content
+ *
+ * Frees the chunk and its dirents.  Negative lookups cannot be served
+ * until the directory is read again.  The content lock must be held
+ * for write.
+ *
+ * @param[in,out] directory The directory
+ * @param[in]     chunk     The chunk to release
+ */
+
+void
+cache_inode_release_dir_chunk(cache_entry_t *directory,
+			      struct cache_inode_dir_chunk *chunk)
+{
+	struct cache_inode_dir_chunks *chunks = directory->object.dir.chunks;
+	struct glist_head *glist, *glistn;
+	cache_inode_dir_entry_t *dirent;
+
+	cache_inode_lru_chunk_remove(chunk);
+
+	glist_for_each_safe(glist, glistn, &chunk->dirents) {
+		dirent = glist_entry(glist, cache_inode_dir_entry_t,
+				     chunk_list);
+		avltree_remove(&dirent->node_ck, &chunks->ck);
+		if (!(dirent->flags & DIR_ENTRY_FLAG_DELETED)) {
+			cache_inode_avl_remove(directory, dirent);
+			directory->object.dir.nbactive--;
+		}
+		cache_inode_lru_charge(
+			directory, -(int64_t) cache_inode_dirent_bytes(dirent));
+		if (dirent->ckey.kv.len)
+			cache_inode_key_delete(&dirent->ckey);
+		gsh_free(dirent);
+	}
+
+	if (chunk->prev != NULL)
+		chunk->prev->next = NULL;
+	if (chunk->next != NULL)
+		chunk->next->prev = NULL;
+	if (chunks->first == chunk)
+		chunks->first = NULL;
+	glist_del(&chunk->chunks);
+	gsh_free(chunk);
+	cache_inode_lru_charge(directory,
+			       -(int64_t) sizeof(struct cache_inode_dir_chunk));
+
+	atomic_clear_uint32_t_bits(&directory->flags,
+				   CACHE_INODE_DIR_POPULATED);
+
+	if (glist_empty(&chunks->chunks)) {
+		directory->object.dir.chunks = NULL;
+		gsh_free(chunks);
+		cache_inode_lru_charge(
+			directory,
+			-(int64_t) sizeof(struct cache_inode_dir_chunks));
+	}
+}
+
+/**
+ * @brief Release all chunks of a directory's content
+ *
+ * Names cached by lookup or creation stay.  The content lock must be
+ * held for write.
+ *
+ * @param[in,out] directory The directory
+ */
+
+void
+cache_inode_release_dir_chunks(cache_entry_t *directory)
+{
+	while (directory->object.dir.chunks != NULL)
+		cache_inode_release_dir_chunk(
+			directory,
+			glist_first_entry(&directory->object.dir.chunks->chunks,
+					  struct cache_inode_dir_chunk,
+					  chunks));
+}
+
+/**
+ * @brief Skip deleted dirents and follow chunks read after
+ *
+ * @param[in,out] chunk  The chunk of dirent
+ * @param[in,out] dirent A dirent of chunk or NULL for its end
+ *
+ * @retval true with the next live dirent, or NULL at the end of the
+ *         directory.
+ * @retval false if the chunk after *chunk has to be read.
+ */
+
+static bool
+dir_chunk_settle(struct cache_inode_dir_chunk **chunk,
+		 cache_inode_dir_entry_t **dirent)
+{
+	for (;;) {
+		while (*dirent != NULL &&
+		       ((*dirent)->flags & DIR_ENTRY_FLAG_DELETED))
+			*dirent = dir_chunk_next_dirent(*chunk, *dirent);
+
+		if (*dirent != NULL || (*chunk)->eod)
+			return true;
+
+		if ((*chunk)->next == NULL ||
+		    cache_inode_dir_chunk_stale((*chunk)->next))
+			return false;
+
+		*chunk = (*chunk)->next;
+		*dirent = dir_chunk_next_dirent(*chunk, NULL);
+	}
+}
+
+/**
+ * @brief Find the dirent following a cookie in the cached chunks
+ *
+ * @param[in]  directory The directory
+ * @param[in]  ck        FSAL cookie of the last dirent read, 0 for
+ *                       the start
+ * @param[out] chunk     Chunk of the dirent found, or the chunk to
+ *                       read on from, NULL if not cached or stale
+ * @param[out] dirent    The dirent, NULL at the end of the directory
+ *
+ * @retval true if the dirent or the end was found.
+ * @retval false if a chunk has to be read.
+ */
+
+static bool
+dir_chunk_seek(cache_entry_t *directory, fsal_cookie_t ck,
+	       struct cache_inode_dir_chunk **chunk,
+	       cache_inode_dir_entry_t **dirent)
+{
+	struct cache_inode_dir_chunks *chunks = directory->object.dir.chunks;
+	cache_inode_dir_entry_t key;
+	struct avltree_node *node;
+
+	*chunk = NULL;
+	*dirent = NULL;
+
+	if (chunks == NULL)
+		return false;
+
+	if (ck == 0) {
+		*chunk = chunks->first;
+		if (*chunk == NULL)
+			return false;
+	} else {
+		key.ck = ck;
+		node = avltree_lookup(&key.node_ck, &chunks->ck);
+		if (node == NULL)
+			return false;
+		*dirent = avltree_container_of(node, cache_inode_dir_entry_t,
+					       node_ck);
+		*chunk = (*dirent)->chunk;
+	}
+
+	if (cache_inode_dir_chunk_stale(*chunk)) {
+		*chunk = NULL;
+		*dirent = NULL;
+		return false;
+	}
+
+	*dirent = dir_chunk_next_dirent(*chunk, *dirent);
+
+	return dir_chunk_settle(chunk, dirent);
+}
+
+/**
+ * @brief State to be passed to the FSAL readdir reading a chunk
+ */
+
+struct cache_inode_chunk_cb_state {
+	cache_entry_t *directory;
+	struct cache_inode_dir_chunk *chunk;	/*< Chunk being read */
+	struct cache_inode_dir_chunk *head;	/*< Its chain's first */
+	struct cache_inode_dir_chunk *link;	/*< Chunk found to follow */
+	cache_inode_status_t status;
+	fsal_cookie_t last_ck;	/*< Cookie of the last name consumed */
+	bool unusable;		/*< The FSAL's cookies cannot be used */
+};
+
+/**
+ * @brief Add a dir entry to the chunk being read
+ *
+ * A cookie seen in another chunk means the rest of the directory may
+ * be cached already: if it starts a chain of chunks and no name was
+ * added since it was read, the read stops and the chunk is linked to
+ * it, else that chunk is released.  A cookie seen before in the same
+ * chain means the FSAL's cookies do not locate entries.  A name
+ * cached before is replaced.
+ *
+ * @param[in]     name      Name of the directory entry
+ * @param[in]     obj       Handle of the entry, consumed
+ * @param[in]     status    Why there is no handle
+ * @param[in,out] dir_state Callback state
+ * @param[in]     cookie    Directory cookie
+ *
+ * @retval true if more entries are requested
+ * @retval false if no more should be sent and the last was not processed
+ */
+
+static bool
+populate_chunk(const char *name, struct fsal_obj_handle *obj,
+	       fsal_status_t status, void *dir_state, fsal_cookie_t cookie)
+{
+	struct cache_inode_chunk_cb_state *state = dir_state;
+	struct cache_inode_dir_chunk *chunk = state->chunk;
+	cache_entry_t *directory = state->directory;
+	struct cache_inode_dir_chunks *chunks = directory->object.dir.chunks;
+	size_t namesize = strlen(name) + 1;
+	cache_inode_dir_entry_t key, *dirent, *old;
+	struct avltree_node *node;
+	cache_entry_t *entry = NULL;
+
+	/* 0, 1 and 2 are the client's, see cache_inode_readdir */
+	if (cookie < 3) {
+		readdir_release_hdl(obj);
+		state->unusable = true;
+		return false;
+	}
+
+	/* Some FSALs return the entry at whence again */
+	if (cookie == chunk->whence) {
+		readdir_release_hdl(obj);
+		return true;
+	}
+
+	if (chunk->num_entries >= cache_param.dir_chunk) {
+		readdir_release_hdl(obj);
+		return false;
+	}
+
+	key.ck = cookie;
+	node = avltree_lookup(&key.node_ck, &chunks->ck);
+	if (node != NULL) {
+		old = avltree_container_of(node, cache_inode_dir_entry_t,
+					   node_ck);
+		if (cache_inode_dir_chunk_stale(old->chunk)) {
+			/* released below, this read replaces it */
+		} else if (dir_chunk_head(old->chunk) == state->head) {
+			readdir_release_hdl(obj);
+			state->unusable = true;
+			return false;
+		} else if (old->chunk->prev == NULL &&
+			   old->chunk != chunks->first &&
+			   old == dir_chunk_next_dirent(old->chunk, NULL)) {
+			readdir_release_hdl(obj);
+			state->link = old->chunk;
+			return false;
+		}
+		cache_inode_release_dir_chunk(directory, old->chunk);
+	}
+
+	if (!readdir_lookup_entry(directory, name, obj, status, &entry,
+				  &state->status))
+		return false;
+
+	state->status = CACHE_INODE_SUCCESS;
+	state->last_ck = cookie;
+
+	if (entry == NULL)
+		return true;
+
+	dirent = gsh_malloc(sizeof(cache_inode_dir_entry_t) + namesize);
+	if (dirent == NULL) {
+		cache_inode_put(entry);
+		state->status = CACHE_INODE_MALLOC_ERROR;
+		return false;
+	}
+
+	dirent->flags = DIR_ENTRY_FLAG_NONE;
+	memcpy(dirent->name, name, namesize);
+	cache_inode_key_dup(&dirent->ckey, &entry->fh_hk.key);
+	dirent->chunk = chunk;
+	dirent->ck = cookie;
+
+	/* return initial ref */
+	cache_inode_put(entry);
+
+	old = cache_inode_avl_qp_lookup_s(directory, name, 1);
+	if (old != NULL) {
+		if (old->chunk != NULL) {
+			avl_dirent_set_deleted(directory, old);
+		} else {
+			cache_inode_avl_remove(directory, old);
+			cache_inode_lru_charge(
+				directory,
+				-(int64_t) cache_inode_dirent_bytes(old));
+			cache_inode_free_dirent(old);
+		}
+		directory->object.dir.nbactive--;
+	}
+
+	if (cache_inode_avl_qp_insert(directory, dirent) < 0) {
+		cache_inode_free_dirent(dirent);
+		return true;
+	}
+
+	avltree_insert(&dirent->node_ck, &chunks->ck);
+	glist_add_tail(&chunk->dirents, &dirent->chunk_list);
+	chunk->num_entries++;
+	directory->object.dir.nbactive++;
+	cache_inode_lru_charge(directory, cache_inode_dirent_bytes(dirent));
+
+	return true;
+}
+
+/**
+ * @brief Read a chunk of a directory
+ *
+ * Reads up to Dir_Chunk names from the FSAL, starting after whence.
+ * Should the FSAL's cookies turn out not to locate entries, the
+ * directory is cached whole from then on.  The content lock must be
+ * held for write.
+ *
+ * @param[in,out] directory The directory
+ * @param[in]     prev      Chunk to read on from, NULL if none
+ * @param[in]     whence    FSAL cookie to read from
+ * @param[out]    chunk     The chunk read
+ *
+ * @retval CACHE_INODE_SUCCESS if the chunk was read.
+ * @retval CACHE_INODE_BAD_COOKIE if the directory cannot be chunked.
+ * @retval Other errors from the FSAL.
+ */
+
+static cache_inode_status_t
+dir_chunk_fill(cache_entry_t *directory, struct cache_inode_dir_chunk *prev,
+	       fsal_cookie_t whence, struct cache_inode_dir_chunk **chunk)
+{
+	struct cache_inode_dir_chunks *chunks = directory->object.dir.chunks;
+	struct cache_inode_chunk_cb_state state;
+	struct cache_inode_dir_chunk *c, *last;
+	fsal_status_t fsal_status;
+	cache_inode_status_t status;
+	bool eod = false;
+
+	c = gsh_calloc(1, sizeof(struct cache_inode_dir_chunk));
+	if (c == NULL)
+		return CACHE_INODE_MALLOC_ERROR;
+
+	if (chunks == NULL) {
+		chunks = gsh_malloc(sizeof(struct cache_inode_dir_chunks));
+		if (chunks == NULL) {
+			gsh_free(c);
+			return CACHE_INODE_MALLOC_ERROR;
+		}
+		avltree_init(&chunks->ck, avl_dirent_ck_cmpf, 0 /* flags */);
+		glist_init(&chunks->chunks);
+		chunks->first = NULL;
+		chunks->gen = 0;
+		directory->object.dir.chunks = chunks;
+		cache_inode_lru_charge(directory,
+				       sizeof(struct cache_inode_dir_chunks));
+	}
+
+	c->parent = directory;
+	glist_init(&c->dirents);
+	c->whence = whence;
+	c->gen = chunks->gen;
+	glist_add(&chunks->chunks, &c->chunks);
+	cache_inode_lru_charge(directory, sizeof(struct cache_inode_dir_chunk));
+
+	if (prev != NULL) {
+		/* a stale chunk read after prev is read again */
+		if (prev->next != NULL)
+			prev->next->prev = NULL;
+		prev->next = c;
+		c->prev = prev;
+	} else if (whence == 0) {
+		chunks->first = c;
+	}
+
+	state.directory = directory;
+	state.chunk = c;
+	state.head = dir_chunk_head(c);
+	state.link = NULL;
+	state.status = CACHE_INODE_SUCCESS;
+	state.last_ck = whence;
+	state.unusable = false;
+
+	fsal_status =
+		directory->obj_handle->ops->readdir_plus(directory->obj_handle,
+							 whence != 0 ? &whence
+							 : NULL,
+							 (void *)&state,
+							 populate_chunk,
+							 &eod);
+
+	if (state.unusable) {
+		LogInfo(COMPONENT_NFS_READDIR,
+			"FSAL cookies cannot locate chunks of dir %p, "
+			"caching it whole",
+			directory->obj_handle);
+		cache_inode_release_dirents(directory, CACHE_INODE_AVL_BOTH);
+		atomic_set_uint32_t_bits(&directory->flags,
+					 CACHE_INODE_DIR_NO_CHUNK);
+		return CACHE_INODE_BAD_COOKIE;
+	}
+
+	if (FSAL_IS_ERROR(fsal_status)) {
+		cache_inode_release_dir_chunk(directory, c);
+		if (fsal_status.major == ERR_FSAL_STALE) {
+			LogEvent(COMPONENT_NFS_READDIR,
+				 "FSAL returned STALE from readdir.");
+			cache_inode_kill_entry(directory);
+		}
+
+		status = cache_inode_error_convert(fsal_status);
+		LogDebug(COMPONENT_NFS_READDIR,
+			 "FSAL readdir status=%s",
+			 cache_inode_err_str(status));
+		return status;
+	}
+
+	if (state.status != CACHE_INODE_SUCCESS) {
+		cache_inode_release_dir_chunk(directory, c);
+		return state.status;
+	}
+
+	c->next_ck = state.last_ck;
+	if (state.link != NULL) {
+		c->next = state.link;
+		state.link->prev = c;
+	} else if (eod || state.last_ck == whence) {
+		/* a read that consumed nothing ends the directory too */
+		c->eod = true;
+	}
+
+	cache_inode_lru_chunk_insert(c);
+
+	LogFullDebug(COMPONENT_NFS_READDIR,
+		     "Read chunk %p of dir %p whence=%" PRIu64 " entries=%"
+		     PRIu32 " next=%p eod=%s", c, directory, whence,
+		     c->num_entries, c->next, c->eod ? "true" : "false");
+
+	/* Negative lookups can be served once the chunks read from the
+	 * start reach the end */
+	if (c->next != NULL || c->eod) {
+		for (last = chunks->first; last != NULL && !last->eod;
+		     last = last->next)
+			;
+		if (last != NULL)
+			atomic_set_uint32_t_bits(&directory->flags,
+						 CACHE_INODE_DIR_POPULATED);
+	}
+
+	*chunk = c;
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Read chunks until the dirent following a cookie is cached
+ *
+ * Takes the content lock for write if it is only held for read.
+ *
+ * @param[in,out] directory The directory
+ * @param[in]     ck        FSAL cookie of the last dirent read
+ * @param[in]     chunk     Chunk to read on from, see dir_chunk_seek
+ * @param[in,out] wrlocked  Whether the content lock is held for write
+ * @param[out]    status    Errors reading chunks
+ *
+ * @return The dirent, NULL at the end of the directory or on error.
+ */
+
+static cache_inode_dir_entry_t *
+dir_chunk_load(cache_entry_t *directory, fsal_cookie_t ck,
+	       struct cache_inode_dir_chunk *chunk, bool *wrlocked,
+	       cache_inode_status_t *status)
+{
+	cache_inode_dir_entry_t *dirent;
+
+	*status = CACHE_INODE_SUCCESS;
+
+	if (!*wrlocked) {
+		PTHREAD_RWLOCK_unlock(&directory->content_lock);
+		PTHREAD_RWLOCK_wrlock(&directory->content_lock);
+		*wrlocked = true;
+
+		/* Chunks may have come or gone while unlocked */
+		if (dir_chunk_seek(directory, ck, &chunk, &dirent))
+			return dirent;
+	}
+
+	do {
+		*status = dir_chunk_fill(directory, chunk,
+					 chunk != NULL ? chunk->next_ck : ck,
+					 &chunk);
+		if (*status != CACHE_INODE_SUCCESS)
+			return NULL;
+		dirent = dir_chunk_next_dirent(chunk, NULL);
+	} while (!dir_chunk_settle(&chunk, &dirent));
+
+	return dirent;
+}
+
+/**
+ * @brief Find where a READDIR of a wholly cached directory starts
+ *
+ * Populates the directory first if needed, taking the content lock
+ * for write.
+ *
+ * @param[in,out] directory The directory
+ * @param[in]     cookie    Starting cookie for the readdir operation
+ * @param[in,out] wrlocked  Whether the content lock is held for write
+ * @param[out]    dirent    First dirent to return, NULL at the end
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+
+static cache_inode_status_t
+readdir_seek_hashed(cache_entry_t *directory, uint64_t cookie,
+		    bool *wrlocked, cache_inode_dir_entry_t **dirent)
+{
+	cache_inode_status_t status;
+	struct avltree_node *dirent_node;
+
+	*dirent = NULL;
+
+	if (!
+	    ((directory->flags & CACHE_INODE_TRUST_CONTENT)
+	     && (directory->flags & CACHE_INODE_DIR_POPULATED))) {
+		if (!*wrlocked) {
+			PTHREAD_RWLOCK_unlock(&directory->content_lock);
+			PTHREAD_RWLOCK_wrlock(&directory->content_lock);
+			*wrlocked = true;
+		}
+		status = cache_inode_readdir_populate(directory);
+		if (status != CACHE_INODE_SUCCESS) {
+			LogFullDebug(COMPONENT_NFS_READDIR,
+				     "cache_inode_readdir_populate status=%s",
+				     cache_inode_err_str(status));
+			return status;
+		}
+	}
+
+	/* deal with initial cookie value:
+	 * 1. cookie is invalid (-should- be checked by caller)
+	 * 2. cookie is 0 (first cookie) -- ok
+	 * 3. cookie is > than highest dirent position (error)
+	 * 4. cookie <= highest dirent position but > highest cached cookie
+	 *    (currently equivalent to #2, because we pre-populate the cookie
+	 *    avl)
+	 * 5. cookie is in cached range -- ok */
+
+	if (cookie == 0) {
+		/* initial readdir */
+		dirent_node = avltree_first(&directory->object.dir.avl.t);
+		if (dirent_node)
+			*dirent = avltree_container_of(dirent_node,
+						       cache_inode_dir_entry_t,
+						       node_hk);
+		return CACHE_INODE_SUCCESS;
+	}
+
+	/* we assert this can now succeed */
+	*dirent = cache_inode_avl_lookup_k(directory, cookie,
+					   CACHE_INODE_FLAG_NEXT_ACTIVE);
+	if (!*dirent) {
+		/* Linux (3.4, etc) has been observed to send readdir
+		 * at the offset of the last entry's cookie, and
+		 * returns no dirents to userland if that readdir
+		 * notfound or badcookie. */
+		if (cache_inode_avl_lookup_k
+		    (directory, cookie, CACHE_INODE_FLAG_NONE)) {
+			/* yup, it was the last entry */
+			LogFullDebug(COMPONENT_NFS_READDIR,
+				     "EOD because empty result");
+			return CACHE_INODE_SUCCESS;
+		}
+		LogFullDebug(COMPONENT_NFS_READDIR,
+			     "seek to cookie=%" PRIu64 " fail",
+			     cookie);
+		return CACHE_INODE_BAD_COOKIE;
+	}
+
+	/* dirent is the NEXT entry to return, since we sent
+	 * CACHE_INODE_FLAG_NEXT_ACTIVE */
+	return CACHE_INODE_SUCCESS;
+}
+
+/**
+ * @brief Find where a READDIR of a chunked directory starts
+ *
+ * Reads the chunks missing, taking the content lock for write.
+ *
+ * @param[in,out] directory The directory
+ * @param[in]     cookie    Starting cookie for the readdir operation
+ * @param[in,out] wrlocked  Whether the content lock is held for write
+ * @param[out]    dirent    First dirent to return, NULL at the end
+ *
+ * @return CACHE_INODE_SUCCESS or errors.
+ */
+
+static cache_inode_status_t
+readdir_seek_chunked(cache_entry_t *directory, uint64_t cookie,
+		     bool *wrlocked, cache_inode_dir_entry_t **dirent)
+{
+	cache_inode_status_t status = CACHE_INODE_SUCCESS;
+	struct cache_inode_dir_chunk *chunk;
+
+	if (!(directory->flags & CACHE_INODE_TRUST_CONTENT)) {
+		if (!*wrlocked) {
+			PTHREAD_RWLOCK_unlock(&directory->content_lock);
+			PTHREAD_RWLOCK_wrlock(&directory->content_lock);
+			*wrlocked = true;
+		}
+		status = cache_inode_invalidate_all_cached_dirent(directory);
+		if (status != CACHE_INODE_SUCCESS)
+			return status;
+	}
+
+	if (!dir_chunk_seek(directory, cookie, &chunk, dirent))
+		*dirent = dir_chunk_load(directory, cookie, chunk, wrlocked,
+					 &status);
+
+	return status;
+}
+
+/**
+ * @brief Step a READDIR to the next dirent
+ *
+ * @param[in,out] directory The directory being read
+ * @param[in]     dirent    The dirent last returned
+ * @param[in,out] wrlocked  Whether the content lock is held for write
+ * @param[out]    status    Errors reading chunks
+ *
+ * @return The next dirent, NULL at the end of the directory or on
+ *         error.
+ */
+
+static cache_inode_dir_entry_t *
+readdir_next(cache_entry_t *directory, cache_inode_dir_entry_t *dirent,
+	     bool *wrlocked, cache_inode_status_t *status)
+{
+	struct cache_inode_dir_chunk *chunk = dirent->chunk;
+	struct avltree_node *dirent_node;
+	fsal_cookie_t ck;
+
+	if (chunk == NULL) {
+		dirent_node = avltree_next(&dirent->node_hk);
+		if (!dirent_node)
+			return NULL;
+		return avltree_container_of(dirent_node,
+					    cache_inode_dir_entry_t, node_hk);
+	}
+
+	ck = dirent->ck;
+	dirent = dir_chunk_next_dirent(chunk, dirent);
+	if (dir_chunk_settle(&chunk, &dirent))
+		return dirent;
+
+	return dir_chunk_load(directory, ck, chunk, wrlocked, status);
+}
+
 /**
  * @brief Reads a directory
  *
  * This function iterates over the cached directory entries (possibly
  * after populating the cache) and invokes a supplied callback
- * function for each one.
+ * function for each one.  Directories are cached whole and returned
+ * in name hash order with hash cookies, or, with Dir_Chunk set, read
+ * a chunk at a time and returned in FSAL order with FSAL cookies.
  *
  * The caller must not hold the attribute or content locks on
  * directory.
@@ -568,8 +1324,10 @@ cache_inode_readdir(cache_entry_t *directory,
 {
 	/* The entry being examined */
 	cache_inode_dir_entry_t *dirent = NULL;
-	/* The node in the tree being traversed */
-	struct avltree_node *dirent_node;
+	/* The chunk last made most recently read */
+	struct cache_inode_dir_chunk *chunk = NULL;
+	/* Whether the content lock is held for write */
+	bool wrlocked = false;
 	/* The access mask corresponding to permission to list directory
 	   entries */
 	fsal_accessflags_t access_mask =
@@ -641,90 +1399,56 @@ cache_inode_readdir(cache_entry_t *directory,
 
 	PTHREAD_RWLOCK_rdlock(&directory->content_lock);
 	PTHREAD_RWLOCK_unlock(&directory->attr_lock);
-	if (!
-	    ((directory->flags & CACHE_INODE_TRUST_CONTENT)
-	     && (directory->flags & CACHE_INODE_DIR_POPULATED))) {
-		PTHREAD_RWLOCK_unlock(&directory->content_lock);
-		PTHREAD_RWLOCK_wrlock(&directory->content_lock);
-		status = cache_inode_readdir_populate(directory);
-		if (status != CACHE_INODE_SUCCESS) {
-			LogFullDebug(COMPONENT_NFS_READDIR,
-				     "cache_inode_readdir_populate status=%s",
-				     cache_inode_err_str(status));
-			goto unlock_dir;
-		}
-	}
 
-	/* deal with initial cookie value:
-	 * 1. cookie is invalid (-should- be checked by caller)
-	 * 2. cookie is 0 (first cookie) -- ok
-	 * 3. cookie is > than highest dirent position (error)
-	 * 4. cookie <= highest dirent position but > highest cached cookie
-	 *    (currently equivalent to #2, because we pre-populate the cookie
-	 *    avl)
-	 * 5. cookie is in cached range -- ok */
-
-	if (cookie > 0) {
-		/* N.B., cache_inode_avl_qp_insert_s ensures k > 2 */
-		if (cookie < 3) {
-			status = CACHE_INODE_BAD_COOKIE;
-			LogFullDebug(COMPONENT_NFS_READDIR,
-				     "Bad cookie");
-			goto unlock_dir;
-		}
+	/* N.B., cache_inode_avl_qp_insert_s ensures k > 2, and chunks
+	 * take no FSAL cookie below 3 */
+	if (cookie > 0 && cookie < 3) {
+		status = CACHE_INODE_BAD_COOKIE;
+		LogFullDebug(COMPONENT_NFS_READDIR,
+			     "Bad cookie");
+		goto unlock_dir;
+	}
 
-		/* we assert this can now succeed */
-		dirent =
-		    cache_inode_avl_lookup_k(directory, cookie,
-					     CACHE_INODE_FLAG_NEXT_ACTIVE);
-		if (!dirent) {
-			/* Linux (3.4, etc) has been observed to send readdir
-			 * at the offset of the last entry's cookie, and
-			 * returns no dirents to userland if that readdir
-			 * notfound or badcookie. */
-			if (cache_inode_avl_lookup_k
-			    (directory, cookie, CACHE_INODE_FLAG_NONE)) {
-				/* yup, it was the last entry */
-				LogFullDebug(COMPONENT_NFS_READDIR,
-					     "EOD because empty result");
-				*eod_met = true;
-				goto unlock_dir;
-			}
-			LogFullDebug(COMPONENT_NFS_READDIR,
-				     "seek to cookie=%" PRIu64 " fail",
-				     cookie);
-			status = CACHE_INODE_BAD_COOKIE;
-			goto unlock_dir;
-		}
+	if (cache_inode_dir_chunked(directory))
+		status = readdir_seek_chunked(directory, cookie, &wrlocked,
+					      &dirent);
+	else
+		status = readdir_seek_hashed(directory, cookie, &wrlocked,
+					     &dirent);
 
-		/* dirent is the NEXT entry to return, since we sent
-		 * CACHE_INODE_FLAG_NEXT_ACTIVE */
-		dirent_node = &dirent->node_hk;
+	/* A directory just found unfit for chunks is read whole */
+	if (status == CACHE_INODE_BAD_COOKIE && cookie == 0
+	    && !cache_inode_dir_chunked(directory))
+		status = readdir_seek_hashed(directory, cookie, &wrlocked,
+					     &dirent);
 
-	} else {
-		/* initial readdir */
-		dirent_node = avltree_first(&directory->object.dir.avl.t);
-	}
+	if (status != CACHE_INODE_SUCCESS)
+		goto unlock_dir;
 
 	LogFullDebug(COMPONENT_NFS_READDIR,
 		     "About to readdir in cache_inode_readdir: directory=%p "
 		     "cookie=%" PRIu64 " collisions %d", directory, cookie,
-		     directory->object.dir.avl.collisions);
+		     directory->object.dir.collisions);
 
 	/* Now satisfy the request from the cached readdir--stop when either
-	 * the requested sequence or dirent sequence is exhausted */
+	 * the requested sequence or dirent sequence is exhausted.  Only
+	 * advance while the reply still has room, since stepping past the
+	 * end of a chunk reads the next one from the FSAL. */
 	*nbfound = 0;
 	*eod_met = false;
 
-	for (; cb_parms.in_result && dirent_node;
-	     dirent_node = avltree_next(dirent_node)) {
+	for (; cb_parms.in_result && dirent;
+	     dirent = cb_parms.in_result
+		     ? readdir_next(directory, dirent, &wrlocked, &status)
+		     : dirent) {
 
 		cache_entry_t *entry = NULL;
 		cache_inode_status_t tmp_status = 0;
 
-		dirent =
-		    avltree_container_of(dirent_node, cache_inode_dir_entry_t,
-					 node_hk);
+		if (dirent->chunk != NULL && dirent->chunk != chunk) {
+			chunk = dirent->chunk;
+			cache_inode_lru_chunk_ref(chunk);
+		}
 
  estale_retry:
 		LogFullDebug(COMPONENT_NFS_READDIR,
@@ -785,7 +1509,8 @@ cache_inode_readdir(cache_entry_t *directory,
 
 		cb_parms.name = dirent->name;
 		cb_parms.attr_allowed = attr_status == CACHE_INODE_SUCCESS;
-		cb_parms.cookie = dirent->hk.k;
+		cb_parms.cookie = dirent->chunk != NULL ? dirent->ck
+		    : dirent->hk.k;
 
 		tmp_status = cache_inode_getattr(entry, &cb_parms, cb);
 
@@ -839,14 +1564,24 @@ cache_inode_readdir(cache_entry_t *directory,
 		}
 	}
 
+	if (status != CACHE_INODE_SUCCESS) {
+		LogDebug(COMPONENT_NFS_READDIR,
+			 "Reading on after %u entries failed with %s",
+			 *nbfound, cache_inode_err_str(status));
+		/* Return what we have, the client will ask for the rest */
+		if (*nbfound > 0)
+			status = CACHE_INODE_SUCCESS;
+		goto unlock_dir;
+	}
+
 	/* We have reached the last node and every node traversed was
 	   added to the result */
 
 	LogDebug(COMPONENT_NFS_READDIR,
-		 "dirent_node = %p, nbfound = %u, in_result = %s", dirent_node,
+		 "dirent = %p, nbfound = %u, in_result = %s", dirent,
 		 *nbfound, cb_parms.in_result ? "TRUE" : "FALSE");
 
-	if (!dirent_node && cb_parms.in_result)
+	if (!dirent && cb_parms.in_result)
 		*eod_met = true;
 	else
 		*eod_met = false;
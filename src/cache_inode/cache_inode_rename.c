@@ -79,6 +79,9 @@ cache_inode_rename_cached_dirent(cache_entry_t *parent,
 	    cache_inode_operate_cached_dirent(parent, oldname, newname,
 					      CACHE_INODE_DIRENT_OP_RENAME);
 
+	/* Where the FSAL returns the new name is unknown */
+	cache_inode_dir_chunks_stale(parent);
+
 	return status;
 }
 
@@ -364,6 +367,7 @@ cache_inode_rename(cache_entry_t *dir_src,
 			cache_inode_invalidate_all_cached_dirent(dir_dest);
 		}
 
+		cache_inode_dir_chunks_stale(dir_dest);
 		tmp_status =
 		    cache_inode_add_cached_dirent(dir_dest, newname, lookup_src,
 						  NULL);
@@ -39,6 +39,10 @@
  * determines which of the partitions (each containing a tree and each
  * separately locked), and a hash which acts as the key within an
  * individual Red-Black Tree.
+ *
+ * Tables created with HT_FLAG_RESIZE keep a growing array of hash
+ * chains in each partition instead of a tree, under the same
+ * partition lock.
  */
 
 #include "config.h"
@@ -50,8 +54,77 @@
 #include "log.h"
 #include "abstract_atomic.h"
 #include "common_utils.h"
+#include "pool_slab.h"
+#include "gsh_intrinsic.h"
 #include <assert.h>
 
+/** Protects hashtables */
+static pthread_mutex_t hashtables_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/** Every table created and not yet destroyed, for hashtable_foreach */
+static struct glist_head hashtables = GLIST_HEAD_INIT(hashtables);
+
+/** The counter stripe of this thread, UINT32_MAX until chosen */
+static __thread uint32_t ht_stripe = UINT32_MAX;
+
+/** Stripe for the next thread to count */
+static uint32_t ht_next_stripe;
+
+/**
+ * @brief The calling thread's stripe of a table's counters
+ *
+ * @param[in] ht The hash table
+ *
+ * @return The stripe.
+ */
+static inline struct hash_counters *
+ht_counters(struct hash_table *ht)
+{
+	if (unlikely(ht_stripe == UINT32_MAX))
+		ht_stripe = atomic_inc_uint32_t(&ht_next_stripe)
+		    % HT_COUNTER_STRIPES;
+
+	return &ht->counters[ht_stripe];
+}
+
+/**
+ * @brief Lock a partition, counting the time spent waiting for it
+ *
+ * Only a lock that is not granted at once is timed, so the clock is
+ * read only under contention.
+ *
+ * @param[in] ht        The hash table
+ * @param[in] index     The partition
+ * @param[in] may_write Lock for write rather than read
+ */
+static void
+partition_lock(struct hash_table *ht, uint32_t index, bool may_write)
+{
+	struct hash_partition *partition = &ht->partitions[index];
+	struct hash_counters *counters;
+	struct timespec start, end;
+	int rc;
+
+	if (may_write)
+		PTHREAD_RWLOCK_trywrlock(&partition->lock, rc);
+	else
+		PTHREAD_RWLOCK_tryrdlock(&partition->lock, rc);
+	if (rc == 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (may_write)
+		PTHREAD_RWLOCK_wrlock(&partition->lock);
+	else
+		PTHREAD_RWLOCK_rdlock(&partition->lock);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	counters = ht_counters(ht);
+	(void) atomic_inc_uint64_t(&counters->lock_waits);
+	(void) atomic_add_uint64_t(&counters->lock_wait_ns,
+				   timespec_diff(&start, &end));
+}
+
 /**
  * @brief Total size of the cache page configured for a table
  *
@@ -271,6 +344,185 @@ compute(struct hash_table *ht, const struct gsh_buffdesc *key,
 	return HASHTABLE_SUCCESS;
 }
 
+/* The following implement the resizable partitions of HT_FLAG_RESIZE
+   tables. */
+
+/**
+ * @brief Buckets a resizable partition starts with
+ */
+#define HT_RESIZE_MIN_BUCKETS 32
+
+/**
+ * @brief Old buckets moved to the new array by each write
+ *
+ * Doubling takes as many inserts as the old array has buckets, so
+ * any step of at least one finishes a resize before the next.
+ */
+#define HT_RESIZE_STEP 4
+
+/**
+ * @brief Whether a table has resizable partitions
+ *
+ * @param[in] ht The hash table to query
+ *
+ * @return true if the partitions are bucket arrays.
+ */
+static inline bool
+ht_resizable(const struct hash_table *ht)
+{
+	return (ht->parameter.flags & HT_FLAG_RESIZE) != 0;
+}
+
+/**
+ * @brief Allocate a bucket array
+ *
+ * @param[in] nbuckets Number of buckets, a power of 2
+ *
+ * @return The array, NULL on failure.
+ */
+static struct hash_buckets *
+buckets_alloc(uint32_t nbuckets)
+{
+	struct hash_buckets *buckets;
+
+	buckets = gsh_calloc(1, sizeof(struct hash_buckets) +
+			     nbuckets * sizeof(struct hash_node *));
+	if (buckets != NULL)
+		buckets->mask = nbuckets - 1;
+
+	return buckets;
+}
+
+/**
+ * @brief Find the bucket a hash is kept in
+ *
+ * The partition must be locked.
+ *
+ * @param[in] partition The partition
+ * @param[in] hash      The hash
+ *
+ * @return The head of the bucket's chain.
+ */
+static inline struct hash_node **
+bucket_of(struct hash_partition *partition, uint64_t hash)
+{
+	struct hash_buckets *old = partition->old;
+
+	if (old != NULL && (hash & old->mask) >= partition->migrate)
+		return &old->bucket[hash & old->mask];
+
+	return &partition->buckets->bucket[hash & partition->buckets->mask];
+}
+
+/**
+ * @brief Locate a key within a resizable partition
+ *
+ * The partition must be locked.
+ *
+ * @param[in]  ht        The hashtable to be used
+ * @param[in]  partition The partition to search
+ * @param[in]  key       The key to look up
+ * @param[in]  hash      Hash of the key
+ * @param[out] link      If non-NULL, set to the pointer to the node found
+ *
+ * @return The node, NULL if the key was not found.
+ */
+static struct hash_node *
+bucket_locate(struct hash_table *ht, struct hash_partition *partition,
+	      const struct gsh_buffdesc *key, uint64_t hash,
+	      struct hash_node ***link)
+{
+	struct hash_node **prev = bucket_of(partition, hash);
+
+	for (; *prev != NULL; prev = &(*prev)->next) {
+		if ((*prev)->hash != hash
+		    || ht->parameter.compare_key((struct gsh_buffdesc *)key,
+						 &(*prev)->data.key) != 0)
+			continue;
+		if (link != NULL)
+			*link = prev;
+		return *prev;
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Move buckets of a resizing partition to the new array
+ *
+ * The partition must be write locked.
+ *
+ * @param[in,out] partition The partition
+ * @param[in]     nbuckets  Most buckets to move
+ */
+static void
+partition_migrate(struct hash_partition *partition, uint32_t nbuckets)
+{
+	struct hash_buckets *old = partition->old;
+	struct hash_buckets *cur = partition->buckets;
+	struct hash_node *node, *next, **head;
+
+	while (old != NULL && nbuckets-- > 0) {
+		for (node = old->bucket[partition->migrate]; node != NULL;
+		     node = next) {
+			next = node->next;
+			head = &cur->bucket[node->hash & cur->mask];
+			node->next = *head;
+			*head = node;
+		}
+		old->bucket[partition->migrate] = NULL;
+
+		if (++partition->migrate > old->mask) {
+			gsh_free(old);
+			partition->old = NULL;
+			old = NULL;
+		}
+	}
+}
+
+/**
+ * @brief Start doubling a partition that has outgrown its buckets
+ *
+ * The partition must be write locked.
+ *
+ * @param[in,out] partition The partition
+ */
+static void
+partition_grow(struct hash_partition *partition)
+{
+	struct hash_buckets *buckets;
+	uint32_t nbuckets = partition->buckets->mask + 1;
+
+	if (partition->count <= nbuckets || nbuckets > UINT32_MAX / 2)
+		return;
+
+	/* Finish the previous resize first */
+	if (partition->old != NULL)
+		partition_migrate(partition, partition->old->mask + 1);
+
+	buckets = buckets_alloc(nbuckets * 2);
+	if (buckets == NULL)
+		return;	/* Try again on the next insert */
+
+	partition->migrate = 0;
+	partition->old = partition->buckets;
+	partition->buckets = buckets;
+}
+
+/**
+ * @brief Free the bucket arrays of a resizable partition
+ *
+ * @param[in,out] partition The partition, which must be empty
+ */
+static void
+partition_free_buckets(struct hash_partition *partition)
+{
+	gsh_free(partition->old);
+	gsh_free(partition->buckets);
+	partition->old = NULL;
+	partition->buckets = NULL;
+}
+
 /* The following are the hash table primitives implementing the
    actual functionality. */
 
@@ -316,11 +568,17 @@ hashtable_init(struct hash_param *hparam)
 	}
 #endif				/* GLIBC */
 
-	ht = gsh_calloc(1, sizeof(struct hash_table) +
-			(sizeof(struct hash_partition) *
-			 hparam->index_size));
+	ht = gsh_malloc_aligned(CACHE_LINE_SIZE, sizeof(struct hash_table) +
+				(sizeof(struct hash_partition) *
+				 hparam->index_size));
 	if (ht == NULL)
 		goto deconstruct;
+	memset(ht, 0, sizeof(struct hash_table) +
+	       (sizeof(struct hash_partition) * hparam->index_size));
+
+	/* Resizable partitions need no cache in front of them */
+	if (hparam->flags & HT_FLAG_RESIZE)
+		hparam->flags &= ~HT_FLAG_CACHE;
 
 	/* Fixup entry size */
 	if (hparam->flags & HT_FLAG_CACHE) {
@@ -349,9 +607,28 @@ hashtable_init(struct hash_param *hparam)
 				goto deconstruct;
 			}
 		}
+
+		if (hparam->flags & HT_FLAG_RESIZE) {
+			partition->buckets =
+			    buckets_alloc(HT_RESIZE_MIN_BUCKETS);
+			if (!(partition->buckets)) {
+				pthread_rwlock_destroy(&partition->lock);
+				goto deconstruct;
+			}
+		}
 		completed++;
 	}
 
+	if (hparam->flags & HT_FLAG_RESIZE) {
+		ht->node_pool =
+		    pool_init(hparam->ht_name, sizeof(struct hash_node),
+			      pool_slab_substrate, NULL, NULL, NULL);
+		if (!(ht->node_pool))
+			goto deconstruct;
+
+		goto register_table;
+	}
+
 	ht->node_pool =
 	    pool_init(NULL, sizeof(rbt_node_t), pool_basic_substrate, NULL,
 		      NULL, NULL);
@@ -364,6 +641,11 @@ hashtable_init(struct hash_param *hparam)
 	if (!(ht->data_pool))
 		goto deconstruct;
 
+ register_table:
+	PTHREAD_MUTEX_lock(&hashtables_mtx);
+	glist_add_tail(&hashtables, &ht->link);
+	PTHREAD_MUTEX_unlock(&hashtables_mtx);
+
 	pthread_rwlockattr_destroy(&rwlockattr);
 	return ht;
 
@@ -372,6 +654,8 @@ hashtable_init(struct hash_param *hparam)
 	while (completed != 0) {
 		if (hparam->flags & HT_FLAG_CACHE)
 			gsh_free(ht->partitions[completed - 1].cache);
+		if (hparam->flags & HT_FLAG_RESIZE)
+			partition_free_buckets(&ht->partitions[completed - 1]);
 
 		pthread_rwlock_destroy(&(ht->partitions[completed - 1].lock));
 		completed--;
@@ -411,16 +695,23 @@ hashtable_destroy(struct hash_table *ht,
 	if (hrc != HASHTABLE_SUCCESS)
 		goto out;
 
+	PTHREAD_MUTEX_lock(&hashtables_mtx);
+	glist_del(&ht->link);
+	PTHREAD_MUTEX_unlock(&hashtables_mtx);
+
 	for (index = 0; index < ht->parameter.index_size; ++index) {
 		if (ht->partitions[index].cache) {
 			gsh_free(ht->partitions[index].cache);
 			ht->partitions[index].cache = NULL;
 		}
+		if (ht_resizable(ht))
+			partition_free_buckets(&ht->partitions[index]);
 
 		pthread_rwlock_destroy(&(ht->partitions[index].lock));
 	}
 	pool_destroy(ht->node_pool);
-	pool_destroy(ht->data_pool);
+	if (ht->data_pool)
+		pool_destroy(ht->data_pool);
 	gsh_free(ht);
 
  out:
@@ -459,6 +750,8 @@ hashtable_getlatch(struct hash_table *ht,
 	uint32_t index = 0;
 	/* The node found for the key */
 	struct rbt_node *locator = NULL;
+	/* The node found for the key, with HT_FLAG_RESIZE */
+	struct hash_node *node = NULL;
 	/* The buffer descritpros for the key and value for the found entry */
 	struct hash_data *data = NULL;
 	/* The hash value to be searched for within the Red-Black tree */
@@ -474,16 +767,23 @@ hashtable_getlatch(struct hash_table *ht,
 		return rc;
 
 	/* Acquire mutex */
-	if (may_write)
-		PTHREAD_RWLOCK_wrlock(&(ht->partitions[index].lock));
-	else
-		PTHREAD_RWLOCK_rdlock(&(ht->partitions[index].lock));
+	partition_lock(ht, index, may_write);
 
-	rc = key_locate(ht, key, index, rbt_hash, &locator);
+	if (ht_resizable(ht)) {
+		node = bucket_locate(ht, &ht->partitions[index], key,
+				     rbt_hash, NULL);
+		if (node != NULL)
+			data = &node->data;
+		else
+			rc = HASHTABLE_ERROR_NO_SUCH_KEY;
+	} else {
+		rc = key_locate(ht, key, index, rbt_hash, &locator);
+		if (rc == HASHTABLE_SUCCESS)
+			data = RBT_OPAQ(locator);
+	}
 
 	if (rc == HASHTABLE_SUCCESS) {
 		/* Key was found */
-		data = RBT_OPAQ(locator);
 		if (val) {
 			val->addr = data->val.addr;
 			val->len = data->val.len;
@@ -510,10 +810,20 @@ hashtable_getlatch(struct hash_table *ht,
 		latch->index = index;
 		latch->rbt_hash = rbt_hash;
 		latch->locator = locator;
+		latch->node = node;
 	} else {
 		PTHREAD_RWLOCK_unlock(&ht->partitions[index].lock);
 	}
 
+ out:
+	if (rc == HASHTABLE_SUCCESS || rc == HASHTABLE_ERROR_NO_SUCH_KEY) {
+		struct hash_counters *counters = ht_counters(ht);
+
+		(void) atomic_inc_uint64_t(&counters->lookups);
+		if (rc == HASHTABLE_SUCCESS)
+			(void) atomic_inc_uint64_t(&counters->hits);
+	}
+
 	if (rc != HASHTABLE_SUCCESS && isDebug(COMPONENT_HASHTABLE)
 	    && isFullDebug(ht->parameter.ht_log_component))
 		LogFullDebug(ht->parameter.ht_log_component,
@@ -589,6 +899,10 @@ hashtable_setlatched(struct hash_table *ht,
 	struct rbt_node *locator = NULL;
 	/* New node for the case of non-overwrite */
 	struct rbt_node *mutator = NULL;
+	/* Its partition, with HT_FLAG_RESIZE */
+	struct hash_partition *partition = &ht->partitions[latch->index];
+	/* New node and its bucket, with HT_FLAG_RESIZE */
+	struct hash_node *node = NULL, **head = NULL;
 
 	if (isDebug(COMPONENT_HASHTABLE)
 	    && isFullDebug(ht->parameter.ht_log_component)) {
@@ -613,13 +927,14 @@ hashtable_setlatched(struct hash_table *ht,
 	}
 
 	/* In the case of collision */
-	if (latch->locator) {
+	if (latch->locator || latch->node) {
 		if (!overwrite) {
 			rc = HASHTABLE_ERROR_KEY_ALREADY_EXISTS;
 			goto out;
 		}
 
-		descriptors = RBT_OPAQ(latch->locator);
+		descriptors = latch->node ? &latch->node->data
+					  : RBT_OPAQ(latch->locator);
 
 		if (isDebug(COMPONENT_HASHTABLE)
 		    && isFullDebug(ht->parameter.ht_log_component)) {
@@ -662,6 +977,28 @@ hashtable_setlatched(struct hash_table *ht,
 	/* We have no collision, so go about creating and inserting a new
 	   node. */
 
+	if (ht_resizable(ht)) {
+		node = pool_alloc(ht->node_pool, NULL);
+		if (node == NULL) {
+			rc = HASHTABLE_INSERT_MALLOC_ERROR;
+			goto out;
+		}
+
+		node->hash = latch->rbt_hash;
+		node->data.key = *key;
+		node->data.val = *val;
+		head = bucket_of(partition, latch->rbt_hash);
+		node->next = *head;
+		*head = node;
+		++partition->count;
+		partition_migrate(partition, HT_RESIZE_STEP);
+		partition_grow(partition);
+		(void) atomic_inc_uint64_t(&ht_counters(ht)->inserts);
+
+		rc = HASHTABLE_SUCCESS;
+		goto out;
+	}
+
 	RBT_FIND(&ht->partitions[latch->index].rbt, locator, latch->rbt_hash);
 
 	mutator = pool_alloc(ht->node_pool, NULL);
@@ -689,6 +1026,7 @@ hashtable_setlatched(struct hash_table *ht,
 
 	/* Only in the non-overwrite case */
 	++ht->partitions[latch->index].count;
+	(void) atomic_inc_uint64_t(&ht_counters(ht)->inserts);
 
 	rc = HASHTABLE_SUCCESS;
 
@@ -736,13 +1074,15 @@ hashtable_deletelatched(struct hash_table *ht,
 	struct hash_data *data = NULL;
 	/* Its partition */
 	struct hash_partition *partition = &ht->partitions[latch->index];
+	/* The pointer to the node, with HT_FLAG_RESIZE */
+	struct hash_node **link = NULL;
 
-	if (!latch->locator) {
+	if (!latch->locator && !latch->node) {
 		hashtable_releaselatched(ht, latch);
 		return HASHTABLE_SUCCESS;
 	}
 
-	data = RBT_OPAQ(latch->locator);
+	data = latch->node ? &latch->node->data : RBT_OPAQ(latch->locator);
 
 	if (isDebug(COMPONENT_HASHTABLE)
 	    && isFullDebug(ht->parameter.ht_log_component)) {
@@ -797,16 +1137,88 @@ hashtable_deletelatched(struct hash_table *ht,
 		}
 	}
 
+	if (latch->node) {
+		link = bucket_of(partition, latch->rbt_hash);
+		while (*link != latch->node)
+			link = &(*link)->next;
+
+		*link = latch->node->next;
+		--partition->count;
+		partition_migrate(partition, HT_RESIZE_STEP);
+		(void) atomic_inc_uint64_t(&ht_counters(ht)->deletes);
+
+		pool_free(ht->node_pool, latch->node);
+		hashtable_releaselatched(ht, latch);
+		return HASHTABLE_SUCCESS;
+	}
+
 	/* Now remove the entry */
 	RBT_UNLINK(&partition->rbt, latch->locator);
 	pool_free(ht->data_pool, data);
 	pool_free(ht->node_pool, latch->locator);
 	--ht->partitions[latch->index].count;
+	(void) atomic_inc_uint64_t(&ht_counters(ht)->deletes);
 
 	hashtable_releaselatched(ht, latch);
 	return HASHTABLE_SUCCESS;
 }
 
+/**
+ * @brief Remove and free all entries of a resizable table
+ *
+ * @param[in,out] ht        The hashtable to be cleared of all entries
+ * @param[in]     free_func The function with which to free the contents
+ *                          of each entry
+ *
+ * @return HASHTABLE_SUCCESS or errors
+ */
+static hash_error_t
+hashtable_delall_buckets(struct hash_table *ht,
+			 int (*free_func)(struct gsh_buffdesc,
+					  struct gsh_buffdesc))
+{
+	uint32_t index = 0;
+	struct hash_partition *partition;
+	struct hash_node *node;
+	struct gsh_buffdesc key, val;
+
+	for (index = 0; index < ht->parameter.index_size; index++) {
+		partition = &ht->partitions[index];
+
+		partition_lock(ht, index, true);
+
+		/* Moving everything to the current array leaves a
+		   single array to empty */
+		if (partition->old != NULL)
+			partition_migrate(partition,
+					  partition->old->mask + 1);
+
+		while (partition->count != 0) {
+			uint32_t bucket;
+
+			for (bucket = 0; partition->buckets->bucket[bucket]
+			     == NULL; bucket++)
+				;
+
+			node = partition->buckets->bucket[bucket];
+			partition->buckets->bucket[bucket] = node->next;
+			--partition->count;
+
+			key = node->data.key;
+			val = node->data.val;
+			pool_free(ht->node_pool, node);
+
+			if (free_func(key, val) == 0) {
+				PTHREAD_RWLOCK_unlock(&partition->lock);
+				return HASHTABLE_ERROR_DELALL_FAIL;
+			}
+		}
+		PTHREAD_RWLOCK_unlock(&partition->lock);
+	}
+
+	return HASHTABLE_SUCCESS;
+}
+
 /**
  * @brief Remove and free all (key,val) couples from the hash store
  *
@@ -827,13 +1239,16 @@ hashtable_delall(struct hash_table *ht,
 	/* Successive partition numbers */
 	uint32_t index = 0;
 
+	if (ht_resizable(ht))
+		return hashtable_delall_buckets(ht, free_func);
+
 	for (index = 0; index < ht->parameter.index_size; index++) {
 		/* The root of each successive partition */
 		struct rbt_head *root = &ht->partitions[index].rbt;
 		/* Pointer to node in tree for removal */
 		struct rbt_node *cursor = NULL;
 
-		PTHREAD_RWLOCK_wrlock(&ht->partitions[index].lock);
+		partition_lock(ht, index, true);
 
 		/* Continue until there are no more entries in the red-black
 		   tree */
@@ -875,6 +1290,49 @@ hashtable_delall(struct hash_table *ht,
 	return HASHTABLE_SUCCESS;
 }
 
+/**
+ * @brief Log the entries of a resizable partition
+ *
+ * @param[in] component The component debugging config to use.
+ * @param[in] ht        The hashtable to be used.
+ * @param[in] index     The partition
+ */
+
+static void
+hashtable_log_buckets(log_components_t component, struct hash_table *ht,
+		      uint32_t index)
+{
+	struct hash_partition *partition = &ht->partitions[index];
+	struct hash_buckets *arrays[2] = { partition->buckets,
+					   partition->old };
+	struct hash_node *node;
+	char dispkey[HASHTABLE_DISPLAY_STRLEN];
+	char dispval[HASHTABLE_DISPLAY_STRLEN];
+	uint32_t a, bucket;
+
+	LogFullDebug(component,
+		     "The partition in position %" PRIu32
+		     " contains: %zu entries in %" PRIu32 " buckets%s",
+		     index, partition->count, partition->buckets->mask + 1,
+		     partition->old != NULL ? ", resizing" : "");
+
+	for (a = 0; a < 2 && arrays[a] != NULL; a++) {
+		for (bucket = 0; bucket <= arrays[a]->mask; bucket++) {
+			for (node = arrays[a]->bucket[bucket]; node != NULL;
+			     node = node->next) {
+				ht->parameter.key_to_str(&node->data.key,
+							 dispkey);
+				ht->parameter.val_to_str(&node->data.val,
+							 dispval);
+				LogFullDebug(component,
+					     "%s => %s; index=%" PRIu32
+					     " hash=%" PRIu64, dispkey,
+					     dispval, index, node->hash);
+			}
+		}
+	}
+}
+
 /**
  * @brief Log information about the hashtable
  *
@@ -916,6 +1374,10 @@ hashtable_log(log_components_t component, struct hash_table *ht)
 	LogFullDebug(component, "The hash contains %zd entries", nb_entries);
 
 	for (i = 0; i < ht->parameter.index_size; i++) {
+		if (ht_resizable(ht)) {
+			hashtable_log_buckets(component, ht, i);
+			continue;
+		}
 		root = &ht->partitions[i].rbt;
 		LogFullDebug(component,
 			     "The partition in position %" PRIu32
@@ -943,6 +1405,67 @@ hashtable_log(log_components_t component, struct hash_table *ht)
 	}
 }
 
+/**
+ * @brief Report occupancy and contention for every hash table
+ *
+ * @param[in] cb  Called once per table, with the table list locked
+ * @param[in] arg Passed to cb
+ */
+
+void
+hashtable_foreach(void (*cb)(const struct hash_table_stats *stats,
+			     void *arg),
+		  void *arg)
+{
+	struct hash_table_stats stats;
+	struct hash_table *ht;
+	struct glist_head *node;
+	uint64_t *entries;
+	uint32_t i;
+
+	PTHREAD_MUTEX_lock(&hashtables_mtx);
+	glist_for_each(node, &hashtables) {
+		ht = glist_entry(node, struct hash_table, link);
+
+		entries = gsh_calloc(ht->parameter.index_size,
+				     sizeof(uint64_t));
+		if (entries == NULL)
+			continue;
+
+		memset(&stats, 0, sizeof(stats));
+		stats.name = ht->parameter.ht_name != NULL
+		    ? ht->parameter.ht_name
+		    : "(unnamed)";
+		stats.partitions = ht->parameter.index_size;
+		stats.partition_entries = entries;
+
+		for (i = 0; i < ht->parameter.index_size; i++) {
+			entries[i] =
+			    atomic_fetch_size_t(&ht->partitions[i].count);
+			stats.entries += entries[i];
+			if (entries[i] > stats.max_partition)
+				stats.max_partition = entries[i];
+		}
+
+		for (i = 0; i < HT_COUNTER_STRIPES; i++) {
+			struct hash_counters *c = &ht->counters[i];
+
+			stats.lookups += atomic_fetch_uint64_t(&c->lookups);
+			stats.hits += atomic_fetch_uint64_t(&c->hits);
+			stats.inserts += atomic_fetch_uint64_t(&c->inserts);
+			stats.deletes += atomic_fetch_uint64_t(&c->deletes);
+			stats.lock_waits +=
+			    atomic_fetch_uint64_t(&c->lock_waits);
+			stats.lock_wait_ns +=
+			    atomic_fetch_uint64_t(&c->lock_wait_ns);
+		}
+
+		cb(&stats, arg);
+		gsh_free(entries);
+	}
+	PTHREAD_MUTEX_unlock(&hashtables_mtx);
+}
+
 /**
  * @brief Set a pair (key,value) into the Hash Table
  *
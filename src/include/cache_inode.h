@@ -79,6 +79,10 @@ struct cache_inode_parameter {
 	/** High water mark for cache entries.  Defaults to 100000,
 	    settable by Entries_HWMark. */
 	uint32_t entries_hwmark;
+	/** High water mark for the approximate bytes held by cache
+	    entries, their dirents and handles.  Defaults to 0 (no
+	    limit), settable by Entries_Bytes_HWMark. */
+	uint64_t entries_bytes_hwmark;
 	/** Base interval in seconds between runs of the LRU cleaner
 	    thread. Defaults to 60, settable with LRU_Run_Interval. */
 	time_t lru_run_interval;
@@ -121,6 +125,15 @@ struct cache_inode_parameter {
 	    client a partial reply based on what we have.
 	    Defaults to false, settable with Retry_Readdir */
 	bool retry_readdir;
+	/** Number of dirents read from the FSAL at a time to cache a
+	    directory, each batch a chunk the LRU may reclaim on its
+	    own.  0 reads and caches whole directories.  Defaults to
+	    128, settable with Dir_Chunk. */
+	uint32_t dir_chunk;
+	/** Number of directory chunks cached before the LRU thread
+	    reclaims the least recently read.  Defaults to 1000,
+	    settable with Chunks_HWMark. */
+	uint32_t chunks_hwmark;
 };
 
 /** @} */
@@ -157,20 +170,25 @@ enum lru_q_id {
 
 typedef struct cache_inode_lru__ {
 	enum lru_q_id qid;	/*< Queue identifier */
-	struct glist_head q;	/*< Link in the physical deque
-				   impelmenting a portion of the logical
-				   LRU. */
 	int32_t refcnt;		/*< Reference count.  This is signed to make
 				   mistakes easy to see. */
 	int32_t pin_refcnt;	/*< Unpin it only if this goes down to zero */
-	uint32_t flags;		/*< Flags for details of this entry's status,
-				 *< such as whether it is pinned and whether
-				 *< it's in L1 or L2. */
+	uint32_t l1_since;	/*< When the entry was put on L1, in
+				 *< seconds, to tell a reuse from the
+				 *< references of one burst. */
 	uint32_t lane;		/*< The lane in which an entry currently
 				 *< resides, so we can lock the deque and
 				 *< decrement the correct counter when moving
 				 *< or deleting the entry. */
 	uint32_t cf;		/*< Confounder */
+	struct glist_head q;	/*< Link in the physical deque
+				   impelmenting a portion of the logical
+				   LRU. */
+	uint64_t bytes;		/*< Approximate memory held by the entry,
+				 *< see cache_inode_lru_charge. */
+	int32_t export_id;	/*< Export the bytes are also charged to,
+				 *< or -1, see
+				 *< cache_inode_lru_charge_export. */
 } cache_inode_lru_t;
 
 /**
@@ -183,6 +201,11 @@ struct cache_stats {
 	uint64_t inode_conf;
 	uint64_t inode_added;
 	uint64_t inode_mapping;
+	uint64_t inode_ghost_l1;	/*< re-created after reclaim from L1 */
+	uint64_t inode_ghost_l2;	/*< re-created after reclaim from L2 */
+	uint64_t inode_evict_l1;	/*< reclaimed from L1 (probation) */
+	uint64_t inode_evict_l2;	/*< reclaimed from L2 (protected) */
+	uint64_t inode_evict_killed;	/*< pushed to cleanup */
 };
 
 extern struct cache_stats *cache_stp;
@@ -224,6 +247,8 @@ static const uint32_t CACHE_INODE_TRUST_ATTRS = 0x00000001;
 static const uint32_t CACHE_INODE_TRUST_CONTENT = 0x00000002;
 /** The directory has been populated (negative lookups are meaningful) */
 static const uint32_t CACHE_INODE_DIR_POPULATED = 0x00000004;
+/** The FSAL's cookies cannot locate chunks, cache the whole directory */
+static const uint32_t CACHE_INODE_DIR_NO_CHUNK = 0x00000008;
 
 /**
  * @brief The ref counted share reservation state.
@@ -311,6 +336,8 @@ cache_inode_key_delete(cache_inode_key_t *key)
 #define DIR_ENTRY_FLAG_NONE     0x0000
 #define DIR_ENTRY_FLAG_DELETED  0x0001
 
+struct cache_inode_dir_chunk;
+
 typedef struct cache_inode_dir_entry__ {
 	struct avltree_node node_hk;	/*< AVL node in tree */
 	struct {
@@ -319,9 +346,61 @@ typedef struct cache_inode_dir_entry__ {
 	} hk;
 	cache_inode_key_t ckey;	/*< Key of cache entry */
 	uint32_t flags;		/*< Flags */
+	/** Chunk the dirent was read in, NULL if cached by name only */
+	struct cache_inode_dir_chunk *chunk;
+	struct glist_head chunk_list;	/*< Link in the chunk */
+	struct avltree_node node_ck;	/*< AVL node in the cookie tree */
+	fsal_cookie_t ck;	/*< FSAL cookie, if in a chunk */
 	char name[];		/*< The NUL-terminated filename */
 } cache_inode_dir_entry_t;
 
+/**
+ * @brief A run of dirents read by one FSAL readdir
+ *
+ * With Dir_Chunk set, directory content is read into chunks of up to
+ * that many dirents, each read from the FSAL cookie its predecessor
+ * stopped at, and client cookies are the FSAL's.  A READDIR
+ * continuing from a cookie finds the dirent in the cookie tree and
+ * goes on from there, reading only the chunks missing.  Chunks are
+ * on an LRU of their own so a large directory can be reclaimed piece
+ * by piece.
+ *
+ * Deleted dirents stay in their chunk, marked DIR_ENTRY_FLAG_DELETED,
+ * so their cookie can still be continued from.  Names added are only
+ * cached by name, since where the FSAL will return them is not known,
+ * and make every chunk read before stale.  A READDIR reads a stale
+ * chunk again when it gets to it.  All fields are
+ * protected by the directory's content_lock, except lru which is
+ * protected by the chunk LRU lock.
+ */
+
+struct cache_inode_dir_chunk {
+	struct glist_head chunks;	/*< Link in the directory's chunks */
+	struct glist_head lru;		/*< Link in the chunk LRU */
+	struct glist_head dirents;	/*< Dirents in FSAL order */
+	cache_entry_t *parent;		/*< The directory */
+	struct cache_inode_dir_chunk *prev;	/*< Chunk read before */
+	struct cache_inode_dir_chunk *next;	/*< Chunk read after */
+	fsal_cookie_t whence;	/*< Cookie the chunk was read from */
+	fsal_cookie_t next_ck;	/*< Cookie to read the next chunk from */
+	uint32_t num_entries;	/*< Dirents in the chunk */
+	uint32_t gen;		/*< Names added gen when read */
+	bool eod;		/*< The chunk ends the directory */
+};
+
+/**
+ * @brief Chunks cached for a directory
+ *
+ * Allocated when the first chunk is read and freed with the last.
+ */
+
+struct cache_inode_dir_chunks {
+	struct avltree ck;	/*< Chunked dirents by FSAL cookie */
+	struct glist_head chunks;	/*< All chunks, in no order */
+	struct cache_inode_dir_chunk *first;	/*< Chunk read from 0 */
+	uint32_t gen;		/*< Bumped when a name is added */
+};
+
 /**
  * @brief Deep free a dirent.
  *
@@ -339,6 +418,20 @@ cache_inode_free_dirent(cache_inode_dir_entry_t *dirent)
 	gsh_free(dirent);
 }
 
+/**
+ * @brief Approximate the memory held by a dirent
+ *
+ * @param dirent [in] The dirent, with its name and key (if any).
+ *
+ * @return Bytes to charge to the directory holding it.
+ */
+static inline size_t
+cache_inode_dirent_bytes(cache_inode_dir_entry_t *dirent)
+{
+	return sizeof(cache_inode_dir_entry_t) + strlen(dirent->name) + 1 +
+	    dirent->ckey.kv.len;
+}
+
 /**
  * @brief Represents one of the many-many links between inodes and exports.
  *
@@ -372,6 +465,28 @@ struct file_deleg_stats {
 					   num_opens */
 };
 
+/**
+ * @brief State anchored on a cached inode
+ *
+ * Most cached inodes never carry state, so the lists are kept out of
+ * the entry and allocated when the state layer first pins it.  See
+ * cache_inode_inc_pin_ref.
+ */
+
+struct cache_inode_state_data {
+	/** States on this cache entry */
+	struct glist_head state_list;
+	/** Layout recalls on this entry */
+	struct glist_head layoutrecall_list;
+	/** Pointers for lock list */
+	struct glist_head lock_list;
+	/** Pointers for delegation list */
+	struct glist_head deleg_list;
+	/** Pointers for NLM share list */
+	struct glist_head nlm_share_list;
+	bool write_delegated; /* true iff write delegated */
+};
+
 /**
  * @brief Represents a cached inode
  *
@@ -384,8 +499,8 @@ struct file_deleg_stats {
  * (1) The attributes field is protected by attr_lock.
  *
  * (2) content_lock must be held for WRITE when modifying the AVL tree
- *     of a directory or any dirent contained therein.  It must be
- *     held for READ when accessing any of this information.
+ *     of a directory, its chunks or any dirent contained therein.  It
+ *     must be held for READ when accessing any of this information.
  *
  * (3) content_lock must be held for WRITE when caching or disposing
  *     of a file descriptor and when writing data into the Ganesha
@@ -404,6 +519,12 @@ struct file_deleg_stats {
  *     pinning must hold the state lock for read through the operation
  *     of moving the entry from one queue to another.
  *
+ * (6) The state_data pointer is set only by cache_inode_inc_pin_ref,
+ *     under the lane lock, and reset by cache_inode_lru_clean.  Until
+ *     the entry is first pinned it points at an empty block shared by
+ *     all entries, which may be examined but never modified.
+ *     Everything that adds state pins the entry first.
+ *
  * The handle, cache key, and type fields are unprotected, as they are
  * considered to be immutable throughout the life of the object.
  *
@@ -428,23 +549,25 @@ struct file_deleg_stats {
  * fsal_obj_handle are two parts of the same thing, a cached inode.
  * cache_entry holds the cache stuff and fsal_obj_handle holds the
  * stuff the the fsal has to manage, i.e. filesystem bits.
+ *
+ * The fields used by lookup, getattr and the LRU come first, so that a
+ * hit touches the first cache lines only.  The locks and the
+ * type-specific data follow.
  */
 
 struct cache_entry_t {
-	/** Reader-writer lock for attributes */
-	pthread_rwlock_t attr_lock;
 	/** The FSAL Handle */
 	struct fsal_obj_handle *obj_handle;
+	/** The type of the entry */
+	object_file_type_t type;
+	/** Flags for this entry */
+	uint32_t flags;
 	/** FH hash linkage */
 	struct {
 		struct avltree_node node_k;	/*< AVL node in tree */
 		cache_inode_key_t key;	/*< Key of this entry */
 		bool inavl;
 	} fh_hk;
-	/** The type of the entry */
-	object_file_type_t type;
-	/** Flags for this entry */
-	uint32_t flags;
 	/** The time of the last operation ganesha knows about.  We
 	    can ue this for change_info4, but atomic MUST be set to
 	    false.  Don't use it for anything else (servicing getattr,
@@ -452,12 +575,20 @@ struct cache_entry_t {
 	time_t change_time;
 	/** Time at which we last refreshed attributes. */
 	time_t attr_time;
+	/** Atomic pointer to the first mapped export for fast path */
+	void *first_export;
 	/** New style LRU link */
 	cache_inode_lru_t lru;
+	/** State, lock and share lists, see locking discipline */
+	struct cache_inode_state_data *state_data;
 	/** There is one export root reference counted for each export
 	    for which this entry is a root for. This field is used
 	    with the atomic inc/dec/fetch routines. */
 	int32_t exp_root_refcount;
+	/** Exports per entry (protected by attr_lock) */
+	struct glist_head export_list;
+	/** Reader-writer lock for attributes */
+	pthread_rwlock_t attr_lock;
 	/** This is separated out from the content lock, since there
 	    are state oerations that don't affect anything guarded by
 	    content (for example, a layout return or request has no
@@ -465,14 +596,6 @@ struct cache_entry_t {
 	    be released and reacquired several times in an operation
 	    that should not see changes in state. */
 	pthread_rwlock_t state_lock;
-	/** States on this cache entry */
-	struct glist_head state_list;
-	/** Exports per entry (protected by attr_lock) */
-	struct glist_head export_list;
-	/** Atomic pointer to the first mapped export for fast path */
-	void *first_export;
-	/** Layout recalls on this entry */
-	struct glist_head layoutrecall_list;
 	/** Lock on type-specific cached content.  See locking
 	    discipline for details. */
 	pthread_rwlock_t content_lock;
@@ -481,22 +604,23 @@ struct cache_entry_t {
 	    attributes.rawdev */
 	union cache_inode_fsobj {
 		struct cache_inode_file {
-			/** Pointers for lock list */
-			struct glist_head lock_list;
-			/** Pointers for delegation list */
-			struct glist_head deleg_list;
-			/** Pointers for NLM share list */
-			struct glist_head nlm_share_list;
-			/** Share reservation state for this file. */
+			/** Share reservation state for this file.  Kept
+			    here as anonymous I/O counts itself in it
+			    without pinning the entry. */
 			cache_inode_share_t share_state;
-			bool write_delegated; /* true iff write delegated */
 			/** Delegation statistics */
 			struct file_deleg_stats fdeleg_stats;
+			/** Asynchronous I/Os in flight.  The FSAL file
+			    must not be closed or reopened while
+			    non-zero, see cache_inode_io_drain. */
+			uint32_t io_inflight;
 		} file;		/*< REGULAR_FILE data */
 
 		struct {
 			/** Number of known active children */
 			uint32_t nbactive;
+			/** Heuristic. Expect 0. */
+			uint32_t collisions;
 			/** The parent of this directory ('..') */
 			cache_inode_key_t parent;
 			struct {
@@ -504,9 +628,9 @@ struct cache_entry_t {
 				struct avltree t;
 				/** Persist cookies */
 				struct avltree c;
-				/** Heuristic. Expect 0. */
-				uint32_t collisions;
 			} avl;
+			/** Content cached in chunks, NULL if none */
+			struct cache_inode_dir_chunks *chunks;
 			/** If this is a junction, the export this node points
 			    to. Protected by the attr_lock. */
 			struct gsh_export *junction_export;
@@ -517,6 +641,46 @@ struct cache_entry_t {
 	} object;
 };
 
+struct cache_inode_io;
+
+/**
+ * @brief Completion callback of cache_inode_rdwr_async
+ *
+ * Called once the FSAL I/O is over, possibly from an FSAL thread
+ * without op_ctx.  It must not block; the I/O is completed by
+ * calling cache_inode_rdwr_finish from a thread with the request's
+ * op_ctx.
+ *
+ * @param[in] io         The I/O
+ * @param[in] caller_arg Argument given to cache_inode_rdwr_async
+ */
+typedef void (*cache_inode_io_cb)(struct cache_inode_io *io,
+				  void *caller_arg);
+
+/**
+ * @brief An asynchronous read or write through the cache layer
+ *
+ * The caller fills in entry, io_direction, sync and the offset,
+ * io_size, buffer and info of fsal; the rest belongs to
+ * cache_inode_rdwr_async and cache_inode_rdwr_finish.
+ */
+
+struct cache_inode_io {
+	cache_entry_t *entry;	/*< File to be read or written */
+	cache_inode_io_direction_t io_direction;	/*< What to do */
+	bool sync;		/*< In, whether a write must be stable.
+				    Out, whether it was. */
+	bool opened;		/*< The I/O opened a closed file */
+	bool need_commit;	/*< Commit after an unstable write */
+	bool commit_deferred;	/*< The FSAL has no commit_async, the
+				    commit is left to
+				    cache_inode_rdwr_finish */
+	struct fsal_io_arg fsal;	/*< FSAL arguments and results */
+	fsal_status_t fsal_status;	/*< Result of the FSAL I/O */
+	cache_inode_io_cb done_cb;	/*< Completion callback */
+	void *caller_arg;	/*< Argument of the completion callback */
+};
+
 /**
  * Data to be used as the key into the cache_entry hash table.
  */
@@ -532,6 +696,7 @@ typedef struct cache_inode_fsal_data {
 
 /** Cache entries pool */
 extern pool_t *cache_inode_entry_pool;
+extern struct cache_inode_state_data cache_inode_no_state;
 
 /**
  * Type-specific data passed to cache_inode_new_entry
@@ -846,6 +1011,14 @@ cache_inode_status_t cache_inode_rdwr_plus(cache_entry_t *entry,
 				      bool *eof,
 				      bool *sync, struct io_info *info);
 
+cache_inode_status_t cache_inode_rdwr_async(struct cache_inode_io *io,
+					    cache_inode_io_cb done_cb,
+					    void *caller_arg);
+
+cache_inode_status_t cache_inode_rdwr_finish(struct cache_inode_io *io);
+
+void cache_inode_io_drain(cache_entry_t *entry);
+
 cache_inode_status_t cache_inode_commit(cache_entry_t *entry, uint64_t offset,
 					size_t count);
 
@@ -874,6 +1047,45 @@ cache_inode_status_t cache_inode_invalidate_all_cached_dirent(
 void cache_inode_release_dirents(cache_entry_t *entry,
 				 cache_inode_avl_which_t which);
 
+void cache_inode_release_dir_chunk(cache_entry_t *directory,
+				   struct cache_inode_dir_chunk *chunk);
+void cache_inode_release_dir_chunks(cache_entry_t *directory);
+
+/**
+ * @brief Return true if the directory's content is cached in chunks
+ *
+ * @param[in] directory The directory
+ */
+static inline bool cache_inode_dir_chunked(cache_entry_t *directory)
+{
+	return cache_param.dir_chunk != 0 &&
+	    !(directory->flags & CACHE_INODE_DIR_NO_CHUNK);
+}
+
+/**
+ * @brief Make the chunks of a directory stale after adding a name
+ *
+ * The content lock must be held for write.
+ *
+ * @param[in,out] directory The directory
+ */
+static inline void cache_inode_dir_chunks_stale(cache_entry_t *directory)
+{
+	if (directory->object.dir.chunks != NULL)
+		directory->object.dir.chunks->gen++;
+}
+
+/**
+ * @brief Return true if a chunk was read before a name was added
+ *
+ * @param[in] chunk The chunk
+ */
+static inline bool
+cache_inode_dir_chunk_stale(struct cache_inode_dir_chunk *chunk)
+{
+	return chunk->gen != chunk->parent->object.dir.chunks->gen;
+}
+
 void cache_inode_kill_entry(cache_entry_t *entry);
 
 cache_inode_status_t cache_inode_invalidate(cache_entry_t *entry,
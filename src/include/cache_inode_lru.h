@@ -48,11 +48,15 @@
  *
  * This module implements a constant-time cache management strategy
  * based on LRU.  Some ideas are taken from 2Q [Johnson and Shasha 1994]
- * and MQ [Zhou, Chen, Li 2004].  In this system, cache management does
- * interact with cache entry lifecycle.  Also, the cache size high- and
- * low- water mark management is maintained, but executes asynchronously
- * to avoid inline request delay.  Cache management operations execute in
- * constant time, as expected with LRU (and MQ).
+ * and ARC [Megiddo and Modha 2003].  New entries enter a probationary
+ * L1; only entries re-created shortly after being reclaimed (a hit in
+ * the ghost set of recently reclaimed keys) are admitted to the
+ * protected L2, and the L1 target size adapts to which ghosts are hit.
+ * In this system, cache management does interact with cache entry
+ * lifecycle.  Also, the cache size high- and low- water mark management
+ * is maintained, but executes asynchronously to avoid inline request
+ * delay.  Cache management operations execute in constant time, as
+ * expected with LRU.
  *
  * Cache entries in use by a currently-active protocol request (or other
  * operation) have a positive refcount, and threfore should not be present
@@ -64,9 +68,34 @@
  *
  */
 
+/**
+ * Entries and bytes charged to an export, approximate
+ */
+
+struct lru_export_bytes {
+	int64_t entries;
+	int64_t bytes;
+};
+
+/**
+ * Export ids per block of lru_export_bytes.  Blocks are allocated as
+ * the exports in them are first charged, so a few exports cost a few
+ * KiB rather than counters for every possible export_id.
+ */
+
+#define LRU_EXPORT_BYTES_BLOCK 256
+
 struct lru_state {
 	uint64_t entries_hiwat;
 	uint64_t entries_used;
+	uint64_t bytes_hiwat;	/* 0 if only entries are bounded */
+	uint64_t bytes_used;
+	struct lru_export_bytes *export_bytes[(UINT16_MAX + 1) /
+					      LRU_EXPORT_BYTES_BLOCK];
+						/* by export_id, see
+						   lru_export_bytes */
+	uint64_t chunks_hiwat;
+	uint64_t chunks_used;	/* protected by the chunk LRU lock */
 	uint32_t fds_system_imposed;
 	uint32_t fds_hard_limit;
 	uint32_t fds_hiwat;
@@ -77,6 +106,9 @@ struct lru_state {
 	uint32_t futility;
 	uint32_t per_lane_work;
 	uint32_t biggest_window;
+	/** Adaptive target size of all L1 lanes together.  Reclaim
+	    takes from L1 while it is larger, else from L2. */
+	uint64_t l1_target;
 	uint64_t prev_fd_count;	/* previous # of open fds */
 	time_t prev_time;	/* previous time the gc thread was run. */
 	bool caching_fds;
@@ -131,6 +163,8 @@ extern int cache_inode_lru_pkgshutdown(void);
 extern size_t open_fd_count;
 
 cache_inode_status_t cache_inode_lru_get(struct cache_entry_t **entry);
+void cache_inode_lru_admit(cache_entry_t *entry);
+void cache_inode_lru_sizes(uint64_t *l1, uint64_t *l2);
 void cache_inode_lru_ref(cache_entry_t *entry, uint32_t flags);
 
 /* XXX */
@@ -141,11 +175,101 @@ void cache_inode_lru_cleanup_try_push(cache_entry_t *entry);
 void cache_inode_lru_unref(cache_entry_t *entry, uint32_t flags);
 void cache_inode_lru_putback(cache_entry_t *entry, uint32_t flags);
 void lru_wake_thread(void);
+void cache_inode_lru_chunk_insert(struct cache_inode_dir_chunk *chunk);
+void cache_inode_lru_chunk_ref(struct cache_inode_dir_chunk *chunk);
+void cache_inode_lru_chunk_remove(struct cache_inode_dir_chunk *chunk);
 cache_inode_status_t cache_inode_inc_pin_ref(cache_entry_t *entry);
 void cache_inode_unpinnable(cache_entry_t *entry);
 void cache_inode_dec_pin_ref(cache_entry_t *entry, bool closefile);
 bool cache_inode_is_pinned(cache_entry_t *entry);
 void cache_inode_lru_kill_for_shutdown(cache_entry_t *entry);
+void cache_inode_lru_charge_export(cache_entry_t *entry, int32_t export_id);
+struct lru_export_bytes *lru_export_bytes_alloc(uint16_t export_id);
+
+/**
+ * @brief Find the counters of an export
+ *
+ * @param[in] export_id The export
+ *
+ * @return The counters, NULL if the export was never charged.
+ */
+
+static inline struct lru_export_bytes *lru_export_bytes(uint16_t export_id)
+{
+	struct lru_export_bytes *block =
+	    atomic_fetch_voidptr((void **)&lru_state.export_bytes[
+					 export_id / LRU_EXPORT_BYTES_BLOCK]);
+
+	if (block == NULL)
+		return NULL;
+
+	return &block[export_id % LRU_EXPORT_BYTES_BLOCK];
+}
+
+/**
+ * @brief Take bytes off a byte count
+ *
+ * Every credit matches an earlier charge, so a count wrapping below
+ * 0 is a bug in the accounting.
+ *
+ * @param[in,out] var   The count
+ * @param[in]     bytes Bytes to take off
+ */
+
+static inline void lru_bytes_sub(uint64_t *var, uint64_t bytes)
+{
+	uint64_t left = atomic_sub_uint64_t(var, bytes);
+
+	if (unlikely(left + bytes < bytes))
+		LogCrit(COMPONENT_CACHE_INODE_LRU,
+			"Byte count %p credited %" PRIu64
+			" more than it was charged", var, -left);
+}
+
+/**
+ * @brief Charge or credit memory held by an entry
+ *
+ * Entries account for what they hold (the entry itself, its key and
+ * FSAL handle, cached dirents) so the LRU can bound the cache by
+ * bytes as well as entries.  Crossing the byte high water mark wakes
+ * the LRU thread to reclaim.  The export the entry is charged to, if
+ * any, is charged as well.
+ *
+ * @param[in] entry  The entry
+ * @param[in] delta  Bytes gained (positive) or released (negative)
+ */
+
+static inline void cache_inode_lru_charge(cache_entry_t *entry,
+					  int64_t delta)
+{
+	int32_t export_id = atomic_fetch_int32_t(&entry->lru.export_id);
+	uint64_t used;
+
+	if (export_id >= 0)
+		atomic_add_int64_t(&lru_export_bytes(export_id)->bytes, delta);
+
+	if (delta >= 0) {
+		atomic_add_uint64_t(&entry->lru.bytes, delta);
+		used = atomic_add_uint64_t(&lru_state.bytes_used, delta);
+		if (lru_state.bytes_hiwat && used >= lru_state.bytes_hiwat &&
+		    used - delta < lru_state.bytes_hiwat)
+			lru_wake_thread();
+	} else {
+		lru_bytes_sub(&entry->lru.bytes, -delta);
+		lru_bytes_sub(&lru_state.bytes_used, -delta);
+	}
+}
+
+/**
+ * Return true if the cache holds more than its byte budget.
+ */
+
+static inline bool cache_inode_lru_over_bytes(void)
+{
+	return lru_state.bytes_hiwat &&
+	    atomic_fetch_uint64_t(&lru_state.bytes_used) >
+	    lru_state.bytes_hiwat;
+}
 
 /**
  * Return true if there are FDs available to serve open requests,
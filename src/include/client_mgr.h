@@ -39,11 +39,16 @@
 #ifndef CLIENT_MGR_H
 #define CLIENT_MGR_H
 
+#include "token_bucket.h"
+
 struct gsh_client {
 	struct avltree_node node_k;
 	pthread_rwlock_t lock;
 	struct gsh_buffdesc addr;
 	int64_t refcnt;
+	uint32_t in_service;	/*< requests dequeued and not yet done */
+	struct token_bucket ops_tb;	/*< against Client_Ops_Rate */
+	struct token_bucket bytes_tb;	/*< against Client_Bytes_Rate */
 	nsecs_elapsed_t last_update;
 	char *hostaddr_str;
 	unsigned char addrbuf[];
@@ -55,6 +60,12 @@ void dbus_client_init(void);
 #endif
 struct gsh_client *get_gsh_client(sockaddr_t *client_ipaddr, bool lookup_only);
 void put_gsh_client(struct gsh_client *client);
+
+static inline void get_gsh_client_ref(struct gsh_client *client)
+{
+	atomic_inc_int64_t(&client->refcnt);
+}
+
 int foreach_gsh_client(bool(*cb) (struct gsh_client *cl, void *state),
 		       void *state);
 
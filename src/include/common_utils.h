@@ -11,6 +11,7 @@
 #define COMMON_UTILS_H
 
 #include <time.h>
+#include <errno.h>
 #include <assert.h>
 #include <string.h>
 #include <stdbool.h>
@@ -128,6 +129,52 @@ extern int portable_clock_gettime(struct timespec *ts);
 		}							\
 	} while (0)							\
 
+/**
+ * @brief Logging write-lock attempt
+ *
+ * @param[in,out] _lock Read-write lock
+ * @param[out]    _rc   0 if the lock was taken, EBUSY if it is held
+ */
+
+#define PTHREAD_RWLOCK_trywrlock(_lock, _rc)				\
+	do {								\
+		_rc = pthread_rwlock_trywrlock(_lock);			\
+		if (_rc == 0) {						\
+			LogFullDebug(COMPONENT_RW_LOCK,			\
+				     "Got write lock on %p (%s) "	\
+				     "at %s:%d", _lock, #_lock,		\
+				     __FILE__, __LINE__);		\
+		} else if (_rc != EBUSY) {				\
+			LogCrit(COMPONENT_RW_LOCK,			\
+				"Error %d, write locking %p (%s) "	\
+				"at %s:%d", _rc, _lock, #_lock,		\
+				__FILE__, __LINE__);			\
+		}							\
+	} while (0)							\
+
+/**
+ * @brief Logging read-lock attempt
+ *
+ * @param[in,out] _lock Read-write lock
+ * @param[out]    _rc   0 if the lock was taken, EBUSY if it is held
+ */
+
+#define PTHREAD_RWLOCK_tryrdlock(_lock, _rc)				\
+	do {								\
+		_rc = pthread_rwlock_tryrdlock(_lock);			\
+		if (_rc == 0) {						\
+			LogFullDebug(COMPONENT_RW_LOCK,			\
+				     "Got read lock on %p (%s) "	\
+				     "at %s:%d", _lock, #_lock,		\
+				     __FILE__, __LINE__);		\
+		} else if (_rc != EBUSY) {				\
+			LogCrit(COMPONENT_RW_LOCK,			\
+				"Error %d, read locking %p (%s) "	\
+				"at %s:%d", _rc, _lock, #_lock,		\
+				__FILE__, __LINE__);			\
+		}							\
+	} while (0)							\
+
 /**
  * @brief Logging read-write lock unlock
  *
@@ -49,6 +49,7 @@
 #cmakedefine HAVE_INCLUDE_LIBLUSTREAPI_H 1
 #cmakedefine HAVE_DAEMON 1
 #cmakedefine USE_LTTNG 1
+#cmakedefine USE_IO_URING 1
 
 #define NFS_GANESHA 1
 
@@ -38,6 +38,7 @@
 
 #include "ganesha_list.h"
 #include "cache_inode.h"
+#include "token_bucket.h"
 
 #ifndef EXPORT_MGR_H
 #define EXPORT_MGR_H
@@ -126,6 +127,19 @@ struct gsh_export {
 	/** Expiration time interval in seconds for attributes.  Settable with
 	    Attr_Expiration_Time. */
 	int32_t expire_time_attr;
+	/** Share of the request queues given to this export relative
+	    to the others.  Settable with Sched_Weight. */
+	uint32_t sched_weight;
+	/** Operations per second allowed on the export, 0 for no
+	    limit.  Settable with Ops_Rate. */
+	uint64_t ops_rate;
+	/** READ and WRITE bytes per second allowed on the export, 0
+	    for no limit.  Settable with Bytes_Rate. */
+	uint64_t bytes_rate;
+	/** Operations charged against ops_rate */
+	struct token_bucket ops_tb;
+	/** Bytes charged against bytes_rate */
+	struct token_bucket bytes_tb;
 	/** Export_Id for this export */
 	uint16_t export_id;
 };
@@ -138,6 +152,10 @@ struct gsh_export *alloc_export(void);
 void free_export(struct gsh_export *export);
 bool insert_gsh_export(struct gsh_export *export);
 struct gsh_export *get_gsh_export(uint16_t export_id);
+uint32_t gsh_export_gen(void);
+nsecs_elapsed_t gsh_export_admit(struct gsh_export *export, uint64_t bytes,
+				 nsecs_elapsed_t now, nsecs_elapsed_t burst,
+				 bool police, uint32_t *weight);
 struct gsh_export *get_gsh_export_by_path(char *path, bool exact_match);
 struct gsh_export *get_gsh_export_by_path_locked(char *path,
 						 bool exact_match);
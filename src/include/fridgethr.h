@@ -69,6 +69,8 @@ struct fridgethr_entry {
 		sigset_t sigmask;	/*< This thread's signal mask */
 		bool woke;	/*< Set to false on first run and if wait
 				   in fridgethr_freeze didn't time out. */
+		bool retire;	/*< Exit once the run function returns,
+				   set by fridgethr_retire. */
 		void *thread_info;	/*< Information belonging to the
 					   user and associated with the
 					   thread.  Never modified by the
@@ -202,6 +204,7 @@ struct fridgethr {
 	uint32_t nthreads;	/*< Number of threads in fridge */
 	struct glist_head idle_q;	/*< Idle threads */
 	uint32_t nidle;		/*< Number of idle threads */
+	uint32_t nretiring;	/*< Threads marked to retire */
 	uint32_t flags;		/*< Fridge-wide flags */
 	fridgethr_comm_t command;	/*< Command state */
 	void (*cb_func) (void *);	/*< Callback on command completion */
@@ -244,6 +247,7 @@ int fridgethr_start(struct fridgethr *, pthread_mutex_t *, pthread_cond_t *,
 		    void (*)(void *), void *);
 int fridgethr_sync_command(struct fridgethr *, fridgethr_comm_t, time_t);
 bool fridgethr_you_should_break(struct fridgethr_context *);
+bool fridgethr_retire(struct fridgethr_context *);
 int fridgethr_populate(struct fridgethr *, void (*)(struct fridgethr_context *),
 		      void *);
 
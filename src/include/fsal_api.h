@@ -309,7 +309,7 @@
  * rules), increment the minor version
  */
 
-#define FSAL_MINOR_VERSION 0
+#define FSAL_MINOR_VERSION 2
 
 /* Forward references for object methods */
 
@@ -353,6 +353,41 @@ struct io_hints {
 	uint32_t hints;
 };
 
+/**
+ * @brief Arguments and results of an asynchronous read or write
+ *
+ * The structure must stay valid until the completion callback has
+ * been called.
+ */
+
+struct fsal_io_arg {
+	uint64_t offset;	/*< Position of the I/O */
+	size_t io_size;		/*< Amount of data to be moved */
+	void *buffer;		/*< Buffer to read into or write from */
+	size_t io_amount;	/*< Amount of data actually moved */
+	bool end_of_file;	/*< A read reached the end of file */
+	bool fsal_stable;	/*< In, a write must reach stable storage.
+				    Out, whether it did. */
+	struct io_info *info;	/*< READ_PLUS/WRITE_PLUS information, or
+				    NULL for a plain read or write */
+};
+
+/**
+ * @brief Completion callback of an asynchronous FSAL operation
+ *
+ * The callback may be called from the thread that started the
+ * operation, before the operation method returns, or later from a
+ * thread of the FSAL's choosing where op_ctx is not set.  It must
+ * not block.
+ *
+ * @param[in] obj_hdl    The object the operation was done on
+ * @param[in] ret        Result of the operation
+ * @param[in] caller_arg Argument given when starting the operation
+ */
+
+typedef void (*fsal_async_cb)(struct fsal_obj_handle *obj_hdl,
+			      fsal_status_t ret, void *caller_arg);
+
 /**
  * @brief FSAL object definition
  *
@@ -1209,6 +1244,31 @@ typedef uint64_t fsal_cookie_t;
 
 typedef bool(*fsal_readdir_cb) (const char *name, void *dir_state,
 				fsal_cookie_t cookie);
+
+/**
+ * @brief Callback receiving an entry from readdir_plus
+ *
+ * The callback owns obj whatever it returns and must release it if
+ * it does not keep it.
+ *
+ * @param[in]     name      Name of the directory entry
+ * @param[in]     obj       Handle of the entry, with its attributes
+ *                          filled in, or NULL if it could not be
+ *                          looked up
+ * @param[in]     status    Why the entry could not be looked up
+ * @param[in,out] dir_state Opaque pointer passed to readdir_plus
+ * @param[in]     cookie    Directory cookie
+ *
+ * @retval true if more entries are required
+ * @retval false if no more entries are required (and the current one
+ *               has not been consumed)
+ */
+
+typedef bool(*fsal_readdir_plus_cb) (const char *name,
+				     struct fsal_obj_handle *obj,
+				     fsal_status_t status,
+				     void *dir_state,
+				     fsal_cookie_t cookie);
 /**
  * @brief FSAL objectoperations vector
  */
@@ -2045,6 +2105,108 @@ struct fsal_obj_ops {
 				  const struct fsal_layoutcommit_arg *arg,
 				  struct fsal_layoutcommit_res *res);
 /**@}*/
+
+/**@{*/
+
+/**
+ * Asynchronous I/O functions
+ *
+ * These start an I/O and report its result through a callback,
+ * letting the worker thread that started it go on with other
+ * requests.  If the method returns an error, the callback is never
+ * called.  Otherwise it is called exactly once, see fsal_async_cb.
+ *
+ * The default read and write methods do the I/O synchronously
+ * through read, read_plus, write and write_plus and call the
+ * callback before returning, so FSALs that do not provide these keep
+ * their synchronous behaviour.  An FSAL providing write_async should
+ * also provide commit_async, which may be started from the completion
+ * of a stable write; the default returns ERR_FSAL_NOTSUPP, and the
+ * commit is then done synchronously by the worker thread that
+ * finishes the write.
+ */
+
+/**
+ * @brief Start reading data from a file
+ *
+ * @param[in]     obj_hdl    File to read
+ * @param[in,out] io         Read arguments, and results on completion.
+ *                           If io->info is set, this is a READ_PLUS.
+ * @param[in]     done_cb    Completion callback
+ * @param[in]     caller_arg Argument for the completion callback
+ *
+ * @return FSAL status of starting the read.
+ */
+	 fsal_status_t(*read_async) (struct fsal_obj_handle *obj_hdl,
+				     struct fsal_io_arg *io,
+				     fsal_async_cb done_cb,
+				     void *caller_arg);
+
+/**
+ * @brief Start writing data to a file
+ *
+ * @param[in]     obj_hdl    File to be written
+ * @param[in,out] io         Write arguments, and results on completion.
+ *                           If io->info is set, this is a WRITE_PLUS.
+ * @param[in]     done_cb    Completion callback
+ * @param[in]     caller_arg Argument for the completion callback
+ *
+ * @return FSAL status of starting the write.
+ */
+	 fsal_status_t(*write_async) (struct fsal_obj_handle *obj_hdl,
+				      struct fsal_io_arg *io,
+				      fsal_async_cb done_cb,
+				      void *caller_arg);
+
+/**
+ * @brief Start committing written data
+ *
+ * @param[in] obj_hdl    File to commit
+ * @param[in] offset     Start of range to commit
+ * @param[in] len        Length of range to commit
+ * @param[in] done_cb    Completion callback
+ * @param[in] caller_arg Argument for the completion callback
+ *
+ * @return FSAL status of starting the commit, ERR_FSAL_NOTSUPP if
+ *         the caller must commit synchronously.
+ */
+	 fsal_status_t(*commit_async) (struct fsal_obj_handle *obj_hdl,
+				       off_t offset, size_t len,
+				       fsal_async_cb done_cb,
+				       void *caller_arg);
+/**@}*/
+
+/**@{*/
+
+/**
+ * Batch directory reading
+ */
+
+/**
+ * @brief Read a directory with the handles of its entries
+ *
+ * This function reads directory entries from the FSAL and supplies
+ * each to a callback together with its looked up handle, as readdir
+ * followed by a lookup of each name would.  FSALs that can get a
+ * handle and attributes along with the names, or more cheaply than a
+ * lookup from scratch, should provide it.  The default method calls
+ * lookup for each name readdir returns.
+ *
+ * @param[in]  dir_hdl   Directory to read
+ * @param[in]  whence    Point at which to start reading.  NULL to
+ *                       start at beginning.
+ * @param[in]  dir_state Opaque pointer to be passed to callback
+ * @param[in]  cb        Callback to receive entries
+ * @param[out] eof       true if the last entry was reached
+ *
+ * @return FSAL status.
+ */
+	 fsal_status_t(*readdir_plus) (struct fsal_obj_handle *dir_hdl,
+				       fsal_cookie_t *whence,
+				       void *dir_state,
+				       fsal_readdir_plus_cb cb,
+				       bool *eof);
+/**@}*/
 };
 
 /**
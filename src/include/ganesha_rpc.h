@@ -149,12 +149,18 @@ const char *str_gc_proc(rpc_gss_proc_t);
 #define XPRT_PRIVATE_FLAG_STALLED 0x0010	/* ie, -on stallq- */
 
 struct drc;
+struct gsh_client;
+struct gsh_export;
 typedef struct gsh_xprt_private {
 	SVCXPRT *xprt;
 	uint32_t flags;
 	uint32_t req_cnt; /*< outstanding requests counter */
 	struct drc *drc; /*< TCP DRC */
 	struct glist_head stallq;
+	uint64_t throttle_until; /*< not read until then (tb_now ns) */
+	struct gsh_client *client; /*< connection's client, decoder only */
+	struct gsh_export *export; /*< its last export, decoder only */
+	uint32_t export_gen; /*< gsh_export_gen when export was found */
 } gsh_xprt_private_t;
 
 static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
@@ -166,11 +172,17 @@ static inline gsh_xprt_private_t *alloc_gsh_xprt_private(SVCXPRT *xprt,
 	xu->flags = XPRT_PRIVATE_FLAG_NONE;
 	xu->req_cnt = 0;
 	xu->drc = NULL;
+	xu->throttle_until = 0;
+	xu->client = NULL;
+	xu->export = NULL;
+	xu->export_gen = 0;
 
 	return xu;
 }
 
 void nfs_dupreq_put_drc(SVCXPRT *, struct drc *, uint32_t);
+void put_gsh_client(struct gsh_client *);
+void put_gsh_export(struct gsh_export *);
 
 #ifndef DRC_FLAG_RELEASE
 #define DRC_FLAG_RELEASE 0x0040
@@ -182,6 +194,10 @@ static inline void free_gsh_xprt_private(SVCXPRT *xprt)
 	if (xu) {
 		if (xu->drc)
 			nfs_dupreq_put_drc(xprt, xu->drc, DRC_FLAG_RELEASE);
+		if (xu->client)
+			put_gsh_client(xu->client);
+		if (xu->export)
+			put_gsh_export(xu->export);
 		gsh_free(xu);
 		xprt->xp_u1 = NULL;
 	}
@@ -0,0 +1,66 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file   gsh_affinity.h
+ * @brief  CPU and NUMA placement of server threads
+ *
+ * Each class of server thread may be confined to a set of CPUs with
+ * the NFS_CORE_PARAM options Event_Channel_CPUs, Decoder_CPUs,
+ * Worker_CPUs and LRU_CPUs.  With NUMA_Affinity set, request queue
+ * shards are also spread over the NUMA nodes: a worker runs only on
+ * the CPUs of its shard's node, a decoder enqueues on a shard of its
+ * own node, and workers steal from shards of their own node before
+ * remote ones.  Threads bound to a node allocate from it, by the
+ * kernel's first touch policy, so their magazines and slabs stay
+ * local too.
+ *
+ * The topology is read from sysfs, so no NUMA library is needed;
+ * elsewhere everything is a single node and binding does nothing.
+ */
+
+#ifndef GSH_AFFINITY_H
+#define GSH_AFFINITY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Classes of thread that may be placed
+ */
+enum gsh_affinity_class {
+	GSH_AFFINITY_EVCHAN,	/*< event channel (svc_rqst) threads */
+	GSH_AFFINITY_DECODER,	/*< decoder fridge threads */
+	GSH_AFFINITY_WORKER,	/*< worker fridge threads */
+	GSH_AFFINITY_LRU,	/*< cache_inode LRU thread */
+	GSH_AFFINITY_CLASSES
+};
+
+void gsh_affinity_init(void);
+bool gsh_numa_enabled(void);
+uint32_t gsh_numa_nodes(void);
+int gsh_cpu_node(int cpu);
+uint32_t gsh_ncpus(void);
+void gsh_bind_thread(enum gsh_affinity_class cls, int node);
+void gsh_numa_place(void *addr, size_t len, int node);
+
+#endif				/* GSH_AFFINITY_H */
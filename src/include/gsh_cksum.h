@@ -0,0 +1,42 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file   gsh_cksum.h
+ * @brief  Fast non-cryptographic checksum
+ *
+ * A checksum for telling buffers apart, not for hashing keys into
+ * tables: it is laid out as independent lanes of 32x32->64 bit
+ * multiply-accumulate, which the compiler turns into SIMD, so it
+ * runs several times faster than CityHash on long buffers.  The
+ * value depends on the host's byte order, so it must not leave the
+ * process.
+ */
+
+#ifndef GSH_CKSUM_H
+#define GSH_CKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t gsh_cksum64(const void *buf, size_t len, uint64_t seed);
+
+#endif				/* GSH_CKSUM_H */
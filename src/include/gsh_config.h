@@ -81,6 +81,26 @@ typedef enum protos {
  */
 #define NB_WORKER_THREAD_DEFAULT 16
 
+/**
+ * @brief Default value for core_param.worker_grow_wait (usecs)
+ */
+#define WORKER_GROW_WAIT_DEFAULT 10000
+
+/**
+ * @brief Default value for core_param.rate_limit_burst (msecs)
+ */
+#define RATE_LIMIT_BURST_DEFAULT 100
+
+/**
+ * @brief Default value for core_param.worker_spin (usecs)
+ */
+#define WORKER_SPIN_DEFAULT 20
+
+/**
+ * @brief Default value for core_param.io_buf_cache_size (bytes)
+ */
+#define IO_BUF_CACHE_SIZE_DEFAULT (64 * 1024 * 1024)
+
 /**
  * @brief Default value for core_param.drc.tcp.npart
  */
@@ -141,6 +161,11 @@ typedef enum protos {
  */
 #define DRC_UDP_CHECKSUM true
 
+/**
+ * @brief Default value for core_param.drc.budget (bytes)
+ */
+#define DRC_BUDGET (64 * 1024 * 1024)
+
 /**
  * @brief Default value for core_param.rpc.debug_flags
  */
@@ -186,8 +211,45 @@ typedef struct nfs_core_param {
 	    worthwhile option to have. */
 	uint32_t program[P_COUNT];
 	/** Number of worker threads.  Set to NB_WORKER_DEFAULT by
-	    default and changed with the Nb_Worker option. */
+	    default and changed with the Nb_Worker option.  When
+	    nb_worker_min is set, this is the most the pool grows to. */
 	uint32_t nb_worker;
+	/** Fewest worker threads the pool shrinks to when idle.
+	    Defaults to 0, meaning Nb_Worker (a fixed size pool), and
+	    settable with Nb_Worker_Min. */
+	uint32_t nb_worker_min;
+	/** Average queue wait, in microseconds, above which a worker
+	    is added to the pool if every worker is busy.  Set to
+	    WORKER_GROW_WAIT_DEFAULT by default and changed with
+	    Worker_Grow_Wait. */
+	uint32_t worker_grow_wait;
+	/** Microseconds an idle worker spins looking for requests
+	    before it sleeps, 0 to sleep at once.  Set to
+	    WORKER_SPIN_DEFAULT by default and changed with
+	    Worker_Spin. */
+	uint32_t worker_spin;
+	/** Most bytes of free READ buffers kept for reuse.  Set to
+	    IO_BUF_CACHE_SIZE_DEFAULT by default and changed with
+	    IO_Buffer_Cache_Size. */
+	uint64_t io_buf_cache_size;
+	/** CPUs the event channel threads may run on, as a list such
+	    as "0-3,8".  All CPUs by default, settable with
+	    Event_Channel_CPUs. */
+	char *evchan_cpus;
+	/** CPUs the decoder threads may run on.  All CPUs by default,
+	    settable with Decoder_CPUs. */
+	char *decoder_cpus;
+	/** CPUs the worker threads may run on.  All CPUs by default,
+	    settable with Worker_CPUs. */
+	char *worker_cpus;
+	/** CPUs the cache_inode LRU thread may run on.  All CPUs by
+	    default, settable with LRU_CPUs. */
+	char *lru_cpus;
+	/** Whether to spread request queue shards over the NUMA nodes,
+	    keep workers on their shard's node and hand requests to
+	    workers of the decoding node.  False by default and
+	    settable with NUMA_Affinity. */
+	bool numa_affinity;
 	/** For NFSv3, whether to drop rather than reply to requests
 	    yielding I/O errors.  True by default and settable with
 	    Drop_IO_Errors.  As this generally results in client
@@ -212,11 +274,40 @@ typedef struct nfs_core_param {
 	    specific transport.  Defaults to 512 and settable by
 	    Dispatch_Max_Reqs_Xprt. */
 	uint32_t dispatch_max_reqs_xprt;
+	/** Number of request queue shards (worker groups).  Requests
+	    are queued on the shard of the decoding CPU and workers
+	    steal from sibling shards only when their own is empty.
+	    Defaults to 0, meaning one per online CPU (but never more
+	    than Nb_Worker), and settable by Dispatch_Queue_Shards. */
+	uint32_t dispatch_queue_shards;
+	/** Maximum number of requests of a single client that may be
+	    executing at once.  Further requests of that client stay
+	    queued.  Defaults to 0, meaning no limit, and settable by
+	    Dispatch_Max_Reqs_Client (or over DBus). */
+	uint32_t dispatch_max_reqs_client;
+	/** Operations per second any one client may send before its
+	    transports stop being read.  Defaults to 0, meaning no
+	    limit, and settable by Client_Ops_Rate (or over DBus). */
+	uint64_t client_ops_rate;
+	/** READ and WRITE bytes per second any one client may move
+	    before its transports stop being read.  Defaults to 0,
+	    meaning no limit, and settable by Client_Bytes_Rate (or
+	    over DBus). */
+	uint64_t client_bytes_rate;
+	/** Milliseconds of a client or export rate limit that may be
+	    used in a single burst.  Set to RATE_LIMIT_BURST_DEFAULT by
+	    default and changed with Rate_Limit_Burst. */
+	uint32_t rate_limit_burst;
 	/** Parameters controlling the Duplicate Request Cache.  */
 	struct {
 		/** Whether to disable the DRC entirely.  Defaults to
 		    false, settable by DRC_Disabled. */
 		bool disabled;
+		/** Bytes of cached requests and replies all DRCs
+		    together may hold before the oldest and largest
+		    are evicted, 0 for no limit.  Defaults to
+		    DRC_BUDGET, settable by DRC_Budget. */
+		uint64_t budget;
 		/* Parameters controlling TCP specific DRC behavior. */
 		struct {
 			/** Number of partitions in the tree for the
@@ -378,6 +469,11 @@ typedef struct nfs_core_param {
  */
 #define DELEG_RECALL_RETRY_DELAY_DEFAULT 1
 
+/**
+ * @brief Default value of max_session_slots.
+ */
+#define MAX_SESSION_SLOTS_DEFAULT 64
+
 typedef struct nfs_version4_parameter {
 	/** Whether to disable the NFSv4 grace period.  Defaults to
 	    false and settable with Graceless. */
@@ -412,6 +508,11 @@ typedef struct nfs_version4_parameter {
 	bool allow_delegations;
 	/** Delay after which server will retry a recall in case of failures */
 	uint32_t deleg_recall_retry_delay;
+	/** Largest NFSv4.1 forechannel slot table we grant a session,
+	    whatever ca_maxrequests the client asks for.  Defaults to
+	    MAX_SESSION_SLOTS_DEFAULT and settable with
+	    Max_Session_Slots. */
+	uint32_t max_session_slots;
 } nfs_version4_parameter_t;
 
 /** @} */
@@ -47,6 +47,8 @@
 #include "log.h"
 #include "abstract_mem.h"
 #include "ganesha_types.h"
+#include "ganesha_list.h"
+#include "gsh_intrinsic.h"
 
 /**
  * @brief A pair of buffer descriptors
@@ -77,6 +79,8 @@ typedef int (*val_display_function_t)(struct gsh_buffdesc *, char *);
 #define HT_FLAG_NONE 0x0000	/*< Null hash table flags */
 #define HT_FLAG_CACHE 0x0001	/*< Indicates that caching should be
 				   enabled */
+#define HT_FLAG_RESIZE 0x0002	/*< Partitions are growing bucket
+				   arrays rather than trees */
 
 /**
  * @brief Hash parameters
@@ -137,11 +141,38 @@ typedef struct hash_stat {
 				       the rbt used. */
 } hash_stat_t;
 
+/**
+ * @brief An entry of a resizable partition
+ */
+
+struct hash_node {
+	struct hash_node *next; /*< Next node in the bucket */
+	uint64_t hash; /*< The full hash of the key */
+	struct hash_data data; /*< The stored key and value */
+};
+
+/**
+ * @brief A bucket array of a resizable partition
+ */
+
+struct hash_buckets {
+	uint32_t mask; /*< Number of buckets, less one */
+	struct hash_node *bucket[]; /*< Chains of nodes */
+};
+
 /**
  * @brief Represents an individual partition
  *
  * This structure holds the per-subtree data making up each partition in
  * a hash table.
+ *
+ * With HT_FLAG_RESIZE the partition is a chained hash rather than a
+ * tree.  It doubles when it holds more entries than buckets, and the
+ * entries are moved to the new array a few buckets at a time by later
+ * writers, so no single insert pays for the whole resize.  Until they
+ * have all moved, lookups search the new array and then, if its
+ * bucket has not been moved yet, the old one.  An outgrown array is
+ * freed once its last bucket has moved.
  */
 
 struct hash_partition {
@@ -149,6 +180,55 @@ struct hash_partition {
 	struct rbt_head rbt; /*< The red-black tree */
 	pthread_rwlock_t lock; /*< Lock for this partition */
 	struct rbt_node **cache; /*< Expected entry cache */
+	uint32_t migrate; /*< Next bucket of old to move */
+	struct hash_buckets *buckets; /*< Current bucket array */
+	struct hash_buckets *old; /*< Array being moved from */
+};
+
+/**
+ * @brief Stripes of a hash table's counters
+ *
+ * Each thread counts in one stripe, so threads busy with different
+ * partitions do not share a cache line just to count themselves.
+ */
+#define HT_COUNTER_STRIPES 16
+
+/**
+ * @brief One stripe of a hash table's counters
+ *
+ * Cache line aligned, so the table holding them is allocated with
+ * gsh_malloc_aligned.
+ */
+
+struct hash_counters {
+	uint64_t lookups; /*< Keys looked up, including those looked up
+			      to be set or deleted */
+	uint64_t hits; /*< Lookups that found the key */
+	uint64_t inserts; /*< New entries */
+	uint64_t deletes; /*< Entries removed */
+	uint64_t lock_waits; /*< Partition locks not granted at once */
+	uint64_t lock_wait_ns; /*< Time spent waiting for them */
+} __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+/**
+ * @brief Occupancy and contention of a hash table
+ *
+ * Counters are summed from their stripes without stopping the table,
+ * so a snapshot is only approximately consistent.
+ */
+
+struct hash_table_stats {
+	const char *name; /*< ht_name, or "(unnamed)" */
+	uint32_t partitions; /*< index_size */
+	uint64_t entries; /*< Entries in the table */
+	uint64_t max_partition; /*< Entries in the fullest partition */
+	const uint64_t *partition_entries; /*< Entries in each partition */
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t inserts;
+	uint64_t deletes;
+	uint64_t lock_waits;
+	uint64_t lock_wait_ns;
 };
 
 /**
@@ -160,8 +240,12 @@ struct hash_partition {
 typedef struct hash_table {
 	struct hash_param parameter; /*< Definitive parameter for the
 					 HashTable */
-	pool_t *node_pool; /*< Pool of RBT nodes */
-	pool_t *data_pool; /*< Pool of buffer pairs */
+	struct glist_head link; /*< On the list of all tables */
+	struct hash_counters counters[HT_COUNTER_STRIPES]; /*< Counters */
+	pool_t *node_pool; /*< Pool of RBT nodes, or of hash nodes with
+			       HT_FLAG_RESIZE */
+	pool_t *data_pool; /*< Pool of buffer pairs, unused with
+			       HT_FLAG_RESIZE */
 	struct hash_partition partitions[]; /*< Parameter.index_size
 						partitions of the hash
 						table. */
@@ -178,6 +262,7 @@ struct hash_latch {
 	uint32_t index;	/*< Saved partition index */
 	uint64_t rbt_hash; /*< Saved red-black hash */
 	struct rbt_node *locator; /*< Saved location in the tree */
+	struct hash_node *node; /*< Saved node with HT_FLAG_RESIZE */
 };
 
 typedef enum hash_set_how {
@@ -229,6 +314,8 @@ hash_error_t hashtable_delall(struct hash_table *,
 				      struct gsh_buffdesc));
 
 void hashtable_log(log_components_t, struct hash_table *);
+void hashtable_foreach(void (*cb)(const struct hash_table_stats *, void *),
+		       void *);
 
 /* These are very simple wrappers around the primitives */
 
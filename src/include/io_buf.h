@@ -0,0 +1,67 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @defgroup io_buf Recycled I/O buffers
+ *
+ * READ replies hold their data until the reply has been sent (or
+ * until an NFSv4.1 slot drops its cached reply), so the buffer can
+ * not live on the worker's stack.  Rather than calling the allocator
+ * for up to a megabyte per READ, buffers are kept in power of two
+ * size classes and handed back out.  Each thread keeps a few buffers
+ * of each class for itself; the rest sit on shared per class lists.
+ * The total held is bounded by NFS_CORE_PARAM { IO_Buffer_Cache_Size }.
+ *
+ * Buffers are aligned to IO_BUF_ALIGN, which is what FSALs doing
+ * direct I/O expect.
+ *
+ * @{
+ */
+
+/**
+ * @file io_buf.h
+ * @brief Recycled, aligned buffers for READ replies
+ */
+
+#ifndef IO_BUF_H
+#define IO_BUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Alignment of every buffer returned by io_buf_get */
+#define IO_BUF_ALIGN 4096
+
+/** Smallest size class, as a power of two */
+#define IO_BUF_MIN_SHIFT 12
+
+/** Largest size class; bigger requests go straight to the allocator */
+#define IO_BUF_MAX_SHIFT 20
+
+/** Number of size classes */
+#define IO_BUF_CLASSES (IO_BUF_MAX_SHIFT - IO_BUF_MIN_SHIFT + 1)
+
+void *io_buf_get(size_t size);
+void io_buf_put(void *buf);
+
+#endif				/* IO_BUF_H */
+
+/** @} */
@@ -69,6 +69,36 @@ char *host_name;
  */
 #define P_FAMILY AF_INET6
 
+struct request_data;
+
+/**
+ * @brief State of a request suspended on asynchronous I/O
+ *
+ * A request whose I/O does not complete at once gives up its worker.
+ * The completion requeues it, and a worker (not necessarily the same
+ * one) re-enters the suspended service function with resume set.
+ */
+struct nfs_req_async {
+	struct request_data *req;	/*< Request to requeue */
+	uint32_t pending;	/*< Held by the submitter and by the
+				    completion, whichever drops it last
+				    carries on with the request */
+	bool suspended;		/*< The service function is waiting for
+				    its I/O */
+	bool resume;		/*< Re-entering the suspended function */
+	bool anonymous_io;	/*< The operation started anonymous I/O */
+	nfs_client_id_t *clientid;	/*< Client record op_ctx->clientid
+					    points into, referenced until
+					    the request is done with */
+	struct cache_inode_io io;	/*< The I/O */
+	struct req_op_context req_ctx;	/*< Saved operation context */
+	struct user_cred creds;	/*< Saved credentials */
+	struct export_perms export_perms;	/*< Saved export permissions */
+	sockaddr_t hostaddr;	/*< Saved client address */
+	compound_data_t compound;	/*< Saved NFSv4 compound data */
+	nsecs_elapsed_t op_start_time;	/*< Start of the suspended NFSv4 op */
+};
+
 typedef struct nfs_request_data {
 	SVCXPRT *xprt;
 	struct svc_req req;
@@ -76,6 +106,7 @@ typedef struct nfs_request_data {
 	nfs_arg_t arg_nfs;
 	nfs_res_t *res_nfs;
 	const nfs_function_desc_t *funcdesc;
+	struct nfs_req_async async;	/*< Asynchronous I/O state */
 } nfs_request_data_t;
 
 enum rpc_chan_type {
@@ -141,6 +172,21 @@ typedef enum request_type {
 #endif				/* _USE_9P */
 } request_type_t;
 
+struct gsh_client;
+
+/**
+ * @brief The fair queueing tenant of a request
+ *
+ * Set by the decoder, for NFS requests, before the request is
+ * queued.  Zeroed (no client, default weight) for other requests.
+ */
+struct req_tenant {
+	struct gsh_client *client;	/*< Client reference, or NULL */
+	int32_t export_id;	/*< Target export, or -1 if unknown */
+	uint32_t weight;	/*< Scheduling weight of the export */
+	bool in_service;	/*< Counted in the client's in_service */
+};
+
 typedef struct request_data {
 	struct glist_head req_q;	/* chaining of pending requests */
 	request_type_t rtype;
@@ -154,6 +200,7 @@ typedef struct request_data {
 	struct timespec time_queued;	/*< The time at which a request was
 					 *  added to the worker thread queue.
 					 */
+	struct req_tenant tenant;	/*< Fair queueing tenant */
 } request_data_t;
 
 /**
@@ -214,12 +261,32 @@ extern pool_t *dupreq_pool;	/* XXX hide */
 
 struct nfs_worker_data {
 	unsigned int worker_index;	/*< Index for log messages */
-	wait_q_entry_t wqe;	/*< Queue for coordinating with decoder */
+	uint32_t q_shard;	/*< Request queue shard (worker group) */
+	bool idled;		/*< Dequeue gave up after an idle period */
 
 	sockaddr_t hostaddr;	/*< Client address */
 	struct fridgethr_context *ctx;	/*< Link back to thread context */
 };
 
+/**
+ * @brief Adaptive worker pool state
+ *
+ * The pool grows, one worker at a time, while the average queue
+ * wait is above Worker_Grow_Wait and every worker is busy executing
+ * (for the most part, blocked in the FSAL).  Workers that find no
+ * work for an idle period exit, down to Nb_Worker_Min.
+ */
+struct nfs_worker_pool {
+	uint32_t threads;	/*< Running workers */
+	uint32_t busy;		/*< Workers executing a request */
+	uint64_t qwait_avg;	/*< Moving average of queue wait (nsecs) */
+	nsecs_elapsed_t last_grow;	/*< When a worker was last added */
+	uint64_t grown;		/*< Workers added by the pool */
+	uint64_t retired;	/*< Idle workers that exited */
+};
+
+extern struct nfs_worker_pool nfs_worker_pool;
+
 /* ServerEpoch is ServerBootTime unless overriden by -E command line option */
 extern struct timespec ServerBootTime;
 extern time_t ServerEpoch;
@@ -240,6 +307,24 @@ void nfs_rpc_enqueue_req(request_data_t *req);
 
 uint32_t get_enqueue_count();
 uint32_t get_dequeue_count();
+bool nfs_worker_pool_saturated(void);
+void nfs_rpc_tenant_suspend(request_data_t *req);
+void nfs_rpc_tenant_release(request_data_t *req);
+cache_inode_status_t nfs_rpc_rdwr_async(nfs_request_data_t *reqnfs,
+				       nfs_client_id_t *clientid,
+				       bool *suspended);
+
+/**
+ * @brief Get the request of an RPC service call
+ *
+ * @param[in] req The svc_req handed to the service function
+ *
+ * @return The request.
+ */
+static inline nfs_request_data_t *nfs_rpc_reqnfs(struct svc_req *req)
+{
+	return container_of(req, nfs_request_data_t, req);
+}
 
 /*
  * Thread entry functions
@@ -289,10 +374,6 @@ void nfs_Init_admin_thread(void);
 void admin_replace_exports(void);
 void admin_halt(void);
 
-/* Tools */
-
-int compare_state_id(struct gsh_buffdesc *buff1, struct gsh_buffdesc *buff2);
-
 /* used in DBUS-api diagnostic functions (e.g., serialize sessionid) */
 int b64_ntop(u_char const *src, size_t srclength, char *target,
 	     size_t targsize);
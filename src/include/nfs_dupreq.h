@@ -40,6 +40,7 @@
 #include "nfs_core.h"
 #include <misc/rbtree_x.h>
 #include <misc/queue.h>
+#include "gsh_intrinsic.h"
 
 enum drc_type {
 	DRC_TCP_V4, /*< safe to use an XID-based, per-connection DRC */
@@ -56,19 +57,42 @@ enum drc_type {
 #define DRC_FLAG_RECYCLE 0x0020
 #define DRC_FLAG_RELEASE 0x0040
 
+/**
+ * @brief Per-partition state of a DRC
+ *
+ * Entries are queued on the partition they hash to, so starting and
+ * retiring a request takes only that partition's lock.  The counters
+ * are updated under the partition lock, but for lock_waits, which is
+ * atomic, and read without it.
+ */
+struct drc_part {
+	TAILQ_HEAD(drc_tailq, dupreq_entry) dupreq_q; /*< oldest first */
+	uint64_t hits; /*< retransmits answered from the cache */
+	uint64_t misses; /*< new requests inserted */
+	uint64_t busy; /*< retransmits of requests still in progress */
+	uint64_t retired; /*< entries retired by the water mark */
+	uint64_t evicted; /*< entries evicted for the DRC budget */
+	uint64_t lock_waits; /*< partition lock found taken, atomic */
+	CACHE_PAD(0);
+};
+
 typedef struct drc {
 	enum drc_type type;
 	struct rbtree_x xt;
-	TAILQ_HEAD(drc_tailq, dupreq_entry) dupreq_q;
-	pthread_mutex_t mtx;
+	struct drc_part *part; /*< npart of them, parallel to xt.tree */
+	pthread_mutex_t mtx; /*< flags and recycling */
 	uint32_t npart;
 	uint32_t cachesz;
-	uint32_t size;
+	uint32_t size; /* atomic */
 	uint32_t maxsize;
 	uint32_t hiwat;
 	uint32_t flags;
-	uint32_t refcnt; /* call path refs */
-	uint32_t retwnd;
+	uint32_t refcnt; /* xprt and call path refs, atomic */
+	uint32_t retwnd; /* atomic */
+	uint32_t retain_s; /*< client's retransmit window, atomic */
+	uint64_t bytes; /*< held by entries, atomic */
+	struct dupreq_entry *retired; /*< unlinked, awaiting reclamation */
+	uint32_t nretired;
 	union {
 		struct {
 			sockaddr_t addr;
@@ -89,6 +113,7 @@ typedef enum dupreq_state {
 struct dupreq_entry {
 	struct opr_rbtree_node rbt_k;
 	TAILQ_ENTRY(dupreq_entry) fifo_q;
+	struct dupreq_entry *retire_next; /*< on drc->retired */
 	pthread_mutex_t mtx;
 	struct {
 		drc_t *drc;
@@ -104,6 +129,7 @@ struct dupreq_entry {
 	uint64_t hk;		/* hash key */
 	dupreq_state_t state;
 	uint32_t refcnt;
+	uint32_t bytes; /*< charged to hin.drc */
 	nfs_res_t *res;
 	time_t timestamp;
 };
@@ -114,10 +140,8 @@ extern pool_t *nfs_res_pool;
 
 static inline nfs_res_t *alloc_nfs_res(void)
 {
-	/* XXX can pool/ctor zero mem? */
-	nfs_res_t *res = pool_alloc(nfs_res_pool, NULL);
-	memset(res, 0, sizeof(nfs_res_t));
-	return res;
+	/* the pool has no constructor, so objects come zeroed */
+	return pool_alloc(nfs_res_pool, NULL);
 }
 
 static inline void free_nfs_res(nfs_res_t *res)
@@ -133,8 +157,23 @@ typedef enum dupreq_status {
 	DUPREQ_ERROR,
 } dupreq_status_t;
 
+/**
+ * @brief A DRC as reported by drc_foreach
+ */
+struct drc_stats {
+	const char *type;
+	const char *addr; /*< peer, empty for the shared DRC */
+	uint32_t size;
+	uint32_t refcnt;
+	uint64_t bytes;
+	uint32_t retain_s;
+	uint32_t npart;
+	const struct drc_part *part;
+};
+
 void dupreq2_pkginit(void);
 void dupreq2_pkgshutdown(void);
+void drc_foreach(void (*cb)(const struct drc_stats *, void *), void *arg);
 
 drc_t *drc_get_tcp_drc(struct svc_req *);
 void drc_release_tcp_drc(drc_t *);
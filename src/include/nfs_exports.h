@@ -263,10 +263,15 @@ typedef struct compound_data {
 	nfs_client_cred_t credential;	/*< Raw RPC credentials */
 	nfs_client_id_t *preserved_clientid;	/*< clientid that has lease
 						   reserved, if any */
-	COMPOUND4res_extended *cached_res;	/*< NFv41: pointer to
-						   cached RPC res in a
-						   session's slot */
+	struct nfs41_session_slot__ *cached_slot;	/*< NFSv41: slot to
+							   cache the reply
+							   in */
+	struct nfs41_cached_reply *cached_res;	/*< NFv41: ref'd reply to
+						   replay from a session's
+						   slot */
 	bool use_drc;		/*< Set to true if session DRC is to be used */
+	bool cachethis;		/*< NFSv41: client asked for the reply to
+				    be cached */
 	uint32_t oppos;		/*< Position of the operation within the
 				    request processed  */
 	nfs41_session_t *session;	/*< Related session (found by
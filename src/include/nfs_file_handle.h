@@ -180,6 +180,30 @@ static inline short nfs3_FhandleToExportId(nfs_fh3 *pfh3)
 	return pfile_handle->exportid;
 }				/* nfs3_FhandleToExportId */
 
+/**
+ * @brief Get the export id of an NFSv3 handle without logging
+ *
+ * For the request decoder, which only classifies requests; a bad
+ * handle is reported when the request is executed.
+ *
+ * @param[in] fh3 The handle
+ *
+ * @return The export id, -1 if the handle is not a valid one.
+ */
+static inline int32_t nfs3_FhandleToExportIdQuiet(nfs_fh3 *fh3)
+{
+	file_handle_v3_t *hdl = (file_handle_v3_t *) fh3->data.data_val;
+
+	if (hdl == NULL
+	    || fh3->data.data_len < sizeof(file_handle_v3_t)
+	    || fh3->data.data_len > sizeof(struct alloc_file_handle_v3)
+	    || hdl->fhversion != GANESHA_FH_VERSION
+	    || fh3->data.data_len != nfs3_sizeof_handle(hdl))
+		return -1;
+
+	return hdl->exportid;
+}
+
 static inline short nlm4_FhandleToExportId(netobj *pfh3)
 {
 	nfs_fh3 fh3;
@@ -216,6 +240,29 @@ static inline int nfs4_Is_Fh_Empty(nfs_fh4 *pfh)
 	return NFS4_OK;
 }				/* nfs4_Is_Fh_Empty */
 
+/**
+ * @brief Get the export id of an NFSv4 handle without logging
+ *
+ * As nfs3_FhandleToExportIdQuiet.
+ *
+ * @param[in] fh The handle
+ *
+ * @return The export id, -1 if the handle is not a valid one.
+ */
+static inline int32_t nfs4_FhandleToExportIdQuiet(nfs_fh4 *fh)
+{
+	file_handle_v4_t *hdl = (file_handle_v4_t *) fh->nfs_fh4_val;
+
+	if (hdl == NULL
+	    || fh->nfs_fh4_len < offsetof(struct file_handle_v4, fsopaque)
+	    || fh->nfs_fh4_len > sizeof(struct alloc_file_handle_v4)
+	    || hdl->fhversion != GANESHA_FH_VERSION
+	    || fh->nfs_fh4_len != nfs4_sizeof_handle(hdl))
+		return -1;
+
+	return hdl->exportid;
+}
+
 /* NFSv4 specific FH related functions */
 int nfs4_Is_Fh_Invalid(nfs_fh4 *);
 int nfs4_Is_Fh_DSHandle(nfs_fh4 *);
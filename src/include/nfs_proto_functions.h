@@ -98,9 +98,23 @@ typedef union nfs_arg__ {
 	ext_setquota_args arg_ext_rquota_setactivequota;
 } nfs_arg_t;
 
+/**
+ * @brief A COMPOUND4 reply shared by a session slot and the requests
+ *        sending it
+ *
+ * The reply's memory belongs to this object and is freed when the
+ * last reference is dropped.
+ */
+typedef struct nfs41_cached_reply {
+	int32_t refcnt;
+	COMPOUND4res res;
+} nfs41_cached_reply_t;
+
 struct COMPOUND4res_extended {
 	COMPOUND4res res_compound4;
-	bool res_cached;
+	nfs41_cached_reply_t *res_cached; /*< If set, res_compound4 is a
+					      copy of this referenced
+					      reply */
 };
 
 typedef union nfs_res__ {
@@ -567,6 +581,7 @@ void nfs4_op_layoutstats_Free(nfs_resop4 *resp);
 
 #define NFS_REQ_OK   0
 #define NFS_REQ_DROP 1
+#define NFS_REQ_ASYNC_WAIT 2	/* suspended, see nfs_rpc_rdwr_async */
 
 /* Free functions */
 void mnt1_Mnt_Free(nfs_res_t *);
@@ -622,6 +637,8 @@ void nfs3_read_free(nfs_res_t *);
 
 void nfs4_Compound_FreeOne(nfs_resop4 *);
 void nfs4_Compound_Free(nfs_res_t *);
+void nfs41_cached_reply_ref(nfs41_cached_reply_t *);
+void nfs41_cached_reply_unref(nfs41_cached_reply_t *);
 void nfs4_Compound_CopyResOne(nfs_resop4 *, nfs_resop4 *);
 void nfs4_Compound_CopyRes(nfs_res_t *, nfs_res_t *);
 
@@ -52,12 +52,32 @@ struct req_q {
 	uint32_t waiters;
 };
 
+/**
+ * @brief A fair queueing flow
+ *
+ * Requests moved to the consumer side of a queue pair are spread
+ * over flows hashed by tenant (client and export).  Active flows
+ * are served deficit round robin, each request costing one unit and
+ * each round granting the flow the weight of the export of its head
+ * request.  Tenants colliding in a hash bucket share a flow.
+ */
+struct req_q_flow {
+	struct glist_head q;	/*< requests of the flow, FIFO */
+	struct glist_head active;	/*< link on the active flow list */
+	uint32_t size;
+	int32_t deficit;
+};
+
+#define N_REQ_FLOWS 64
+
 struct req_q_pair {
 	const char *s;
 	 CACHE_PAD(0);
 	struct req_q producer;	/* from decoder */
 	 CACHE_PAD(1);
-	struct req_q consumer;	/* to executor */
+	struct req_q consumer;	/* to executor, protects the flows */
+	struct glist_head active;	/*< flows with requests */
+	struct req_q_flow flows[N_REQ_FLOWS];
 	 CACHE_PAD(2);
 };
 
@@ -73,14 +93,50 @@ struct req_q_set {
 	struct req_q_pair qset[N_REQ_QUEUES];
 };
 
+/**
+ * @brief A request queue shard
+ *
+ * Requests are enqueued on the shard of the CPU that decoded them,
+ * and each worker is bound to one shard (its worker group).  A worker
+ * only looks at sibling shards, stealing from them, when its own
+ * shard is empty.  Each shard has its own event count on which its
+ * idle workers park, so the common enqueue/dequeue path never touches
+ * a lock shared by all workers.  Before parking, a worker spins for
+ * up to Worker_Spin microseconds; an enqueue that sees a spinning
+ * worker issues no wakeup at all.
+ *
+ * With NUMA_Affinity the shards are divided among the NUMA nodes in
+ * contiguous runs, CPUs map to shards of their own node, and workers
+ * steal within their node before looking further.
+ */
+
+struct req_q_shard {
+	struct req_q_set nfs_request_q;
+	 CACHE_PAD(0);
+	event_count_t ec;	/*< idle workers of the shard park here */
+	uint32_t spinners;	/*< workers spinning before they park */
+	uint32_t ctr;		/*< slot counter for dequeue weighting */
+	uint32_t node;		/*< NUMA node of the shard's workers */
+	uint32_t *visit;	/*< all shards, this one first, then the
+				    rest of its node, then other nodes */
+	 CACHE_PAD(1);
+	uint32_t enqueued;	/*< requests enqueued on this shard */
+	uint32_t dequeued;	/*< requests dequeued from this shard */
+	uint64_t local;		/*< dequeued by a worker of this shard */
+	uint64_t stolen;	/*< dequeued by a worker of another shard */
+	uint64_t spin_hits;	/*< found work while spinning */
+	uint64_t parks;		/*< workers that went to sleep */
+	uint64_t wakeups;	/*< workers woken by enqueues */
+	 CACHE_PAD(2);
+};
+
 struct nfs_req_st {
 	struct {
-		uint32_t ctr;
-		struct req_q_set nfs_request_q;
+		uint32_t nshards;
+		struct req_q_shard *shards;
+		uint32_t ncpus;
+		uint32_t *cpu_shard;	/*< shard to enqueue on, by CPU */
 		uint64_t size;
-		pthread_spinlock_t sp;
-		struct glist_head wait_list;
-		uint32_t waiters;
 	} reqs;
 	 CACHE_PAD(1);
 	struct {
@@ -103,27 +159,59 @@ static inline void nfs_rpc_q_init(struct req_q *q)
 	q->waiters = 0;
 }
 
-static inline uint32_t nfs_rpc_q_next_slot(void)
+static inline void nfs_rpc_q_init_flows(struct req_q_pair *qpair)
+{
+	uint32_t ix;
+
+	glist_init(&qpair->active);
+	for (ix = 0; ix < N_REQ_FLOWS; ++ix) {
+		glist_init(&qpair->flows[ix].q);
+		glist_init(&qpair->flows[ix].active);
+		qpair->flows[ix].size = 0;
+		qpair->flows[ix].deficit = 0;
+	}
+}
+
+static inline uint32_t nfs_rpc_q_next_slot(struct req_q_shard *shard)
 {
-	uint32_t ix = atomic_inc_uint32_t(&nfs_req_st.reqs.ctr);
+	uint32_t ix = atomic_inc_uint32_t(&shard->ctr);
 	if (!ix)
-		ix = atomic_inc_uint32_t(&nfs_req_st.reqs.ctr);
+		ix = atomic_inc_uint32_t(&shard->ctr);
 	return ix;
 }
 
+/**
+ * @brief Map a worker index to its request queue shard
+ *
+ * @param[in] worker_index Index of the worker
+ *
+ * @return The shard index.
+ */
+static inline uint32_t nfs_rpc_q_worker_shard(uint32_t worker_index)
+{
+	return worker_index % nfs_req_st.reqs.nshards;
+}
+
+/**
+ * @brief Requests queued on a shard and not yet dequeued
+ */
+static inline uint32_t nfs_rpc_q_backlog(struct req_q_shard *shard)
+{
+	int32_t backlog = atomic_fetch_uint32_t(&shard->enqueued) -
+	    atomic_fetch_uint32_t(&shard->dequeued);
+
+	/* the two counters are read apart, so this may be transiently
+	 * negative */
+	return backlog > 0 ? backlog : 0;
+}
+
 static inline void nfs_rpc_queue_awaken(void *arg)
 {
 	struct nfs_req_st *st = arg;
-	struct glist_head *g = NULL;
-	struct glist_head *n = NULL;
-
-	pthread_spin_lock(&st->reqs.sp);
-	glist_for_each_safe(g, n, &st->reqs.wait_list) {
-		wait_q_entry_t *wqe = glist_entry(g, wait_q_entry_t, waitq);
-		pthread_cond_signal(&wqe->lwe.cv);
-		pthread_cond_signal(&wqe->rwe.cv);
-	}
-	pthread_spin_unlock(&st->reqs.sp);
+	uint32_t ix;
+
+	for (ix = 0; ix < st->reqs.nshards; ++ix)
+		(void) ec_notify(&st->reqs.shards[ix].ec, UINT32_MAX);
 }
 
 #endif				/* NFS_REQ_QUEUE_H */
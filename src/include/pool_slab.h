@@ -0,0 +1,86 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file   pool_slab.h
+ * @brief  Slab pool substrate with per-thread magazines
+ *
+ * @page SlabPoolSubstrate The Slab Pool Substrate
+ *
+ * Objects are carved out of large slabs and kept, once freed, on the
+ * pool's depot.  Each thread holds a magazine of free objects for
+ * every slab pool it uses, so most allocations and frees touch no
+ * shared state.  An empty magazine is refilled, and a full one
+ * drained, half a magazine at a time under the depot lock.  When a
+ * thread exits its magazines go back to the depot.
+ *
+ * Slabs are never returned to the allocator until the pool is
+ * destroyed, so a pool's resident size is its high water mark.
+ *
+ * As with the basic substrate, objects from a pool without a
+ * constructor are zeroed on allocation.
+ */
+
+#ifndef POOL_SLAB_H
+#define POOL_SLAB_H
+
+#include <stdint.h>
+#include "abstract_mem.h"
+
+/**
+ * @brief Parameters for a slab pool
+ *
+ * Pass NULL to pool_init for the defaults.
+ */
+
+struct pool_slab_params {
+	uint32_t magazine_size;	/*< Objects a thread may hold, 0 for
+				    the default */
+	size_t slab_size;	/*< Bytes per slab, 0 for the default */
+};
+
+/**
+ * @brief Statistics for one slab pool
+ *
+ * Magazine counters are summed without stopping their owners, so a
+ * snapshot is only approximately consistent.
+ */
+
+struct pool_slab_stats {
+	const char *name;	/*< Pool name */
+	uint64_t object_size;	/*< Bytes per object, after rounding */
+	uint64_t resident;	/*< Bytes of slab memory held */
+	uint64_t in_use;	/*< Objects allocated and not freed */
+	uint64_t cached;	/*< Free objects in the depot and magazines */
+	uint64_t allocs;	/*< Total allocations */
+	uint64_t hits;		/*< Allocations served by a magazine
+				    without taking the depot lock */
+	uint64_t refills;	/*< Magazine refills from the depot */
+	uint64_t drains;	/*< Magazine drains to the depot */
+};
+
+extern const struct pool_substrate_vector pool_slab_substrate[];
+
+void pool_slab_foreach(void (*cb)(const struct pool_slab_stats *stats,
+				  void *arg),
+		       void *arg);
+
+#endif				/* POOL_SLAB_H */
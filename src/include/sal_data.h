@@ -117,10 +117,11 @@ extern pool_t *nfs41_session_pool;
 extern hash_table_t *ht_session_id;
 
 /**
- * @brief Number of forechannel slots in a session
+ * @brief Number of backchannel slots in a session
  *
- * This is also the maximum number of backchannel slots we'll use,
- * even if the client offers more.
+ * This is the maximum number of backchannel slots we'll use, even if
+ * the client offers more.  The forechannel slot table is sized per
+ * session from ca_maxrequests, up to NFSv4::Max_Session_Slots.
  */
 #define NFS41_NB_SLOTS 3
 
@@ -131,8 +132,9 @@ extern hash_table_t *ht_session_id;
 typedef struct nfs41_session_slot__ {
 	sequenceid4 sequence;	/*< Sequence number of this operation */
 	pthread_mutex_t lock;	/*< Lock on the slot */
-	COMPOUND4res_extended cached_result;	/*< The cached result */
+	nfs41_cached_reply_t *cached_result;	/*< The cached reply, ref'd */
 	unsigned int cache_used;	/*< If we cached the result */
+	bool busy;		/*< The current sequence is being processed */
 } nfs41_session_slot_t;
 
 /**
@@ -171,7 +173,10 @@ struct nfs41_session {
 	SVCXPRT *xprt;		/*< Referenced pointer to transport */
 
 	channel_attrs4 fore_channel_attrs;	/*< Fore-channel attributes */
-	nfs41_session_slot_t slots[NFS41_NB_SLOTS];	/*< Slot table */
+	nfs41_session_slot_t *slots;	/*< Slot table */
+	uint32_t nb_slots;	/*< Slots in the table, ca_maxrequests */
+	uint32_t target_slots;	/*< Slots we want the client to use,
+				   one more than target_highest_slotid */
 
 	channel_attrs4 back_channel_attrs;	/*< Back-channel attributes */
 	nfs41_cb_session_slot_t cb_slots[NFS41_NB_SLOTS];	/*< Callback
@@ -243,8 +248,6 @@ extern char v4_recov_dir[PATH_MAX];
  *
  *****************************************************************************/
 
-extern hash_table_t *ht_state_id;
-
 /**
  * @brief Type of state
  */
@@ -692,8 +695,11 @@ struct nfs_client_id_t {
 	int32_t cid_refcount;	/*< Reference count for lifecycle */
 	int cid_lease_reservations;	/*< Counted lease reservations, to spare
 					   this clientid from the reaper */
+	struct glist_head cid_lease_link;	/*< Link in the lease wheel */
+	time_t cid_lease_expire;	/*< Second the wheel checks the lease */
+	bool cid_lease_queued;	/*< On the lease wheel, protected by
+				   the wheel's mutex */
 	uint32_t cid_minorversion;
-	uint32_t cid_stateid_counter;
 
 	uint32_t curr_deleg_grants; /* current num of delegations owned by
 				       this client */
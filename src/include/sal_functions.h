@@ -303,6 +303,9 @@ int nfs41_Session_Get_Pointer(char sessionid[NFS4_SESSIONID_SIZE],
 int nfs41_Session_Del(char sessionid[NFS4_SESSIONID_SIZE]);
 void nfs41_Build_sessionid(clientid4 *clientid, char *sessionid);
 void nfs41_Session_PrintAll(void);
+void nfs41_Slot_Release_Reply(nfs41_session_slot_t *slot);
+bool nfs41_Session_Alloc_Slots(nfs41_session_t *session, uint32_t nb_slots);
+void nfs41_Session_Free_Slots(nfs41_session_t *session);
 int display_session(nfs41_session_t *session, char *str);
 int display_session_id(char *session_id, char *str);
 
@@ -348,15 +351,6 @@ int nfs4_State_Get_Pointer(char other[OTHERSIZE], state_t **state_data);
 void nfs4_State_Del(char other[OTHERSIZE]);
 void nfs_State_PrintAll(void);
 
-int display_state_id_val(struct gsh_buffdesc *buff, char *str);
-int display_state_id_key(struct gsh_buffdesc *buff, char *str);
-
-uint32_t state_id_value_hash_func(hash_parameter_t *hparam,
-				  struct gsh_buffdesc *key);
-
-uint64_t state_id_rbt_hash_func(hash_parameter_t *hparam,
-				struct gsh_buffdesc *key);
-
 /******************************************************************************
  *
  * NFSv4 Lease functions
@@ -366,6 +360,10 @@ uint64_t state_id_rbt_hash_func(hash_parameter_t *hparam,
 int reserve_lease(nfs_client_id_t *clientid);
 void update_lease(nfs_client_id_t *clientid);
 bool valid_lease(nfs_client_id_t *clientid);
+void lease_wheel_init(void);
+void lease_wheel_add(nfs_client_id_t *clientid);
+void lease_wheel_requeue(nfs_client_id_t *clientid);
+int lease_wheel_due(struct glist_head *due);
 
 /******************************************************************************
  *
@@ -60,6 +60,7 @@ struct nfsv41_stats;
 struct nfsv42_stats;
 struct deleg_stats;
 struct _9p_stats;
+struct sched_stats;
 
 struct gsh_stats {
 	struct nfsv3_stats *nfsv3;
@@ -71,6 +72,7 @@ struct gsh_stats {
 	struct nfsv41_stats *nfsv42;
 	struct deleg_stats *deleg;
 	struct _9p_stats *_9p;
+	struct sched_stats *sched;
 };
 
 /**
@@ -210,6 +212,80 @@ struct export_stats {
 	.direction = "out"	       \
 }
 
+#define REQ_QUEUE_REPLY		\
+{				\
+	.name = "totals",	\
+	.type = "(ststst)",	\
+	.direction = "out"	\
+},				\
+{				\
+	.name = "shards",	\
+	.type = "a(uttttt)",	\
+	.direction = "out"	\
+}
+
+#define WORKER_POOL_REPLY		\
+{					\
+	.name = "workers",		\
+	.type = "(ststststststst)",	\
+	.direction = "out"		\
+}
+
+/* name, object size, resident bytes, objects in use and cached,
+ * allocs, magazine hits, refills, drains
+ */
+#define SLAB_POOLS_REPLY		\
+{					\
+	.name = "pools",		\
+	.type = "a(stttttttt)",		\
+	.direction = "out"		\
+}
+
+/* name, partitions, entries, entries in the fullest partition,
+ * lookups, hits, inserts, deletes, lock waits, lock wait ns,
+ * entries per partition
+ */
+#define HASHTABLES_REPLY		\
+{					\
+	.name = "hashtables",		\
+	.type = "a(suttttttttat)",	\
+	.direction = "out"		\
+}
+
+/* type, peer address, entries, refs, bytes, retention seconds, and
+ * per partition the hits, misses, retransmits in progress,
+ * retirements, budget evictions and lock waits
+ */
+#define DRC_REPLY			\
+{					\
+	.name = "drcs",			\
+	.type = "a(ssuutua(tttttt))",	\
+	.direction = "out"		\
+}
+
+/* bytes held by the inode cache and its budget, then per export the
+ * export id, entries charged to it and bytes they hold
+ */
+#define CACHE_BYTES_REPLY		\
+{					\
+	.name = "cache_bytes",		\
+	.type = "(tt)",			\
+	.direction = "out"		\
+},					\
+{					\
+	.name = "exports",		\
+	.type = "a(qtt)",		\
+	.direction = "out"		\
+}
+
+/* requests executed, queue wait total, min and max */
+#define SCHED_REPLY		\
+{				\
+	.name = "sched_stats",	\
+	.type = "(tttt)",	\
+	.direction = "out"	\
+}
+
 void server_stats_summary(DBusMessageIter *iter, struct gsh_stats *st);
 void server_dbus_v3_iostats(struct nfsv3_stats *v3p, DBusMessageIter *iter);
 void server_dbus_v40_iostats(struct nfsv40_stats *v40p, DBusMessageIter *iter);
@@ -218,11 +294,18 @@ void server_dbus_v41_layouts(struct nfsv41_stats *v41p, DBusMessageIter *iter);
 void server_dbus_v42_iostats(struct nfsv41_stats *v42p, DBusMessageIter *iter);
 void server_dbus_v42_layouts(struct nfsv41_stats *v42p, DBusMessageIter *iter);
 void server_dbus_delegations(struct deleg_stats *ds, DBusMessageIter *iter);
+void server_dbus_sched(struct sched_stats *sp, DBusMessageIter *iter);
 void server_dbus_total_ops(struct export_stats *export_st,
 			   DBusMessageIter *iter);
 void global_dbus_total_ops(DBusMessageIter *iter);
 void server_dbus_fast_ops(DBusMessageIter *iter);
 void cache_inode_dbus_show(DBusMessageIter *iter);
+void cache_inode_bytes_dbus_show(DBusMessageIter *iter);
+void nfs_rpc_queue_dbus_show(DBusMessageIter *iter);
+void nfs_worker_pool_dbus_show(DBusMessageIter *iter);
+void pool_slab_dbus_show(DBusMessageIter *iter);
+void hashtable_dbus_show(DBusMessageIter *iter);
+void drc_dbus_show(DBusMessageIter *iter);
 
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter);
 void server_dbus_9p_transstats(struct _9p_stats *_9pp, DBusMessageIter *iter);
@@ -0,0 +1,150 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file   token_bucket.h
+ * @brief  Lock-free token buckets for request admission control
+ *
+ * A bucket is kept as the time at which it would next be full again
+ * (the "theoretical arrival time" of the generic cell rate
+ * algorithm), so charging it is a single compare and swap and the
+ * fill rate is not stored in the bucket at all: the caller passes the
+ * current limit on every charge, and a limit changed over dbus takes
+ * effect on the next request.
+ *
+ * Charges are never refused.  A request has already been decoded by
+ * the time its cost is known, so a charge beyond the burst puts the
+ * bucket into debt, and the returned delay tells the caller how long
+ * to stop taking work from whoever incurred it.  A caller that cannot
+ * stop taking work from one sender alone checks tb_debt first and
+ * refuses the request instead of charging it.
+ *
+ * Each bucket also measures the rate actually charged over roughly
+ * the last second, for reporting.
+ */
+
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <stdint.h>
+#include <time.h>
+#include "abstract_atomic.h"
+#include "common_utils.h"
+
+struct token_bucket {
+	uint64_t tat;		/*< when the bucket is full again (ns) */
+	uint64_t win_start;	/*< start of the measuring window (ns) */
+	uint64_t win_units;	/*< units charged in the window */
+	uint64_t rate;		/*< units/s over the last full window */
+	uint64_t throttles;	/*< charges that exceeded the burst */
+};
+
+/**
+ * @brief Monotonic time in nanoseconds, for bucket arithmetic
+ */
+static inline nsecs_elapsed_t tb_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return timespec_to_nsecs(&ts);
+}
+
+/**
+ * @brief Charge a bucket
+ *
+ * @param[in] tb    The bucket
+ * @param[in] limit Units per second allowed, 0 for no limit
+ * @param[in] cost  Units to charge
+ * @param[in] now   Current time from tb_now
+ * @param[in] burst Nanoseconds of @c limit that may be used at once
+ *
+ * @return How long the charger should wait (ns), 0 if within limits.
+ */
+static inline nsecs_elapsed_t tb_charge(struct token_bucket *tb,
+					uint64_t limit, uint64_t cost,
+					nsecs_elapsed_t now,
+					nsecs_elapsed_t burst)
+{
+	uint64_t start = atomic_fetch_uint64_t(&tb->win_start);
+	uint64_t old, tat, units;
+
+	/* measure; concurrent window rollovers lose a little */
+	if (now - start >= NS_PER_SEC
+	    && __sync_bool_compare_and_swap(&tb->win_start, start, now)) {
+		units = atomic_postclear_uint64_t_bits(&tb->win_units,
+						       UINT64_MAX);
+		atomic_store_uint64_t(&tb->rate, start == 0 ? units :
+				      units * NS_PER_SEC / (now - start));
+	}
+	(void) atomic_add_uint64_t(&tb->win_units, cost);
+
+	if (limit == 0 || cost == 0)
+		return 0;
+
+	do {
+		old = atomic_fetch_uint64_t(&tb->tat);
+		tat = (old > now ? old : now) + cost * NS_PER_SEC / limit;
+	} while (!__sync_bool_compare_and_swap(&tb->tat, old, tat));
+
+	if (tat - now <= burst)
+		return 0;
+
+	(void) atomic_inc_uint64_t(&tb->throttles);
+	return tat - now - burst;
+}
+
+/**
+ * @brief How far a bucket is over its burst, without charging it
+ *
+ * @param[in] tb    The bucket
+ * @param[in] limit Units per second allowed, 0 for no limit
+ * @param[in] now   Current time from tb_now
+ * @param[in] burst Nanoseconds of @c limit that may be used at once
+ *
+ * @return Nanoseconds until the bucket is within its burst, 0 if it is.
+ */
+static inline nsecs_elapsed_t tb_debt(struct token_bucket *tb,
+				      uint64_t limit, nsecs_elapsed_t now,
+				      nsecs_elapsed_t burst)
+{
+	uint64_t tat = atomic_fetch_uint64_t(&tb->tat);
+
+	if (limit == 0 || tat <= now + burst)
+		return 0;
+
+	(void) atomic_inc_uint64_t(&tb->throttles);
+	return tat - now - burst;
+}
+
+/**
+ * @brief Recently measured rate of a bucket, in units per second
+ */
+static inline uint64_t tb_rate(struct token_bucket *tb, nsecs_elapsed_t now)
+{
+	/* nothing charged for a whole window */
+	if (now - atomic_fetch_uint64_t(&tb->win_start) > 2 * NS_PER_SEC)
+		return 0;
+
+	return atomic_fetch_uint64_t(&tb->rate);
+}
+
+#endif				/* TOKEN_BUCKET_H */
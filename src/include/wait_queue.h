@@ -38,7 +38,15 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 #include "ganesha_list.h"
+#include "abstract_atomic.h"
 
 typedef struct wait_entry {
 	pthread_mutex_t mtx;
@@ -88,6 +96,174 @@ static inline void init_wait_q_entry(wait_q_entry_t *wqe)
 	init_wait_entry(&wqe->rwe);
 }
 
+/**
+ * @brief An event count
+ *
+ * Lets threads sleep until "something happened" without a lost
+ * wakeup and without the notifier taking a lock when nobody sleeps.
+ * A waiter calls ec_prepare_wait, checks its condition once more,
+ * and then either ec_cancel_wait or ec_wait with the key it got.
+ * A notifier first makes the condition true and then calls
+ * ec_notify, which costs one fence and a load when there are no
+ * waiters.
+ *
+ * On Linux waiters sleep on a futex on the sequence number; other
+ * systems use a mutex and condition variable.
+ */
+typedef struct event_count {
+	uint32_t seq;		/*< Bumped by every notify with waiters */
+	uint32_t waiters;	/*< Threads between prepare and wakeup */
+#ifndef __linux__
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+#endif
+} event_count_t;
+
+static inline void init_event_count(event_count_t *ec)
+{
+	ec->seq = 0;
+	ec->waiters = 0;
+#ifndef __linux__
+	pthread_mutex_init(&ec->mtx, NULL);
+	pthread_cond_init(&ec->cv, NULL);
+#endif
+}
+
+/**
+ * @brief Announce an intent to wait
+ *
+ * @return The key to pass to ec_wait.
+ */
+static inline uint32_t ec_prepare_wait(event_count_t *ec)
+{
+	/* the increment is a full barrier, so the caller's recheck
+	 * can not be ordered before it */
+	(void) atomic_inc_uint32_t(&ec->waiters);
+	return atomic_fetch_uint32_t(&ec->seq);
+}
+
+/**
+ * @brief Withdraw an intent to wait
+ */
+static inline void ec_cancel_wait(event_count_t *ec)
+{
+	(void) atomic_dec_uint32_t(&ec->waiters);
+}
+
+/**
+ * @brief Sleep until notified after ec_prepare_wait
+ *
+ * Returns at once if a notify happened since the key was taken, and
+ * may return spuriously.  Withdraws the intent to wait in any case.
+ *
+ * @param[in] ec      The event count
+ * @param[in] key     Key from ec_prepare_wait
+ * @param[in] timeout Relative timeout, or NULL to wait indefinitely
+ *
+ * @retval 0 if woken (or spuriously)
+ * @retval ETIMEDOUT if the timeout expired first.
+ */
+static inline int ec_wait(event_count_t *ec, uint32_t key,
+			  const struct timespec *timeout)
+{
+	int rc = 0;
+
+#ifdef __linux__
+	if (syscall(SYS_futex, &ec->seq, FUTEX_WAIT_PRIVATE, key, timeout,
+		    NULL, 0) != 0
+	    && errno == ETIMEDOUT)
+		rc = ETIMEDOUT;
+#else
+	struct timespec abstime;
+
+	if (timeout != NULL) {
+		clock_gettime(CLOCK_REALTIME, &abstime);
+		abstime.tv_sec += timeout->tv_sec;
+		abstime.tv_nsec += timeout->tv_nsec;
+		if (abstime.tv_nsec >= 1000000000) {
+			abstime.tv_sec++;
+			abstime.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&ec->mtx);
+	while (ec->seq == key && rc == 0) {
+		if (timeout != NULL)
+			rc = pthread_cond_timedwait(&ec->cv, &ec->mtx,
+						    &abstime);
+		else
+			rc = pthread_cond_wait(&ec->cv, &ec->mtx);
+	}
+	pthread_mutex_unlock(&ec->mtx);
+	if (rc != ETIMEDOUT)
+		rc = 0;
+#endif
+	ec_cancel_wait(ec);
+	return rc;
+}
+
+/**
+ * @brief Number of threads waiting, or about to
+ */
+static inline uint32_t ec_waiters(event_count_t *ec)
+{
+	return atomic_fetch_uint32_t(&ec->waiters);
+}
+
+/**
+ * @brief Wake up to @c n waiters
+ *
+ * The caller must already have made the waited-for condition true.
+ *
+ * @param[in] ec The event count
+ * @param[in] n  Most threads to wake, UINT32_MAX for all
+ *
+ * @return The number of threads that were waiting, at most n.
+ */
+static inline uint32_t ec_notify(event_count_t *ec, uint32_t n)
+{
+	uint32_t waiters;
+#ifndef __linux__
+	uint32_t ix;
+#endif
+
+	/* order the caller's update before the load of waiters, pairing
+	 * with the barrier in ec_prepare_wait */
+	__sync_synchronize();
+	waiters = atomic_fetch_uint32_t(&ec->waiters);
+	if (waiters == 0)
+		return 0;
+
+	(void) atomic_inc_uint32_t(&ec->seq);
+#ifdef __linux__
+	(void) syscall(SYS_futex, &ec->seq, FUTEX_WAKE_PRIVATE,
+		       n > INT32_MAX ? INT32_MAX : n, NULL, NULL, 0);
+#else
+	pthread_mutex_lock(&ec->mtx);
+	if (n >= waiters)
+		pthread_cond_broadcast(&ec->cv);
+	else
+		for (ix = 0; ix < n; ++ix)
+			pthread_cond_signal(&ec->cv);
+	pthread_mutex_unlock(&ec->mtx);
+#endif
+	return waiters < n ? waiters : n;
+}
+
+/**
+ * @brief Relax the CPU inside a spin loop
+ */
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield" ::: "memory");
+#else
+	__sync_synchronize();
+#endif
+}
+
 static inline void thread_delay_ms(unsigned long ms)
 {
 	struct timespec then = {
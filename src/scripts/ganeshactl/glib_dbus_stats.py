@@ -225,6 +225,14 @@ class InodeStats():
         self.cache_conflict = stats[3][7]
         self.cache_add = stats[3][9]
         self.cache_mapping = stats[3][11]
+        self.lru_l1 = stats[3][13]
+        self.lru_l2 = stats[3][15]
+        self.lru_l1_target = stats[3][17]
+        self.ghost_l1_hits = stats[3][19]
+        self.ghost_l2_hits = stats[3][21]
+        self.evict_l1 = stats[3][23]
+        self.evict_l2 = stats[3][25]
+        self.evict_killed = stats[3][27]
     def __str__(self):
         if self.status != "OK":
             return "No NFS activity, GANESHA RESPONSE STATUS: " + self.status
@@ -234,7 +242,15 @@ class InodeStats():
                  "\nInode Cache Misses: " + str(self.cache_miss) +
                  "\nInode Cache Conflicts:: " + str(self.cache_conflict) +
                  "\nInode Cache Adds: " + str(self.cache_add) +
-                 "\nInode Cache Mapping: " + str(self.cache_mapping) )
+                 "\nInode Cache Mapping: " + str(self.cache_mapping) +
+                 "\nInode LRU L1 (probation): " + str(self.lru_l1) +
+                 "\nInode LRU L2 (protected): " + str(self.lru_l2) +
+                 "\nInode LRU L1 Target: " + str(self.lru_l1_target) +
+                 "\nInode LRU L1 Ghost Hits: " + str(self.ghost_l1_hits) +
+                 "\nInode LRU L2 Ghost Hits: " + str(self.ghost_l2_hits) +
+                 "\nInode LRU L1 Reclaims: " + str(self.evict_l1) +
+                 "\nInode LRU L2 Reclaims: " + str(self.evict_l2) +
+                 "\nInode LRU Killed: " + str(self.evict_killed) )
 
 class FastStats():
     def __init__(self, stats):
@@ -511,10 +511,205 @@ static struct gsh_dbus_method cltmgr_show_clients = {
 		 END_ARG_LIST}
 };
 
+/**
+ * @brief Set the per-client cap on requests in service
+ *
+ * Runtime override of Dispatch_Max_Reqs_Client, 0 removes the cap.
+ */
+
+static bool gsh_client_setmaxreqs(DBusMessageIter *args,
+				  DBusMessage *reply,
+				  DBusError *error)
+{
+	char *errormsg = "OK";
+	bool success = true;
+	uint32_t max_reqs;
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (args == NULL) {
+		success = false;
+		errormsg = "message has no arguments";
+	} else if (dbus_message_iter_get_arg_type(args) != DBUS_TYPE_UINT32) {
+		success = false;
+		errormsg = "arg not a 32 bit integer";
+	} else {
+		dbus_message_iter_get_basic(args, &max_reqs);
+		atomic_store_uint32_t(&nfs_param.core_param.
+				      dispatch_max_reqs_client, max_reqs);
+		LogEvent(COMPONENT_DISPATCH,
+			 "Dispatch_Max_Reqs_Client set to %u", max_reqs);
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_set_max_reqs = {
+	.name = "SetMaxReqsClient",
+	.method = gsh_client_setmaxreqs,
+	.args = {{
+		  .name = "max_reqs",
+		  .type = "u",
+		  .direction = "in"},
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * @brief Set the per-client rate limits
+ *
+ * Runtime override of Client_Ops_Rate and Client_Bytes_Rate, 0
+ * removes a limit.
+ */
+
+static bool gsh_client_setrates(DBusMessageIter *args,
+				DBusMessage *reply,
+				DBusError *error)
+{
+	char *errormsg = "OK";
+	bool success = true;
+	uint64_t ops_rate, bytes_rate;
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	if (args == NULL) {
+		success = false;
+		errormsg = "message has no arguments";
+	} else if (dbus_message_iter_get_arg_type(args) != DBUS_TYPE_UINT64) {
+		success = false;
+		errormsg = "ops_rate not a 64 bit integer";
+	} else {
+		dbus_message_iter_get_basic(args, &ops_rate);
+		if (!dbus_message_iter_next(args)
+		    || dbus_message_iter_get_arg_type(args) !=
+		    DBUS_TYPE_UINT64) {
+			success = false;
+			errormsg = "bytes_rate not a 64 bit integer";
+		} else {
+			dbus_message_iter_get_basic(args, &bytes_rate);
+			atomic_store_uint64_t(&nfs_param.core_param.
+					      client_ops_rate, ops_rate);
+			atomic_store_uint64_t(&nfs_param.core_param.
+					      client_bytes_rate, bytes_rate);
+			LogEvent(COMPONENT_DISPATCH,
+				 "Client_Ops_Rate set to %" PRIu64
+				 ", Client_Bytes_Rate set to %" PRIu64,
+				 ops_rate, bytes_rate);
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_set_rates = {
+	.name = "SetClientRates",
+	.method = gsh_client_setrates,
+	.args = {{
+		  .name = "ops_rate",
+		  .type = "t",
+		  .direction = "in"},
+		 {
+		  .name = "bytes_rate",
+		  .type = "t",
+		  .direction = "in"},
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
+struct showrates_state {
+	DBusMessageIter client_iter;
+	nsecs_elapsed_t now;
+};
+
+static bool client_rates_to_dbus(struct gsh_client *cl_node, void *state)
+{
+	struct showrates_state *iter_state = (struct showrates_state *)state;
+	char ipaddr[64];
+	const char *addrp;
+	int addr_type;
+	uint64_t val;
+	DBusMessageIter struct_iter;
+
+	addr_type = (cl_node->addr.len == 4) ? AF_INET : AF_INET6;
+	addrp =
+	    inet_ntop(addr_type, cl_node->addr.addr, ipaddr, sizeof(ipaddr));
+	dbus_message_iter_open_container(&iter_state->client_iter,
+					 DBUS_TYPE_STRUCT, NULL, &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &addrp);
+	val = tb_rate(&cl_node->ops_tb, iter_state->now);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = tb_rate(&cl_node->bytes_tb, iter_state->now);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&cl_node->ops_tb.throttles);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&cl_node->bytes_tb.throttles);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	dbus_message_iter_close_container(&iter_state->client_iter,
+					  &struct_iter);
+	return true;
+}
+
+/**
+ * @brief Show each client's current rates and throttle counts
+ *
+ * Rates are operations and bytes per second over about the last
+ * second; throttles count requests that put the client over
+ * Client_Ops_Rate or Client_Bytes_Rate.
+ */
+
+static bool gsh_client_showrates(DBusMessageIter *args,
+				 DBusMessage *reply,
+				 DBusError *error)
+{
+	DBusMessageIter iter;
+	struct showrates_state iter_state;
+	struct timespec timestamp;
+	uint64_t val;
+
+	now(&timestamp);
+	iter_state.now = tb_now();
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_append_timestamp(&iter, &timestamp);
+	val = atomic_fetch_uint64_t(&nfs_param.core_param.client_ops_rate);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&nfs_param.core_param.client_bytes_rate);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &val);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					 "(stttt)",
+					 &iter_state.client_iter);
+
+	(void)foreach_gsh_client(client_rates_to_dbus, (void *)&iter_state);
+
+	dbus_message_iter_close_container(&iter, &iter_state.client_iter);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_rates = {
+	.name = "ShowClientRates",
+	.method = gsh_client_showrates,
+	.args = {TIMESTAMP_REPLY,
+		 {
+		  .name = "ops_rate",
+		  .type = "t",
+		  .direction = "out"},
+		 {
+		  .name = "bytes_rate",
+		  .type = "t",
+		  .direction = "out"},
+		 {
+		  .name = "clients",
+		  .type = "a(stttt)",
+		  .direction = "out"},
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *cltmgr_client_methods[] = {
 	&cltmgr_add_client,
 	&cltmgr_remove_client,
 	&cltmgr_show_clients,
+	&cltmgr_set_max_reqs,
+	&cltmgr_set_rates,
+	&cltmgr_show_rates,
 	NULL
 };
 
@@ -874,6 +1069,52 @@ static struct gsh_dbus_method cltmgr_show_9p_trans = {
 		 END_ARG_LIST}
 };
 
+/**
+ * DBUS method to report fair queueing statistics of a client
+ *
+ */
+
+static bool get_sched_stats(DBusMessageIter *args,
+			    DBusMessage *reply,
+			    DBusError *error)
+{
+	struct gsh_client *client = NULL;
+	struct server_stats *server_st = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	client = lookup_client(args, &errormsg);
+	if (client == NULL) {
+		success = false;
+		if (errormsg == NULL)
+			errormsg = "Client IP address not found";
+	} else {
+		server_st = container_of(client, struct server_stats, client);
+		if (server_st->st.sched == NULL) {
+			success = false;
+			errormsg = "Client does not have any activity";
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success)
+		server_dbus_sched(server_st->st.sched, &iter);
+
+	if (client != NULL)
+		put_gsh_client(client);
+	return true;
+}
+
+static struct gsh_dbus_method cltmgr_show_sched = {
+	.name = "GetSchedStats",
+	.method = get_sched_stats,
+	.args = {IPADDR_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 SCHED_REPLY,
+		 END_ARG_LIST}
+};
 
 static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_v3_io,
@@ -883,6 +1124,7 @@ static struct gsh_dbus_method *cltmgr_stats_methods[] = {
 	&cltmgr_show_delegations,
 	&cltmgr_show_9p_io,
 	&cltmgr_show_9p_trans,
+	&cltmgr_show_sched,
 	NULL
 };
 
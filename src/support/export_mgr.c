@@ -72,6 +72,7 @@ struct export_by_id {
 	struct avltree t;
 	struct avltree_node **cache;
 	uint32_t cache_sz;
+	uint32_t gen;	/*< bumped when an export goes, atomic */
 };
 
 static struct export_by_id export_by_id;
@@ -340,6 +341,73 @@ struct gsh_export *get_gsh_export(uint16_t export_id)
 	return exp;
 }
 
+/**
+ * @brief Generation of the export table
+ *
+ * Moves whenever an export is removed or changes state, so that a
+ * caller holding on to an export it looked up earlier knows to look
+ * it up again.
+ *
+ * @return the generation.
+ */
+uint32_t gsh_export_gen(void)
+{
+	return atomic_fetch_uint32_t(&export_by_id.gen);
+}
+
+/**
+ * @brief Admit a request to an export
+ *
+ * Charges the request to the export's rate limits and gets its
+ * scheduling weight.  Used by the request decoder, which keeps the
+ * export of a connection's requests referenced from one request to
+ * the next, so no lock is taken.
+ *
+ * @param export      [IN] the export, referenced by the caller
+ * @param bytes       [IN] READ and WRITE bytes the request moves
+ * @param now         [IN] the time, from tb_now
+ * @param burst       [IN] nanoseconds of a rate usable at once
+ * @param police      [IN] refuse, rather than charge, a request while
+ *                         the export is over its burst
+ * @param weight      [OUT] the export's Sched_Weight
+ *
+ * @return nanoseconds the sender should be held off, 0 if none.  When
+ *         policing, non-zero means the request was refused.
+ */
+nsecs_elapsed_t gsh_export_admit(struct gsh_export *export, uint64_t bytes,
+				 nsecs_elapsed_t now, nsecs_elapsed_t burst,
+				 bool police, uint32_t *weight)
+{
+	nsecs_elapsed_t delay, bdelay;
+
+	*weight = atomic_fetch_uint32_t(&export->sched_weight);
+
+	if (police) {
+		delay = tb_debt(&export->ops_tb,
+				atomic_fetch_uint64_t(&export->ops_rate),
+				now, burst);
+		if (delay == 0)
+			delay = tb_debt(&export->bytes_tb,
+					atomic_fetch_uint64_t(
+						&export->bytes_rate),
+					now, burst);
+		if (delay != 0)
+			return delay;
+	}
+
+	delay = tb_charge(&export->ops_tb,
+			  atomic_fetch_uint64_t(&export->ops_rate),
+			  1, now, burst);
+	bdelay = tb_charge(&export->bytes_tb,
+			   atomic_fetch_uint64_t(&export->bytes_rate),
+			   bytes, now, burst);
+	if (bdelay > delay)
+		delay = bdelay;
+
+	/* admitted; the debt it ran up refuses the next ones */
+	return police ? 0 : delay;
+}
+
 /**
  * @brief Set export entry's state
  *
@@ -365,6 +433,7 @@ void set_gsh_export_state(struct gsh_export *export, export_state_t state)
 		assert(0);
 	}
 	export->state = state;
+	(void) atomic_inc_uint32_t(&export_by_id.gen);
 	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
 }
 
@@ -716,6 +785,9 @@ void remove_gsh_export(uint16_t export_id)
 
 		/* Remove the export from the export list */
 		glist_del(&export->exp_list);
+
+		/* and from the decoder's connections */
+		(void) atomic_inc_uint32_t(&export_by_id.gen);
 	}
 
 	PTHREAD_RWLOCK_unlock(&export_by_id.lock);
@@ -1177,11 +1249,205 @@ static struct gsh_dbus_method export_show_exports = {
 		 END_ARG_LIST}
 };
 
+/**
+ * @brief Set the scheduling weight of an export
+ *
+ * Changes the export's share of the request queues without a
+ * config reload.  Applies to requests decoded from now on.
+ */
+
+static bool gsh_export_setschedweight(DBusMessageIter *args,
+				      DBusMessage *reply,
+				      DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	char *errormsg = "OK";
+	bool success = true;
+	uint32_t weight;
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	export = lookup_export(args, &errormsg);
+	if (export == NULL) {
+		success = false;
+	} else if (!dbus_message_iter_next(args)
+		   || dbus_message_iter_get_arg_type(args) !=
+		   DBUS_TYPE_UINT32) {
+		success = false;
+		errormsg = "weight not a 32 bit integer";
+	} else {
+		dbus_message_iter_get_basic(args, &weight);
+		if (weight < 1 || weight > 1024) {
+			success = false;
+			errormsg = "weight must be from 1 to 1024";
+		} else {
+			atomic_store_uint32_t(&export->sched_weight, weight);
+			LogEvent(COMPONENT_EXPORT,
+				 "Export %d Sched_Weight set to %u",
+				 export->export_id, weight);
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+
+	if (export != NULL)
+		put_gsh_export(export);
+	return true;
+}
+
+static struct gsh_dbus_method export_set_sched_weight = {
+	.name = "SetSchedWeight",
+	.method = gsh_export_setschedweight,
+	.args = {EXPORT_ID_ARG,
+		 {
+		  .name = "weight",
+		  .type = "u",
+		  .direction = "in"},
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * @brief Set the rate limits of an export
+ *
+ * Runtime override of Ops_Rate and Bytes_Rate, 0 removes a limit.
+ */
+
+static bool gsh_export_setrates(DBusMessageIter *args,
+				DBusMessage *reply,
+				DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	char *errormsg = "OK";
+	bool success = true;
+	uint64_t ops_rate, bytes_rate;
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	export = lookup_export(args, &errormsg);
+	if (export == NULL) {
+		success = false;
+	} else if (!dbus_message_iter_next(args)
+		   || dbus_message_iter_get_arg_type(args) !=
+		   DBUS_TYPE_UINT64) {
+		success = false;
+		errormsg = "ops_rate not a 64 bit integer";
+	} else {
+		dbus_message_iter_get_basic(args, &ops_rate);
+		if (!dbus_message_iter_next(args)
+		    || dbus_message_iter_get_arg_type(args) !=
+		    DBUS_TYPE_UINT64) {
+			success = false;
+			errormsg = "bytes_rate not a 64 bit integer";
+		} else {
+			dbus_message_iter_get_basic(args, &bytes_rate);
+			atomic_store_uint64_t(&export->ops_rate, ops_rate);
+			atomic_store_uint64_t(&export->bytes_rate, bytes_rate);
+			LogEvent(COMPONENT_EXPORT,
+				 "Export %d Ops_Rate set to %" PRIu64
+				 ", Bytes_Rate set to %" PRIu64,
+				 export->export_id, ops_rate, bytes_rate);
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+
+	if (export != NULL)
+		put_gsh_export(export);
+	return true;
+}
+
+static struct gsh_dbus_method export_set_rates = {
+	.name = "SetExportRates",
+	.method = gsh_export_setrates,
+	.args = {EXPORT_ID_ARG,
+		 {
+		  .name = "ops_rate",
+		  .type = "t",
+		  .direction = "in"},
+		 {
+		  .name = "bytes_rate",
+		  .type = "t",
+		  .direction = "in"},
+		 STATUS_REPLY,
+		 END_ARG_LIST}
+};
+
+struct showrates_state {
+	DBusMessageIter export_iter;
+	nsecs_elapsed_t now;
+};
+
+static bool export_rates_to_dbus(struct gsh_export *exp_node, void *state)
+{
+	struct showrates_state *iter_state = (struct showrates_state *)state;
+	DBusMessageIter struct_iter;
+	uint64_t val;
+
+	dbus_message_iter_open_container(&iter_state->export_iter,
+					 DBUS_TYPE_STRUCT, NULL, &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT16,
+				       &exp_node->export_id);
+	val = atomic_fetch_uint64_t(&exp_node->ops_rate);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&exp_node->bytes_rate);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = tb_rate(&exp_node->ops_tb, iter_state->now);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = tb_rate(&exp_node->bytes_tb, iter_state->now);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&exp_node->ops_tb.throttles);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	val = atomic_fetch_uint64_t(&exp_node->bytes_tb.throttles);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	dbus_message_iter_close_container(&iter_state->export_iter,
+					  &struct_iter);
+	return true;
+}
+
+/**
+ * @brief Show each export's rate limits, current rates and throttles
+ */
+
+static bool gsh_export_showrates(DBusMessageIter *args,
+				 DBusMessage *reply,
+				 DBusError *error)
+{
+	DBusMessageIter iter;
+	struct showrates_state iter_state;
+	struct timespec timestamp;
+
+	now(&timestamp);
+	iter_state.now = tb_now();
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_append_timestamp(&iter, &timestamp);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					 "(qtttttt)",
+					 &iter_state.export_iter);
+
+	(void)foreach_gsh_export(export_rates_to_dbus, (void *)&iter_state);
+
+	dbus_message_iter_close_container(&iter, &iter_state.export_iter);
+	return true;
+}
+
+static struct gsh_dbus_method export_show_rates = {
+	.name = "ShowExportRates",
+	.method = gsh_export_showrates,
+	.args = {TIMESTAMP_REPLY,
+		 {
+		  .name = "exports",
+		  .type = "a(qtttttt)",
+		  .direction = "out"},
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *export_mgr_methods[] = {
 	&export_add_export,
 	&export_remove_export,
 	&export_display_export,
 	&export_show_exports,
+	&export_set_sched_weight,
+	&export_set_rates,
+	&export_show_rates,
 	NULL
 };
 
@@ -1445,6 +1711,22 @@ static bool show_cache_inode_stats(DBusMessageIter *args,
 	return true;
 }
 
+static bool show_req_queue_stats(DBusMessageIter *args,
+				 DBusMessage *reply,
+				 DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	nfs_rpc_queue_dbus_show(&iter);
+
+	return true;
+}
+
 static struct gsh_dbus_method export_show_v41_layouts = {
 	.name = "GetNFSv41Layouts",
 	.method = get_nfsv41_export_layouts,
@@ -1539,6 +1821,210 @@ static struct gsh_dbus_method cache_inode_show = {
 		 END_ARG_LIST}
 };
 
+static struct gsh_dbus_method req_queue_show = {
+	.name = "ShowReqQueues",
+	.method = show_req_queue_stats,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 REQ_QUEUE_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report the worker pool size and adaptation
+ *
+ */
+
+static bool show_worker_pool(DBusMessageIter *args,
+			     DBusMessage *reply,
+			     DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	nfs_worker_pool_dbus_show(&iter);
+
+	return true;
+}
+
+static struct gsh_dbus_method worker_pool_show = {
+	.name = "ShowWorkers",
+	.method = show_worker_pool,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 WORKER_POOL_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report slab pool allocator statistics
+ *
+ */
+
+static bool show_slab_pools(DBusMessageIter *args,
+			    DBusMessage *reply,
+			    DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	pool_slab_dbus_show(&iter);
+
+	return true;
+}
+
+static struct gsh_dbus_method slab_pools_show = {
+	.name = "ShowPools",
+	.method = show_slab_pools,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 SLAB_POOLS_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report hash table occupancy and contention
+ *
+ */
+
+static bool show_hashtables(DBusMessageIter *args,
+			    DBusMessage *reply,
+			    DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	hashtable_dbus_show(&iter);
+
+	return true;
+}
+
+static struct gsh_dbus_method hashtables_show = {
+	.name = "ShowHashtables",
+	.method = show_hashtables,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 HASHTABLES_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report duplicate request cache statistics
+ *
+ */
+
+static bool show_drcs(DBusMessageIter *args,
+		      DBusMessage *reply,
+		      DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	drc_dbus_show(&iter);
+
+	return true;
+}
+
+static struct gsh_dbus_method drcs_show = {
+	.name = "ShowDRC",
+	.method = show_drcs,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 DRC_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report the memory held by the inode cache
+ *
+ */
+
+static bool show_cache_inode_bytes(DBusMessageIter *args,
+				   DBusMessage *reply,
+				   DBusError *error)
+{
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_status_reply(&iter, success, errormsg);
+
+	cache_inode_bytes_dbus_show(&iter);
+
+	return true;
+}
+
+static struct gsh_dbus_method cache_inode_bytes_show = {
+	.name = "ShowCacheInodeBytes",
+	.method = show_cache_inode_bytes,
+	.args = {STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 CACHE_BYTES_REPLY,
+		 END_ARG_LIST}
+};
+
+/**
+ * DBUS method to report fair queueing statistics of an export
+ *
+ */
+
+static bool get_sched_export(DBusMessageIter *args,
+			     DBusMessage *reply,
+			     DBusError *error)
+{
+	struct gsh_export *export = NULL;
+	struct export_stats *export_st = NULL;
+	bool success = true;
+	char *errormsg = "OK";
+	DBusMessageIter iter;
+
+	dbus_message_iter_init_append(reply, &iter);
+	export = lookup_export(args, &errormsg);
+	if (export == NULL) {
+		success = false;
+	} else {
+		export_st = container_of(export, struct export_stats, export);
+		if (export_st->st.sched == NULL) {
+			success = false;
+			errormsg = "Export does not have any activity";
+		}
+	}
+	dbus_status_reply(&iter, success, errormsg);
+	if (success)
+		server_dbus_sched(export_st->st.sched, &iter);
+
+	if (export != NULL)
+		put_gsh_export(export);
+	return true;
+}
+
+static struct gsh_dbus_method export_show_sched = {
+	.name = "GetSchedStats",
+	.method = get_sched_export,
+	.args = {EXPORT_ID_ARG,
+		 STATUS_REPLY,
+		 TIMESTAMP_REPLY,
+		 SCHED_REPLY,
+		 END_ARG_LIST}
+};
+
 static struct gsh_dbus_method *export_stats_methods[] = {
 	&export_show_v3_io,
 	&export_show_v40_io,
@@ -1549,6 +2035,13 @@ static struct gsh_dbus_method *export_stats_methods[] = {
 	&global_show_total_ops,
 	&global_show_fast_ops,
 	&cache_inode_show,
+	&req_queue_show,
+	&worker_pool_show,
+	&slab_pools_show,
+	&hashtables_show,
+	&drcs_show,
+	&cache_inode_bytes_show,
+	&export_show_sched,
 	NULL
 };
 
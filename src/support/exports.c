@@ -1200,6 +1200,12 @@ static struct config_item export_params[] = {
 	CONF_ITEM_I32_SET("Attr_Expiration_Time", -1, INT32_MAX, 60,
 		       gsh_export, expire_time_attr,
 		       EXPORT_OPTION_EXPIRE_SET,  options_set),
+	CONF_ITEM_UI32("Sched_Weight", 1, 1024, 1,
+		       gsh_export, sched_weight),
+	CONF_ITEM_UI64("Ops_Rate", 0, UINT64_MAX, 0,
+		       gsh_export, ops_rate),
+	CONF_ITEM_UI64("Bytes_Rate", 0, UINT64_MAX, 0,
+		       gsh_export, bytes_rate),
 	CONF_RELAX_BLOCK("FSAL", fsal_params,
 			 fsal_init, fsal_commit,
 			 gsh_export, fsal_export),
@@ -1308,6 +1314,7 @@ static int build_default_root(void)
 	export->PrefWrite = FSAL_MAXIOSIZE;
 	export->PrefRead = FSAL_MAXIOSIZE;
 	export->PrefReaddir = 16384;
+	export->sched_weight = 1;
 	glist_init(&export->exp_state_list);
 	glist_init(&export->exp_lock_list);
 	glist_init(&export->exp_nlm_share_list);
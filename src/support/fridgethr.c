@@ -379,9 +379,12 @@ static bool fridgethr_freeze(struct fridgethr *fr,
 
 	/* rc would have been set in the while loop below */
 	if (((rc == ETIMEDOUT) && (fr->nthreads > fr->p.thr_min))
+	    || fe->ctx.retire
 	    || (fr->command == fridgethr_comm_stop)) {
 		/* We do this here since we already have the fridge
 		   lock. */
+		if (fe->ctx.retire)
+			--(fr->nretiring);
 		--(fr->nthreads);
 		glist_del(&fe->thread_link);
 		if ((fr->nthreads == 0) && (fr->command == fridgethr_comm_stop)
@@ -1369,6 +1372,39 @@ bool fridgethr_you_should_break(struct fridgethr_context *ctx)
 	return rc;
 }
 
+/**
+ * @brief Ask for the calling thread to exit
+ *
+ * For fridgethr_flavor_looper fridges, whose run function waits for
+ * work on its own and so never times out in the fridge.  If the
+ * fridge would still have more than thr_min threads, the thread is
+ * marked to exit as soon as its run function returns.
+ *
+ * @param[in] ctx Thread context
+ *
+ * @retval true if the run function should return now.
+ * @retval false if the thread is needed to keep thr_min threads.
+ */
+
+bool fridgethr_retire(struct fridgethr_context *ctx)
+{
+	/* Entry for this thread */
+	struct fridgethr_entry *fe = container_of(ctx, struct fridgethr_entry,
+						  ctx);
+	struct fridgethr *fr = fe->fr;
+	bool rc = false;
+
+	PTHREAD_MUTEX_lock(&fr->mtx);
+	if (!ctx->retire
+	    && (fr->nthreads - fr->nretiring) > fr->p.thr_min) {
+		ctx->retire = true;
+		++(fr->nretiring);
+		rc = true;
+	}
+	PTHREAD_MUTEX_unlock(&fr->mtx);
+	return rc;
+}
+
 /**
  * @brief Populate a fridge with threads all running the same thing
  *
@@ -0,0 +1,300 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file gsh_affinity.c
+ * @brief CPU and NUMA placement of server threads
+ */
+
+#include "config.h"
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef LINUX
+#include <sys/syscall.h>
+#endif
+#include "log.h"
+#include "abstract_mem.h"
+#include "gsh_config.h"
+#include "gsh_affinity.h"
+
+/** Most NUMA nodes looked for in sysfs */
+#define GSH_MAX_NODES 64
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+static const char *const affinity_class_s[GSH_AFFINITY_CLASSES] = {
+	[GSH_AFFINITY_EVCHAN] = "Event_Channel_CPUs",
+	[GSH_AFFINITY_DECODER] = "Decoder_CPUs",
+	[GSH_AFFINITY_WORKER] = "Worker_CPUs",
+	[GSH_AFFINITY_LRU] = "LRU_CPUs",
+};
+
+static struct {
+	uint32_t ncpus;		/*< CPUs the kernel knows of */
+	uint32_t nnodes;	/*< NUMA nodes, 1 if unknown */
+	bool numa;		/*< NUMA_Affinity is on, with > 1 node */
+	int *cpu_node;		/*< node of each CPU */
+	cpu_set_t node_cpus[GSH_MAX_NODES];
+	bool class_set[GSH_AFFINITY_CLASSES];	/*< class is confined */
+	cpu_set_t class_cpus[GSH_AFFINITY_CLASSES];
+} affinity;
+
+/**
+ * @brief Parse a CPU list such as "0-3,8,10-11"
+ *
+ * @param[in]  list The list
+ * @param[out] set  The CPUs in it
+ *
+ * @return 0 on success, -1 if the list is malformed.
+ */
+static int parse_cpulist(const char *list, cpu_set_t *set)
+{
+	const char *p = list;
+	char *end;
+	long lo, hi;
+
+	CPU_ZERO(set);
+	while (*p != '\0') {
+		while (isspace(*p) || *p == ',')
+			p++;
+		if (*p == '\0')
+			break;
+		lo = strtol(p, &end, 10);
+		if (end == p || lo < 0)
+			return -1;
+		hi = lo;
+		p = end;
+		if (*p == '-') {
+			hi = strtol(p + 1, &end, 10);
+			if (end == p + 1 || hi < lo)
+				return -1;
+			p = end;
+		}
+		for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+			CPU_SET(lo, set);
+		while (isspace(*p))
+			p++;
+		if (*p != '\0' && *p != ',')
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Read the NUMA topology from sysfs
+ */
+static void read_topology(void)
+{
+	char path[64], buf[1024];
+	uint32_t node, cpu;
+	FILE *fp;
+
+	affinity.nnodes = 1;
+	for (cpu = 0; cpu < affinity.ncpus; cpu++)
+		affinity.cpu_node[cpu] = 0;
+
+	for (node = 0; node < GSH_MAX_NODES; node++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%u/cpulist", node);
+		fp = fopen(path, "r");
+		if (fp == NULL)
+			continue;
+		if (fgets(buf, sizeof(buf), fp) != NULL) {
+			buf[strcspn(buf, "\n")] = '\0';
+			if (parse_cpulist(buf, &affinity.node_cpus[node]) == 0)
+				affinity.nnodes = node + 1;
+		}
+		fclose(fp);
+	}
+
+	for (node = 0; node < affinity.nnodes; node++)
+		for (cpu = 0; cpu < affinity.ncpus && cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &affinity.node_cpus[node]))
+				affinity.cpu_node[cpu] = node;
+}
+
+/**
+ * @brief Read the topology and the affinity options
+ *
+ * Must be called after the configuration is parsed and before any
+ * of the placed threads are started.
+ */
+void gsh_affinity_init(void)
+{
+	char *lists[GSH_AFFINITY_CLASSES] = {
+		[GSH_AFFINITY_EVCHAN] = nfs_param.core_param.evchan_cpus,
+		[GSH_AFFINITY_DECODER] = nfs_param.core_param.decoder_cpus,
+		[GSH_AFFINITY_WORKER] = nfs_param.core_param.worker_cpus,
+		[GSH_AFFINITY_LRU] = nfs_param.core_param.lru_cpus,
+	};
+	long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	int cls;
+
+	affinity.ncpus = (ncpus > 0) ? ncpus : 1;
+	affinity.cpu_node = gsh_calloc(affinity.ncpus, sizeof(int));
+	if (affinity.cpu_node == NULL)
+		LogFatal(COMPONENT_INIT, "Unable to allocate CPU node map");
+
+	read_topology();
+	affinity.numa = nfs_param.core_param.numa_affinity
+	    && affinity.nnodes > 1;
+
+	for (cls = 0; cls < GSH_AFFINITY_CLASSES; cls++) {
+		if (lists[cls] == NULL || lists[cls][0] == '\0')
+			continue;
+		if (parse_cpulist(lists[cls], &affinity.class_cpus[cls]) != 0
+		    || CPU_COUNT(&affinity.class_cpus[cls]) == 0) {
+			LogCrit(COMPONENT_INIT,
+				"Ignoring malformed %s \"%s\"",
+				affinity_class_s[cls], lists[cls]);
+			continue;
+		}
+		affinity.class_set[cls] = true;
+	}
+
+	LogInfo(COMPONENT_INIT, "%u CPUs in %u NUMA nodes, NUMA affinity %s",
+		affinity.ncpus, affinity.nnodes,
+		affinity.numa ? "on" : "off");
+}
+
+/**
+ * @brief Whether threads and queues are placed by NUMA node
+ */
+bool gsh_numa_enabled(void)
+{
+	return affinity.numa;
+}
+
+/**
+ * @brief Number of NUMA nodes, 1 when NUMA placement is off
+ */
+uint32_t gsh_numa_nodes(void)
+{
+	return affinity.numa ? affinity.nnodes : 1;
+}
+
+/**
+ * @brief Number of CPUs the kernel knows of
+ */
+uint32_t gsh_ncpus(void)
+{
+	return affinity.ncpus;
+}
+
+/**
+ * @brief NUMA node of a CPU, 0 when NUMA placement is off
+ */
+int gsh_cpu_node(int cpu)
+{
+	if (!affinity.numa || cpu < 0 || (uint32_t) cpu >= affinity.ncpus)
+		return 0;
+
+	return affinity.cpu_node[cpu];
+}
+
+/**
+ * @brief Place the calling thread
+ *
+ * The thread is confined to its class's CPUs, and when NUMA
+ * placement is on and @c node is not negative, to those of that
+ * node as well.  If the two do not intersect, the node wins.
+ *
+ * @param[in] cls  The thread's class
+ * @param[in] node NUMA node, or -1 for none
+ */
+void gsh_bind_thread(enum gsh_affinity_class cls, int node)
+{
+	cpu_set_t set;
+	int rc;
+
+	if (!affinity.numa || node < 0 || (uint32_t) node >= affinity.nnodes)
+		node = -1;
+
+	if (node < 0 && !affinity.class_set[cls])
+		return;
+
+	if (node < 0) {
+		set = affinity.class_cpus[cls];
+	} else if (affinity.class_set[cls]) {
+		CPU_AND(&set, &affinity.class_cpus[cls],
+			&affinity.node_cpus[node]);
+		if (CPU_COUNT(&set) == 0)
+			set = affinity.node_cpus[node];
+	} else {
+		set = affinity.node_cpus[node];
+	}
+
+	rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (rc != 0)
+		LogWarn(COMPONENT_THREAD,
+			"Could not set %s affinity (node %d): %d",
+			affinity_class_s[cls], node, rc);
+}
+
+/**
+ * @brief Prefer a NUMA node for a range of memory
+ *
+ * Pages of the range already touched are moved, later ones are
+ * faulted in on @c node.  Only whole pages inside the range are
+ * affected.  Does nothing when NUMA placement is off.
+ *
+ * @param[in] addr Start of the range
+ * @param[in] len  Length of the range
+ * @param[in] node NUMA node
+ */
+void gsh_numa_place(void *addr, size_t len, int node)
+{
+#ifdef LINUX
+	uintptr_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t start = ((uintptr_t) addr + page - 1) & ~(page - 1);
+	uintptr_t end = ((uintptr_t) addr + len) & ~(page - 1);
+	unsigned long mask[GSH_MAX_NODES / (8 * sizeof(unsigned long))];
+
+	if (!affinity.numa || node < 0 || (uint32_t) node >= affinity.nnodes
+	    || end <= start)
+		return;
+
+	memset(mask, 0, sizeof(mask));
+	mask[node / (8 * sizeof(unsigned long))] |=
+	    1UL << (node % (8 * sizeof(unsigned long)));
+
+	if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, mask,
+		    GSH_MAX_NODES + 1, MPOL_MF_MOVE) != 0)
+		LogDebug(COMPONENT_INIT, "mbind to node %d failed: %d",
+			 node, errno);
+#endif
+}
@@ -0,0 +1,368 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @addtogroup io_buf
+ * @{
+ */
+
+/**
+ * @file io_buf.c
+ * @brief Recycled, aligned buffers for READ replies
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "abstract_mem.h"
+#include "abstract_atomic.h"
+#include "gsh_config.h"
+#include "log.h"
+#include "common_utils.h"
+#include "io_buf.h"
+
+/**
+ * @brief Buffers of each class a thread keeps for itself
+ */
+#define IO_BUF_MAG_SIZE 4
+
+/**
+ * @brief Class of buffers too large to recycle
+ */
+#define IO_BUF_DIRECT IO_BUF_CLASSES
+
+/**
+ * @brief Link in the data of a free buffer
+ */
+struct io_buf_free {
+	struct io_buf_free *next;	/*< Next free buffer of the class */
+};
+
+/**
+ * @brief Shared free list for one size class
+ */
+struct io_buf_list {
+	pthread_mutex_t mtx;
+	struct io_buf_free *head;
+};
+
+/**
+ * @brief A thread's own free buffers for one size class
+ */
+struct io_buf_mag {
+	struct io_buf_free *head;
+	uint32_t count;
+};
+
+static struct io_buf_list io_buf_lists[IO_BUF_CLASSES];
+
+/**
+ * @brief Size class map
+ *
+ * A buffer's size class is kept out of line, so that a buffer costs
+ * no more than its class: io_buf_put looks it up by the buffer's
+ * address.  The map is a three level table over the IO_BUF_ALIGN
+ * units of a 48 bit address space; a leaf holds one byte, the class
+ * plus one, per unit and covers IO_BUF_MAP_SIZE units.  Nodes are
+ * allocated as buffers land in their range, installed with a
+ * compare-and-swap and never freed, so lookups take no lock.
+ */
+#define IO_BUF_MAP_SHIFT 12
+#define IO_BUF_MAP_SIZE (1 << IO_BUF_MAP_SHIFT)
+#define IO_BUF_MAP_MASK (IO_BUF_MAP_SIZE - 1)
+
+struct io_buf_map_leaf {
+	uint8_t sclass[IO_BUF_MAP_SIZE];
+};
+
+struct io_buf_map_mid {
+	struct io_buf_map_leaf *leaf[IO_BUF_MAP_SIZE];
+};
+
+static struct io_buf_map_mid *io_buf_map[IO_BUF_MAP_SIZE];
+
+/**
+ * @brief Bytes held on free lists and in thread magazines
+ */
+static uint64_t io_buf_cached;
+
+static __thread struct io_buf_mag io_buf_mags[IO_BUF_CLASSES];
+static __thread bool io_buf_registered;
+
+static pthread_once_t io_buf_once = PTHREAD_ONCE_INIT;
+static pthread_key_t io_buf_key;
+
+static inline size_t io_buf_class_size(uint32_t sclass)
+{
+	return (size_t) 1 << (sclass + IO_BUF_MIN_SHIFT);
+}
+
+/**
+ * @brief Get a node of the size class map, creating it if asked to
+ *
+ * @param[in,out] slot   Where the node hangs
+ * @param[in]     size   Size of the node
+ * @param[in]     create Allocate the node if there is none
+ *
+ * @return The node, NULL if there is none.
+ */
+static void *io_buf_map_node(void **slot, size_t size, bool create)
+{
+	void *node = atomic_fetch_voidptr(slot);
+
+	if (node != NULL || !create)
+		return node;
+
+	node = gsh_calloc(1, size);
+	if (node == NULL)
+		return NULL;
+
+	/* another thread may have got there first */
+	if (!__sync_bool_compare_and_swap(slot, NULL, node)) {
+		gsh_free(node);
+		node = atomic_fetch_voidptr(slot);
+	}
+
+	return node;
+}
+
+/**
+ * @brief Find the size class map byte of a buffer
+ *
+ * @param[in] buf    The buffer
+ * @param[in] create Allocate the map nodes it needs
+ *
+ * @return The byte, NULL if the buffer is outside the map or its
+ *         nodes could not be allocated.
+ */
+static uint8_t *io_buf_map_slot(void *buf, bool create)
+{
+	uintptr_t unit = (uintptr_t) buf / IO_BUF_ALIGN;
+	uintptr_t top = unit >> (2 * IO_BUF_MAP_SHIFT);
+	struct io_buf_map_mid *mid;
+	struct io_buf_map_leaf *leaf;
+
+	if (top >= IO_BUF_MAP_SIZE)
+		return NULL;
+
+	mid = io_buf_map_node((void **)&io_buf_map[top],
+			      sizeof(struct io_buf_map_mid), create);
+	if (mid == NULL)
+		return NULL;
+
+	leaf = io_buf_map_node(
+		(void **)&mid->leaf[(unit >> IO_BUF_MAP_SHIFT) &
+				    IO_BUF_MAP_MASK],
+		sizeof(struct io_buf_map_leaf), create);
+	if (leaf == NULL)
+		return NULL;
+
+	return &leaf->sclass[unit & IO_BUF_MAP_MASK];
+}
+
+/**
+ * @brief Smallest class holding @c size bytes
+ */
+static inline uint32_t io_buf_class(size_t size)
+{
+	uint32_t sclass = 0;
+
+	if (size > io_buf_class_size(IO_BUF_CLASSES - 1))
+		return IO_BUF_DIRECT;
+
+	while (io_buf_class_size(sclass) < size)
+		sclass++;
+
+	return sclass;
+}
+
+/**
+ * @brief Hand an exiting thread's buffers to the shared lists
+ *
+ * Workers come and go with the pool size, so their magazines must
+ * not be lost with them.
+ */
+static void io_buf_thread_exit(void *arg)
+{
+	uint32_t sclass;
+
+	for (sclass = 0; sclass < IO_BUF_CLASSES; sclass++) {
+		struct io_buf_mag *mag = &io_buf_mags[sclass];
+		struct io_buf_list *list = &io_buf_lists[sclass];
+		struct io_buf_free *hdr;
+
+		if (mag->head == NULL)
+			continue;
+
+		PTHREAD_MUTEX_lock(&list->mtx);
+		while (mag->head != NULL) {
+			hdr = mag->head;
+			mag->head = hdr->next;
+			hdr->next = list->head;
+			list->head = hdr;
+		}
+		PTHREAD_MUTEX_unlock(&list->mtx);
+		mag->count = 0;
+	}
+}
+
+static void io_buf_init(void)
+{
+	uint32_t sclass;
+
+	for (sclass = 0; sclass < IO_BUF_CLASSES; sclass++)
+		pthread_mutex_init(&io_buf_lists[sclass].mtx, NULL);
+
+	if (pthread_key_create(&io_buf_key, io_buf_thread_exit) != 0)
+		LogCrit(COMPONENT_MAIN,
+			"Could not create I/O buffer thread key");
+}
+
+/**
+ * @brief Get a buffer of at least @c size bytes
+ *
+ * The buffer is aligned to IO_BUF_ALIGN and its contents are
+ * undefined.  It must be released with io_buf_put.
+ *
+ * @param[in] size Bytes needed
+ *
+ * @return The buffer, or NULL if memory is exhausted.
+ */
+void *io_buf_get(size_t size)
+{
+	uint32_t sclass = io_buf_class(size);
+	struct io_buf_mag *mag;
+	struct io_buf_list *list;
+	struct io_buf_free *buf;
+	uint8_t *slot;
+
+	if (sclass == IO_BUF_DIRECT)
+		goto alloc;
+
+	mag = &io_buf_mags[sclass];
+	buf = mag->head;
+	if (buf != NULL) {
+		mag->head = buf->next;
+		mag->count--;
+		goto hit;
+	}
+
+	/* Only a hint, saving the lock when there is plainly nothing
+	 * to take; the list is looked at again under the lock */
+	list = &io_buf_lists[sclass];
+	if (atomic_fetch_voidptr((void **)&list->head) == NULL)
+		goto alloc;
+
+	pthread_once(&io_buf_once, io_buf_init);
+	PTHREAD_MUTEX_lock(&list->mtx);
+	buf = list->head;
+	if (buf != NULL)
+		list->head = buf->next;
+	PTHREAD_MUTEX_unlock(&list->mtx);
+	if (buf == NULL)
+		goto alloc;
+
+ hit:
+	(void) atomic_sub_uint64_t(&io_buf_cached, io_buf_class_size(sclass));
+	return buf;
+
+ alloc:
+	buf = gsh_malloc_aligned(IO_BUF_ALIGN,
+				 sclass == IO_BUF_DIRECT
+				 ? size
+				 : io_buf_class_size(sclass));
+	if (buf == NULL)
+		return NULL;
+
+	slot = io_buf_map_slot(buf, true);
+	if (slot == NULL) {
+		LogCrit(COMPONENT_MAIN,
+			"Could not map the size class of I/O buffer %p", buf);
+		gsh_free(buf);
+		return NULL;
+	}
+
+	*slot = sclass + 1;
+	return buf;
+}
+
+/**
+ * @brief Release a buffer from io_buf_get
+ *
+ * The buffer goes to the calling thread's magazine, then to the
+ * shared list of its class, or back to the allocator if that would
+ * hold more than IO_Buffer_Cache_Size bytes.
+ *
+ * @param[in] buf Buffer to release
+ */
+void io_buf_put(void *buf)
+{
+	struct io_buf_free *hdr = buf;
+	struct io_buf_mag *mag;
+	struct io_buf_list *list;
+	uint8_t *slot;
+	uint32_t sclass;
+	size_t size;
+
+	if (buf == NULL)
+		return;
+
+	slot = io_buf_map_slot(buf, false);
+	assert(slot != NULL && *slot != 0);
+	sclass = *slot - 1;
+	if (sclass == IO_BUF_DIRECT)
+		goto release;
+
+	size = io_buf_class_size(sclass);
+	if (atomic_add_uint64_t(&io_buf_cached, size) >
+	    nfs_param.core_param.io_buf_cache_size) {
+		(void) atomic_sub_uint64_t(&io_buf_cached, size);
+		goto release;
+	}
+
+	pthread_once(&io_buf_once, io_buf_init);
+
+	mag = &io_buf_mags[sclass];
+	if (mag->count < IO_BUF_MAG_SIZE) {
+		if (!io_buf_registered) {
+			(void) pthread_setspecific(io_buf_key, mag);
+			io_buf_registered = true;
+		}
+		hdr->next = mag->head;
+		mag->head = hdr;
+		mag->count++;
+		return;
+	}
+
+	list = &io_buf_lists[sclass];
+	PTHREAD_MUTEX_lock(&list->mtx);
+	hdr->next = list->head;
+	list->head = hdr;
+	PTHREAD_MUTEX_unlock(&list->mtx);
+	return;
+
+ release:
+	*slot = 0;
+	gsh_free(buf);
+}
+
+/** @} */
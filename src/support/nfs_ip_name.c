@@ -340,6 +340,7 @@ static struct ip_name_cache ip_name_cache = {
 	.hash_param.compare_key = compare_ip_name,
 	.hash_param.key_to_str = display_ip_name_key,
 	.hash_param.val_to_str = display_ip_name_val,
+	.hash_param.ht_name = "IP Name",
 	.hash_param.flags = HT_FLAG_NONE,
 };
 
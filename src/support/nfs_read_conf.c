@@ -85,6 +85,26 @@ static struct config_item core_params[] = {
 		       nfs_core_param, program[P_RQUOTA]),
 	CONF_ITEM_UI32("Nb_Worker", 1, 1024*128, NB_WORKER_THREAD_DEFAULT,
 		       nfs_core_param, nb_worker),
+	CONF_ITEM_UI32("Nb_Worker_Min", 0, 1024*128, 0,
+		       nfs_core_param, nb_worker_min),
+	CONF_ITEM_UI32("Worker_Grow_Wait", 1, 10000000,
+		       WORKER_GROW_WAIT_DEFAULT,
+		       nfs_core_param, worker_grow_wait),
+	CONF_ITEM_UI32("Worker_Spin", 0, 1000000, WORKER_SPIN_DEFAULT,
+		       nfs_core_param, worker_spin),
+	CONF_ITEM_UI64("IO_Buffer_Cache_Size", 0, UINT64_MAX,
+		       IO_BUF_CACHE_SIZE_DEFAULT,
+		       nfs_core_param, io_buf_cache_size),
+	CONF_ITEM_STR("Event_Channel_CPUs", 1, 1024, NULL,
+		      nfs_core_param, evchan_cpus),
+	CONF_ITEM_STR("Decoder_CPUs", 1, 1024, NULL,
+		      nfs_core_param, decoder_cpus),
+	CONF_ITEM_STR("Worker_CPUs", 1, 1024, NULL,
+		      nfs_core_param, worker_cpus),
+	CONF_ITEM_STR("LRU_CPUs", 1, 1024, NULL,
+		      nfs_core_param, lru_cpus),
+	CONF_ITEM_BOOL("NUMA_Affinity", false,
+		       nfs_core_param, numa_affinity),
 	CONF_ITEM_BOOL("Drop_IO_Errors", false,
 		       nfs_core_param, drop_io_errors),
 	CONF_ITEM_BOOL("Drop_Inval_Errors", false,
@@ -95,8 +115,21 @@ static struct config_item core_params[] = {
 		       nfs_core_param, dispatch_max_reqs),
 	CONF_ITEM_UI32("Dispatch_Max_Reqs_Xprt", 1, 2048, 512,
 		       nfs_core_param, dispatch_max_reqs_xprt),
+	CONF_ITEM_UI32("Dispatch_Queue_Shards", 0, 1024, 0,
+		       nfs_core_param, dispatch_queue_shards),
+	CONF_ITEM_UI32("Dispatch_Max_Reqs_Client", 0, 10000, 0,
+		       nfs_core_param, dispatch_max_reqs_client),
+	CONF_ITEM_UI64("Client_Ops_Rate", 0, UINT64_MAX, 0,
+		       nfs_core_param, client_ops_rate),
+	CONF_ITEM_UI64("Client_Bytes_Rate", 0, UINT64_MAX, 0,
+		       nfs_core_param, client_bytes_rate),
+	CONF_ITEM_UI32("Rate_Limit_Burst", 1, 60000,
+		       RATE_LIMIT_BURST_DEFAULT,
+		       nfs_core_param, rate_limit_burst),
 	CONF_ITEM_BOOL("DRC_Disabled", false,
 		       nfs_core_param, drc.disabled),
+	CONF_ITEM_UI64("DRC_Budget", 0, UINT64_MAX, DRC_BUDGET,
+		       nfs_core_param, drc.budget),
 	CONF_ITEM_UI32("DRC_TCP_Npart", 1, 20, DRC_TCP_NPART,
 		       nfs_core_param, drc.tcp.npart),
 	CONF_ITEM_UI32("DRC_TCP_Size", 1, 32767, DRC_TCP_SIZE,
@@ -230,6 +263,9 @@ static struct config_item version4_params[] = {
 	CONF_ITEM_UI32("Deleg_Recall_Retry_Delay", 0, 10,
 			DELEG_RECALL_RETRY_DELAY_DEFAULT,
 			nfs_version4_parameter, deleg_recall_retry_delay),
+	CONF_ITEM_UI32("Max_Session_Slots", 1, 1024,
+		       MAX_SESSION_SLOTS_DEFAULT,
+		       nfs_version4_parameter, max_session_slots),
 	CONFIG_EOL
 };
 
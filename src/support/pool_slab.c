@@ -0,0 +1,508 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ * -------------
+ */
+
+/**
+ * @file   pool_slab.c
+ * @brief  Slab pool substrate with per-thread magazines
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include "abstract_mem.h"
+#include "ganesha_list.h"
+#include "gsh_intrinsic.h"
+#include "common_utils.h"
+#include "log.h"
+#include "pool_slab.h"
+
+/**
+ * @brief Slab pools that get per-thread magazines
+ *
+ * Later pools share their depot lock among all threads.
+ */
+#define POOL_SLAB_MAX 64
+
+#define POOL_SLAB_MAGAZINE_DEFAULT 32
+#define POOL_SLAB_SIZE_DEFAULT (64 * 1024)
+
+/** Object alignment, the same as malloc's */
+#define POOL_SLAB_ALIGN 16
+
+/** Fewest objects per slab */
+#define POOL_SLAB_MIN_OBJECTS 8
+
+/**
+ * @brief Header at the start of every slab
+ */
+struct pool_slab_chunk {
+	struct pool_slab_chunk *next;
+};
+
+#define POOL_SLAB_HDR \
+	((sizeof(struct pool_slab_chunk) + POOL_SLAB_ALIGN - 1) & \
+	 ~(POOL_SLAB_ALIGN - 1))
+
+/**
+ * @brief A free object, linked on the depot
+ */
+struct pool_slab_free {
+	struct pool_slab_free *next;
+};
+
+/**
+ * @brief Shared state of a slab pool, kept in pool->substrate_data
+ */
+struct pool_slab_depot {
+	pthread_mutex_t mtx;	/*< Protects everything below but mags */
+	pool_t *pool;		/*< The pool we belong to */
+	struct pool_slab_free *free;	/*< Free objects */
+	uint64_t nfree;		/*< Length of free */
+	struct pool_slab_chunk *slabs;	/*< Every slab we carved */
+	uint64_t nslabs;	/*< Number of slabs */
+	uint64_t objects;	/*< Objects carved from slabs */
+	size_t obj_size;	/*< Rounded object size */
+	size_t slab_size;	/*< Bytes per slab */
+	uint32_t per_slab;	/*< Objects per slab */
+	uint32_t mag_size;	/*< Objects per magazine */
+	uint32_t index;		/*< Slot in pool_slab_mags */
+	uint64_t allocs;	/*< Depot allocations and folded counts */
+	uint64_t hits;		/*< Folded magazine hits */
+	uint64_t refills;	/*< Magazine refills */
+	uint64_t drains;	/*< Magazine drains */
+	struct glist_head mags;	/*< Magazines, under pool_slab_mtx */
+	struct glist_head link;	/*< On pool_slab_all */
+};
+
+/**
+ * @brief A thread's magazine for one pool
+ */
+struct pool_slab_mag {
+	struct glist_head link;	/*< On depot->mags */
+	struct pool_slab_depot *depot;	/*< NULL once the pool is gone */
+	uint32_t count;		/*< Objects held */
+	uint64_t allocs;	/*< Allocations by this thread */
+	uint64_t hits;		/*< Allocations not needing a refill */
+	void *objs[];		/*< Free objects, depot->mag_size of them */
+};
+
+/** Protects pool_slab_all, depot->mags and mag->depot */
+static pthread_mutex_t pool_slab_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct glist_head pool_slab_all = GLIST_HEAD_INIT(pool_slab_all);
+static uint32_t pool_slab_next_index;
+
+static pthread_once_t pool_slab_once = PTHREAD_ONCE_INIT;
+static pthread_key_t pool_slab_key;
+
+static __thread struct pool_slab_mag *pool_slab_mags[POOL_SLAB_MAX];
+
+static inline struct pool_slab_depot *pool_slab_depot(pool_t *pool)
+{
+	return (struct pool_slab_depot *)pool->substrate_data;
+}
+
+/**
+ * @brief Carve a new slab onto the depot
+ *
+ * @note The depot lock must be held.
+ */
+static bool pool_slab_grow(struct pool_slab_depot *depot)
+{
+	struct pool_slab_chunk *slab;
+	struct pool_slab_free *obj;
+	char *base;
+	uint32_t i;
+
+	slab = gsh_malloc_aligned(POOL_SLAB_ALIGN, depot->slab_size);
+	if (slab == NULL)
+		return false;
+
+	slab->next = depot->slabs;
+	depot->slabs = slab;
+	depot->nslabs++;
+
+	/* Push in reverse so objects are handed out in address order */
+	base = (char *)slab + POOL_SLAB_HDR;
+	for (i = depot->per_slab; i > 0; i--) {
+		obj = (struct pool_slab_free *)(base +
+						(i - 1) * depot->obj_size);
+		obj->next = depot->free;
+		depot->free = obj;
+	}
+	depot->nfree += depot->per_slab;
+	depot->objects += depot->per_slab;
+
+	return true;
+}
+
+/**
+ * @brief Take one object from the depot
+ *
+ * @note The depot lock must be held.
+ */
+static inline void *pool_slab_pop(struct pool_slab_depot *depot)
+{
+	struct pool_slab_free *obj;
+
+	if (depot->free == NULL && !pool_slab_grow(depot))
+		return NULL;
+
+	obj = depot->free;
+	depot->free = obj->next;
+	depot->nfree--;
+	return obj;
+}
+
+/**
+ * @brief Return one object to the depot
+ *
+ * @note The depot lock must be held.
+ */
+static inline void pool_slab_push(struct pool_slab_depot *depot, void *object)
+{
+	struct pool_slab_free *obj = object;
+
+	obj->next = depot->free;
+	depot->free = obj;
+	depot->nfree++;
+}
+
+/**
+ * @brief Fill half of an empty magazine from the depot
+ */
+static void pool_slab_refill(struct pool_slab_depot *depot,
+			     struct pool_slab_mag *mag)
+{
+	uint32_t want = depot->mag_size / 2;
+	void *obj;
+
+	PTHREAD_MUTEX_lock(&depot->mtx);
+	depot->refills++;
+	while (mag->count < want) {
+		obj = pool_slab_pop(depot);
+		if (obj == NULL)
+			break;
+		mag->objs[mag->count++] = obj;
+	}
+	PTHREAD_MUTEX_unlock(&depot->mtx);
+}
+
+/**
+ * @brief Move half of a full magazine to the depot
+ */
+static void pool_slab_drain(struct pool_slab_depot *depot,
+			    struct pool_slab_mag *mag)
+{
+	uint32_t keep = depot->mag_size / 2;
+
+	PTHREAD_MUTEX_lock(&depot->mtx);
+	depot->drains++;
+	while (mag->count > keep)
+		pool_slab_push(depot, mag->objs[--mag->count]);
+	PTHREAD_MUTEX_unlock(&depot->mtx);
+}
+
+/**
+ * @brief Return an exiting thread's magazines to their depots
+ */
+static void pool_slab_thread_exit(void *arg)
+{
+	struct pool_slab_depot *depot;
+	struct pool_slab_mag *mag;
+	uint32_t ix;
+
+	PTHREAD_MUTEX_lock(&pool_slab_mtx);
+	for (ix = 0; ix < POOL_SLAB_MAX; ix++) {
+		mag = pool_slab_mags[ix];
+		if (mag == NULL)
+			continue;
+		pool_slab_mags[ix] = NULL;
+
+		depot = mag->depot;
+		if (depot != NULL) {
+			PTHREAD_MUTEX_lock(&depot->mtx);
+			while (mag->count > 0)
+				pool_slab_push(depot,
+					       mag->objs[--mag->count]);
+			depot->allocs += mag->allocs;
+			depot->hits += mag->hits;
+			glist_del(&mag->link);
+			PTHREAD_MUTEX_unlock(&depot->mtx);
+		}
+		gsh_free(mag);
+	}
+	PTHREAD_MUTEX_unlock(&pool_slab_mtx);
+}
+
+static void pool_slab_key_init(void)
+{
+	if (pthread_key_create(&pool_slab_key, pool_slab_thread_exit) != 0)
+		LogCrit(COMPONENT_MAIN,
+			"Could not create slab pool thread key");
+}
+
+/**
+ * @brief Create this thread's magazine for a pool
+ *
+ * @return The magazine, or NULL to use the depot directly.
+ */
+static struct pool_slab_mag *pool_slab_mag_new(struct pool_slab_depot *depot)
+{
+	struct pool_slab_mag *mag;
+
+	mag = gsh_calloc(1, sizeof(struct pool_slab_mag) +
+			 depot->mag_size * sizeof(void *));
+	if (mag == NULL)
+		return NULL;
+
+	pthread_once(&pool_slab_once, pool_slab_key_init);
+	(void) pthread_setspecific(pool_slab_key, pool_slab_mags);
+
+	PTHREAD_MUTEX_lock(&pool_slab_mtx);
+	mag->depot = depot;
+	glist_add_tail(&depot->mags, &mag->link);
+	PTHREAD_MUTEX_unlock(&pool_slab_mtx);
+
+	pool_slab_mags[depot->index] = mag;
+	return mag;
+}
+
+static inline struct pool_slab_mag *pool_slab_mag(struct pool_slab_depot *depot)
+{
+	struct pool_slab_mag *mag;
+
+	if (unlikely(depot->index >= POOL_SLAB_MAX))
+		return NULL;
+
+	mag = pool_slab_mags[depot->index];
+	if (likely(mag != NULL))
+		return mag;
+
+	return pool_slab_mag_new(depot);
+}
+
+/**
+ * @brief Initialize a slab pool
+ *
+ * @param[in] size  Size of the objects
+ * @param[in] param A struct pool_slab_params, or NULL for defaults
+ *
+ * @return the allocated pool_t structure.
+ */
+static pool_t *pool_slab_initializer(size_t size, void *param)
+{
+	struct pool_slab_params *params = param;
+	struct pool_slab_depot *depot;
+	pool_t *pool;
+
+	pool = gsh_calloc(1, sizeof(pool_t) + sizeof(struct pool_slab_depot));
+	if (pool == NULL)
+		return NULL;
+
+	depot = pool_slab_depot(pool);
+	depot->pool = pool;
+
+	if (size < sizeof(struct pool_slab_free))
+		size = sizeof(struct pool_slab_free);
+	depot->obj_size = (size + POOL_SLAB_ALIGN - 1) & ~(POOL_SLAB_ALIGN - 1);
+
+	depot->mag_size = POOL_SLAB_MAGAZINE_DEFAULT;
+	if (params != NULL && params->magazine_size != 0)
+		depot->mag_size = params->magazine_size;
+	if (depot->mag_size < 2)
+		depot->mag_size = 2;
+
+	depot->slab_size = POOL_SLAB_SIZE_DEFAULT;
+	if (params != NULL && params->slab_size != 0)
+		depot->slab_size = params->slab_size;
+	if (depot->slab_size <
+	    POOL_SLAB_HDR + POOL_SLAB_MIN_OBJECTS * depot->obj_size)
+		depot->slab_size =
+		    POOL_SLAB_HDR + POOL_SLAB_MIN_OBJECTS * depot->obj_size;
+	depot->per_slab = (depot->slab_size - POOL_SLAB_HDR) / depot->obj_size;
+
+	pthread_mutex_init(&depot->mtx, NULL);
+	glist_init(&depot->mags);
+
+	PTHREAD_MUTEX_lock(&pool_slab_mtx);
+	depot->index = pool_slab_next_index;
+	if (pool_slab_next_index < POOL_SLAB_MAX)
+		pool_slab_next_index++;
+	glist_add_tail(&pool_slab_all, &depot->link);
+	PTHREAD_MUTEX_unlock(&pool_slab_mtx);
+
+	return pool;
+}
+
+/**
+ * @brief Destroy a slab pool
+ *
+ * Magazines still held by live threads are disowned; their slot is
+ * never reused, so they are only freed when the thread exits.
+ *
+ * @param[in] pool The pool to destroy
+ */
+static void pool_slab_destroy(pool_t *pool)
+{
+	struct pool_slab_depot *depot = pool_slab_depot(pool);
+	struct pool_slab_chunk *slab;
+	struct pool_slab_mag *mag;
+	struct glist_head *node, *noden;
+
+	PTHREAD_MUTEX_lock(&pool_slab_mtx);
+	glist_del(&depot->link);
+	glist_for_each_safe(node, noden, &depot->mags) {
+		mag = glist_entry(node, struct pool_slab_mag, link);
+		glist_del(&mag->link);
+		mag->depot = NULL;
+		mag->count = 0;
+	}
+	PTHREAD_MUTEX_unlock(&pool_slab_mtx);
+
+	while (depot->slabs != NULL) {
+		slab = depot->slabs;
+		depot->slabs = slab->next;
+		gsh_free(slab);
+	}
+
+	pthread_mutex_destroy(&depot->mtx);
+	gsh_free(pool->name);
+	gsh_free(pool);
+}
+
+/**
+ * @brief Allocate an object from a slab pool
+ *
+ * @param[in] pool The pool from which to allocate.
+ *
+ * @return the allocated object or NULL.
+ */
+static void *pool_slab_alloc(pool_t *pool)
+{
+	struct pool_slab_depot *depot = pool_slab_depot(pool);
+	struct pool_slab_mag *mag = pool_slab_mag(depot);
+	void *object;
+
+	if (likely(mag != NULL)) {
+		if (likely(mag->count != 0))
+			mag->hits++;
+		else
+			pool_slab_refill(depot, mag);
+
+		if (unlikely(mag->count == 0))
+			return NULL;
+
+		object = mag->objs[--mag->count];
+		mag->allocs++;
+	} else {
+		PTHREAD_MUTEX_lock(&depot->mtx);
+		object = pool_slab_pop(depot);
+		if (object != NULL)
+			depot->allocs++;
+		PTHREAD_MUTEX_unlock(&depot->mtx);
+
+		if (object == NULL)
+			return NULL;
+	}
+
+	if (pool->constructor == NULL)
+		memset(object, 0, pool->object_size);
+
+	return object;
+}
+
+/**
+ * @brief Free an object in a slab pool
+ *
+ * @param[in] pool   The pool to which to return the object
+ * @param[in] object The object to free
+ */
+static void pool_slab_free(pool_t *pool, void *object)
+{
+	struct pool_slab_depot *depot = pool_slab_depot(pool);
+	struct pool_slab_mag *mag = pool_slab_mag(depot);
+
+	if (likely(mag != NULL)) {
+		if (unlikely(mag->count == depot->mag_size))
+			pool_slab_drain(depot, mag);
+		mag->objs[mag->count++] = object;
+		return;
+	}
+
+	PTHREAD_MUTEX_lock(&depot->mtx);
+	pool_slab_push(depot, object);
+	PTHREAD_MUTEX_unlock(&depot->mtx);
+}
+
+const struct pool_substrate_vector pool_slab_substrate[] = {
+	{
+		.initializer = pool_slab_initializer,
+		.destroyer = pool_slab_destroy,
+		.allocator = pool_slab_alloc,
+		.freer = pool_slab_free
+	}
+};
+
+/**
+ * @brief Report statistics for every slab pool
+ *
+ * @param[in] cb  Called once per pool, with the pool list locked
+ * @param[in] arg Passed to cb
+ */
+void pool_slab_foreach(void (*cb)(const struct pool_slab_stats *stats,
+				  void *arg),
+		       void *arg)
+{
+	struct pool_slab_depot *depot;
+	struct pool_slab_mag *mag;
+	struct pool_slab_stats stats;
+	struct glist_head *node, *mnode;
+
+	PTHREAD_MUTEX_lock(&pool_slab_mtx);
+	glist_for_each(node, &pool_slab_all) {
+		depot = glist_entry(node, struct pool_slab_depot, link);
+
+		PTHREAD_MUTEX_lock(&depot->mtx);
+		stats.name = depot->pool->name != NULL
+		    ? depot->pool->name
+		    : "(unnamed)";
+		stats.object_size = depot->obj_size;
+		stats.resident = depot->nslabs * depot->slab_size;
+		stats.allocs = depot->allocs;
+		stats.hits = depot->hits;
+		stats.cached = depot->nfree;
+		stats.refills = depot->refills;
+		stats.drains = depot->drains;
+		glist_for_each(mnode, &depot->mags) {
+			mag = glist_entry(mnode, struct pool_slab_mag, link);
+			stats.allocs += mag->allocs;
+			stats.hits += mag->hits;
+			stats.cached += mag->count;
+		}
+		stats.in_use = depot->objects > stats.cached
+		    ? depot->objects - stats.cached
+		    : 0;
+		PTHREAD_MUTEX_unlock(&depot->mtx);
+
+		cb(&stats, arg);
+	}
+	PTHREAD_MUTEX_unlock(&pool_slab_mtx);
+}
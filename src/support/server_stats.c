@@ -58,6 +58,11 @@
 #include "client_mgr.h"
 #include "export_mgr.h"
 #include "server_stats.h"
+#include "nfs_req_queue.h"
+#include "pool_slab.h"
+#include "hashtable.h"
+#include "nfs_dupreq.h"
+#include "cache_inode_lru.h"
 #include <abstract_atomic.h>
 
 #define NFS_V3_NB_COMMAND (NFSPROC3_COMMIT + 1)
@@ -376,6 +381,14 @@ struct nfsv41_stats {
 	struct layout_op recall;
 };
 
+/* Fair queueing counters, per client and per export
+ */
+
+struct sched_stats {
+	uint64_t total;		/* requests executed */
+	struct op_latency queue_latency;	/* queue wait time */
+};
+
 struct _9p_stats {
 	struct proto_op cmds;	/* non-I/O ops */
 	struct xfer_op read;
@@ -538,9 +551,44 @@ static struct _9p_stats *get_9p(struct gsh_stats *stats, pthread_rwlock_t *lock)
 }
 #endif
 
+static struct sched_stats *get_sched(struct gsh_stats *stats,
+				     pthread_rwlock_t *lock)
+{
+	if (unlikely(stats->sched == NULL)) {
+		PTHREAD_RWLOCK_wrlock(lock);
+		if (stats->sched == NULL)
+			stats->sched =
+			    gsh_calloc(sizeof(struct sched_stats), 1);
+		PTHREAD_RWLOCK_unlock(lock);
+	}
+	return stats->sched;
+}
+
 /* Functions for recording statistics
  */
 
+/**
+ * @brief Record the queue wait of a request for its tenant
+ *
+ * @param gsh_st     [IN] stats struct of the client or export
+ * @param lock       [IN] lock on the client or export
+ * @param qwait_time [IN] time sitting on queue
+ */
+static void record_sched(struct gsh_stats *gsh_st, pthread_rwlock_t *lock,
+			 nsecs_elapsed_t qwait_time)
+{
+	struct sched_stats *sp = get_sched(gsh_st, lock);
+
+	if (sp == NULL)
+		return;
+	(void)atomic_inc_uint64_t(&sp->total);
+	(void)atomic_add_uint64_t(&sp->queue_latency.latency, qwait_time);
+	if (sp->queue_latency.min == 0L || sp->queue_latency.min > qwait_time)
+		(void)atomic_store_uint64_t(&sp->queue_latency.min, qwait_time);
+	if (sp->queue_latency.max == 0L || sp->queue_latency.max < qwait_time)
+		(void)atomic_store_uint64_t(&sp->queue_latency.max, qwait_time);
+}
+
 /**
  * @brief Record latency stats
  *
@@ -1016,6 +1064,8 @@ void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup)
 			     stop_time - op_ctx->start_time,
 			     op_ctx->queue_wait,
 			     rc == NFS_REQ_OK, dup, true);
+		record_sched(&server_st->st, &client->lock,
+			     op_ctx->queue_wait);
 		(void)atomic_store_uint64_t(&client->last_update, stop_time);
 	}
 	if (!dup && op_ctx->export != NULL) {
@@ -1026,6 +1076,8 @@ void server_stats_nfs_done(request_data_t *reqdata, int rc, bool dup)
 		record_stats(&exp_st->st, &op_ctx->export->lock, reqdata,
 			     stop_time - op_ctx->start_time,
 			     op_ctx->queue_wait, rc == NFS_REQ_OK, dup, false);
+		record_sched(&exp_st->st, &op_ctx->export->lock,
+			     op_ctx->queue_wait);
 		(void)atomic_store_uint64_t(&op_ctx->export->last_update,
 					    stop_time);
 	}
@@ -1576,8 +1628,12 @@ void cache_inode_dbus_show(DBusMessageIter *iter)
 {
 	struct timespec timestamp;
 	DBusMessageIter struct_iter;
+	uint64_t l1, l2, target;
 	char *type;
 
+	cache_inode_lru_sizes(&l1, &l2);
+	target = atomic_fetch_uint64_t(&lru_state.l1_target);
+
 	now(&timestamp);
 	dbus_append_timestamp(iter, &timestamp);
 
@@ -1607,10 +1663,413 @@ void cache_inode_dbus_show(DBusMessageIter *iter)
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
 	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
 					&cache_st.inode_mapping);
+	type = "lru_l1";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &l1);
+	type = "lru_l2";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &l2);
+	type = "lru_l1_target";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&target);
+	type = "ghost_l1_hit";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.inode_ghost_l1);
+	type = "ghost_l2_hit";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.inode_ghost_l2);
+	type = "evict_l1";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.inode_evict_l1);
+	type = "evict_l2";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.inode_evict_l2);
+	type = "evict_killed";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+					&cache_st.inode_evict_killed);
+
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
+static bool export_cache_bytes(struct gsh_export *export, void *state)
+{
+	DBusMessageIter *array_iter = state;
+	DBusMessageIter struct_iter;
+	struct lru_export_bytes *eb = lru_export_bytes(export->export_id);
+	int64_t val;
+	uint64_t entries = 0;
+	uint64_t bytes = 0;
+
+	/* racing charges may leave the counters briefly negative */
+	if (eb != NULL) {
+		val = atomic_fetch_int64_t(&eb->entries);
+		if (val > 0)
+			entries = val;
+		val = atomic_fetch_int64_t(&eb->bytes);
+		if (val > 0)
+			bytes = val;
+	}
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT16,
+				       &export->export_id);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &entries);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &bytes);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+
+	return true;
+}
+
+/**
+ * @brief Report the memory held by the inode cache
+ *
+ * The totals struct carries the bytes charged to cache entries and
+ * Entries_Bytes_HWMark.  The array gives per export the entries
+ * charged to it and the bytes they hold, kept up to date as entries
+ * are charged.  An entry reachable through several exports counts in
+ * the first it was mapped to.
+ *
+ * @param iter [IN] iterator to stuff the reply into
+ */
+
+void cache_inode_bytes_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+	DBusMessageIter array_iter;
+	uint64_t val;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	val = atomic_fetch_uint64_t(&lru_state.bytes_used);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &lru_state.bytes_hiwat);
+	dbus_message_iter_close_container(iter, &struct_iter);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(qtt)",
+					 &array_iter);
+	(void)foreach_gsh_export(export_cache_bytes, &array_iter);
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report request queue shard statistics
+ *
+ * The totals struct carries the shard count and how many requests
+ * were dequeued by a worker of their own shard (local) versus stolen
+ * by a worker of a sibling shard.  The array repeats the last two per
+ * shard, followed by how often a spinning worker found work, how
+ * often workers parked and how many were woken by enqueues.
+ *
+ * @param iter [IN] iterator to stuff the reply into
+ */
+
+void nfs_rpc_queue_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+	DBusMessageIter array_iter;
+	DBusMessageIter shard_iter;
+	struct req_q_shard *shard;
+	uint64_t nshards = nfs_req_st.reqs.nshards;
+	uint64_t local = 0;
+	uint64_t stolen = 0;
+	uint64_t val;
+	uint32_t ix;
+	char *type;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	for (ix = 0; ix < nshards; ++ix) {
+		shard = &nfs_req_st.reqs.shards[ix];
+		local += atomic_fetch_uint64_t(&shard->local);
+		stolen += atomic_fetch_uint64_t(&shard->stolen);
+	}
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	type = "shards";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &nshards);
+	type = "local";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &local);
+	type = "stolen";
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stolen);
+	dbus_message_iter_close_container(iter, &struct_iter);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(uttttt)",
+					 &array_iter);
+	for (ix = 0; ix < nshards; ++ix) {
+		shard = &nfs_req_st.reqs.shards[ix];
+		dbus_message_iter_open_container(&array_iter,
+						 DBUS_TYPE_STRUCT, NULL,
+						 &shard_iter);
+		dbus_message_iter_append_basic(&shard_iter, DBUS_TYPE_UINT32,
+					       &ix);
+		val = atomic_fetch_uint64_t(&shard->local);
+		dbus_message_iter_append_basic(&shard_iter, DBUS_TYPE_UINT64,
+					       &val);
+		val = atomic_fetch_uint64_t(&shard->stolen);
+		dbus_message_iter_append_basic(&shard_iter, DBUS_TYPE_UINT64,
+					       &val);
+		val = atomic_fetch_uint64_t(&shard->spin_hits);
+		dbus_message_iter_append_basic(&shard_iter, DBUS_TYPE_UINT64,
+					       &val);
+		val = atomic_fetch_uint64_t(&shard->parks);
+		dbus_message_iter_append_basic(&shard_iter, DBUS_TYPE_UINT64,
+					       &val);
+		val = atomic_fetch_uint64_t(&shard->wakeups);
+		dbus_message_iter_append_basic(&shard_iter, DBUS_TYPE_UINT64,
+					       &val);
+		dbus_message_iter_close_container(&array_iter, &shard_iter);
+	}
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+/**
+ * @brief Report the worker pool size and adaptation counters
+ *
+ * @param iter [IN] iterator to stuff the reply into
+ */
+
+void nfs_worker_pool_dbus_show(DBusMessageIter *iter)
+{
+	struct nfs_worker_pool *wp = &nfs_worker_pool;
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+	uint64_t val;
+	char *type;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
 
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	type = "min";
+	val = nfs_param.core_param.nb_worker_min != 0
+	    && nfs_param.core_param.nb_worker_min <
+	    nfs_param.core_param.nb_worker
+	    ? nfs_param.core_param.nb_worker_min
+	    : nfs_param.core_param.nb_worker;
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "max";
+	val = nfs_param.core_param.nb_worker;
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "threads";
+	val = atomic_fetch_uint32_t(&wp->threads);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "busy";
+	val = atomic_fetch_uint32_t(&wp->busy);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "queue_wait_avg";
+	val = atomic_fetch_uint64_t(&wp->qwait_avg);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "grown";
+	val = atomic_fetch_uint64_t(&wp->grown);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
+	type = "retired";
+	val = atomic_fetch_uint64_t(&wp->retired);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &val);
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
+static void pool_slab_dbus_one(const struct pool_slab_stats *stats,
+			       void *arg)
+{
+	DBusMessageIter *array_iter = arg;
+	DBusMessageIter struct_iter;
+	const char *name = stats->name;
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->object_size);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->resident);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->in_use);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->cached);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->allocs);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->hits);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->refills);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->drains);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * @brief Report allocator statistics for every slab pool
+ *
+ * @param iter [IN] iterator to stuff the reply into
+ */
+
+void pool_slab_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 "(stttttttt)", &array_iter);
+	pool_slab_foreach(pool_slab_dbus_one, &array_iter);
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+static void hashtable_dbus_one(const struct hash_table_stats *stats,
+			       void *arg)
+{
+	DBusMessageIter *array_iter = arg;
+	DBusMessageIter struct_iter, part_iter;
+	const char *name = stats->name;
+	uint32_t i;
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &stats->partitions);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->entries);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->max_partition);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->lookups);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->hits);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->inserts);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->deletes);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->lock_waits);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->lock_wait_ns);
+	dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY, "t",
+					 &part_iter);
+	for (i = 0; i < stats->partitions; i++)
+		dbus_message_iter_append_basic(&part_iter, DBUS_TYPE_UINT64,
+					       &stats->partition_entries[i]);
+	dbus_message_iter_close_container(&struct_iter, &part_iter);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * @brief Report occupancy and contention for every hash table
+ *
+ * @param iter [IN] iterator to stuff the reply into
+ */
+
+void hashtable_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 "(suttttttttat)", &array_iter);
+	hashtable_foreach(hashtable_dbus_one, &array_iter);
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
+static void drc_dbus_one(const struct drc_stats *stats, void *arg)
+{
+	DBusMessageIter *array_iter = arg;
+	DBusMessageIter struct_iter, part_iter, p_iter;
+	const struct drc_part *p;
+	uint32_t i;
+
+	dbus_message_iter_open_container(array_iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
+				       &stats->type);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING,
+				       &stats->addr);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &stats->size);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &stats->refcnt);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &stats->bytes);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32,
+				       &stats->retain_s);
+	dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY,
+					 "(tttttt)", &part_iter);
+	for (i = 0; i < stats->npart; i++) {
+		p = &stats->part[i];
+		dbus_message_iter_open_container(&part_iter, DBUS_TYPE_STRUCT,
+						 NULL, &p_iter);
+		dbus_message_iter_append_basic(&p_iter, DBUS_TYPE_UINT64,
+					       &p->hits);
+		dbus_message_iter_append_basic(&p_iter, DBUS_TYPE_UINT64,
+					       &p->misses);
+		dbus_message_iter_append_basic(&p_iter, DBUS_TYPE_UINT64,
+					       &p->busy);
+		dbus_message_iter_append_basic(&p_iter, DBUS_TYPE_UINT64,
+					       &p->retired);
+		dbus_message_iter_append_basic(&p_iter, DBUS_TYPE_UINT64,
+					       &p->evicted);
+		dbus_message_iter_append_basic(&p_iter, DBUS_TYPE_UINT64,
+					       &p->lock_waits);
+		dbus_message_iter_close_container(&part_iter, &p_iter);
+	}
+	dbus_message_iter_close_container(&struct_iter, &part_iter);
+	dbus_message_iter_close_container(array_iter, &struct_iter);
+}
+
+/**
+ * @brief Report bytes, hits, misses and contention for every DRC
+ *
+ * @param iter [IN] iterator to stuff the reply into
+ */
+
+void drc_dbus_show(DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter array_iter;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					 "(ssuutua(tttttt))", &array_iter);
+	drc_foreach(drc_dbus_one, &array_iter);
+	dbus_message_iter_close_container(iter, &array_iter);
+}
+
 void server_dbus_9p_iostats(struct _9p_stats *_9pp, DBusMessageIter *iter)
 {
 	struct timespec timestamp;
@@ -1710,6 +2169,32 @@ void server_dbus_delegations(struct deleg_stats *ds, DBusMessageIter *iter)
 	dbus_message_iter_close_container(iter, &struct_iter);
 }
 
+/**
+ * @brief Report fair queueing stats of a client or export
+ *
+ * @param sp    [IN] the tenant's scheduling stats
+ * @param iter  [IN] interator in reply stream to fill
+ */
+void server_dbus_sched(struct sched_stats *sp, DBusMessageIter *iter)
+{
+	struct timespec timestamp;
+	DBusMessageIter struct_iter;
+
+	now(&timestamp);
+	dbus_append_timestamp(iter, &timestamp);
+	dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL,
+					 &struct_iter);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &sp->total);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &sp->queue_latency.latency);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &sp->queue_latency.min);
+	dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64,
+				       &sp->queue_latency.max);
+	dbus_message_iter_close_container(iter, &struct_iter);
+}
+
 #endif				/* USE_DBUS */
 
 /**
@@ -1755,6 +2240,10 @@ void server_stats_free(struct gsh_stats *statsp)
 		gsh_free(statsp->_9p);
 		statsp->_9p = NULL;
 	}
+	if (statsp->sched != NULL) {
+		gsh_free(statsp->sched);
+		statsp->sched = NULL;
+	}
 }
 
 /** @} */
@@ -0,0 +1,231 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file test_cache_entry_mem.c
+ * @brief Measure the memory a cached inode costs
+ *
+ * Prints the layout of cache_entry_t, the cache line each field
+ * starts in, then allocates entries from a basic pool as
+ * cache_inode_init does and gives a share of them a state block as
+ * cache_inode_inc_pin_ref does.  For each share, the resident memory
+ * added per entry is printed next to what the entry would cost with
+ * the state lists kept inline.
+ *
+ * Each share is measured in a child process so that memory the
+ * allocator keeps from one run does not hide the next.
+ *
+ * test_cache_entry_mem [-n entries] [-s state %[,state %...]]
+ */
+
+#include "config.h"
+
+#include <getopt.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "abstract_mem.h"
+#include "cache_inode.h"
+
+#define CACHE_LINE 64
+
+/** Bytes a cache hit reads, up to the export bookkeeping and locks */
+#define HOT_BYTES offsetof(cache_entry_t, exp_root_refcount)
+
+#define FIELD(f) { #f, offsetof(cache_entry_t, f), \
+		   sizeof(((cache_entry_t *)0)->f) }
+
+static const struct {
+	const char *name;
+	size_t offset;
+	size_t size;
+} fields[] = {
+	FIELD(obj_handle),
+	FIELD(type),
+	FIELD(flags),
+	FIELD(fh_hk),
+	FIELD(change_time),
+	FIELD(attr_time),
+	FIELD(first_export),
+	FIELD(lru),
+	FIELD(state_data),
+	FIELD(exp_root_refcount),
+	FIELD(export_list),
+	FIELD(attr_lock),
+	FIELD(state_lock),
+	FIELD(content_lock),
+	FIELD(object.file),
+	FIELD(object.dir),
+};
+
+static void print_layout(void)
+{
+	size_t i;
+
+	printf("%-20s %6s %6s %5s\n", "field", "offset", "size", "line");
+	for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+		printf("%-20s %6zu %6zu %5zu\n", fields[i].name,
+		       fields[i].offset, fields[i].size,
+		       fields[i].offset / CACHE_LINE);
+
+	printf("\nsizeof(cache_entry_t) %zu (%zu lines), hot fields %zu %s\n",
+	       sizeof(cache_entry_t),
+	       (sizeof(cache_entry_t) + CACHE_LINE - 1) / CACHE_LINE,
+	       (HOT_BYTES + CACHE_LINE - 1) / CACHE_LINE, "lines");
+	printf("sizeof(struct cache_inode_state_data) %zu\n\n",
+	       sizeof(struct cache_inode_state_data));
+}
+
+static size_t resident_bytes(void)
+{
+	unsigned long size, resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+
+	if (f == NULL)
+		return 0;
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @brief Allocate the entries and report what they cost
+ *
+ * @param[in] n     Number of entries
+ * @param[in] share Percentage of them with a state block
+ *
+ * @return 0 or 1 if allocation failed.
+ */
+static int measure(size_t n, unsigned int share)
+{
+	pool_t *pool;
+	cache_entry_t **entries;
+	size_t before, after, i, with_state = 0;
+	double inline_bytes;
+
+	entries = calloc(n, sizeof(*entries));
+	pool = pool_init("Entry Pool", sizeof(cache_entry_t),
+			 pool_basic_substrate, NULL, NULL, NULL);
+	if (entries == NULL || pool == NULL)
+		return 1;
+
+	before = resident_bytes();
+
+	for (i = 0; i < n; i++) {
+		cache_entry_t *entry = pool_alloc(pool, NULL);
+		struct cache_inode_state_data *sd;
+
+		if (entry == NULL)
+			return 1;
+		entries[i] = entry;
+
+		if ((i % 100) >= share)
+			continue;
+
+		sd = gsh_calloc(1, sizeof(*sd));
+		if (sd == NULL)
+			return 1;
+		glist_init(&sd->state_list);
+		glist_init(&sd->layoutrecall_list);
+		glist_init(&sd->lock_list);
+		glist_init(&sd->deleg_list);
+		glist_init(&sd->nlm_share_list);
+		entry->state_data = sd;
+		with_state++;
+	}
+
+	after = resident_bytes();
+
+	inline_bytes = sizeof(cache_entry_t)
+		+ sizeof(struct cache_inode_state_data) - sizeof(void *);
+
+	printf("%6u%% %10zu %10.1f %10.1f %10zu\n", share, with_state,
+	       (double)(after - before) / n, inline_bytes,
+	       (after - before) >> 10);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t n = 1000000;
+	char shares[256] = "0,1,10,100";
+	char *s;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		switch (opt) {
+		case 'n':
+			n = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			snprintf(shares, sizeof(shares), "%s", optarg);
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-n entries] [-s state %%[,state %%...]]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (n == 0)
+		n = 1;
+
+	print_layout();
+
+	printf("%7s %10s %10s %10s %10s\n", "state", "entries",
+	       "B/entry", "inline", "KiB");
+	fflush(stdout);
+
+	for (s = strtok(shares, ","); s != NULL; s = strtok(NULL, ",")) {
+		unsigned int share = strtoul(s, NULL, 10);
+		pid_t pid;
+		int status;
+
+		if (share > 100)
+			share = 100;
+
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			return 1;
+		}
+		if (pid == 0) {
+			status = measure(n, share);
+			fflush(stdout);
+			_exit(status);
+		}
+		if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+		    || WEXITSTATUS(status) != 0) {
+			fprintf(stderr, "measuring %u%% failed\n", share);
+			return 1;
+		}
+	}
+
+	return 0;
+}
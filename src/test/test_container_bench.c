@@ -0,0 +1,857 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file test_container_bench.c
+ * @brief Measure the lookup containers under concurrency
+ *
+ * Threads run a mix of lookups, inserts and deletes against one of
+ * the containers requests go through:
+ *
+ * - ht, ht-cache, ht-resize: the generic hashtable, with its
+ *   red-black tree partitions, with their entry cache and with
+ *   resizable bucket partitions
+ * - avl: a single avltree under one rwlock, as the client and export
+ *   managers keep theirs
+ * - cih: rwlocked avltree partitions with a direct-mapped cache in
+ *   front, laid out as cache_inode_hash.h does for cache entries
+ * - rbtx: ntirpc rbtree_x partitions with a write-through cache under
+ *   a mutex, as the DRC uses them
+ *
+ * Keys are drawn uniformly or from a Zipf distribution over a fixed
+ * key space, half of which is loaded before the run.  For each
+ * container and thread count, ops/s, the lookup hit ratio, latency
+ * percentiles and the share of thread time spent waiting for
+ * partition locks are printed.
+ *
+ * The hashtable takes its locks internally, so lock waits are counted
+ * by interposing pthread_rwlock_rdlock and pthread_rwlock_wrlock: a
+ * lock that cannot be had at once is timed until it is granted.
+ *
+ * test_container_bench [-c container|all] [-t threads[,threads...]]
+ *                      [-T seconds] [-n keys] [-r read %]
+ *                      [-i insert %] [-z zipf exponent]
+ *                      [-p partitions] [-s cache slots]
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "config.h"
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <misc/rbtree_x.h>
+
+#include "log.h"
+#include "avltree.h"
+#include "hashtable.h"
+
+/** Sub-buckets per power of two in the latency histograms */
+#define HIST_SUB 16
+#define HIST_BUCKETS (61 * HIST_SUB)
+
+struct item {
+	uint64_t key;
+	uint64_t hk;		/*< mixed key, picks the partition */
+	struct avltree_node avl_k;
+	struct opr_rbtree_node rbt_k;
+};
+
+struct bench_thread {
+	pthread_t id;
+	uint64_t rng;
+	uint64_t ops;
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t lock_waits;
+	uint64_t lock_wait_ns;
+	uint64_t hist[HIST_BUCKETS];
+};
+
+struct container {
+	const char *name;
+	void (*setup)(void);
+	void (*teardown)(void);
+	bool (*lookup)(struct item *it);
+	bool (*insert)(struct item *it);
+	bool (*remove)(struct item *it);
+};
+
+static struct {
+	uint32_t nkeys;
+	uint32_t read_pct;
+	uint32_t insert_pct;
+	double zipf;
+	uint32_t npart;
+	uint32_t cache_sz;
+	uint32_t seconds;
+} opt = {
+	.nkeys = 1000000,
+	.read_pct = 90,
+	.insert_pct = 5,
+	.zipf = 0.0,
+	.npart = 17,
+	.cache_sz = 32767,
+	.seconds = 5,
+};
+
+static struct item *items;
+static double *zipf_cdf;	/*< by popularity rank */
+static uint32_t *zipf_perm;	/*< rank to item */
+static volatile bool stop;
+static pthread_barrier_t start_barrier;
+static __thread struct bench_thread *self;
+
+/* The server's logging is not linked in; nothing here logs. */
+static log_levels_t log_levels[COMPONENT_COUNT];
+log_levels_t *component_log_level = log_levels;
+
+void DisplayLogComponentLevel(log_components_t component, char *file,
+			      int line, char *function, log_levels_t level,
+			      char *format, ...)
+{
+}
+
+static inline uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t mix64(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+static inline uint64_t rng_next(uint64_t *s)
+{
+	*s ^= *s >> 12;
+	*s ^= *s << 25;
+	*s ^= *s >> 27;
+	return *s * 2685821657736338717ULL;
+}
+
+static inline uint32_t hist_index(uint64_t ns)
+{
+	int b;
+
+	if (ns < HIST_SUB)
+		return ns;
+	b = 63 - __builtin_clzll(ns);
+	return (b - 3) * HIST_SUB + ((ns >> (b - 4)) & (HIST_SUB - 1));
+}
+
+static inline uint64_t hist_value(uint32_t ix)
+{
+	int b;
+
+	if (ix < HIST_SUB)
+		return ix;
+	b = ix / HIST_SUB + 3;
+	return (1ULL << b) | ((uint64_t) (ix % HIST_SUB) << (b - 4));
+}
+
+static void lock_waited(uint64_t start)
+{
+	if (self == NULL)
+		return;
+	self->lock_waits++;
+	self->lock_wait_ns += now_ns() - start;
+}
+
+/* Timed locks: the interposed rwlock calls, and a mutex helper */
+
+static int (*real_rdlock)(pthread_rwlock_t *);
+static int (*real_wrlock)(pthread_rwlock_t *);
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *lock)
+{
+	uint64_t start;
+	int rc;
+
+	if (pthread_rwlock_tryrdlock(lock) == 0)
+		return 0;
+	start = now_ns();
+	rc = real_rdlock(lock);
+	lock_waited(start);
+	return rc;
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *lock)
+{
+	uint64_t start;
+	int rc;
+
+	if (pthread_rwlock_trywrlock(lock) == 0)
+		return 0;
+	start = now_ns();
+	rc = real_wrlock(lock);
+	lock_waited(start);
+	return rc;
+}
+
+static void mutex_lock(pthread_mutex_t *mtx)
+{
+	uint64_t start;
+
+	if (pthread_mutex_trylock(mtx) == 0)
+		return;
+	start = now_ns();
+	pthread_mutex_lock(mtx);
+	lock_waited(start);
+}
+
+/* The generic hashtable */
+
+static struct hash_table *ht;
+static uint32_t ht_flags;
+
+static uint32_t ht_index(struct hash_param *hparam, struct gsh_buffdesc *key)
+{
+	return ((struct item *)key->addr)->hk % hparam->index_size;
+}
+
+static uint64_t ht_hash(struct hash_param *hparam, struct gsh_buffdesc *key)
+{
+	return ((struct item *)key->addr)->hk;
+}
+
+static int ht_compare(struct gsh_buffdesc *k1, struct gsh_buffdesc *k2)
+{
+	return ((struct item *)k1->addr)->key != ((struct item *)k2->addr)->key;
+}
+
+static int ht_display(struct gsh_buffdesc *buff, char *str)
+{
+	return sprintf(str, "%" PRIu64, ((struct item *)buff->addr)->key);
+}
+
+static int ht_free(struct gsh_buffdesc key, struct gsh_buffdesc val)
+{
+	return 1;
+}
+
+static void ht_setup(void)
+{
+	struct hash_param hparam = {
+		.flags = ht_flags,
+		.index_size = opt.npart,
+		.hash_func_key = ht_index,
+		.hash_func_rbt = ht_hash,
+		.compare_key = ht_compare,
+		.key_to_str = ht_display,
+		.val_to_str = ht_display,
+		.ht_name = "bench",
+		.ht_log_component = COMPONENT_HASHTABLE,
+	};
+
+	ht = hashtable_init(&hparam);
+	if (ht == NULL) {
+		fprintf(stderr, "hashtable_init failed\n");
+		exit(1);
+	}
+}
+
+static void ht_plain_setup(void)
+{
+	ht_flags = HT_FLAG_NONE;
+	ht_setup();
+}
+
+static void ht_cache_setup(void)
+{
+	ht_flags = HT_FLAG_CACHE;
+	ht_setup();
+}
+
+static void ht_resize_setup(void)
+{
+	ht_flags = HT_FLAG_RESIZE;
+	ht_setup();
+}
+
+static void ht_teardown(void)
+{
+	hashtable_destroy(ht, ht_free);
+	ht = NULL;
+}
+
+static bool ht_lookup(struct item *it)
+{
+	struct gsh_buffdesc key = { .addr = it, .len = sizeof(*it) };
+	struct gsh_buffdesc val;
+
+	return HashTable_Get(ht, &key, &val) == HASHTABLE_SUCCESS;
+}
+
+static bool ht_insert(struct item *it)
+{
+	struct gsh_buffdesc key = { .addr = it, .len = sizeof(*it) };
+	struct gsh_buffdesc val = { .addr = it, .len = sizeof(*it) };
+
+	return HashTable_Set(ht, &key, &val) == HASHTABLE_SUCCESS;
+}
+
+static bool ht_remove(struct item *it)
+{
+	struct gsh_buffdesc key = { .addr = it, .len = sizeof(*it) };
+
+	return HashTable_Del(ht, &key, NULL, NULL) == HASHTABLE_SUCCESS;
+}
+
+/* A single avltree */
+
+static struct avltree avl;
+static pthread_rwlock_t avl_lock;
+
+static int avl_cmpf(const struct avltree_node *lhs,
+		    const struct avltree_node *rhs)
+{
+	struct item *lk = avltree_container_of(lhs, struct item, avl_k);
+	struct item *rk = avltree_container_of(rhs, struct item, avl_k);
+
+	if (lk->key < rk->key)
+		return -1;
+	return lk->key > rk->key;
+}
+
+static void avl_setup(void)
+{
+	avltree_init(&avl, avl_cmpf, 0);
+	pthread_rwlock_init(&avl_lock, NULL);
+}
+
+static void avl_teardown(void)
+{
+	pthread_rwlock_destroy(&avl_lock);
+}
+
+static bool avl_lookup(struct item *it)
+{
+	bool found;
+
+	pthread_rwlock_rdlock(&avl_lock);
+	found = avltree_lookup(&it->avl_k, &avl) != NULL;
+	pthread_rwlock_unlock(&avl_lock);
+	return found;
+}
+
+static bool avl_insert(struct item *it)
+{
+	bool inserted;
+
+	pthread_rwlock_wrlock(&avl_lock);
+	inserted = avltree_insert(&it->avl_k, &avl) == NULL;
+	pthread_rwlock_unlock(&avl_lock);
+	return inserted;
+}
+
+static bool avl_remove(struct item *it)
+{
+	bool found;
+
+	pthread_rwlock_wrlock(&avl_lock);
+	found = avltree_lookup(&it->avl_k, &avl) != NULL;
+	if (found)
+		avltree_remove(&it->avl_k, &avl);
+	pthread_rwlock_unlock(&avl_lock);
+	return found;
+}
+
+/* Partitioned avltrees with a cache, as cache_inode_hash.h */
+
+struct cih_part {
+	pthread_rwlock_t lock;
+	struct avltree t;
+	struct avltree_node **cache;
+	char pad[64];
+};
+
+static struct cih_part *cih;
+
+static int cih_cmpf(const struct avltree_node *lhs,
+		    const struct avltree_node *rhs)
+{
+	struct item *lk = avltree_container_of(lhs, struct item, avl_k);
+	struct item *rk = avltree_container_of(rhs, struct item, avl_k);
+
+	if (lk->hk != rk->hk)
+		return lk->hk < rk->hk ? -1 : 1;
+	if (lk->key < rk->key)
+		return -1;
+	return lk->key > rk->key;
+}
+
+static void cih_setup(void)
+{
+	uint32_t ix;
+
+	cih = calloc(opt.npart, sizeof(*cih));
+	for (ix = 0; ix < opt.npart; ix++) {
+		pthread_rwlock_init(&cih[ix].lock, NULL);
+		avltree_init(&cih[ix].t, cih_cmpf, 0);
+		cih[ix].cache = calloc(opt.cache_sz, sizeof(void *));
+	}
+}
+
+static void cih_teardown(void)
+{
+	uint32_t ix;
+
+	for (ix = 0; ix < opt.npart; ix++) {
+		pthread_rwlock_destroy(&cih[ix].lock);
+		free(cih[ix].cache);
+	}
+	free(cih);
+}
+
+static bool cih_lookup(struct item *it)
+{
+	struct cih_part *cp = &cih[it->hk % opt.npart];
+	struct avltree_node **slot = &cp->cache[it->hk % opt.cache_sz];
+	struct avltree_node *node;
+
+	pthread_rwlock_rdlock(&cp->lock);
+	node = __atomic_load_n(slot, __ATOMIC_RELAXED);
+	if (node == NULL || cih_cmpf(node, &it->avl_k) != 0) {
+		node = avltree_lookup(&it->avl_k, &cp->t);
+		if (node != NULL)
+			__atomic_store_n(slot, node, __ATOMIC_RELAXED);
+	}
+	pthread_rwlock_unlock(&cp->lock);
+	return node != NULL;
+}
+
+static bool cih_insert(struct item *it)
+{
+	struct cih_part *cp = &cih[it->hk % opt.npart];
+	bool inserted;
+
+	pthread_rwlock_wrlock(&cp->lock);
+	inserted = avltree_insert(&it->avl_k, &cp->t) == NULL;
+	if (inserted)
+		cp->cache[it->hk % opt.cache_sz] = &it->avl_k;
+	pthread_rwlock_unlock(&cp->lock);
+	return inserted;
+}
+
+static bool cih_remove(struct item *it)
+{
+	struct cih_part *cp = &cih[it->hk % opt.npart];
+	struct avltree_node **slot = &cp->cache[it->hk % opt.cache_sz];
+	bool found;
+
+	pthread_rwlock_wrlock(&cp->lock);
+	found = avltree_lookup(&it->avl_k, &cp->t) != NULL;
+	if (found) {
+		avltree_remove(&it->avl_k, &cp->t);
+		if (*slot == &it->avl_k)
+			*slot = NULL;
+	}
+	pthread_rwlock_unlock(&cp->lock);
+	return found;
+}
+
+/* ntirpc rbtree_x partitions, as the DRC */
+
+static struct rbtree_x xt;
+
+static int rbtx_cmpf(const struct opr_rbtree_node *lhs,
+		     const struct opr_rbtree_node *rhs)
+{
+	struct item *lk = opr_containerof(lhs, struct item, rbt_k);
+	struct item *rk = opr_containerof(rhs, struct item, rbt_k);
+
+	if (lk->key < rk->key)
+		return -1;
+	return lk->key > rk->key;
+}
+
+static void rbtx_setup(void)
+{
+	uint32_t ix;
+
+	if (rbtx_init(&xt, rbtx_cmpf, opt.npart,
+		      RBT_X_FLAG_ALLOC | RBT_X_FLAG_CACHE_WT) != 0) {
+		fprintf(stderr, "rbtx_init failed\n");
+		exit(1);
+	}
+	xt.cachesz = opt.cache_sz;
+	for (ix = 0; ix < opt.npart; ix++)
+		xt.tree[ix].cache =
+		    calloc(opt.cache_sz, sizeof(struct opr_rbtree_node *));
+}
+
+static void rbtx_teardown(void)
+{
+	uint32_t ix;
+
+	for (ix = 0; ix < opt.npart; ix++)
+		free(xt.tree[ix].cache);
+}
+
+static bool rbtx_lookup(struct item *it)
+{
+	struct rbtree_x_part *t = rbtx_partition_of_scalar(&xt, it->hk);
+	bool found;
+
+	mutex_lock(&t->mtx);
+	found = rbtree_x_cached_lookup(&xt, t, &it->rbt_k, it->hk) != NULL;
+	pthread_mutex_unlock(&t->mtx);
+	return found;
+}
+
+static bool rbtx_insert(struct item *it)
+{
+	struct rbtree_x_part *t = rbtx_partition_of_scalar(&xt, it->hk);
+	bool inserted = false;
+
+	mutex_lock(&t->mtx);
+	if (rbtree_x_cached_lookup(&xt, t, &it->rbt_k, it->hk) == NULL) {
+		(void)rbtree_x_cached_insert(&xt, t, &it->rbt_k, it->hk);
+		inserted = true;
+	}
+	pthread_mutex_unlock(&t->mtx);
+	return inserted;
+}
+
+static bool rbtx_remove(struct item *it)
+{
+	struct rbtree_x_part *t = rbtx_partition_of_scalar(&xt, it->hk);
+	bool found;
+
+	mutex_lock(&t->mtx);
+	found = rbtree_x_cached_lookup(&xt, t, &it->rbt_k, it->hk) != NULL;
+	if (found)
+		rbtree_x_cached_remove(&xt, t, &it->rbt_k, it->hk);
+	pthread_mutex_unlock(&t->mtx);
+	return found;
+}
+
+static const struct container containers[] = {
+	{ "ht", ht_plain_setup, ht_teardown, ht_lookup, ht_insert,
+	  ht_remove },
+	{ "ht-cache", ht_cache_setup, ht_teardown, ht_lookup, ht_insert,
+	  ht_remove },
+	{ "ht-resize", ht_resize_setup, ht_teardown, ht_lookup, ht_insert,
+	  ht_remove },
+	{ "avl", avl_setup, avl_teardown, avl_lookup, avl_insert,
+	  avl_remove },
+	{ "cih", cih_setup, cih_teardown, cih_lookup, cih_insert,
+	  cih_remove },
+	{ "rbtx", rbtx_setup, rbtx_teardown, rbtx_lookup, rbtx_insert,
+	  rbtx_remove },
+};
+
+#define NCONTAINERS (sizeof(containers) / sizeof(containers[0]))
+
+/* Workload */
+
+static void zipf_init(void)
+{
+	uint32_t i, j, tmp;
+	uint64_t seed = 0x5eed;
+	double sum = 0.0;
+
+	zipf_cdf = malloc(opt.nkeys * sizeof(double));
+	zipf_perm = malloc(opt.nkeys * sizeof(uint32_t));
+	if (zipf_cdf == NULL || zipf_perm == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	for (i = 0; i < opt.nkeys; i++) {
+		sum += 1.0 / pow(i + 1, opt.zipf);
+		zipf_cdf[i] = sum;
+	}
+	for (i = 0; i < opt.nkeys; i++)
+		zipf_cdf[i] /= sum;
+
+	/* Spread the popular keys over the partitions */
+	for (i = 0; i < opt.nkeys; i++)
+		zipf_perm[i] = i;
+	for (i = opt.nkeys - 1; i > 0; i--) {
+		j = rng_next(&seed) % (i + 1);
+		tmp = zipf_perm[i];
+		zipf_perm[i] = zipf_perm[j];
+		zipf_perm[j] = tmp;
+	}
+}
+
+static inline struct item *pick_item(uint64_t *rng)
+{
+	double u;
+	uint32_t lo, hi, mid;
+
+	if (zipf_cdf == NULL)
+		return &items[rng_next(rng) % opt.nkeys];
+
+	u = (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+	lo = 0;
+	hi = opt.nkeys - 1;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (zipf_cdf[mid] < u)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return &items[zipf_perm[lo]];
+}
+
+static const struct container *running;
+
+static void *bench_thread(void *arg)
+{
+	struct bench_thread *bt = arg;
+	struct item *it;
+	uint64_t start, end;
+	uint32_t dice;
+
+	self = bt;
+	pthread_barrier_wait(&start_barrier);
+
+	while (!stop) {
+		it = pick_item(&bt->rng);
+		dice = rng_next(&bt->rng) % 100;
+
+		start = now_ns();
+		if (dice < opt.read_pct) {
+			bt->lookups++;
+			if (running->lookup(it))
+				bt->hits++;
+		} else if (dice < opt.read_pct + opt.insert_pct) {
+			(void)running->insert(it);
+		} else {
+			(void)running->remove(it);
+		}
+		end = now_ns();
+
+		bt->hist[hist_index(end - start)]++;
+		bt->ops++;
+	}
+
+	self = NULL;
+	return NULL;
+}
+
+static uint64_t percentile(const uint64_t *hist, uint64_t total, double pct)
+{
+	uint64_t want = (uint64_t) (total * pct / 100.0), seen = 0;
+	uint32_t ix;
+
+	for (ix = 0; ix < HIST_BUCKETS; ix++) {
+		seen += hist[ix];
+		if (seen > want)
+			return hist_value(ix);
+	}
+	return hist_value(HIST_BUCKETS - 1);
+}
+
+static void run(const struct container *c, uint32_t nthreads)
+{
+	struct bench_thread *bt = calloc(nthreads, sizeof(*bt));
+	uint64_t hist[HIST_BUCKETS] = { 0 };
+	uint64_t ops = 0, lookups = 0, hits = 0, waits = 0, wait_ns = 0;
+	uint64_t start, elapsed, max = 0;
+	uint32_t i, ix;
+
+	if (bt == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	c->setup();
+	for (i = 0; i < opt.nkeys; i += 2)
+		(void)c->insert(&items[i]);
+
+	running = c;
+	stop = false;
+	pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+	for (i = 0; i < nthreads; i++) {
+		bt[i].rng = mix64(i + 1) | 1;
+		if (pthread_create(&bt[i].id, NULL, bench_thread, &bt[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(1);
+		}
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	start = now_ns();
+	sleep(opt.seconds);
+	stop = true;
+	for (i = 0; i < nthreads; i++)
+		pthread_join(bt[i].id, NULL);
+	elapsed = now_ns() - start;
+	pthread_barrier_destroy(&start_barrier);
+
+	for (i = 0; i < nthreads; i++) {
+		ops += bt[i].ops;
+		lookups += bt[i].lookups;
+		hits += bt[i].hits;
+		waits += bt[i].lock_waits;
+		wait_ns += bt[i].lock_wait_ns;
+		for (ix = 0; ix < HIST_BUCKETS; ix++) {
+			hist[ix] += bt[i].hist[ix];
+			if (bt[i].hist[ix] != 0 && hist_value(ix) > max)
+				max = hist_value(ix);
+		}
+	}
+
+	printf("%-12s %3u thr %12.0f ops/s  hit %5.1f%%  "
+	       "p50 %6" PRIu64 " p99 %7" PRIu64 " p99.9 %8" PRIu64
+	       " max %9" PRIu64 " ns  lock wait %5.1f%% (%" PRIu64 ")\n",
+	       c->name, nthreads, ops * 1e9 / elapsed,
+	       lookups ? hits * 100.0 / lookups : 0.0,
+	       percentile(hist, ops, 50.0), percentile(hist, ops, 99.0),
+	       percentile(hist, ops, 99.9), max,
+	       wait_ns * 100.0 / ((double)elapsed * nthreads), waits);
+
+	c->teardown();
+	free(bt);
+}
+
+static void usage(const char *prog)
+{
+	uint32_t i;
+
+	fprintf(stderr,
+		"Usage: %s [-c container|all] [-t threads[,threads...]]\n"
+		"          [-T seconds] [-n keys] [-r read %%] [-i insert %%]\n"
+		"          [-z zipf exponent] [-p partitions] "
+		"[-s cache slots]\n"
+		"Containers:", prog);
+	for (i = 0; i < NCONTAINERS; i++)
+		fprintf(stderr, " %s", containers[i].name);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *which = "all";
+	const char *threads = "1,2,4,8";
+	char *list, *tok, *save = NULL;
+	uint32_t i, nthreads;
+	bool matched = false;
+	int c;
+
+	while ((c = getopt(argc, argv, "c:t:T:n:r:i:z:p:s:h")) != -1) {
+		switch (c) {
+		case 'c':
+			which = optarg;
+			break;
+		case 't':
+			threads = optarg;
+			break;
+		case 'T':
+			opt.seconds = atoi(optarg);
+			break;
+		case 'n':
+			opt.nkeys = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			opt.read_pct = atoi(optarg);
+			break;
+		case 'i':
+			opt.insert_pct = atoi(optarg);
+			break;
+		case 'z':
+			opt.zipf = atof(optarg);
+			break;
+		case 'p':
+			opt.npart = atoi(optarg);
+			break;
+		case 's':
+			opt.cache_sz = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (opt.nkeys < 2 || opt.npart == 0 || opt.cache_sz == 0
+	    || opt.read_pct + opt.insert_pct > 100)
+		usage(argv[0]);
+
+	real_rdlock = dlsym(RTLD_NEXT, "pthread_rwlock_rdlock");
+	real_wrlock = dlsym(RTLD_NEXT, "pthread_rwlock_wrlock");
+	if (real_rdlock == NULL || real_wrlock == NULL) {
+		fprintf(stderr, "Cannot find the pthread rwlock calls\n");
+		return 1;
+	}
+
+	items = calloc(opt.nkeys, sizeof(*items));
+	if (items == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for (i = 0; i < opt.nkeys; i++) {
+		items[i].key = i;
+		items[i].hk = mix64(i);
+	}
+	if (opt.zipf > 0.0)
+		zipf_init();
+
+	printf("%u keys, %u%% lookup %u%% insert %u%% delete, %s%.2f, "
+	       "%u partitions, %u cache slots, %us per run\n",
+	       opt.nkeys, opt.read_pct, opt.insert_pct,
+	       100 - opt.read_pct - opt.insert_pct,
+	       opt.zipf > 0.0 ? "zipf " : "uniform ", opt.zipf, opt.npart,
+	       opt.cache_sz, opt.seconds);
+
+	for (i = 0; i < NCONTAINERS; i++) {
+		if (strcmp(which, "all") != 0
+		    && strcmp(which, containers[i].name) != 0)
+			continue;
+		matched = true;
+		list = strdup(threads);
+		for (tok = strtok_r(list, ",", &save); tok != NULL;
+		     tok = strtok_r(NULL, ",", &save)) {
+			nthreads = atoi(tok);
+			if (nthreads > 0)
+				run(&containers[i], nthreads);
+		}
+		free(list);
+	}
+
+	if (!matched)
+		usage(argv[0]);
+
+	return 0;
+}
@@ -0,0 +1,431 @@
+/*
+ * vim:noexpandtab:shiftwidth=8:tabstop=8:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ * ---------------------------------------
+ */
+
+/**
+ * @file test_vfs_uring.c
+ * @brief Compare the FSAL_VFS I/O engines
+ *
+ * Worker threads each do one I/O at a time, as NFS workers do,
+ * through vfs_read_async and vfs_write_async, with each engine
+ * FSAL_VFS offers: blocking pread/pwrite, one io_uring shared by all
+ * threads with combined submission, and one io_uring per thread,
+ * optionally through registered buffers.  vfs_uring.c is built into
+ * the test, so what is measured is the engine itself, reaper thread
+ * included; only the handle, the synchronous I/O and the server's
+ * logging and credentials are stubbed.
+ *
+ * Workloads are 4K random and 1M sequential reads and writes on a
+ * scratch file.  For each, ops/s, MB/s, mean latency and I/Os per
+ * io_uring_enter are printed.  io_uring_submit is interposed to count
+ * the latter.
+ *
+ * test_vfs_uring [-d dir] [-s file MB] [-t threads] [-T seconds]
+ *                [-q ring depth] [-f fixed buffers]
+ */
+
+#include "config.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <liburing.h>
+
+#include "log.h"
+#include "fsal.h"
+#include "fsal_convert.h"
+#include "FSAL/access_check.h"
+#include "../FSAL/FSAL_VFS/vfs_methods.h"
+
+enum engine {
+	ENGINE_PREAD,
+	ENGINE_URING_SHARED,
+	ENGINE_URING_PER_THREAD,
+};
+
+static const char * const engine_names[] = {
+	"pread", "io_uring shared", "io_uring per thread"
+};
+
+struct workload {
+	const char *name;
+	size_t io_size;
+	bool random;
+	bool write;
+};
+
+static const struct workload workloads[] = {
+	{ "4K random read", 4096, true, false },
+	{ "4K random write", 4096, true, true },
+	{ "1M sequential read", 1024 * 1024, false, false },
+	{ "1M sequential write", 1024 * 1024, false, true },
+};
+
+struct waiter {
+	pthread_mutex_t mtx;
+	pthread_cond_t cv;
+	bool done;
+	fsal_status_t status;
+};
+
+struct worker {
+	pthread_t thread;
+	void *buf;
+	uint64_t ops;
+	uint64_t bytes;
+	uint64_t lat_ns;
+	uint64_t seq_off;
+	unsigned int seed;
+	struct waiter w;
+};
+
+static const char *dir = "/tmp";
+static uint64_t file_size = 1024ULL * 1024 * 1024;
+static int nthreads = 32;
+static int seconds = 5;
+static unsigned int depth = 256;
+static int nfixed;
+static int fd;
+static volatile bool stop;
+static const struct workload *cur_wl;
+static uint64_t enters;
+
+/* The file, as the engine sees it */
+static struct fsal_module vfs_module;
+static struct fsal_filesystem vfs_fs = {
+	.fsal = &vfs_module,
+};
+static struct vfs_fsal_obj_handle vfs_file;
+
+/* The server's logging is not linked in; the engine's messages are
+ * dropped. */
+static log_levels_t log_levels[COMPONENT_COUNT];
+log_levels_t *component_log_level = log_levels;
+
+void DisplayLogComponentLevel(log_components_t component, char *file,
+			      int line, char *function, log_levels_t level,
+			      char *format, ...)
+{
+}
+
+void SetNameFunction(const char *nom)
+{
+}
+
+/* Nor are credentials, which only matter to quotas */
+__thread struct req_op_context *op_ctx;
+
+void fsal_set_credentials(const struct user_cred *creds)
+{
+}
+
+void fsal_restore_ganesha_credentials()
+{
+}
+
+int posix2fsal_error(int posix_errorcode)
+{
+	return posix_errorcode == 0 ? ERR_FSAL_NO_ERROR : ERR_FSAL_IO;
+}
+
+/* The synchronous I/O of the pread engine and of full rings */
+
+fsal_status_t vfs_read(struct fsal_obj_handle *obj_hdl,
+		       uint64_t offset,
+		       size_t buffer_size, void *buffer, size_t *read_amount,
+		       bool *end_of_file)
+{
+	ssize_t n = pread(fd, buffer, buffer_size, offset);
+
+	if (n < 0)
+		return fsalstat(posix2fsal_error(errno), errno);
+	*read_amount = n;
+	*end_of_file = n == 0;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+fsal_status_t vfs_write(struct fsal_obj_handle *obj_hdl,
+			uint64_t offset,
+			size_t buffer_size, void *buffer, size_t *write_amount,
+			bool *fsal_stable)
+{
+	ssize_t n = pwrite(fd, buffer, buffer_size, offset);
+
+	if (n < 0)
+		return fsalstat(posix2fsal_error(errno), errno);
+	*write_amount = n;
+	*fsal_stable = false;
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+fsal_status_t vfs_commit(struct fsal_obj_handle *obj_hdl,
+			 off_t offset, size_t len)
+{
+	if (fsync(fd) < 0)
+		return fsalstat(posix2fsal_error(errno), errno);
+	return fsalstat(ERR_FSAL_NO_ERROR, 0);
+}
+
+/* Count io_uring_enter calls, made by io_uring_submit */
+
+static int (*real_submit)(struct io_uring *);
+
+int io_uring_submit(struct io_uring *ring)
+{
+	__atomic_add_fetch(&enters, 1, __ATOMIC_RELAXED);
+	return real_submit(ring);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void io_done(struct fsal_obj_handle *obj_hdl, fsal_status_t ret,
+		    void *caller_arg)
+{
+	struct waiter *w = caller_arg;
+
+	pthread_mutex_lock(&w->mtx);
+	w->status = ret;
+	w->done = true;
+	pthread_cond_signal(&w->cv);
+	pthread_mutex_unlock(&w->mtx);
+}
+
+static ssize_t do_io(struct worker *wk, uint64_t off, size_t len)
+{
+	struct fsal_io_arg io = {
+		.offset = off,
+		.io_size = len,
+		.buffer = wk->buf,
+	};
+	fsal_status_t status;
+
+	wk->w.done = false;
+
+	if (cur_wl->write)
+		status = vfs_write_async(&vfs_file.obj_handle, &io, io_done,
+					 &wk->w);
+	else
+		status = vfs_read_async(&vfs_file.obj_handle, &io, io_done,
+					&wk->w);
+	if (FSAL_IS_ERROR(status))
+		return -status.minor;
+
+	pthread_mutex_lock(&wk->w.mtx);
+	while (!wk->w.done)
+		pthread_cond_wait(&wk->w.cv, &wk->w.mtx);
+	pthread_mutex_unlock(&wk->w.mtx);
+
+	if (FSAL_IS_ERROR(wk->w.status))
+		return -wk->w.status.minor;
+	return io.io_amount;
+}
+
+static void *worker_run(void *arg)
+{
+	struct worker *wk = arg;
+	struct req_op_context req_ctx;
+	size_t len = cur_wl->io_size;
+	uint64_t nblocks = file_size / len;
+	uint64_t off, start;
+	ssize_t res;
+
+	memset(&req_ctx, 0, sizeof(req_ctx));
+	op_ctx = &req_ctx;
+
+	while (!stop) {
+		if (cur_wl->random) {
+			off = (rand_r(&wk->seed) % nblocks) * len;
+		} else {
+			off = wk->seq_off;
+			wk->seq_off = (wk->seq_off + len * nthreads) %
+			    (nblocks * len);
+		}
+
+		start = now_ns();
+		res = do_io(wk, off, len);
+		if (res < 0) {
+			fprintf(stderr, "I/O error %zd\n", res);
+			exit(1);
+		}
+		wk->lat_ns += now_ns() - start;
+		wk->ops++;
+		wk->bytes += res;
+	}
+	return NULL;
+}
+
+static void run(enum engine engine, const struct workload *wl)
+{
+	struct worker *wks = calloc(nthreads, sizeof(struct worker));
+	struct vfs_io_engine_params params = {
+		.engine = engine == ENGINE_PREAD ? VFS_IO_ENGINE_PREAD
+		    : VFS_IO_ENGINE_IO_URING,
+		.rings = engine == ENGINE_URING_SHARED ? 1 : 0,
+		.ring_depth = depth,
+		.fixed_buffers = nfixed,
+		.fixed_buffer_size = 1024 * 1024,
+	};
+	uint64_t ops = 0, bytes = 0, lat = 0;
+	int i;
+
+	cur_wl = wl;
+	stop = false;
+	enters = 0;
+
+	vfs_io_engine_init(&params);
+
+	for (i = 0; i < nthreads; i++) {
+		wks[i].seed = i + 1;
+		wks[i].seq_off = (uint64_t)i * wl->io_size;
+		if (posix_memalign(&wks[i].buf, 4096, wl->io_size) != 0)
+			exit(1);
+		memset(wks[i].buf, 'a' + i % 26, wl->io_size);
+		pthread_mutex_init(&wks[i].w.mtx, NULL);
+		pthread_cond_init(&wks[i].w.cv, NULL);
+		pthread_create(&wks[i].thread, NULL, worker_run, &wks[i]);
+	}
+
+	sleep(seconds);
+	stop = true;
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(wks[i].thread, NULL);
+		ops += wks[i].ops;
+		bytes += wks[i].bytes;
+		lat += wks[i].lat_ns;
+		free(wks[i].buf);
+	}
+	vfs_io_engine_shutdown();
+
+	printf("%-20s %-20s %10.0f ops/s %9.1f MB/s %8.1f us",
+	       wl->name, engine_names[engine],
+	       (double)ops / seconds, (double)bytes / seconds / 1048576,
+	       ops ? (double)lat / ops / 1000 : 0.0);
+	if (enters)
+		printf(" %6.2f I/O per enter", (double)ops / enters);
+	printf("\n");
+
+	free(wks);
+}
+
+int main(int argc, char *argv[])
+{
+	char path[PATH_MAX];
+	void *buf;
+	uint64_t off;
+	ssize_t n;
+	size_t w;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:s:t:T:q:f:")) != -1) {
+		switch (opt) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 's':
+			file_size = strtoull(optarg, NULL, 0) * 1024 * 1024;
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'T':
+			seconds = atoi(optarg);
+			break;
+		case 'q':
+			depth = atoi(optarg);
+			break;
+		case 'f':
+			nfixed = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr,
+				"usage: %s [-d dir] [-s file MB] [-t threads] [-T seconds] [-q ring depth] [-f fixed buffers]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (nthreads < 1 || file_size < 1024 * 1024 * (uint64_t)nthreads) {
+		fprintf(stderr, "file too small for %d threads\n", nthreads);
+		return 1;
+	}
+	if (nfixed > (int)depth)
+		nfixed = depth;
+
+	real_submit = dlsym(RTLD_NEXT, "io_uring_submit");
+	if (real_submit == NULL) {
+		fprintf(stderr, "io_uring_submit: %s\n", dlerror());
+		return 1;
+	}
+
+	snprintf(path, sizeof(path), "%s/test_vfs_uring.XXXXXX", dir);
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	unlink(path);
+
+	/* lay the file out so reads hit real blocks */
+	buf = calloc(1, 1024 * 1024);
+	for (off = 0; off < file_size; off += n) {
+		n = pwrite(fd, buf, 1024 * 1024, off);
+		if (n <= 0) {
+			perror("pwrite");
+			return 1;
+		}
+	}
+	free(buf);
+	fsync(fd);
+
+	vfs_file.obj_handle.fsal = &vfs_module;
+	vfs_file.obj_handle.fs = &vfs_fs;
+	vfs_file.obj_handle.attributes.filesize = file_size;
+	vfs_file.u.file.fd = fd;
+	vfs_file.u.file.openflags = FSAL_O_RDWR;
+
+	printf("%d threads, %llu MB file, ring depth %u, %d fixed buffers\n",
+	       nthreads, (unsigned long long)(file_size >> 20), depth,
+	       nfixed);
+
+	for (w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+		run(ENGINE_PREAD, &workloads[w]);
+		run(ENGINE_URING_SHARED, &workloads[w]);
+		run(ENGINE_URING_PER_THREAD, &workloads[w]);
+	}
+
+	close(fd);
+	return 0;
+}